@@ -9,6 +9,9 @@
 //
 
 #include "connection.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <utility>
 #include <vector>
 #include "connection_manager.hpp"
@@ -21,12 +24,45 @@ namespace http
 namespace server
 {
 
+namespace
+{
+
+bool
+iequals(const std::string& a, const std::string& b)
+{
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y)
+                      {
+               return std::tolower(x) == std::tolower(y);
+           });
+}
+
+const std::string*
+find_header(const request& req, const std::string& name)
+{
+    for (auto const& h : req.headers)
+    {
+        if (iequals(h.name, name))
+        {
+            return &h.value;
+        }
+    }
+    return nullptr;
+}
+}
+
 connection::connection(asio::ip::tcp::socket socket,
-                       connection_manager& manager, server& handler)
+                       connection_manager& manager, server& handler,
+                       std::chrono::seconds idle_timeout)
     : socket_(std::move(socket))
     , connection_manager_(manager)
     , request_handler_(handler)
+    , idle_timer_(socket_.get_io_service())
+    , idle_timeout_(idle_timeout)
     , received_count_(0)
+    , reading_body_(false)
+    , body_size_(0)
+    , keep_alive_(false)
 {
 }
 
@@ -39,6 +75,7 @@ connection::start()
 void
 connection::stop()
 {
+    idle_timer_.cancel();
     socket_.close();
 }
 
@@ -46,31 +83,31 @@ void
 connection::do_read()
 {
     auto self(shared_from_this());
+
+    // Without a deadline, a client that stops sending -- typically one
+    // holding a keep-alive connection open between requests -- keeps its
+    // connection (and a slot of the listen backlog) forever.
+    idle_timer_.expires_from_now(idle_timeout_);
+    idle_timer_.async_wait([this, self](asio::error_code ec)
+                           {
+        // A read that completed just as the timer fired has pushed the
+        // deadline back, and the connection stays open.
+        if (ec != asio::error::operation_aborted &&
+            idle_timer_.expires_at() <= std::chrono::steady_clock::now())
+        {
+            connection_manager_.stop(shared_from_this());
+        }
+    });
+
     socket_.async_read_some(asio::buffer(buffer_),
                             [this, self](asio::error_code ec,
                                          std::size_t bytes_transferred)
                             {
+        idle_timer_.expires_at(std::chrono::steady_clock::time_point::max());
         if (!ec)
         {
-            request_parser::result_type result;
-            std::tie(result, std::ignore) = request_parser_.parse(
-                request_, buffer_.data(), buffer_.data() + bytes_transferred);
             received_count_ += bytes_transferred;
-
-            if (result == request_parser::bad || received_count_ > MAX_REQUEST_SIZE)
-            {
-                reply_ = reply::stock_reply(reply::bad_request);
-                do_write();
-            }
-            else if (result == request_parser::good)
-            {
-                request_handler_.handle_request(request_, reply_);
-                do_write();
-            }
-            else
-            {
-                do_read();
-            }
+            consume(buffer_.data(), buffer_.data() + bytes_transferred);
         }
         else if (ec != asio::error::operation_aborted)
         {
@@ -79,13 +116,122 @@ connection::do_read()
     });
 }
 
+void
+connection::consume(const char* begin, const char* end)
+{
+    if (!reading_body_)
+    {
+        request_parser::result_type result;
+        std::tie(result, begin) = request_parser_.parse(request_, begin, end);
+
+        if (result == request_parser::good)
+        {
+            body_size_ = 0;
+            auto length = find_header(request_, "Content-Length");
+            if (length)
+            {
+                char* lengthEnd = nullptr;
+                auto size = std::strtoull(length->c_str(), &lengthEnd, 10);
+                if (length->empty() || *lengthEnd != '\0' ||
+                    size > MAX_REQUEST_SIZE)
+                {
+                    result = request_parser::bad;
+                }
+                body_size_ = static_cast<size_t>(size);
+            }
+            reading_body_ = true;
+        }
+
+        if (result == request_parser::bad ||
+            received_count_ > MAX_REQUEST_SIZE)
+        {
+            keep_alive_ = false;
+            reply_ = reply::stock_reply(reply::bad_request);
+            do_write();
+            return;
+        }
+        else if (result == request_parser::indeterminate)
+        {
+            do_read();
+            return;
+        }
+    }
+
+    auto take = std::min<size_t>(body_size_ - request_.body.size(),
+                                 static_cast<size_t>(end - begin));
+    request_.body.append(begin, take);
+    begin += take;
+    if (request_.body.size() < body_size_)
+    {
+        do_read();
+        return;
+    }
+
+    pending_.assign(begin, end);
+    handle();
+}
+
+void
+connection::handle()
+{
+    // Replies start with an HTTP/1.0 status line, so connections are only
+    // kept open for clients that ask for it.
+    auto connectionHeader = find_header(request_, "Connection");
+    keep_alive_ = connectionHeader && iequals(*connectionHeader, "keep-alive");
+
+    auto self(shared_from_this());
+    if (!request_handler_.handle_async_request(request_, [this, self](reply& rep)
+                                               {
+            reply_ = std::move(rep);
+            do_write();
+        }))
+    {
+        request_handler_.handle_request(request_, reply_);
+        do_write();
+    }
+}
+
 void
 connection::do_write()
 {
+    if (!socket_.is_open())
+    {
+        // Stopped while an asynchronous route was producing the reply.
+        return;
+    }
+
+    header connectionHeader;
+    connectionHeader.name = "Connection";
+    connectionHeader.value = keep_alive_ ? "keep-alive" : "close";
+    reply_.headers.push_back(connectionHeader);
+
     auto self(shared_from_this());
     asio::async_write(socket_, reply_.to_buffers(),
                       [this, self](asio::error_code ec, std::size_t)
                       {
+        if (!ec && keep_alive_)
+        {
+            // Start on the next request, which may already be (partly)
+            // received.
+            request_ = request();
+            request_parser_.reset();
+            reply_ = reply();
+            reading_body_ = false;
+            body_size_ = 0;
+            std::string pending;
+            pending.swap(pending_);
+            received_count_ = pending.size();
+            if (pending.empty())
+            {
+                do_read();
+            }
+            else
+            {
+                consume(pending.data(), pending.data() + pending.size());
+            }
+            return;
+        }
+
         if (!ec)
         {
             // Initiate graceful connection closure.
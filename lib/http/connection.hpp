@@ -16,6 +16,7 @@
 #include "util/asio.h"
 
 #include <array>
+#include <chrono>
 #include <memory>
 #include "reply.hpp"
 #include "request.hpp"
@@ -35,9 +36,11 @@ public:
   connection(const connection&) = delete;
   connection& operator=(const connection&) = delete;
 
-  /// Construct a connection with the given socket.
+  /// Construct a connection with the given socket, to be closed when the
+  /// client sends nothing for idle_timeout.
   explicit connection(asio::ip::tcp::socket socket,
-      connection_manager& manager, server& handler);
+      connection_manager& manager, server& handler,
+      std::chrono::seconds idle_timeout);
 
   /// Start the first asynchronous operation for the connection.
   void start();
@@ -46,9 +49,16 @@ public:
   void stop();
 
 private:
-  /// Perform an asynchronous read operation.
+  /// Perform an asynchronous read operation, closing the connection if it
+  /// does not complete within the idle timeout.
   void do_read();
 
+  /// Parse received data, reading more if the request is not complete.
+  void consume(const char* begin, const char* end);
+
+  /// Hand the complete request to the server.
+  void handle();
+
   /// Perform an asynchronous write operation.
   void do_write();
 
@@ -61,6 +71,12 @@ private:
   /// The handler used to process the incoming request.
   server& request_handler_;
 
+  /// Closes the connection when a read waits longer than idle_timeout_.
+  asio::basic_waitable_timer<std::chrono::steady_clock> idle_timer_;
+
+  /// How long a read may wait for data.
+  std::chrono::seconds idle_timeout_;
+
   /// Buffer for incoming data.
   std::array<char, 8192> buffer_;
 
@@ -70,6 +86,19 @@ private:
   /// The incoming request.
   request request_;
 
+  /// Whether the request's headers are complete and its body is being read.
+  bool reading_body_;
+
+  /// Size of the request's body (its Content-Length).
+  size_t body_size_;
+
+  /// Whether the client asked to keep the connection open for more requests.
+  bool keep_alive_;
+
+  /// Data received after the end of the current request, i.e. the start of
+  /// the next ones when the client pipelines requests.
+  std::string pending_;
+
   /// The parser for the incoming request.
   request_parser request_parser_;
 
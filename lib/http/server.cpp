@@ -23,17 +23,20 @@ server::server(asio::io_service& io_service)
     , acceptor_(io_service_)
     , connection_manager_()
     , socket_(io_service_)
+    , idle_timeout_(0)
 {
 
 }
 
 server::server(asio::io_service& io_service, const std::string& address,
-               unsigned short port, int maxClient)
+               unsigned short port, int maxClient,
+               std::chrono::seconds idleTimeout)
     : io_service_(io_service)
     , signals_(io_service_)
     , acceptor_(io_service_)
     , connection_manager_()
     , socket_(io_service_)
+    , idle_timeout_(idleTimeout)
 {
     asio::ip::tcp::endpoint endpoint(asio::ip::address::from_string(address),
                                      port);
@@ -57,6 +60,13 @@ server::addRoute(const std::string& routeName, routeHandler callback)
     mRoutes[routeName] = callback;
 }
 
+void
+server::addAsyncRoute(const std::string& routeName,
+                      asyncRouteHandler callback)
+{
+    mAsyncRoutes[routeName] = callback;
+}
+
 void
 server::do_accept()
 {
@@ -72,7 +82,8 @@ server::do_accept()
         if (!ec)
         {
             connection_manager_.start(std::make_shared<connection>(
-                std::move(socket_), connection_manager_, *this));
+                std::move(socket_), connection_manager_, *this,
+                idle_timeout_));
         }
 
         do_accept();
@@ -85,22 +96,20 @@ server::~server()
     connection_manager_.stop_all();
 }
 
-void
-server::handle_request(const request& req, reply& rep)
+bool
+server::split_uri(const request& req, std::string& command,
+                  std::string& params)
 {
     // Decode url to path.
     std::string request_path;
     if (!url_decode(req.uri, request_path))
     {
-        rep = reply::stock_reply(reply::bad_request);
-        return;
+        return false;
     }
 
     if (request_path.size() && request_path[0] == '/')
         request_path = request_path.substr(1);
 
-    std::string command;
-    std::string params;
     auto pos = request_path.find('?');
     if (pos == std::string::npos)
         command = request_path;
@@ -109,6 +118,51 @@ server::handle_request(const request& req, reply& rep)
         command = request_path.substr(0, pos);
         params = request_path.substr(pos);
     }
+    return true;
+}
+
+bool
+server::handle_async_request(const request& req,
+                             std::function<void(reply&)> done)
+{
+    std::string command;
+    std::string params;
+    if (!split_uri(req, command, params))
+    {
+        return false;
+    }
+
+    auto it = mAsyncRoutes.find(command);
+    if (it == mAsyncRoutes.end())
+    {
+        return false;
+    }
+
+    it->second(req, [done](const std::string& content)
+               {
+        reply rep;
+        rep.status = reply::ok;
+        rep.content = content;
+        rep.headers.resize(2);
+        rep.headers[0].name = "Content-Length";
+        rep.headers[0].value = std::to_string(rep.content.size());
+        rep.headers[1].name = "Content-Type";
+        rep.headers[1].value = "application/json";
+        done(rep);
+    });
+    return true;
+}
+
+void
+server::handle_request(const request& req, reply& rep)
+{
+    std::string command;
+    std::string params;
+    if (!split_uri(req, command, params))
+    {
+        rep = reply::stock_reply(reply::bad_request);
+        return;
+    }
 
     if (mRoutes.find(command) != mRoutes.end())
     {
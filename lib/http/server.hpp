@@ -15,6 +15,7 @@
 // else.
 #include "util/asio.h"
 
+#include <chrono>
 #include <string>
 #include <map>
 #include <functional>
@@ -30,22 +31,37 @@ class server
 
 public:
     typedef std::function<void(const std::string&, std::string&)> routeHandler;
+    /// A route whose reply is produced later: the handler is given the whole
+    /// request (including its body) and must eventually call the callback,
+    /// once and on the io_service's thread, with the JSON reply content.
+    typedef std::function<void(const request&,
+                               std::function<void(const std::string&)>)>
+        asyncRouteHandler;
     server(const server&) = delete;
     server& operator=(const server&) = delete;
 
     // construct a server that just doesn't listen
     server(asio::io_service& io_service);
 
-    /// Construct the server to listen on the specified TCP address and port
+    /// Construct the server to listen on the specified TCP address and port;
+    /// clients that send nothing for idleTimeout are disconnected.
     explicit server(asio::io_service& io_service,
-                    const std::string& address, unsigned short port, int maxClient);
+                    const std::string& address, unsigned short port, int maxClient,
+                    std::chrono::seconds idleTimeout);
     ~server();
 
     void addRoute(const std::string& routeName, routeHandler callback);
     void add404(routeHandler callback);
+    void addAsyncRoute(const std::string& routeName,
+                       asyncRouteHandler callback);
 
     void handle_request(const request& req, reply& rep);
 
+    /// Dispatch the request to an asynchronous route, which calls done with
+    /// the reply. Returns false, without calling done, if there is none.
+    bool handle_async_request(const request& req,
+                              std::function<void(reply&)> done);
+
     static void parseParams(const std::string& params, std::map<std::string, std::string>& retMap);
 
 private:
@@ -56,6 +72,11 @@ private:
     /// invalid.
     static bool url_decode(const std::string& in, std::string& out);
 
+    /// Split the request's URI into a command and its parameters. Returns
+    /// false if the URI is invalid.
+    static bool split_uri(const request& req, std::string& command,
+                          std::string& params);
+
     /// The io_service used to perform asynchronous operations.
     asio::io_service& io_service_;
 
@@ -71,7 +92,11 @@ private:
     /// The next socket to be accepted.
     asio::ip::tcp::socket socket_;
 
+    /// How long a connection may wait for data before it is closed.
+    std::chrono::seconds idle_timeout_;
+
     std::map<std::string, routeHandler> mRoutes;
+    std::map<std::string, asyncRouteHandler> mAsyncRoutes;
 };
 
 } // namespace server
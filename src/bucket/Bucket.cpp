@@ -8,8 +8,11 @@
 #include "util/asio.h"
 #include "bucket/Bucket.h"
 #include "bucket/BucketApplicator.h"
+#include "bucket/BucketBloomFilter.h"
+#include "bucket/BucketIndex.h"
 #include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
+#include "bucket/BucketMergeScheduler.h"
 #include "bucket/BucketOutputIterator.h"
 #include "bucket/LedgerCmp.h"
 #include "crypto/Hex.h"
@@ -31,12 +34,26 @@
 #include "util/TmpDir.h"
 #include "util/XDRStream.h"
 #include "xdrpp/message.h"
+#include <algorithm>
 #include <cassert>
 #include <future>
 
 namespace stellar
 {
 
+namespace
+{
+LedgerKey
+bucketEntryKey(BucketEntry const& e)
+{
+    if (e.type() == LIVEENTRY)
+    {
+        return LedgerEntryKey(e.liveEntry());
+    }
+    return e.deadEntry();
+}
+}
+
 Bucket::Bucket(std::string const& filename, Hash const& hash)
     : mFilename(filename), mHash(hash)
 {
@@ -64,20 +81,161 @@ Bucket::getFilename() const
     return mFilename;
 }
 
-bool
-Bucket::containsBucketIdentity(BucketEntry const& id) const
+std::string
+Bucket::getBloomFilterFilename() const
 {
-    BucketEntryIdCmp cmp;
+    assert(!mFilename.empty());
+    return mFilename + ".bloom";
+}
+
+std::string
+Bucket::getIndexFilename() const
+{
+    assert(!mFilename.empty());
+    return mFilename + ".index";
+}
+
+void
+Bucket::loadIndexes() const
+{
+    assert(!mFilename.empty());
+    if (!mBloomFilter)
+    {
+        mBloomFilter = BucketBloomFilter::load(getBloomFilterFilename());
+    }
+    if (!mIndex)
+    {
+        mIndex = BucketIndex::load(getIndexFilename());
+    }
+    if (mBloomFilter && mIndex)
+    {
+        return;
+    }
+
+    CLOG(DEBUG, "Bucket") << "Building key filter and index for "
+                          << mFilename;
+    BucketBloomFilter::Builder filterBuilder;
+    BucketIndex::Builder indexBuilder;
+    for (BucketInputIterator iter(shared_from_this()); iter; ++iter)
+    {
+        filterBuilder.add(BucketBloomFilter::hashKey(*iter));
+        indexBuilder.add(*iter, iter.pos());
+    }
+    if (!mBloomFilter)
+    {
+        mBloomFilter = filterBuilder.finish();
+        mBloomFilter->save(getBloomFilterFilename());
+    }
+    if (!mIndex)
+    {
+        mIndex = indexBuilder.finish();
+        mIndex->save(getIndexFilename());
+    }
+}
+
+std::shared_ptr<BucketBloomFilter const>
+Bucket::getBloomFilter() const
+{
+    if (mFilename.empty())
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mIndexMutex);
+    loadIndexes();
+    return mBloomFilter;
+}
+
+std::shared_ptr<BucketIndex const>
+Bucket::getIndex() const
+{
+    if (mFilename.empty())
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mIndexMutex);
+    loadIndexes();
+    return mIndex;
+}
+
+void
+Bucket::setIndexes(std::shared_ptr<BucketBloomFilter const> filter,
+                   std::shared_ptr<BucketIndex const> index)
+{
+    assert(filter);
+    assert(index);
+    if (mFilename.empty())
+    {
+        return;
+    }
+
+    // Adopting a file may hand back an existing bucket, whose filter and
+    // index may already be on disk.
+    std::lock_guard<std::mutex> lock(mIndexMutex);
+    if (!mBloomFilter)
+    {
+        if (!fs::exists(getBloomFilterFilename()))
+        {
+            filter->save(getBloomFilterFilename());
+        }
+        mBloomFilter = filter;
+    }
+    if (!mIndex)
+    {
+        if (!fs::exists(getIndexFilename()))
+        {
+            index->save(getIndexFilename());
+        }
+        mIndex = index;
+    }
+}
+
+optional<BucketEntry>
+Bucket::getBucketEntry(LedgerKey const& key) const
+{
+    auto filter = getBloomFilter();
+    if (!filter || !filter->mayContain(key))
+    {
+        return nullopt<BucketEntry>();
+    }
+
+    LedgerEntryIdCmp cmp;
     BucketInputIterator iter(shared_from_this());
-    while (iter)
+    iter.seek(getIndex()->getRunOffset(key));
+    for (uint32_t i = 0; iter && i < BucketIndex::kStride; ++i, ++iter)
     {
-        if (!(cmp(*iter, id) || cmp(id, *iter)))
+        auto const& e = *iter;
+        if (e.type() == LIVEENTRY)
+        {
+            auto const& data = e.liveEntry().data;
+            if (cmp(key, data))
+            {
+                break;
+            }
+            if (!cmp(data, key))
+            {
+                return make_optional<BucketEntry>(e);
+            }
+        }
+        else
         {
-            return true;
+            auto const& k = e.deadEntry();
+            if (cmp(key, k))
+            {
+                break;
+            }
+            if (!cmp(k, key))
+            {
+                return make_optional<BucketEntry>(e);
+            }
         }
-        ++iter;
     }
-    return false;
+    return nullopt<BucketEntry>();
+}
+
+bool
+Bucket::containsBucketIdentity(BucketEntry const& id) const
+{
+    return static_cast<bool>(getBucketEntry(bucketEntryKey(id)));
 }
 
 std::pair<size_t, size_t>
@@ -110,64 +268,181 @@ Bucket::apply(Database& db) const
     }
 }
 
+namespace
+{
+// Batches at least this large are sorted on several threads.
+size_t const kParallelSortThreshold = 8192;
+
+// Sorts the lower half of [begin, end) on one of the merge scheduler's
+// threads while this thread sorts the upper half. The lower half is queued
+// ahead of every merge, but if no scheduler thread has picked it up by the
+// time the upper half is sorted, this thread sorts it too rather than wait.
+void
+sortBucketEntries(BucketMergeScheduler& scheduler,
+                  std::vector<BucketEntry>::iterator begin,
+                  std::vector<BucketEntry>::iterator end, unsigned depth)
+{
+    BucketEntryIdCmp cmp;
+    if (depth == 0 ||
+        static_cast<size_t>(end - begin) < kParallelSortThreshold)
+    {
+        std::sort(begin, end, cmp);
+        return;
+    }
+    auto mid = begin + (end - begin) / 2;
+    auto lower = std::make_shared<std::packaged_task<void()>>(
+        [&scheduler, begin, mid, depth]() {
+            sortBucketEntries(scheduler, begin, mid, depth - 1);
+        });
+    auto lowerSorted = lower->get_future();
+    auto job = scheduler.schedule(0, [lower]() { (*lower)(); });
+    sortBucketEntries(scheduler, mid, end, depth - 1);
+    job->run();
+    lowerSorted.get();
+    std::inplace_merge(begin, mid, end, cmp);
+}
+
+void
+sortBucketEntries(BucketMergeScheduler& scheduler,
+                  std::vector<BucketEntry>& entries)
+{
+    // Batches taken from a LedgerDelta arrive already sorted.
+    if (std::is_sorted(entries.begin(), entries.end(), BucketEntryIdCmp()))
+    {
+        return;
+    }
+    // Split into at most one piece per scheduler thread, plus one for this
+    // thread.
+    unsigned depth = 0;
+    for (size_t n = scheduler.getThreadCount() + 1; n > 1 && depth < 3;
+         n /= 2)
+    {
+        ++depth;
+    }
+    sortBucketEntries(scheduler, entries.begin(), entries.end(), depth);
+}
+}
+
 std::shared_ptr<Bucket>
 Bucket::fresh(BucketManager& bucketManager,
-              std::vector<LedgerEntry> const& liveEntries,
-              std::vector<LedgerKey> const& deadEntries)
+              std::vector<LedgerEntry> liveEntries,
+              std::vector<LedgerKey> deadEntries)
 {
-    std::vector<BucketEntry> live, dead, combined;
+    std::vector<BucketEntry> live, dead;
     live.reserve(liveEntries.size());
     dead.reserve(deadEntries.size());
 
-    for (auto const& e : liveEntries)
+    for (auto& e : liveEntries)
     {
-        BucketEntry ce;
-        ce.type(LIVEENTRY);
-        ce.liveEntry() = e;
-        live.push_back(ce);
+        live.emplace_back(LIVEENTRY);
+        live.back().liveEntry() = std::move(e);
     }
 
-    for (auto const& e : deadEntries)
+    for (auto& e : deadEntries)
     {
-        BucketEntry ce;
-        ce.type(DEADENTRY);
-        ce.deadEntry() = e;
-        dead.push_back(ce);
+        dead.emplace_back(DEADENTRY);
+        dead.back().deadEntry() = std::move(e);
     }
 
-    std::sort(live.begin(), live.end(), BucketEntryIdCmp());
-
-    std::sort(dead.begin(), dead.end(), BucketEntryIdCmp());
+    auto& scheduler = bucketManager.getMergeScheduler();
+    sortBucketEntries(scheduler, live);
+    sortBucketEntries(scheduler, dead);
 
-    BucketOutputIterator liveOut(bucketManager.getTmpDir(), true);
-    BucketOutputIterator deadOut(bucketManager.getTmpDir(), true);
-    for (auto const& e : live)
+    // Interleave the sorted live and dead entries into a single output file,
+    // exactly as merging a bucket of the live entries with a (newer) bucket
+    // of the dead entries would: a dead entry overrides every live entry with
+    // the same key, and among duplicates the last in sort order wins.
+    auto timer = LogSlowExecution("Bucket fresh");
+    BucketOutputIterator out(bucketManager.getTmpDir(), true);
+    BucketEntryIdCmp cmp;
+    auto li = live.begin();
+    auto di = dead.begin();
+    while (li != live.end() || di != dead.end())
     {
-        liveOut.put(e);
+        if (di == dead.end() || (li != live.end() && cmp(*li, *di)))
+        {
+            out.put(std::move(*li++));
+        }
+        else if (li == live.end() || cmp(*di, *li))
+        {
+            out.put(std::move(*di++));
+        }
+        else
+        {
+            while (li != live.end() && !cmp(*di, *li))
+            {
+                ++li;
+            }
+            out.put(std::move(*di++));
+        }
     }
-    for (auto const& e : dead)
+    return out.getBucket(bucketManager);
+}
+
+namespace
+{
+// A shadow bucket consulted during a merge. The shadow's file is only opened,
+// and its iterator only advanced, once its key filter reports that some
+// candidate entry might be present; shadows that shadow nothing in a given
+// merge are therefore never read. When the iterator does advance, the index
+// lets it seek over whole runs of entries instead of reading them.
+struct ShadowCursor
+{
+    std::shared_ptr<Bucket const> mBucket;
+    std::shared_ptr<BucketBloomFilter const> mFilter;
+    std::shared_ptr<BucketIndex const> mIndex;
+    std::unique_ptr<BucketInputIterator> mIter;
+
+    explicit ShadowCursor(std::shared_ptr<Bucket const> const& b)
+        : mBucket(b), mFilter(b->getBloomFilter()), mIndex(b->getIndex())
     {
-        deadOut.put(e);
     }
 
-    auto liveBucket = liveOut.getBucket(bucketManager);
-    auto deadBucket = deadOut.getBucket(bucketManager);
-
-    std::shared_ptr<Bucket> bucket;
+    BucketInputIterator&
+    iterTowards(LedgerKey const& key)
     {
-        auto timer = LogSlowExecution("Bucket merge");
-        bucket = Bucket::merge(bucketManager, liveBucket, deadBucket);
+        if (!mIter)
+        {
+            mIter = std::make_unique<BucketInputIterator>(mBucket);
+        }
+        if (*mIter)
+        {
+            auto offset = mIndex->getRunOffset(key);
+            if (offset > mIter->pos())
+            {
+                mIter->seek(offset);
+            }
+        }
+        return *mIter;
     }
-    return bucket;
+};
 }
 
 inline void
 maybePut(BucketOutputIterator& out, BucketEntry const& entry,
-         std::vector<BucketInputIterator>& shadowIterators)
+         std::vector<ShadowCursor>& shadowCursors)
 {
+    if (shadowCursors.empty())
+    {
+        out.put(entry);
+        return;
+    }
+
     BucketEntryIdCmp cmp;
-    for (auto& si : shadowIterators)
+    auto key = bucketEntryKey(entry);
+    auto keyHash = BucketBloomFilter::hashKey(key);
+    for (auto& sc : shadowCursors)
     {
+        // Empty shadows, and shadows whose filter definitely lacks the
+        // entry's key, cannot shadow it. Leaving their iterators where they
+        // are is fine: they only ever need to move forward, and will do so
+        // as and if necessary in future calls to maybePut.
+        if (!sc.mFilter || !sc.mFilter->mayContain(keyHash))
+        {
+            continue;
+        }
+
+        auto& si = sc.iterTowards(key);
         // Advance the shadowIterator while it's less than the candidate
         while (si && cmp(*si, entry))
         {
@@ -206,8 +481,7 @@ Bucket::merge(BucketManager& bucketManager,
     BucketInputIterator oi(oldBucket);
     BucketInputIterator ni(newBucket);
 
-    std::vector<BucketInputIterator> shadowIterators(shadows.begin(),
-                                                     shadows.end());
+    std::vector<ShadowCursor> shadowCursors(shadows.begin(), shadows.end());
 
     auto timer = bucketManager.getMergeTimer().TimeScope();
     BucketOutputIterator out(bucketManager.getTmpDir(), keepDeadEntries);
@@ -218,31 +492,31 @@ Bucket::merge(BucketManager& bucketManager,
         if (!ni)
         {
             // Out of new entries, take old entries.
-            maybePut(out, *oi, shadowIterators);
+            maybePut(out, *oi, shadowCursors);
             ++oi;
         }
         else if (!oi)
         {
             // Out of old entries, take new entries.
-            maybePut(out, *ni, shadowIterators);
+            maybePut(out, *ni, shadowCursors);
             ++ni;
         }
         else if (cmp(*oi, *ni))
         {
             // Next old-entry has smaller key, take it.
-            maybePut(out, *oi, shadowIterators);
+            maybePut(out, *oi, shadowCursors);
             ++oi;
         }
         else if (cmp(*ni, *oi))
         {
             // Next new-entry has smaller key, take it.
-            maybePut(out, *ni, shadowIterators);
+            maybePut(out, *ni, shadowCursors);
             ++ni;
         }
         else
         {
             // Old and new are for the same key, take new.
-            maybePut(out, *ni, shadowIterators);
+            maybePut(out, *ni, shadowCursors);
             ++oi;
             ++ni;
         }
@@ -9,6 +9,8 @@
 #include "overlay/StellarXDR.h"
 #include "util/NonCopyable.h"
 #include "util/XDRStream.h"
+#include "util/optional.h"
+#include <mutex>
 #include <string>
 
 namespace medida
@@ -30,6 +32,8 @@ namespace stellar
  * merged in sorted order, and all elements are hashed while being added.
  */
 
+class BucketBloomFilter;
+class BucketIndex;
 class BucketManager;
 class BucketList;
 class Database;
@@ -41,6 +45,17 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
     std::string const mFilename;
     Hash const mHash;
 
+    // The key filter and sparse index are derived data rather than bucket
+    // content, so they are attached lazily; they never change once set.
+    mutable std::mutex mIndexMutex;
+    mutable std::shared_ptr<BucketBloomFilter const> mBloomFilter;
+    mutable std::shared_ptr<BucketIndex const> mIndex;
+
+    // Load the key filter and index from their files, or failing that build
+    // them in a single scan of the bucket and persist them. Caller must hold
+    // mIndexMutex.
+    void loadIndexes() const;
+
   public:
     // Create an empty bucket. The empty bucket has hash '000000...' and its
     // filename is the empty string.
@@ -54,6 +69,29 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
     Hash const& getHash() const;
     std::string const& getFilename() const;
 
+    // Return the names of the files persisting this bucket's key filter and
+    // sparse index.
+    std::string getBloomFilterFilename() const;
+    std::string getIndexFilename() const;
+
+    // Return a filter over the keys in this bucket, or nullptr for the empty
+    // bucket. The filter is loaded from its persisted file or, if there is
+    // none, built by scanning the bucket and then persisted. Threadsafe.
+    std::shared_ptr<BucketBloomFilter const> getBloomFilter() const;
+
+    // Return the sparse key index of this bucket, or nullptr for the empty
+    // bucket. Loaded or built like the key filter. Threadsafe.
+    std::shared_ptr<BucketIndex const> getIndex() const;
+
+    // Attach a filter and index built while writing this bucket, persisting
+    // them unless the bucket already has them.
+    void setIndexes(std::shared_ptr<BucketBloomFilter const> filter,
+                    std::shared_ptr<BucketIndex const> index);
+
+    // Return the entry (live or dead) for `key` in this bucket, or nullopt if
+    // the bucket has none. Reads at most one index run of the bucket file.
+    optional<BucketEntry> getBucketEntry(LedgerKey const& key) const;
+
     // Returns true if a BucketEntry that is key-wise identical to the given
     // BucketEntry exists in the bucket. For testing.
     bool containsBucketIdentity(BucketEntry const& id) const;
@@ -70,16 +108,18 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
 
     // Create a fresh bucket from a given vector of live LedgerEntries and
     // dead LedgerEntryKeys. The bucket will be sorted, hashed, and adopted
-    // in the provided BucketManager.
-    static std::shared_ptr<Bucket>
-    fresh(BucketManager& bucketManager,
-          std::vector<LedgerEntry> const& liveEntries,
-          std::vector<LedgerKey> const& deadEntries);
+    // in the provided BucketManager. Entries are moved out of the vectors
+    // passed, which callers should hand over with std::move when they can;
+    // inputs that are already sorted (eg. from a LedgerDelta) skip sorting.
+    static std::shared_ptr<Bucket> fresh(BucketManager& bucketManager,
+                                         std::vector<LedgerEntry> liveEntries,
+                                         std::vector<LedgerKey> deadEntries);
 
     // Merge two buckets together, producing a fresh one. Entries in `oldBucket`
     // are overridden in the fresh bucket by keywise-equal entries in
     // `newBucket`. Entries are inhibited from the fresh bucket by keywise-equal
-    // entries in any of the buckets in the provided `shadows` vector.
+    // entries in any of the buckets in the provided `shadows` vector; shadows
+    // are only read for entries their key filters say they might contain.
     static std::shared_ptr<Bucket>
     merge(BucketManager& bucketManager,
           std::shared_ptr<Bucket> const& oldBucket,
@@ -0,0 +1,181 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketBloomFilter.h"
+#include "crypto/Hex.h"
+#include "crypto/Random.h"
+#include "crypto/SHA.h"
+#include "ledger/EntryFrame.h"
+#include "util/Logging.h"
+#include "xdrpp/marshal.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace stellar
+{
+
+uint32_t const BucketBloomFilter::kBitsPerKey = 10;
+uint32_t const BucketBloomFilter::kNumProbes = 7;
+
+namespace
+{
+uint32_t const kMagic = 0x42424631; // "BBF1"
+
+uint64_t
+readWord(uint256 const& h, size_t offset)
+{
+    uint64_t w = 0;
+    for (size_t i = 0; i < 8; ++i)
+    {
+        w = (w << 8) | h[offset + i];
+    }
+    return w;
+}
+}
+
+BucketBloomFilter::KeyHash
+BucketBloomFilter::hashKey(LedgerKey const& k)
+{
+    auto h = sha256(xdr::xdr_to_opaque(k));
+    // Force the second hash odd so probe sequences never degenerate.
+    return KeyHash{readWord(h, 0), readWord(h, 8) | 1};
+}
+
+BucketBloomFilter::KeyHash
+BucketBloomFilter::hashKey(BucketEntry const& e)
+{
+    if (e.type() == LIVEENTRY)
+    {
+        return hashKey(LedgerEntryKey(e.liveEntry()));
+    }
+    return hashKey(e.deadEntry());
+}
+
+void
+BucketBloomFilter::Builder::add(KeyHash const& h)
+{
+    mHashes.push_back(h);
+}
+
+void
+BucketBloomFilter::Builder::add(LedgerKey const& k)
+{
+    add(hashKey(k));
+}
+
+std::shared_ptr<BucketBloomFilter const>
+BucketBloomFilter::Builder::finish() const
+{
+    auto f = std::make_shared<BucketBloomFilter>();
+    size_t nBits = std::max<size_t>(64, mHashes.size() * kBitsPerKey);
+    f->mBits.resize((nBits + 63) / 64, 0);
+    f->mNumProbes = kNumProbes;
+    for (auto const& h : mHashes)
+    {
+        f->set(h);
+    }
+    return f;
+}
+
+void
+BucketBloomFilter::set(KeyHash const& h)
+{
+    uint64_t nBits = mBits.size() * 64;
+    for (uint32_t i = 0; i < mNumProbes; ++i)
+    {
+        uint64_t bit = (h.mH1 + i * h.mH2) % nBits;
+        mBits[bit / 64] |= (uint64_t(1) << (bit % 64));
+    }
+}
+
+bool
+BucketBloomFilter::mayContain(KeyHash const& h) const
+{
+    uint64_t nBits = mBits.size() * 64;
+    if (nBits == 0)
+    {
+        return true;
+    }
+    for (uint32_t i = 0; i < mNumProbes; ++i)
+    {
+        uint64_t bit = (h.mH1 + i * h.mH2) % nBits;
+        if ((mBits[bit / 64] & (uint64_t(1) << (bit % 64))) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+BucketBloomFilter::mayContain(LedgerKey const& k) const
+{
+    return mayContain(hashKey(k));
+}
+
+void
+BucketBloomFilter::save(std::string const& filename) const
+{
+    // Write to a temporary name and rename into place, so a crash mid-write
+    // never leaves a truncated filter that claims to be complete. The name is
+    // unique so that concurrent writers of the same filter do not interleave.
+    std::string tmp = filename + ".tmp-" + binToHex(randomBytes(8));
+    {
+        std::ofstream out(tmp, std::ofstream::binary | std::ofstream::trunc);
+        uint64_t nWords = mBits.size();
+        out.write(reinterpret_cast<char const*>(&kMagic), sizeof(kMagic));
+        out.write(reinterpret_cast<char const*>(&mNumProbes),
+                  sizeof(mNumProbes));
+        out.write(reinterpret_cast<char const*>(&nWords), sizeof(nWords));
+        out.write(reinterpret_cast<char const*>(mBits.data()),
+                  nWords * sizeof(uint64_t));
+        if (!out)
+        {
+            CLOG(WARNING, "Bucket") << "Failed to write bloom filter " << tmp;
+            out.close();
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+        CLOG(WARNING, "Bucket") << "Failed to rename bloom filter " << tmp;
+        std::remove(tmp.c_str());
+    }
+}
+
+std::shared_ptr<BucketBloomFilter const>
+BucketBloomFilter::load(std::string const& filename)
+{
+    std::ifstream in(filename, std::ifstream::binary);
+    if (!in)
+    {
+        return nullptr;
+    }
+    uint32_t magic = 0;
+    uint64_t nWords = 0;
+    auto f = std::make_shared<BucketBloomFilter>();
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    in.read(reinterpret_cast<char*>(&f->mNumProbes), sizeof(f->mNumProbes));
+    in.read(reinterpret_cast<char*>(&nWords), sizeof(nWords));
+    if (!in || magic != kMagic || f->mNumProbes == 0 || nWords == 0 ||
+        nWords > (uint64_t(1) << 32))
+    {
+        CLOG(WARNING, "Bucket") << "Ignoring malformed bloom filter "
+                                << filename;
+        return nullptr;
+    }
+    f->mBits.resize(nWords);
+    in.read(reinterpret_cast<char*>(f->mBits.data()),
+            nWords * sizeof(uint64_t));
+    if (!in)
+    {
+        CLOG(WARNING, "Bucket") << "Ignoring truncated bloom filter "
+                                << filename;
+        return nullptr;
+    }
+    return f;
+}
+}
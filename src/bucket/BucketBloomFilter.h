@@ -0,0 +1,70 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/StellarXDR.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * BucketBloomFilter is a compact, probabilistic set of the LedgerKeys present
+ * in a bucket. It never reports a present key as absent, but may report an
+ * absent key as present (at roughly a 1% rate with the default sizing).
+ *
+ * Filters are built by feeding keys to a BucketBloomFilter::Builder as a bucket
+ * is written, and are persisted next to the bucket file so that they survive
+ * restarts. The on-disk format is host-local cache data: a filter that fails to
+ * load is simply rebuilt from the bucket.
+ */
+class BucketBloomFilter
+{
+  public:
+    // A key digest; computed once per key and reusable across several filters.
+    struct KeyHash
+    {
+        uint64_t mH1;
+        uint64_t mH2;
+    };
+
+    class Builder
+    {
+        std::vector<KeyHash> mHashes;
+
+      public:
+        void add(KeyHash const& h);
+        void add(LedgerKey const& k);
+        std::shared_ptr<BucketBloomFilter const> finish() const;
+    };
+
+    static KeyHash hashKey(LedgerKey const& k);
+    static KeyHash hashKey(BucketEntry const& e);
+
+    bool mayContain(KeyHash const& h) const;
+    bool mayContain(LedgerKey const& k) const;
+
+    // Write the filter to `filename`, replacing any existing file.
+    void save(std::string const& filename) const;
+
+    // Read a filter previously written by save(); returns nullptr if the file
+    // is missing or malformed.
+    static std::shared_ptr<BucketBloomFilter const>
+    load(std::string const& filename);
+
+    // Bits of filter per key, and resulting number of probes.
+    static uint32_t const kBitsPerKey;
+    static uint32_t const kNumProbes;
+
+  private:
+    uint32_t mNumProbes{0};
+    std::vector<uint64_t> mBits;
+
+    void set(KeyHash const& h);
+};
+}
@@ -0,0 +1,161 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketIndex.h"
+#include "bucket/LedgerCmp.h"
+#include "crypto/Hex.h"
+#include "crypto/Random.h"
+#include "ledger/EntryFrame.h"
+#include "util/Logging.h"
+#include "xdrpp/marshal.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace stellar
+{
+
+uint32_t const BucketIndex::kStride = 128;
+
+namespace
+{
+uint32_t const kMagic = 0x42494431; // "BID1"
+uint32_t const kMaxKeySize = 0x10000;
+}
+
+void
+BucketIndex::Builder::add(BucketEntry const& e, uint64_t offset)
+{
+    if (mCount++ % kStride != 0)
+    {
+        return;
+    }
+    if (e.type() == LIVEENTRY)
+    {
+        mEntries.emplace_back(LedgerEntryKey(e.liveEntry()), offset);
+    }
+    else
+    {
+        mEntries.emplace_back(e.deadEntry(), offset);
+    }
+}
+
+std::shared_ptr<BucketIndex const>
+BucketIndex::Builder::finish()
+{
+    auto idx = std::make_shared<BucketIndex>();
+    idx->mEntries = std::move(mEntries);
+    mEntries.clear();
+    mCount = 0;
+    return idx;
+}
+
+uint64_t
+BucketIndex::getRunOffset(LedgerKey const& k) const
+{
+    LedgerEntryIdCmp cmp;
+    // First indexed entry strictly greater than k; the run containing k
+    // starts at the entry before it.
+    auto i = std::upper_bound(
+        mEntries.begin(), mEntries.end(), k,
+        [&cmp](LedgerKey const& key,
+               std::pair<LedgerKey, uint64_t> const& entry) {
+            return cmp(key, entry.first);
+        });
+    if (i == mEntries.begin())
+    {
+        return 0;
+    }
+    return std::prev(i)->second;
+}
+
+void
+BucketIndex::save(std::string const& filename) const
+{
+    // Write to a temporary name and rename into place, so a crash mid-write
+    // never leaves a truncated index that claims to be complete. The name is
+    // unique so that concurrent writers of the same index do not interleave.
+    std::string tmp = filename + ".tmp-" + binToHex(randomBytes(8));
+    {
+        std::ofstream out(tmp, std::ofstream::binary | std::ofstream::trunc);
+        uint64_t n = mEntries.size();
+        out.write(reinterpret_cast<char const*>(&kMagic), sizeof(kMagic));
+        out.write(reinterpret_cast<char const*>(&n), sizeof(n));
+        for (auto const& e : mEntries)
+        {
+            auto key = xdr::xdr_to_opaque(e.first);
+            uint32_t sz = static_cast<uint32_t>(key.size());
+            out.write(reinterpret_cast<char const*>(&e.second),
+                      sizeof(e.second));
+            out.write(reinterpret_cast<char const*>(&sz), sizeof(sz));
+            out.write(reinterpret_cast<char const*>(key.data()), sz);
+        }
+        if (!out)
+        {
+            CLOG(WARNING, "Bucket") << "Failed to write bucket index " << tmp;
+            out.close();
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+        CLOG(WARNING, "Bucket") << "Failed to rename bucket index " << tmp;
+        std::remove(tmp.c_str());
+    }
+}
+
+std::shared_ptr<BucketIndex const>
+BucketIndex::load(std::string const& filename)
+{
+    std::ifstream in(filename, std::ifstream::binary);
+    if (!in)
+    {
+        return nullptr;
+    }
+    uint32_t magic = 0;
+    uint64_t n = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    in.read(reinterpret_cast<char*>(&n), sizeof(n));
+    if (!in || magic != kMagic)
+    {
+        CLOG(WARNING, "Bucket") << "Ignoring malformed bucket index "
+                                << filename;
+        return nullptr;
+    }
+
+    auto idx = std::make_shared<BucketIndex>();
+    std::vector<uint8_t> buf;
+    try
+    {
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            uint64_t offset = 0;
+            uint32_t sz = 0;
+            in.read(reinterpret_cast<char*>(&offset), sizeof(offset));
+            in.read(reinterpret_cast<char*>(&sz), sizeof(sz));
+            if (!in || sz > kMaxKeySize)
+            {
+                throw std::runtime_error("bad index record");
+            }
+            buf.resize(sz);
+            in.read(reinterpret_cast<char*>(buf.data()), sz);
+            if (!in)
+            {
+                throw std::runtime_error("truncated index record");
+            }
+            LedgerKey k;
+            xdr::xdr_from_opaque(buf, k);
+            idx->mEntries.emplace_back(std::move(k), offset);
+        }
+    }
+    catch (std::exception& e)
+    {
+        CLOG(WARNING, "Bucket") << "Ignoring malformed bucket index "
+                                << filename << ": " << e.what();
+        return nullptr;
+    }
+    return idx;
+}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/StellarXDR.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * BucketIndex is a sparse index over the sorted entries of a bucket file: it
+ * records the key and file offset of every kStride'th entry. Looking up a key
+ * narrows the search to a single run of at most kStride entries starting at a
+ * known offset, so a point lookup reads a few kilobytes rather than the whole
+ * file, and a sequential reader can seek forward over runs it has no use for.
+ *
+ * Like BucketBloomFilter, indexes are built as a bucket is written and
+ * persisted next to the bucket file as host-local cache data.
+ */
+class BucketIndex
+{
+  public:
+    class Builder
+    {
+        std::vector<std::pair<LedgerKey, uint64_t>> mEntries;
+        uint64_t mCount{0};
+
+      public:
+        // Note an entry written at `offset`; entries must arrive in order.
+        void add(BucketEntry const& e, uint64_t offset);
+        std::shared_ptr<BucketIndex const> finish();
+    };
+
+    // Return the offset of the run of entries that would contain `k` if it
+    // were present: the offset of the greatest indexed key not greater than
+    // `k`, or 0 if `k` precedes every indexed key.
+    uint64_t getRunOffset(LedgerKey const& k) const;
+
+    // Write the index to `filename`, replacing any existing file.
+    void save(std::string const& filename) const;
+
+    // Read an index previously written by save(); returns nullptr if the file
+    // is missing or malformed.
+    static std::shared_ptr<BucketIndex const>
+    load(std::string const& filename);
+
+    static uint32_t const kStride;
+
+  private:
+    std::vector<std::pair<LedgerKey, uint64_t>> mEntries;
+};
+}
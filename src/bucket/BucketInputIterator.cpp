@@ -14,6 +14,7 @@ namespace stellar
 void
 BucketInputIterator::loadEntry()
 {
+    mEntryPos = mIn.pos();
     if (mIn.readOne(mEntry))
     {
         mEntryPtr = &mEntry;
@@ -63,4 +64,21 @@ BucketInputIterator& BucketInputIterator::operator++()
     }
     return *this;
 }
+
+size_t
+BucketInputIterator::pos() const
+{
+    return mEntryPos;
+}
+
+void
+BucketInputIterator::seek(size_t offset)
+{
+    if (mBucket->getFilename().empty())
+    {
+        return;
+    }
+    mIn.seek(offset);
+    loadEntry();
+}
 }
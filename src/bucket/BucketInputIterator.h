@@ -26,6 +26,7 @@ class BucketInputIterator
     BucketEntry const* mEntryPtr;
     XDRInputFileStream mIn;
     BucketEntry mEntry;
+    size_t mEntryPos{0};
 
     void loadEntry();
 
@@ -39,5 +40,12 @@ class BucketInputIterator
     ~BucketInputIterator();
 
     BucketInputIterator& operator++();
+
+    // Return the file offset of the current entry.
+    size_t pos() const;
+
+    // Reposition the iterator at the entry starting at file offset `offset`,
+    // which must be an entry boundary (eg. taken from a BucketIndex).
+    void seek(size_t offset);
 };
 }
@@ -120,7 +120,8 @@ BucketLevel::prepare(Application& app, uint32_t currLedger,
     }
 
     mNextCurr = FutureBucket(app, curr, snap, shadows,
-                             BucketList::keepDeadEntries(mLevel));
+                             BucketList::keepDeadEntries(mLevel),
+                             BucketList::mergeDeadline(currLedger, mLevel));
     assert(mNextCurr.isMerging());
 }
 
@@ -307,6 +308,21 @@ BucketList::levelShouldSpill(uint32_t ledger, uint32_t level)
             ledger == mask(ledger, levelSize(level)));
 }
 
+uint32_t
+BucketList::mergeDeadline(uint32_t ledger, uint32_t level)
+{
+    if (level == 0)
+    {
+        return ledger;
+    }
+    // Level `level - 1` spills at every multiple of its half-size.
+    uint32_t const half = levelHalf(level - 1);
+    uint32_t deadline = mask(ledger, half) + half;
+    assert(deadline > ledger);
+    assert(levelShouldSpill(deadline, level - 1));
+    return deadline;
+}
+
 bool
 BucketList::keepDeadEntries(uint32_t level)
 {
@@ -327,8 +343,8 @@ BucketList::getLevel(uint32_t i)
 
 void
 BucketList::addBatch(Application& app, uint32_t currLedger,
-                     std::vector<LedgerEntry> const& liveEntries,
-                     std::vector<LedgerKey> const& deadEntries)
+                     std::vector<LedgerEntry> liveEntries,
+                     std::vector<LedgerKey> deadEntries)
 {
     assert(currLedger > 0);
 
@@ -417,13 +433,14 @@ BucketList::addBatch(Application& app, uint32_t currLedger,
     assert(shadows.size() == 0);
     mLevels[0].prepare(
         app, currLedger,
-        Bucket::fresh(app.getBucketManager(), liveEntries, deadEntries),
+        Bucket::fresh(app.getBucketManager(), std::move(liveEntries),
+                      std::move(deadEntries)),
         shadows);
     mLevels[0].commit();
 }
 
 void
-BucketList::restartMerges(Application& app)
+BucketList::restartMerges(Application& app, uint32_t currLedger)
 {
     for (uint32_t i = 0; i < static_cast<uint32>(mLevels.size()); i++)
     {
@@ -431,7 +448,8 @@ BucketList::restartMerges(Application& app)
         auto& next = level.getNext();
         if (next.hasHashes() && !next.isLive())
         {
-            next.makeLive(app, keepDeadEntries(i));
+            next.makeLive(app, keepDeadEntries(i),
+                          mergeDeadline(currLedger, i));
             if (next.isMerging())
             {
                 CLOG(INFO, "Bucket")
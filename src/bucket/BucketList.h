@@ -321,6 +321,12 @@ class BucketList
     // should spill curr->snap and start merging snap into its next level.
     static bool levelShouldSpill(uint32_t ledger, uint32_t level);
 
+    // Returns the ledger by which a merge into `level`, started while closing
+    // `ledger`, must be complete: the next ledger at which `level - 1` spills
+    // and `level` commits the merge's result. Level 0 merges are committed
+    // as soon as they are prepared, so are due at `ledger` itself.
+    static uint32_t mergeDeadline(uint32_t ledger, uint32_t level);
+
     // Returns true if at given `level` dead entries should be kept.
     static bool keepDeadEntries(uint32_t level);
 
@@ -343,7 +349,7 @@ class BucketList
     // merging buckets between levels. This needs to be called after forcing a
     // BucketList to adopt a new state, either at application restart or when
     // catching up from buckets loaded over the network.
-    void restartMerges(Application& app);
+    void restartMerges(Application& app, uint32_t currLedger);
 
     // Add a batch of live and dead entries to the bucketlist, representing the
     // entries effected by closing `currLedger`. The bucketlist will incorporate
@@ -351,7 +357,7 @@ class BucketList
     // for any levels that should have spilled due to passing through
     // `currLedger`.
     void addBatch(Application& app, uint32_t currLedger,
-                  std::vector<LedgerEntry> const& liveEntries,
-                  std::vector<LedgerKey> const& deadEntries);
+                  std::vector<LedgerEntry> liveEntries,
+                  std::vector<LedgerKey> deadEntries);
 };
 }
@@ -16,6 +16,7 @@ namespace stellar
 
 class Application;
 class BucketList;
+class BucketMergeScheduler;
 struct LedgerHeader;
 struct HistoryArchiveState;
 
@@ -56,6 +57,9 @@ class BucketManager : NonMovableOrCopyable
 
     virtual medida::Timer& getMergeTimer() = 0;
 
+    // Return the scheduler on which FutureBuckets run their merges.
+    virtual BucketMergeScheduler& getMergeScheduler() = 0;
+
     // Get a reference to a persistent bucket (in the BucketManager's bucket
     // directory), from the BucketManager's shared bucket-set.
     //
@@ -78,12 +82,27 @@ class BucketManager : NonMovableOrCopyable
     // not immediately cause the buckets to delete themselves, if someone else
     // is using them via a shared_ptr<>, but the BucketManager will no longer
     // independently keep them alive.
+    //
+    // Only buckets that have left the BucketList since the last call (or were
+    // never in it) are examined, and the files of forgotten buckets are
+    // deleted on a worker thread, so this is cheap enough to call on every
+    // ledger close.
     virtual void forgetUnreferencedBuckets() = 0;
 
+    // Synchronously delete the files of buckets already forgotten whose
+    // deletion is still pending on a worker thread.
+    virtual void flushPendingDeletes() = 0;
+
     // Feed a new batch of entries to the bucket list.
     virtual void addBatch(Application& app, uint32_t currLedger,
-                          std::vector<LedgerEntry> const& liveEntries,
-                          std::vector<LedgerKey> const& deadEntries) = 0;
+                          std::vector<LedgerEntry> liveEntries,
+                          std::vector<LedgerKey> deadEntries) = 0;
+
+    // Return the current state of the ledger entry named by `key`, according
+    // to the BucketList: buckets are searched newest-first, using each
+    // bucket's key filter and index, and the first entry found wins. Returns
+    // nullopt if the entry is dead or absent. Call from the main thread.
+    virtual optional<LedgerEntry> getLedgerEntry(LedgerKey const& key) = 0;
 
     // Update the given LedgerHeader's bucketListHash to reflect the current
     // state of the bucket list.
@@ -4,6 +4,7 @@
 
 #include "bucket/BucketManagerImpl.h"
 #include "bucket/BucketList.h"
+#include "bucket/BucketMergeScheduler.h"
 #include "crypto/Hex.h"
 #include "history/HistoryManager.h"
 #include "main/Application.h"
@@ -18,6 +19,7 @@
 #include <map>
 #include <regex>
 #include <set>
+#include <vector>
 
 #include "medida/counter.h"
 #include "medida/meter.h"
@@ -65,12 +67,76 @@ BucketManagerImpl::BucketManagerImpl(Application& app)
     , mBucketSnapMerge(app.getMetrics().NewTimer({"bucket", "snap", "merge"}))
     , mSharedBucketsSize(
           app.getMetrics().NewCounter({"bucket", "memory", "shared"}))
-
+    , mBucketsForgotten(
+          app.getMetrics().NewMeter({"bucket", "memory", "forget"}, "bucket"))
+    , mPendingDeletes(std::make_shared<PendingDeletes>())
+    , mMergeScheduler(std::make_unique<BucketMergeScheduler>(
+          app.getMetrics(), app.getConfig().MAX_CONCURRENT_BUCKET_MERGES))
 {
 }
 
 const std::string BucketManagerImpl::kLockFilename = "stellar-core.lock";
 
+class BucketManagerImpl::PendingDeletes
+{
+    std::mutex mMutex;
+    std::map<Hash, std::vector<std::string>> mFiles;
+
+  public:
+    void
+    add(Hash const& hash, std::vector<std::string> files)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto& pending = mFiles[hash];
+        pending.insert(pending.end(), files.begin(), files.end());
+    }
+
+    // Called before a bucket is (re)created for `hash`, so that a deletion
+    // queued when it was last forgotten does not remove its files.
+    void
+    cancel(Hash const& hash)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFiles.erase(hash);
+    }
+
+    void
+    run(Hash const& hash)
+    {
+        // The lock is held while removing so that cancel() -- and with it any
+        // adoption of a new file under the same name -- waits for us.
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto i = mFiles.find(hash);
+        if (i == mFiles.end())
+        {
+            return;
+        }
+        for (auto const& f : i->second)
+        {
+            CLOG(TRACE, "Bucket") << "removing bucket file: " << f;
+            std::remove(f.c_str());
+        }
+        mFiles.erase(i);
+    }
+
+    void
+    runAll()
+    {
+        std::vector<Hash> hashes;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (auto const& p : mFiles)
+            {
+                hashes.push_back(p.first);
+            }
+        }
+        for (auto const& h : hashes)
+        {
+            run(h);
+        }
+    }
+};
+
 namespace
 {
 std::string
@@ -82,7 +148,18 @@ bucketBasename(std::string const& bucketHexHash)
 bool
 isBucketFile(std::string const& name)
 {
-    static std::regex re("^bucket-[a-z0-9]{64}\\.xdr(\\.gz)?$");
+    static std::regex re(
+        "^bucket-[a-z0-9]{64}\\.xdr(\\.gz|\\.bloom|\\.index)?$");
+    return std::regex_match(name, re);
+};
+
+// left behind by a bloom filter or index write that never finished (see
+// BucketBloomFilter::save and BucketIndex::save)
+bool
+isBucketTempFile(std::string const& name)
+{
+    static std::regex re(
+        "^bucket-[a-z0-9]{64}\\.xdr\\.(bloom|index)\\.tmp-[a-f0-9]{16}$");
     return std::regex_match(name, re);
 };
 
@@ -139,6 +216,9 @@ BucketManagerImpl::getBucketDir()
 
 BucketManagerImpl::~BucketManagerImpl()
 {
+    // Wait for the merges in progress before anything they use is torn down.
+    mMergeScheduler.reset();
+
     if (mLockedBucketDir)
     {
         std::string d = mApp.getConfig().BUCKET_DIR_PATH;
@@ -160,6 +240,12 @@ BucketManagerImpl::getMergeTimer()
     return mBucketSnapMerge;
 }
 
+BucketMergeScheduler&
+BucketManagerImpl::getMergeScheduler()
+{
+    return *mMergeScheduler;
+}
+
 std::shared_ptr<Bucket>
 BucketManagerImpl::adoptFileAsBucket(std::string const& filename,
                                      uint256 const& hash, size_t nObjects,
@@ -199,10 +285,7 @@ BucketManagerImpl::adoptFileAsBucket(std::string const& filename,
         }
 
         b = std::make_shared<Bucket>(canonicalName, hash);
-        {
-            mSharedBuckets.insert(std::make_pair(hash, b));
-            mSharedBucketsSize.set_count(mSharedBuckets.size());
-        }
+        addSharedBucket(hash, b);
     }
     assert(b);
     return b;
@@ -224,6 +307,9 @@ BucketManagerImpl::getBucketByHash(uint256 const& hash)
             << ") found bucket " << i->second->getFilename();
         return i->second;
     }
+    // A bucket forgotten earlier may be needed again before its files were
+    // deleted; keep them, or wait for the deletion to finish, before looking.
+    mPendingDeletes->cancel(hash);
     std::string canonicalName = bucketFilename(hash);
     if (fs::exists(canonicalName))
     {
@@ -231,13 +317,21 @@ BucketManagerImpl::getBucketByHash(uint256 const& hash)
             << "BucketManager::getBucketByHash(" << binToHex(hash)
             << ") found no bucket, making new one";
         auto p = std::make_shared<Bucket>(canonicalName, hash);
-        mSharedBuckets.insert(std::make_pair(hash, p));
-        mSharedBucketsSize.set_count(mSharedBuckets.size());
+        addSharedBucket(hash, p);
         return p;
     }
     return std::shared_ptr<Bucket>();
 }
 
+void
+BucketManagerImpl::addSharedBucket(Hash const& hash, std::shared_ptr<Bucket> b)
+{
+    mSharedBuckets.insert(std::make_pair(hash, b));
+    mSharedBucketsSize.set_count(mSharedBuckets.size());
+    // Not yet known to be in the BucketList; the next GC pass decides.
+    mGCCandidates.insert(hash);
+}
+
 std::set<Hash>
 BucketManagerImpl::getReferencedBuckets() const
 {
@@ -260,7 +354,7 @@ BucketManagerImpl::getReferencedBuckets() const
         for (auto const& h : pub)
         {
             CLOG(DEBUG, "Bucket")
-                << "BucketManager::forgetUnreferencedBuckets: " << h
+                << "BucketManager::getReferencedBuckets: " << h
                 << " referenced by publish queue";
             referenced.insert(hexToBin256(h));
         }
@@ -292,20 +386,75 @@ BucketManagerImpl::cleanupStaleFiles()
             std::remove(fullName.c_str());
         }
     }
+
+    // only ever called before merges are restarted, so no write is still
+    // in progress
+    for (auto f : fs::findfiles(getBucketDir(), isBucketTempFile))
+    {
+        auto fullName = getBucketDir() + "/" + f;
+        std::remove(fullName.c_str());
+    }
+}
+
+void
+BucketManagerImpl::updateBucketListReferences()
+{
+    std::set<Hash> current;
+    for (uint32_t i = 0; i < BucketList::kNumLevels; ++i)
+    {
+        auto const& level = mBucketList.getLevel(i);
+        current.insert(level.getCurr()->getHash());
+        current.insert(level.getSnap()->getHash());
+        for (auto const& h : level.getNext().getHashes())
+        {
+            current.insert(hexToBin256(h));
+        }
+    }
+
+    // Anything the BucketList dropped since the last pass may now be garbage;
+    // anything it picked up no longer is.
+    for (auto const& h : mBucketListReferences)
+    {
+        if (current.find(h) == current.end())
+        {
+            mGCCandidates.insert(h);
+        }
+    }
+    for (auto const& h : current)
+    {
+        mGCCandidates.erase(h);
+    }
+    mBucketListReferences = std::move(current);
 }
 
 void
 BucketManagerImpl::forgetUnreferencedBuckets()
 {
     std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
-    auto referenced = getReferencedBuckets();
+    updateBucketListReferences();
+    if (mGCCandidates.empty())
+    {
+        return;
+    }
 
-    for (auto i = mSharedBuckets.begin(); i != mSharedBuckets.end();)
+    // Implicitly retain any buckets that are referenced by a state in
+    // the publish queue; they stay candidates until that publish finishes.
+    std::set<Hash> published;
+    for (auto const& h :
+         mApp.getHistoryManager().getBucketsReferencedByPublishQueue())
     {
-        // Standard says map iterators other than the one you're erasing remain
-        // valid.
-        auto j = i;
-        ++i;
+        published.insert(hexToBin256(h));
+    }
+
+    for (auto c = mGCCandidates.begin(); c != mGCCandidates.end();)
+    {
+        auto hash = *c;
+        auto j = mSharedBuckets.find(hash);
+        if (j == mSharedBuckets.end())
+        {
+            c = mGCCandidates.erase(c);
+            continue;
+        }
 
         // Only drop buckets if the bucketlist has forgotten them _and_
         // no other in-progress structures (worker threads, shadow lists)
@@ -316,34 +465,69 @@ BucketManagerImpl::forgetUnreferencedBuckets()
         // one bucket ever exists in memory with a given filename, and that
         // we're the first and last to know about it. Otherwise buckets might
         // race on deleting the underlying file from one another.
+        if (published.find(hash) != published.end() ||
+            j->second.use_count() != 1)
+        {
+            ++c;
+            continue;
+        }
 
-        if (referenced.find(j->first) == referenced.end() &&
-            j->second.use_count() == 1)
+        auto filename = j->second->getFilename();
+        CLOG(TRACE, "Bucket")
+            << "BucketManager::forgetUnreferencedBuckets dropping " << filename;
+        if (!filename.empty())
         {
-            auto filename = j->second->getFilename();
-            CLOG(TRACE, "Bucket")
-                << "BucketManager::forgetUnreferencedBuckets dropping "
-                << filename;
-            if (!filename.empty())
-            {
-                CLOG(TRACE, "Bucket") << "removing bucket file: " << filename;
-                std::remove(filename.c_str());
-                auto gzfilename = filename + ".gz";
-                std::remove(gzfilename.c_str());
-            }
-            mSharedBuckets.erase(j);
+            mPendingDeletes->add(
+                hash, {filename, filename + ".gz",
+                       j->second->getBloomFilterFilename(),
+                       j->second->getIndexFilename()});
+            auto pending = mPendingDeletes;
+            mApp.getWorkerIOService().post(
+                [pending, hash]() { pending->run(hash); });
         }
+        mSharedBuckets.erase(j);
+        mBucketsForgotten.Mark();
+        c = mGCCandidates.erase(c);
     }
     mSharedBucketsSize.set_count(mSharedBuckets.size());
 }
 
+void
+BucketManagerImpl::flushPendingDeletes()
+{
+    mPendingDeletes->runAll();
+}
+
 void
 BucketManagerImpl::addBatch(Application& app, uint32_t currLedger,
-                            std::vector<LedgerEntry> const& liveEntries,
-                            std::vector<LedgerKey> const& deadEntries)
+                            std::vector<LedgerEntry> liveEntries,
+                            std::vector<LedgerKey> deadEntries)
 {
     auto timer = mBucketAddBatch.TimeScope();
-    mBucketList.addBatch(app, currLedger, liveEntries, deadEntries);
+    mBucketList.addBatch(app, currLedger, std::move(liveEntries),
+                         std::move(deadEntries));
+}
+
+optional<LedgerEntry>
+BucketManagerImpl::getLedgerEntry(LedgerKey const& key)
+{
+    for (uint32_t i = 0; i < BucketList::kNumLevels; ++i)
+    {
+        auto const& level = mBucketList.getLevel(i);
+        for (auto const& b : {level.getCurr(), level.getSnap()})
+        {
+            auto e = b->getBucketEntry(key);
+            if (e)
+            {
+                if (e->type() == LIVEENTRY)
+                {
+                    return make_optional<LedgerEntry>(e->liveEntry());
+                }
+                return nullopt<LedgerEntry>();
+            }
+        }
+    }
+    return nullopt<LedgerEntry>();
 }
 
 // updates the given LedgerHeader to reflect the current state of the bucket
@@ -412,8 +596,8 @@ BucketManagerImpl::assumeState(HistoryArchiveState const& has)
         mBucketList.getLevel(i).setNext(has.currentBuckets.at(i).next);
     }
 
-    mBucketList.restartMerges(mApp);
     cleanupStaleFiles();
+    mBucketList.restartMerges(mApp, has.currentLedger);
 }
 
 void
@@ -421,5 +605,6 @@ BucketManagerImpl::shutdown()
 {
     // forgetUnreferencedBuckets does what we want - it retains needed buckets
     forgetUnreferencedBuckets();
+    flushPendingDeletes();
 }
 }
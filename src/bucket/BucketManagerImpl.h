@@ -28,6 +28,7 @@ class TmpDir;
 class Application;
 class Bucket;
 class BucketList;
+class BucketMergeScheduler;
 struct HistoryArchiveState;
 
 class BucketManagerImpl : public BucketManager
@@ -45,9 +46,28 @@ class BucketManagerImpl : public BucketManager
     medida::Timer& mBucketAddBatch;
     medida::Timer& mBucketSnapMerge;
     medida::Counter& mSharedBucketsSize;
+    medida::Meter& mBucketsForgotten;
+
+    // Hashes referenced by the BucketList as of the last GC pass, and shared
+    // buckets that are not: only the latter are examined by
+    // forgetUnreferencedBuckets, so a GC pass costs O(levels + candidates)
+    // rather than O(buckets).
+    std::set<Hash> mBucketListReferences;
+    std::set<Hash> mGCCandidates;
+
+    // Files of forgotten buckets, deleted on a worker thread. Shared with the
+    // posted deletion tasks so that they may outlive the BucketManager.
+    class PendingDeletes;
+    std::shared_ptr<PendingDeletes> mPendingDeletes;
+
+    // Declared last so that it is destroyed, joining its threads, while the
+    // rest of the BucketManager is still intact for merges to use.
+    std::unique_ptr<BucketMergeScheduler> mMergeScheduler;
 
     std::set<Hash> getReferencedBuckets() const;
     void cleanupStaleFiles();
+    void updateBucketListReferences();
+    void addSharedBucket(Hash const& hash, std::shared_ptr<Bucket> b);
 
   protected:
     void calculateSkipValues(LedgerHeader& currentHeader);
@@ -61,6 +81,7 @@ class BucketManagerImpl : public BucketManager
     std::string const& getBucketDir() override;
     BucketList& getBucketList() override;
     medida::Timer& getMergeTimer() override;
+    BucketMergeScheduler& getMergeScheduler() override;
     std::shared_ptr<Bucket> adoptFileAsBucket(std::string const& filename,
                                               uint256 const& hash,
                                               size_t nObjects,
@@ -68,9 +89,11 @@ class BucketManagerImpl : public BucketManager
     std::shared_ptr<Bucket> getBucketByHash(uint256 const& hash) override;
 
     void forgetUnreferencedBuckets() override;
+    void flushPendingDeletes() override;
     void addBatch(Application& app, uint32_t currLedger,
-                  std::vector<LedgerEntry> const& liveEntries,
-                  std::vector<LedgerKey> const& deadEntries) override;
+                  std::vector<LedgerEntry> liveEntries,
+                  std::vector<LedgerKey> deadEntries) override;
+    optional<LedgerEntry> getLedgerEntry(LedgerKey const& key) override;
     void snapshotLedger(LedgerHeader& currentHeader) override;
 
     std::vector<std::string>
@@ -0,0 +1,146 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketMergeScheduler.h"
+#include "util/Logging.h"
+
+#include "medida/counter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+#include <cassert>
+
+namespace stellar
+{
+
+BucketMergeScheduler::Job::Job(std::function<void()> merge,
+                               medida::Timer& resolveBlocked)
+    : mMerge(std::move(merge)), mResolveBlocked(resolveBlocked)
+{
+}
+
+bool
+BucketMergeScheduler::Job::run()
+{
+    if (mStarted.exchange(true))
+    {
+        return false;
+    }
+    // Only the thread that won the exchange above ever touches mMerge.
+    auto merge = std::move(mMerge);
+    mMerge = nullptr;
+    merge();
+    return true;
+}
+
+medida::Timer&
+BucketMergeScheduler::Job::getResolveBlockedTimer()
+{
+    return mResolveBlocked;
+}
+
+BucketMergeScheduler::BucketMergeScheduler(medida::MetricsRegistry& metrics,
+                                           size_t nThreads)
+    : mQueueSize(metrics.NewCounter({"bucket", "merge", "queued"}))
+    , mRunning(metrics.NewCounter({"bucket", "merge", "running"}))
+    , mQueueDelay(metrics.NewTimer({"bucket", "merge", "queue-delay"}))
+    , mResolveBlocked(
+          metrics.NewTimer({"bucket", "merge", "resolve-blocked"}))
+{
+    assert(nThreads > 0);
+    CLOG(DEBUG, "Bucket") << "Starting " << nThreads
+                          << " bucket merge threads";
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        mThreads.emplace_back([this]() { runThread(); });
+    }
+}
+
+BucketMergeScheduler::~BucketMergeScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+        // Queued merges keep living in their jobs, so a consumer that needs
+        // one still runs it itself; no need to hold up shutdown for them.
+        while (!mQueue.empty())
+        {
+            mQueue.pop();
+        }
+        mQueueSize.set_count(0);
+    }
+    mCond.notify_all();
+    mIdleCond.notify_all();
+    for (auto& t : mThreads)
+    {
+        t.join();
+    }
+}
+
+std::shared_ptr<BucketMergeScheduler::Job>
+BucketMergeScheduler::schedule(uint32_t deadline, std::function<void()> merge)
+{
+    auto job = std::make_shared<Job>(std::move(merge), mResolveBlocked);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        assert(!mStopping);
+        mQueue.push(QueuedJob{deadline, mNextSeq++, job,
+                              std::chrono::steady_clock::now()});
+        mQueueSize.set_count(mQueue.size());
+    }
+    mCond.notify_one();
+    return job;
+}
+
+size_t
+BucketMergeScheduler::getThreadCount() const
+{
+    return mThreads.size();
+}
+
+void
+BucketMergeScheduler::runThread()
+{
+    for (;;)
+    {
+        QueuedJob next;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCond.wait(lock, [this]() { return mStopping || !mQueue.empty(); });
+            if (mQueue.empty())
+            {
+                return;
+            }
+            next = mQueue.top();
+            mQueue.pop();
+            mQueueSize.set_count(mQueue.size());
+            ++mActive;
+        }
+
+        mQueueDelay.Update(std::chrono::steady_clock::now() - next.mQueuedAt);
+        mRunning.inc();
+        if (!next.mJob->run())
+        {
+            CLOG(TRACE, "Bucket")
+                << "Merge due at ledger " << next.mDeadline
+                << " was already claimed by its consumer";
+        }
+        mRunning.dec();
+        next.mJob.reset();
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            --mActive;
+        }
+        mIdleCond.notify_all();
+    }
+}
+
+void
+BucketMergeScheduler::waitUntilIdle()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdleCond.wait(lock, [this]() { return mQueue.empty() && mActive == 0; });
+}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace medida
+{
+class Counter;
+class MetricsRegistry;
+class Timer;
+}
+
+namespace stellar
+{
+
+/**
+ * BucketMergeScheduler runs BucketList merges on a small dedicated pool of
+ * threads, separate from the application's general worker io_service (which
+ * also hashes buckets, verifies downloads and so on).
+ *
+ * Each merge is scheduled with a deadline: the ledger at which the BucketList
+ * will need its result (see BucketList::mergeDeadline). Queued merges are
+ * started earliest-deadline-first, so a multi-gigabyte merge on a deep level,
+ * whose result is not needed for thousands of ledgers, cannot hold up the
+ * small merges that the next few ledger closes depend on.
+ *
+ * Additionally, the thread that needs a merge result can claim a merge that
+ * has not started yet and run it itself (see Job::run), so a ledger close
+ * only ever waits on merges that are actually in progress, never on queue
+ * position.
+ *
+ * Bucket::fresh also queues halves of large batches here to sort them in
+ * parallel, with a deadline of 0 so they go ahead of every merge.
+ */
+class BucketMergeScheduler : NonMovableOrCopyable
+{
+  public:
+    class Job
+    {
+        std::function<void()> mMerge;
+        std::atomic<bool> mStarted{false};
+        medida::Timer& mResolveBlocked;
+
+      public:
+        Job(std::function<void()> merge, medida::Timer& resolveBlocked);
+
+        // Run the merge unless some thread has already started it. Returns
+        // true if this call ran the merge.
+        bool run();
+
+        // Time the consumer of the merge spends waiting for its result.
+        medida::Timer& getResolveBlockedTimer();
+    };
+
+    BucketMergeScheduler(medida::MetricsRegistry& metrics, size_t nThreads);
+
+    // Drops the merges still queued, which their consumers can still run
+    // with Job::run, and joins the scheduler's threads once the merges they
+    // are running are done.
+    ~BucketMergeScheduler();
+
+    // Queue `merge`, whose result is needed by ledger `deadline`. Merges
+    // with equal deadlines start in submission order.
+    std::shared_ptr<Job> schedule(uint32_t deadline,
+                                  std::function<void()> merge);
+
+    // Number of threads merges run on.
+    size_t getThreadCount() const;
+
+    // Block until no merge is queued or running. For testing.
+    void waitUntilIdle();
+
+  private:
+    struct QueuedJob
+    {
+        uint32_t mDeadline;
+        uint64_t mSeq;
+        std::shared_ptr<Job> mJob;
+        std::chrono::steady_clock::time_point mQueuedAt;
+    };
+
+    struct QueuedJobCmp
+    {
+        bool
+        operator()(QueuedJob const& a, QueuedJob const& b) const
+        {
+            // std::priority_queue pops its greatest element, so "less" here
+            // means "later".
+            if (a.mDeadline != b.mDeadline)
+            {
+                return a.mDeadline > b.mDeadline;
+            }
+            return a.mSeq > b.mSeq;
+        }
+    };
+
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    std::condition_variable mIdleCond;
+    std::priority_queue<QueuedJob, std::vector<QueuedJob>, QueuedJobCmp>
+        mQueue;
+    uint64_t mNextSeq{0};
+    size_t mActive{0};
+    bool mStopping{false};
+    std::vector<std::thread> mThreads;
+
+    medida::Counter& mQueueSize;
+    medida::Counter& mRunning;
+    medida::Timer& mQueueDelay;
+    medida::Timer& mResolveBlocked;
+
+    void runThread();
+};
+}
@@ -44,12 +44,12 @@ BucketOutputIterator::BucketOutputIterator(std::string const& tmpDir,
     mOut.open(mFilename);
 }
 
-void
-BucketOutputIterator::put(BucketEntry const& e)
+bool
+BucketOutputIterator::makeRoomFor(BucketEntry const& e)
 {
     if (!mKeepDeadEntries && e.type() == DEADENTRY)
     {
-        return;
+        return false;
     }
 
     // Check to see if there's an existing buffered entry.
@@ -63,17 +63,41 @@ BucketOutputIterator::put(BucketEntry const& e)
         // merely replace (same identity), the buffered entry.
         if (mCmp(*mBuf, e))
         {
-            mOut.writeOne(*mBuf, mHasher.get(), &mBytesPut);
-            mObjectsPut++;
+            writeBuffered();
         }
     }
     else
     {
         mBuf = std::make_unique<BucketEntry>();
     }
+    return true;
+}
+
+void
+BucketOutputIterator::put(BucketEntry const& e)
+{
+    if (makeRoomFor(e))
+    {
+        *mBuf = e;
+    }
+}
 
-    // In any case, replace *mBuf with e.
-    *mBuf = e;
+void
+BucketOutputIterator::put(BucketEntry&& e)
+{
+    if (makeRoomFor(e))
+    {
+        *mBuf = std::move(e);
+    }
+}
+
+void
+BucketOutputIterator::writeBuffered()
+{
+    mIndexBuilder.add(*mBuf, mBytesPut);
+    mOut.writeOne(*mBuf, mHasher.get(), &mBytesPut);
+    mFilterBuilder.add(BucketBloomFilter::hashKey(*mBuf));
+    mObjectsPut++;
 }
 
 std::shared_ptr<Bucket>
@@ -82,8 +106,7 @@ BucketOutputIterator::getBucket(BucketManager& bucketManager)
     assert(mOut);
     if (mBuf)
     {
-        mOut.writeOne(*mBuf, mHasher.get(), &mBytesPut);
-        mObjectsPut++;
+        writeBuffered();
         mBuf.reset();
     }
 
@@ -96,7 +119,9 @@ BucketOutputIterator::getBucket(BucketManager& bucketManager)
         std::remove(mFilename.c_str());
         return std::make_shared<Bucket>();
     }
-    return bucketManager.adoptFileAsBucket(mFilename, mHasher->finish(),
-                                           mObjectsPut, mBytesPut);
+    auto b = bucketManager.adoptFileAsBucket(mFilename, mHasher->finish(),
+                                             mObjectsPut, mBytesPut);
+    b->setIndexes(mFilterBuilder.finish(), mIndexBuilder.finish());
+    return b;
 }
 }
@@ -4,6 +4,8 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "bucket/BucketBloomFilter.h"
+#include "bucket/BucketIndex.h"
 #include "bucket/LedgerCmp.h"
 #include "util/XDRStream.h"
 #include "xdr/Stellar-ledger.h"
@@ -18,7 +20,7 @@ class Bucket;
 class BucketManager;
 
 // Helper class that writes new elements to a file and returns a bucket
-// when finished.
+// when finished, along with the bucket's key filter and index.
 class BucketOutputIterator
 {
     std::string mFilename;
@@ -26,14 +28,23 @@ class BucketOutputIterator
     BucketEntryIdCmp mCmp;
     std::unique_ptr<BucketEntry> mBuf;
     std::unique_ptr<SHA256> mHasher;
+    BucketBloomFilter::Builder mFilterBuilder;
+    BucketIndex::Builder mIndexBuilder;
     size_t mBytesPut{0};
     size_t mObjectsPut{0};
     bool mKeepDeadEntries{true};
 
+    void writeBuffered();
+
+    // Flushes the buffered entry if e has a greater identity, so that e can
+    // replace it; returns false if e should be dropped instead.
+    bool makeRoomFor(BucketEntry const& e);
+
   public:
     BucketOutputIterator(std::string const& tmpDir, bool keepDeadEntries);
 
     void put(BucketEntry const& e);
+    void put(BucketEntry&& e);
 
     std::shared_ptr<Bucket> getBucket(BucketManager& bucketManager);
 };
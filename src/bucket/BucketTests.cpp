@@ -7,10 +7,13 @@
 // else.
 #include "util/asio.h"
 #include "bucket/Bucket.h"
+#include "bucket/BucketBloomFilter.h"
+#include "bucket/BucketIndex.h"
 #include "bucket/BucketInputIterator.h"
 #include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
 #include "bucket/BucketManagerImpl.h"
+#include "bucket/BucketMergeScheduler.h"
 #include "bucket/LedgerCmp.h"
 #include "crypto/Hex.h"
 #include "database/Database.h"
@@ -31,7 +34,9 @@
 #include "util/types.h"
 #include "xdrpp/autocheck.h"
 #include <algorithm>
+#include <fstream>
 #include <future>
+#include <thread>
 
 using namespace stellar;
 
@@ -593,6 +598,29 @@ TEST_CASE("merging bucket entries", "[bucket]")
             Bucket::merge(app->getBucketManager(), b1, b2);
         CHECK(countEntries(b3) == liveCount);
     }
+
+    SECTION("fresh matches merge of separate live and dead buckets")
+    {
+        // Large enough to take the parallel sort path, with some dead keys
+        // shadowing live entries and the input in no particular order.
+        std::vector<LedgerEntry> live(
+            LedgerTestUtils::generateValidLedgerEntries(10000));
+        std::vector<LedgerKey> dead;
+        for (size_t i = 0; i < live.size(); i += 7)
+        {
+            dead.push_back(LedgerEntryKey(live[i]));
+        }
+        std::reverse(live.begin(), live.end());
+        auto& bm = app->getBucketManager();
+        std::vector<LedgerKey> noDead;
+        std::vector<LedgerEntry> noLive;
+        auto merged = Bucket::merge(bm, Bucket::fresh(bm, live, noDead),
+                                    Bucket::fresh(bm, noLive, dead));
+        auto fresh = Bucket::fresh(bm, live, dead);
+        CHECK(fresh->getHash() == merged->getHash());
+        std::sort(live.begin(), live.end(), LedgerEntryIdCmp());
+        CHECK(Bucket::fresh(bm, live, dead)->getHash() == fresh->getHash());
+    }
 }
 
 static void
@@ -605,6 +633,10 @@ clearFutures(Application::pointer app, BucketList& bl)
         bl.getLevel(i).getNext().clear();
     }
 
+    // Then let the merge scheduler finish any merges it has queued or
+    // running; they hold shared_ptr<Bucket>s to their inputs.
+    app->getBucketManager().getMergeScheduler().waitUntilIdle();
+
     // Then go through all the _worker threads_ and mop up any work they
     // might still be doing (that might be "dropping a shared_ptr<Bucket>").
 
@@ -634,6 +666,134 @@ clearFutures(Application::pointer app, BucketList& bl)
     }
 }
 
+TEST_CASE("bucket key filters and indexes", "[bucket][bloom][index]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto& bm = app->getBucketManager();
+
+    std::vector<LedgerEntry> live(
+        LedgerTestUtils::generateValidLedgerEntries(500));
+    std::vector<LedgerKey> dead{};
+    std::shared_ptr<Bucket> b = Bucket::fresh(bm, live, dead);
+
+    SECTION("filter has no false negatives and is persisted")
+    {
+        auto filter = b->getBloomFilter();
+        REQUIRE(filter);
+        for (auto const& e : live)
+        {
+            CHECK(filter->mayContain(LedgerEntryKey(e)));
+        }
+        REQUIRE(fs::exists(b->getBloomFilterFilename()));
+        auto loaded = BucketBloomFilter::load(b->getBloomFilterFilename());
+        REQUIRE(loaded);
+        for (auto const& e : live)
+        {
+            CHECK(loaded->mayContain(LedgerEntryKey(e)));
+        }
+
+        size_t falsePositives = 0;
+        auto others = LedgerTestUtils::generateValidLedgerEntries(1000);
+        for (auto const& e : others)
+        {
+            BucketEntry be;
+            be.type(DEADENTRY);
+            be.deadEntry() = LedgerEntryKey(e);
+            if (!b->containsBucketIdentity(be) &&
+                filter->mayContain(be.deadEntry()))
+            {
+                ++falsePositives;
+            }
+        }
+        CHECK(falsePositives < 50);
+    }
+
+    SECTION("point lookups find every entry through the index")
+    {
+        REQUIRE(fs::exists(b->getIndexFilename()));
+        REQUIRE(BucketIndex::load(b->getIndexFilename()));
+        for (auto const& e : live)
+        {
+            auto found = b->getBucketEntry(LedgerEntryKey(e));
+            REQUIRE(found);
+            REQUIRE(found->type() == LIVEENTRY);
+            CHECK(LedgerEntryKey(found->liveEntry()) == LedgerEntryKey(e));
+        }
+    }
+
+    SECTION("index is rebuilt if its file is lost")
+    {
+        std::remove(b->getIndexFilename().c_str());
+        std::remove(b->getBloomFilterFilename().c_str());
+        auto reloaded = std::make_shared<Bucket>(b->getFilename(), b->getHash());
+        for (auto const& e : live)
+        {
+            CHECK(reloaded->getBucketEntry(LedgerEntryKey(e)));
+        }
+        CHECK(fs::exists(reloaded->getIndexFilename()));
+        CHECK(fs::exists(reloaded->getBloomFilterFilename()));
+    }
+
+    SECTION("filtered shadows still shadow their entries")
+    {
+        std::vector<LedgerEntry> shadowed(live.begin(), live.begin() + 100);
+        auto shadow = Bucket::fresh(bm, shadowed, dead);
+        auto other = Bucket::fresh(
+            bm, LedgerTestUtils::generateValidLedgerEntries(500), dead);
+        auto merged = Bucket::merge(bm, b, other, {shadow});
+        for (auto const& e : shadowed)
+        {
+            BucketEntry be;
+            be.type(LIVEENTRY);
+            be.liveEntry() = e;
+            CHECK(!merged->containsBucketIdentity(be));
+        }
+        auto unshadowed = Bucket::merge(bm, b, other);
+        CHECK(countEntries(merged) < countEntries(unshadowed));
+    }
+}
+
+TEST_CASE("bucketmanager point lookups", "[bucket][index]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto& bm = app->getBucketManager();
+    auto& bl = bm.getBucketList();
+
+    auto alice = LedgerTestUtils::generateValidLedgerEntry(5);
+    auto aliceKey = LedgerEntryKey(alice);
+    auto others = LedgerTestUtils::generateValidLedgerEntries(100);
+
+    // Alice is written early and sinks into deeper levels, then updated, then
+    // deleted; lookups must always see her most recent state.
+    bl.addBatch(*app, 1, {alice}, {});
+    for (uint32_t i = 2; i < 40; ++i)
+    {
+        bl.addBatch(*app, i, LedgerTestUtils::generateValidLedgerEntries(5),
+                    {});
+    }
+    auto found = bm.getLedgerEntry(aliceKey);
+    REQUIRE(found);
+    CHECK(*found == alice);
+
+    alice.lastModifiedLedgerSeq = 40;
+    bl.addBatch(*app, 40, {alice}, {});
+    found = bm.getLedgerEntry(aliceKey);
+    REQUIRE(found);
+    CHECK(found->lastModifiedLedgerSeq == 40);
+
+    bl.addBatch(*app, 41, {}, {aliceKey});
+    CHECK(!bm.getLedgerEntry(aliceKey));
+
+    for (auto const& e : others)
+    {
+        CHECK(!bm.getLedgerEntry(LedgerEntryKey(e)));
+    }
+}
+
 TEST_CASE("bucketmanager ownership", "[bucket]")
 {
     VirtualClock clock;
@@ -670,6 +830,7 @@ TEST_CASE("bucketmanager ownership", "[bucket]")
     CHECK(fs::exists(filename));
     b1.reset();
     app->getBucketManager().forgetUnreferencedBuckets();
+    app->getBucketManager().flushPendingDeletes();
     CHECK(!fs::exists(filename));
 
     // Try adding a bucket to the BucketManager's bucketlist
@@ -698,6 +859,39 @@ TEST_CASE("bucketmanager ownership", "[bucket]")
     CHECK(fs::exists(filename));
     b1.reset();
     app->getBucketManager().forgetUnreferencedBuckets();
+    app->getBucketManager().flushPendingDeletes();
+    CHECK(!fs::exists(filename));
+}
+
+TEST_CASE("bucketmanager forgotten bucket readopted before deletion",
+          "[bucket]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto& bm = app->getBucketManager();
+
+    std::vector<LedgerEntry> live(
+        LedgerTestUtils::generateValidLedgerEntries(10));
+    std::vector<LedgerKey> dead{};
+
+    auto b = Bucket::fresh(bm, live, dead);
+    auto hash = b->getHash();
+    auto filename = b->getFilename();
+    b.reset();
+
+    // Forgetting the bucket only queues its files for deletion, which may or
+    // may not have happened by the time an identical bucket is made again;
+    // either way the new bucket's file must survive a later flush.
+    bm.forgetUnreferencedBuckets();
+    auto again = Bucket::fresh(bm, live, dead);
+    bm.flushPendingDeletes();
+    CHECK(fs::exists(filename));
+    CHECK(again->getHash() == hash);
+
+    again.reset();
+    bm.forgetUnreferencedBuckets();
+    bm.flushPendingDeletes();
     CHECK(!fs::exists(filename));
 }
 
@@ -866,8 +1060,16 @@ TEST_CASE("bucket persistence over app restart", "[bucket][bucketpersist]")
     // pick up the bucket list correctly.
     cfg1.FORCE_SCP = false;
     {
+        // Leave a temporary filter behind as if a save had been interrupted.
+        std::string tmpFilter = cfg1.BUCKET_DIR_PATH + "/bucket-" +
+                                std::string(64, 'a') +
+                                ".xdr.bloom.tmp-0123456789abcdef";
+        std::ofstream(tmpFilter) << "partial";
+        REQUIRE(fs::exists(tmpFilter));
+
         Application::pointer app = Application::create(clock, cfg1, false);
         app->start();
+        REQUIRE(!fs::exists(tmpFilter));
         BucketList& bl = app->getBucketManager().getBucketList();
 
         // Confirm that we re-acquired the close-ledger state.
@@ -1028,6 +1230,111 @@ TEST_CASE("BucketList check bucket sizes", "[bucket][count]")
     }
 }
 
+TEST_CASE("BucketList merge deadlines", "[bucket][merge]")
+{
+    for (uint32_t ledger = 1; ledger < 2048; ++ledger)
+    {
+        CHECK(BucketList::mergeDeadline(ledger, 0) == ledger);
+        for (uint32_t level = 1; level < BucketList::kNumLevels; ++level)
+        {
+            auto deadline = BucketList::mergeDeadline(ledger, level);
+            REQUIRE(deadline > ledger);
+            REQUIRE(BucketList::levelShouldSpill(deadline, level - 1));
+            if (level < 4)
+            {
+                for (uint32_t l = ledger + 1; l < deadline; ++l)
+                {
+                    REQUIRE(!BucketList::levelShouldSpill(l, level - 1));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("bucket merge scheduler", "[bucket][merge]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool released = false;
+    std::vector<uint32_t> order;
+
+    SECTION("earliest deadline runs first")
+    {
+        BucketMergeScheduler sched(app->getMetrics(), 1);
+        // Occupy the single merge thread until everything else is queued.
+        sched.schedule(0, [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return released; });
+        });
+        for (uint32_t d : {300, 100, 200, 100})
+        {
+            sched.schedule(d, [&order, &mutex, d]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(d);
+            });
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            released = true;
+        }
+        cv.notify_all();
+        sched.waitUntilIdle();
+        REQUIRE(order == std::vector<uint32_t>{100, 100, 200, 300});
+    }
+
+    SECTION("consumer can claim an unstarted merge")
+    {
+        BucketMergeScheduler sched(app->getMetrics(), 1);
+        sched.schedule(0, [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return released; });
+        });
+        int runs = 0;
+        auto job = sched.schedule(1, [&runs]() { ++runs; });
+        REQUIRE(job->run());
+        REQUIRE(!job->run());
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            released = true;
+        }
+        cv.notify_all();
+        sched.waitUntilIdle();
+        REQUIRE(runs == 1);
+    }
+
+    SECTION("shutdown does not wait for queued merges")
+    {
+        int runs = 0;
+        std::shared_ptr<BucketMergeScheduler::Job> job;
+        std::thread releaser;
+        {
+            BucketMergeScheduler sched(app->getMetrics(), 1);
+            sched.schedule(0, [&]() {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return released; });
+            });
+            job = sched.schedule(1, [&runs]() { ++runs; });
+            // let the destructor drop the queue before the running merge ends
+            releaser = std::thread([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    released = true;
+                }
+                cv.notify_all();
+            });
+        }
+        releaser.join();
+        REQUIRE(runs == 0);
+        REQUIRE(job->run());
+        REQUIRE(runs == 1);
+    }
+}
+
 TEST_CASE("checkdb succeeding", "[bucket][checkdb]")
 {
     VirtualClock clock;
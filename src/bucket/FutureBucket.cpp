@@ -15,6 +15,8 @@
 #include "util/LogSlowExecution.h"
 #include "util/Logging.h"
 
+#include "medida/timer.h"
+
 #include <chrono>
 
 namespace stellar
@@ -24,7 +26,7 @@ FutureBucket::FutureBucket(Application& app,
                            std::shared_ptr<Bucket> const& curr,
                            std::shared_ptr<Bucket> const& snap,
                            std::vector<std::shared_ptr<Bucket>> const& shadows,
-                           bool keepDeadEntries)
+                           bool keepDeadEntries, uint32_t mergeDeadline)
     : mState(FB_LIVE_INPUTS)
     , mInputCurrBucket(curr)
     , mInputSnapBucket(snap)
@@ -41,7 +43,7 @@ FutureBucket::FutureBucket(Application& app,
     {
         mInputShadowBucketHashes.push_back(binToHex(b->getHash()));
     }
-    startMerge(app, keepDeadEntries);
+    startMerge(app, keepDeadEntries, mergeDeadline);
 }
 
 void
@@ -169,6 +171,7 @@ FutureBucket::clearOutput()
     // its captures) on invalidation (due to get()); must explicitly reset.
     mOutputBucket = std::shared_future<std::shared_ptr<Bucket>>();
     mOutputBucketHash.clear();
+    mMergeJob.reset();
 }
 
 void
@@ -215,7 +218,20 @@ FutureBucket::resolve()
 
     {
         auto timer = LogSlowExecution("Resolving bucket");
-        bucket = mOutputBucket.get();
+        if (mMergeJob)
+        {
+            auto blocked = mMergeJob->getResolveBlockedTimer().TimeScope();
+            if (mMergeJob->run())
+            {
+                CLOG(DEBUG, "Bucket") << "Ran unstarted merge while resolving";
+            }
+            bucket = mOutputBucket.get();
+        }
+        else
+        {
+            bucket = mOutputBucket.get();
+        }
+        mMergeJob.reset();
     }
 
     if (mOutputBucketHash.empty())
@@ -251,7 +267,8 @@ FutureBucket::getOutputHash() const
 }
 
 void
-FutureBucket::startMerge(Application& app, bool keepDeadEntries)
+FutureBucket::startMerge(Application& app, bool keepDeadEntries,
+                         uint32_t mergeDeadline)
 {
     // NB: startMerge starts with FutureBucket in a half-valid state; the inputs
     // are live but the merge is not yet running. So you can't call checkState()
@@ -269,7 +286,8 @@ FutureBucket::startMerge(Application& app, bool keepDeadEntries)
 
     CLOG(TRACE, "Bucket") << "Preparing merge of curr="
                           << hexAbbrev(curr->getHash())
-                          << " with snap=" << hexAbbrev(snap->getHash());
+                          << " with snap=" << hexAbbrev(snap->getHash())
+                          << ", due at ledger " << mergeDeadline;
 
     BucketManager& bm = app.getBucketManager();
 
@@ -290,12 +308,14 @@ FutureBucket::startMerge(Application& app, bool keepDeadEntries)
         });
 
     mOutputBucket = task->get_future().share();
-    app.postOnBackgroundThread(bind(&task_t::operator(), task));
+    mMergeJob = bm.getMergeScheduler().schedule(
+        mergeDeadline, std::bind(&task_t::operator(), task));
     checkState();
 }
 
 void
-FutureBucket::makeLive(Application& app, bool keepDeadEntries)
+FutureBucket::makeLive(Application& app, bool keepDeadEntries,
+                       uint32_t mergeDeadline)
 {
     checkState();
     assert(!isLive());
@@ -321,7 +341,7 @@ FutureBucket::makeLive(Application& app, bool keepDeadEntries)
             mInputShadowBuckets.push_back(b);
         }
         mState = FB_LIVE_INPUTS;
-        startMerge(app, keepDeadEntries);
+        startMerge(app, keepDeadEntries, mergeDeadline);
         assert(isLive());
     }
 }
@@ -4,6 +4,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "bucket/BucketMergeScheduler.h"
 #include "overlay/StellarXDR.h"
 #include <cereal/cereal.hpp>
 #include <future>
@@ -61,6 +62,10 @@ class FutureBucket
     std::vector<std::shared_ptr<Bucket>> mInputShadowBuckets;
     std::shared_future<std::shared_ptr<Bucket>> mOutputBucket;
 
+    // While a merge is running, the scheduler job producing mOutputBucket,
+    // which resolve() may claim and run itself.
+    std::shared_ptr<BucketMergeScheduler::Job> mMergeJob;
+
     // These strings hold the serializable (or deserialized) bucket hashes of
     // the inputs and outputs of a merge; depending on the state of the
     // FutureBucket they may be empty strings, but if they are nonempty and the
@@ -73,7 +78,8 @@ class FutureBucket
 
     void checkHashesMatch() const;
     void checkState() const;
-    void startMerge(Application& app, bool keepDeadEntries);
+    void startMerge(Application& app, bool keepDeadEntries,
+                    uint32_t mergeDeadline);
 
     void clearInputs();
     void clearOutput();
@@ -83,7 +89,7 @@ class FutureBucket
     FutureBucket(Application& app, std::shared_ptr<Bucket> const& curr,
                  std::shared_ptr<Bucket> const& snap,
                  std::vector<std::shared_ptr<Bucket>> const& shadows,
-                 bool keepDeadEntries);
+                 bool keepDeadEntries, uint32_t mergeDeadline);
 
     FutureBucket() = default;
     FutureBucket(FutureBucket const& other) = default;
@@ -111,11 +117,14 @@ class FutureBucket
     // Precondition: isLive(); returns whether a live merge is ready to resolve.
     bool mergeComplete() const;
 
-    // Precondition: isLive(); waits-for and resolves to merged bucket.
+    // Precondition: isLive(); waits-for and resolves to merged bucket. If
+    // the merge has not started yet, runs it on the calling thread.
     std::shared_ptr<Bucket> resolve();
 
-    // Precondition: !isLive(); transitions from FB_HASH_FOO to FB_LIVE_FOO
-    void makeLive(Application& app, bool keepDeadEntries);
+    // Precondition: !isLive(); transitions from FB_HASH_FOO to FB_LIVE_FOO,
+    // scheduling any merge to be complete by ledger `mergeDeadline`.
+    void makeLive(Application& app, bool keepDeadEntries,
+                  uint32_t mergeDeadline);
 
     // Return all hashes referenced by this future.
     std::vector<std::string> getHashes() const;
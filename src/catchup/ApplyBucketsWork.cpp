@@ -9,6 +9,7 @@
 #include "bucket/BucketManager.h"
 #include "crypto/Hex.h"
 #include "crypto/SecretKey.h"
+#include "database/Database.h"
 #include "history/HistoryArchive.h"
 #include "historywork/Progress.h"
 #include "invariant/InvariantManager.h"
@@ -34,6 +35,8 @@ ApplyBucketsWork::ApplyBucketsWork(
     , mApplyState(applyState)
     , mApplying(false)
     , mLevel(BucketList::kNumLevels - 1)
+    , mBucketApplySkipped(app.getMetrics().NewMeter(
+          {"history", "bucket-apply", "skipped"}, "event"))
     , mBucketApplyStart(app.getMetrics().NewMeter(
           {"history", "bucket-apply", "start"}, "event"))
     , mBucketApplySuccess(app.getMetrics().NewMeter(
@@ -82,8 +85,24 @@ ApplyBucketsWork::onStart()
     auto& level = getBucketLevel(mLevel);
     HistoryStateBucket const& i = mApplyState.currentBuckets.at(mLevel);
 
+    // Looking up the previous votes of every account written would double
+    // the reads of bucket apply; the tally is rebuilt once at the end instead.
+    mApp.getDatabase().setTrackingInflationVotes(false);
+
+    // Levels are applied as a delta against the local state: from the top,
+    // buckets the local BucketList already holds are skipped. Once a bucket
+    // differs, everything modified since its oldest ledger is dropped, so
+    // every bucket below it has to be applied again.
     bool applySnap = (i.snap != binToHex(level.getSnap()->getHash()));
     bool applyCurr = (i.curr != binToHex(level.getCurr()->getHash()));
+    if (!mApplying && !applySnap)
+    {
+        // The snap is skipped, and so is the curr if it is unchanged too.
+        mBucketApplySkipped.Mark(applyCurr ? 1 : 2);
+        CLOG(DEBUG, "History")
+            << "ApplyBuckets : level[" << mLevel << "]"
+            << (applyCurr ? ".snap" : "") << " unchanged, skipping";
+    }
     if (!mApplying && (applySnap || applyCurr))
     {
         uint32_t oldestLedger = applySnap
@@ -189,6 +208,7 @@ ApplyBucketsWork::onSuccess()
 
     CLOG(DEBUG, "History") << "ApplyBuckets : done, restarting merges";
     mApp.getBucketManager().assumeState(mApplyState);
+    resumeTrackingInflationVotes();
     return WORK_SUCCESS;
 }
 
@@ -203,6 +223,20 @@ void
 ApplyBucketsWork::onFailureRaise()
 {
     mBucketApplyFailure.Mark();
+    resumeTrackingInflationVotes();
     Work::onFailureRaise();
 }
+
+void
+ApplyBucketsWork::resumeTrackingInflationVotes()
+{
+    auto& db = mApp.getDatabase();
+    if (!db.isTrackingInflationVotes())
+    {
+        soci::transaction sqlTx(db.getSession());
+        AccountFrame::rebuildInflationVotes(db);
+        db.setTrackingInflationVotes(true);
+        sqlTx.commit();
+    }
+}
 }
@@ -33,12 +33,14 @@ class ApplyBucketsWork : public Work
     std::unique_ptr<BucketApplicator> mSnapApplicator;
     std::unique_ptr<BucketApplicator> mCurrApplicator;
 
+    medida::Meter& mBucketApplySkipped;
     medida::Meter& mBucketApplyStart;
     medida::Meter& mBucketApplySuccess;
     medida::Meter& mBucketApplyFailure;
 
     std::shared_ptr<Bucket const> getBucket(std::string const& bucketHash);
     BucketLevel& getBucketLevel(uint32_t level);
+    void resumeTrackingInflationVotes();
 
   public:
     ApplyBucketsWork(
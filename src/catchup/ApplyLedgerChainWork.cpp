@@ -5,6 +5,8 @@
 #include "catchup/ApplyLedgerChainWork.h"
 #include "herder/LedgerCloseData.h"
 #include "history/FileTransferInfo.h"
+#include "history/HistoryArchiveManager.h"
+#include "history/HistoryFileCache.h"
 #include "history/HistoryManager.h"
 #include "historywork/Progress.h"
 #include "ledger/CheckpointRange.h"
@@ -267,6 +269,10 @@ ApplyLedgerChainWork::onRun()
     catch (std::runtime_error& e)
     {
         CLOG(ERROR, "History") << "Replay failed: " << e.what();
+        // the transactions of the checkpoint being replayed may not be what
+        // its ledger headers committed to
+        mApp.getHistoryArchiveManager().getFileCache().removeCheckpoint(
+            mCurrSeq);
         scheduleFailure();
     }
 }
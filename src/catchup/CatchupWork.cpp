@@ -7,6 +7,7 @@
 #include "catchup/ApplyLedgerChainWork.h"
 #include "catchup/CatchupConfiguration.h"
 #include "catchup/DownloadBucketsWork.h"
+#include "catchup/ReplayLedgerSegmentsWork.h"
 #include "catchup/VerifyLedgerChainWork.h"
 #include "history/FileTransferInfo.h"
 #include "history/HistoryManager.h"
@@ -47,7 +48,11 @@ CatchupWork::getStatus() const
 {
     if (mState == WORK_PENDING)
     {
-        if (mApplyTransactionsWork)
+        if (mReplayLedgerSegmentsWork)
+        {
+            return mReplayLedgerSegmentsWork->getStatus();
+        }
+        else if (mApplyTransactionsWork)
         {
             return mApplyTransactionsWork->getStatus();
         }
@@ -117,6 +122,7 @@ CatchupWork::onReset()
     mApplyBucketsWork.reset();
     mDownloadTransactionsWork.reset();
     mApplyTransactionsWork.reset();
+    mReplayLedgerSegmentsWork.reset();
 
     mLastClosedLedgerAtReset = mApp.getLedgerManager().getLastClosedLedgerNum();
     mGetHistoryArchiveStateWork = addWork<GetHistoryArchiveStateWork>(
@@ -294,6 +300,24 @@ CatchupWork::applyTransactions(LedgerRange const& range)
     return true;
 }
 
+bool
+CatchupWork::replayLedgerSegments(LedgerRange const& range)
+{
+    if (mReplayLedgerSegmentsWork)
+    {
+        assert(mReplayLedgerSegmentsWork->getState() == WORK_SUCCESS);
+        return false;
+    }
+
+    CLOG(INFO, "History") << "Catchup replaying ledger segments for range ["
+                          << range.first() << ".." << range.last() << "]";
+
+    mReplayLedgerSegmentsWork = addWork<ReplayLedgerSegmentsWork>(
+        *mDownloadDir, range, mManualCatchup, mLastApplied);
+
+    return true;
+}
+
 Work::State
 CatchupWork::onSuccess()
 {
@@ -315,6 +339,21 @@ CatchupWork::onSuccess()
     auto checkpointRange =
         CheckpointRange{ledgerRange, mApp.getHistoryManager()};
 
+    if (!catchupRange.second &&
+        mApp.getConfig().CATCHUP_SEGMENT_CHECKPOINTS != 0)
+    {
+        if (replayLedgerSegments(ledgerRange))
+        {
+            return WORK_PENDING;
+        }
+
+        mProgressHandler({}, ProgressState::APPLIED_TRANSACTIONS,
+                         mLastApplied);
+        mProgressHandler({}, ProgressState::FINISHED, mLastApplied);
+        mApp.getCatchupManager().historyCaughtup();
+        return WORK_SUCCESS;
+    }
+
     if (downloadLedgers(checkpointRange))
     {
         return WORK_PENDING;
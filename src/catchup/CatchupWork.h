@@ -52,6 +52,10 @@ using CatchupRange = std::pair<LedgerRange, bool>;
 // (as in MINIMAL and RECENT catchups), and then download and apply
 // transactions (as in COMPLETE and RECENT catchups).
 //
+// When only transactions are applied and CATCHUP_SEGMENT_CHECKPOINTS is set,
+// downloading, verifying and applying are instead done segment by segment by
+// ReplayLedgerSegmentsWork, which can resume an interrupted catchup.
+//
 // After that, catchup is done and node can replay buffered ledgers and take
 // part in consensus protocol.
 class CatchupWork : public BucketDownloadWork
@@ -121,6 +125,7 @@ class CatchupWork : public BucketDownloadWork
     std::shared_ptr<Work> mApplyBucketsWork;
     std::shared_ptr<Work> mDownloadTransactionsWork;
     std::shared_ptr<Work> mApplyTransactionsWork;
+    std::shared_ptr<Work> mReplayLedgerSegmentsWork;
     LedgerHeaderHistoryEntry mFirstVerified;
     LedgerHeaderHistoryEntry mLastVerified;
     LedgerHeaderHistoryEntry mLastApplied;
@@ -136,5 +141,6 @@ class CatchupWork : public BucketDownloadWork
     bool applyBuckets();
     bool downloadTransactions(CheckpointRange const& range);
     bool applyTransactions(LedgerRange const& range);
+    bool replayLedgerSegments(LedgerRange const& range);
 };
 }
@@ -3,6 +3,8 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "catchup/DownloadBucketsWork.h"
+#include "bucket/BucketManager.h"
+#include "crypto/Hex.h"
 #include "history/FileTransferInfo.h"
 #include "historywork/GetAndUnzipRemoteFileWork.h"
 #include "historywork/VerifyBucketWork.h"
@@ -21,6 +23,8 @@ DownloadBucketsWork::DownloadBucketsWork(
     , mBuckets{buckets}
     , mHashes{std::move(hashes)}
     , mDownloadDir{downloadDir}
+    , mDownloadBucketLocal{app.getMetrics().NewMeter(
+          {"history", "download-bucket", "local"}, "event")}
     , mDownloadBucketStart{app.getMetrics().NewMeter(
           {"history", "download-bucket", "start"}, "event")}
     , mDownloadBucketSuccess{app.getMetrics().NewMeter(
@@ -52,6 +56,20 @@ DownloadBucketsWork::onReset()
 
     for (auto const& hash : mHashes)
     {
+        // Buckets missing from the local HistoryArchiveState may still be on
+        // disk, e.g. the outputs of merges that were still running when it
+        // was saved, or buckets not yet garbage-collected.
+        auto local =
+            mApp.getBucketManager().getBucketByHash(hexToBin256(hash));
+        if (local)
+        {
+            CLOG(DEBUG, "History")
+                << "Bucket " << hash << " is already local, not downloading";
+            mBuckets[hash] = local;
+            mDownloadBucketLocal.Mark();
+            continue;
+        }
+
         FileTransferInfo ft(mDownloadDir, HISTORY_FILE_TYPE_BUCKET, hash);
         // Each bucket gets its own work-chain of
         // download->gunzip->verify
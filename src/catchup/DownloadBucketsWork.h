@@ -19,10 +19,11 @@ class TmpDir;
 
 class DownloadBucketsWork : public Work
 {
-    std::map<std::string, std::shared_ptr<Bucket>> mBuckets;
+    std::map<std::string, std::shared_ptr<Bucket>>& mBuckets;
     std::vector<std::string> mHashes;
     TmpDir const& mDownloadDir;
 
+    medida::Meter& mDownloadBucketLocal;
     medida::Meter& mDownloadBucketStart;
     medida::Meter& mDownloadBucketSuccess;
     medida::Meter& mDownloadBucketFailure;
@@ -0,0 +1,195 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "catchup/LedgerSegmentWork.h"
+#include "catchup/CatchupManager.h"
+#include "catchup/VerifyLedgerChainWork.h"
+#include "history/FileTransferInfo.h"
+#include "history/HistoryArchiveManager.h"
+#include "history/HistoryFileCache.h"
+#include "historywork/BatchDownloadWork.h"
+#include "ledger/CheckpointRange.h"
+#include "ledger/LedgerManager.h"
+#include "main/Application.h"
+#include "util/XDRStream.h"
+#include "util/types.h"
+#include <lib/util/format.h>
+#include <medida/meter.h>
+#include <medida/metrics_registry.h>
+
+namespace stellar
+{
+
+LedgerSegmentWork::LedgerSegmentWork(Application& app, WorkParent& parent,
+                                     TmpDir const& downloadDir,
+                                     LedgerRange range, bool verifyLedgers,
+                                     bool downloadTransactions,
+                                     Hash const& trustedLast)
+    : Work(app, parent,
+           fmt::format("ledger-segment-{:08x}-{:08x}", range.first(),
+                       range.last()))
+    , mDownloadDir(downloadDir)
+    , mRange(range)
+    , mVerifyLedgers(verifyLedgers)
+    , mDownloadTransactions(downloadTransactions)
+    , mTrustedLast(trustedLast)
+    , mVerifyLedgerSuccess(app.getMetrics().NewMeter(
+          {"history", "verify-ledger", "success"}, "event"))
+    , mVerifyLedgerChainSuccess(app.getMetrics().NewMeter(
+          {"history", "verify-ledger-chain", "success"}, "event"))
+    , mVerifyLedgerChainFailure(app.getMetrics().NewMeter(
+          {"history", "verify-ledger-chain", "failure"}, "event"))
+{
+}
+
+LedgerSegmentWork::~LedgerSegmentWork()
+{
+    clearChildren();
+}
+
+void
+LedgerSegmentWork::onReset()
+{
+    clearChildren();
+    mFirstVerified = {};
+    mLastVerified = {};
+
+    auto checkpoints = CheckpointRange{mRange, mApp.getHistoryManager()};
+    if (mVerifyLedgers)
+    {
+        addWork<BatchDownloadWork>(checkpoints, HISTORY_FILE_TYPE_LEDGER,
+                                   mDownloadDir);
+    }
+    if (mDownloadTransactions)
+    {
+        addWork<BatchDownloadWork>(checkpoints, HISTORY_FILE_TYPE_TRANSACTIONS,
+                                   mDownloadDir);
+    }
+}
+
+HistoryManager::LedgerVerificationStatus
+LedgerSegmentWork::verifySegment()
+{
+    auto checkpoints = CheckpointRange{mRange, mApp.getHistoryManager()};
+    LedgerHeaderHistoryEntry prev;
+
+    for (auto checkpoint = checkpoints.first();
+         checkpoint <= checkpoints.last() &&
+         prev.header.ledgerSeq != mRange.last();
+         checkpoint += checkpoints.frequency())
+    {
+        FileTransferInfo ft(mDownloadDir, HISTORY_FILE_TYPE_LEDGER,
+                            checkpoint);
+        XDRInputFileStream hdrIn;
+        hdrIn.open(ft.localPath_nogz());
+
+        LedgerHeaderHistoryEntry curr;
+        while (prev.header.ledgerSeq != mRange.last() && hdrIn &&
+               hdrIn.readOne(curr))
+        {
+            if (curr.header.ledgerVersion >
+                Config::CURRENT_LEDGER_PROTOCOL_VERSION)
+            {
+                return HistoryManager::VERIFY_STATUS_ERR_BAD_LEDGER_VERSION;
+            }
+
+            auto status = HistoryManager::VERIFY_STATUS_OK;
+            if (prev.header.ledgerSeq == 0)
+            {
+                // The first header of a segment is linked to the one before
+                // it by ReplayLedgerSegmentsWork (or, for the first segment,
+                // by ApplyLedgerChainWork knitting up with the LCL).
+                status = verifyLedgerHistoryEntry(curr);
+                mFirstVerified = curr;
+            }
+            else if (curr.header.ledgerSeq != prev.header.ledgerSeq + 1)
+            {
+                CLOG(ERROR, "History")
+                    << "History chain expected ledger seq "
+                    << prev.header.ledgerSeq + 1 << ", got "
+                    << curr.header.ledgerSeq << " instead";
+                status = HistoryManager::VERIFY_STATUS_ERR_OVERSHOT;
+            }
+            else
+            {
+                status = verifyLedgerHistoryLink(prev.hash, curr);
+            }
+
+            if (status != HistoryManager::VERIFY_STATUS_OK)
+            {
+                return status;
+            }
+            mVerifyLedgerSuccess.Mark();
+            prev = curr;
+        }
+    }
+
+    if (prev.header.ledgerSeq != mRange.last())
+    {
+        CLOG(ERROR, "History")
+            << "History chain did not reach end of segment " << mRange.last();
+        return HistoryManager::VERIFY_STATUS_ERR_MISSING_ENTRIES;
+    }
+
+    if (!isZero(mTrustedLast) && prev.hash != mTrustedLast)
+    {
+        CLOG(ERROR, "History")
+            << "Bad hash-chain: " << LedgerManager::ledgerAbbrev(prev)
+            << " was expected to have hash " << hexAbbrev(mTrustedLast);
+        return HistoryManager::VERIFY_STATUS_ERR_BAD_HASH;
+    }
+
+    mLastVerified = prev;
+    return HistoryManager::VERIFY_STATUS_OK;
+}
+
+Work::State
+LedgerSegmentWork::onSuccess()
+{
+    if (!mVerifyLedgers)
+    {
+        return WORK_SUCCESS;
+    }
+
+    mApp.getCatchupManager().logAndUpdateCatchupStatus(true);
+
+    // This is in onSuccess rather than onRun, so we can force a FAILURE_FATAL.
+    auto status = verifySegment();
+    if (status != HistoryManager::VERIFY_STATUS_OK)
+    {
+        mVerifyLedgerChainFailure.Mark();
+        CLOG(ERROR, "History")
+            << "Catchup material for segment [" << mRange.first() << ".."
+            << mRange.last()
+            << "] failed verification, propagating failure";
+        return WORK_FAILURE_FATAL;
+    }
+
+    mVerifyLedgerChainSuccess.Mark();
+    CLOG(DEBUG, "History") << "History chain segment [" << mRange.first()
+                           << ".." << mRange.last() << "] verified";
+    return WORK_SUCCESS;
+}
+
+void
+LedgerSegmentWork::onFailureRaise()
+{
+    // Only a verification failure implicates the files themselves.
+    if (!mVerifyLedgers || !allChildrenSuccessful())
+    {
+        return;
+    }
+
+    // the segment's headers do not chain up, and a broken link or hash may
+    // span two checkpoints, so evict all of them
+    auto& cache = mApp.getHistoryArchiveManager().getFileCache();
+    auto checkpoints = CheckpointRange{mRange, mApp.getHistoryManager()};
+    for (auto checkpoint = checkpoints.first();
+         checkpoint <= checkpoints.last();
+         checkpoint += checkpoints.frequency())
+    {
+        cache.removeCheckpoint(checkpoint);
+    }
+}
+}
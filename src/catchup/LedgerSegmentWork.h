@@ -0,0 +1,79 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#pragma once
+
+#include "history/HistoryManager.h"
+#include "ledger/LedgerRange.h"
+#include "work/Work.h"
+
+namespace medida
+{
+class Meter;
+}
+
+namespace stellar
+{
+
+class TmpDir;
+
+/**
+ * LedgerSegmentWork downloads the files of one catchup segment -- a range of
+ * ledgers ending on a checkpoint or on the catchup target -- and checks that
+ * its ledger headers form a single hash chain ending with trustedLast, if that
+ * is known (non-zero).
+ *
+ * Unlike VerifyLedgerChainWork it needs nothing from before the segment, so
+ * segments can be checked in any order and at the same time; knitting them
+ * together is left to ReplayLedgerSegmentsWork.
+ *
+ * * verifyLedgers - download the ledger headers and check them
+ * * downloadTransactions - download the transactions, to apply later
+ */
+class LedgerSegmentWork : public Work
+{
+    TmpDir const& mDownloadDir;
+    LedgerRange const mRange;
+    bool const mVerifyLedgers;
+    bool const mDownloadTransactions;
+    Hash const mTrustedLast;
+    LedgerHeaderHistoryEntry mFirstVerified;
+    LedgerHeaderHistoryEntry mLastVerified;
+
+    medida::Meter& mVerifyLedgerSuccess;
+    medida::Meter& mVerifyLedgerChainSuccess;
+    medida::Meter& mVerifyLedgerChainFailure;
+
+    HistoryManager::LedgerVerificationStatus verifySegment();
+
+  public:
+    LedgerSegmentWork(Application& app, WorkParent& parent,
+                      TmpDir const& downloadDir, LedgerRange range,
+                      bool verifyLedgers, bool downloadTransactions,
+                      Hash const& trustedLast);
+    ~LedgerSegmentWork();
+    void onReset() override;
+    Work::State onSuccess() override;
+    void onFailureRaise() override;
+
+    LedgerRange const&
+    getRange() const
+    {
+        return mRange;
+    }
+
+    // First and last headers of the segment's checkpoint files that were
+    // verified; the first one may precede the segment (and the LCL).
+    LedgerHeaderHistoryEntry const&
+    getFirstVerified() const
+    {
+        return mFirstVerified;
+    }
+    LedgerHeaderHistoryEntry const&
+    getLastVerified() const
+    {
+        return mLastVerified;
+    }
+};
+}
@@ -0,0 +1,390 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "catchup/ReplayLedgerSegmentsWork.h"
+#include "catchup/ApplyLedgerChainWork.h"
+#include "catchup/CatchupManager.h"
+#include "catchup/LedgerSegmentWork.h"
+#include "crypto/Hex.h"
+#include "history/FileTransferInfo.h"
+#include "history/HistoryManager.h"
+#include "ledger/CheckpointRange.h"
+#include "ledger/LedgerManager.h"
+#include "main/Application.h"
+#include "main/PersistentState.h"
+#include "util/Logging.h"
+#include <lib/util/format.h>
+#include <medida/meter.h>
+#include <medida/metrics_registry.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+namespace stellar
+{
+
+ReplayLedgerSegmentsWork::Cursor
+ReplayLedgerSegmentsWork::loadCursor(Application& app)
+{
+    Cursor cursor;
+    std::istringstream in(
+        app.getPersistentState().getState(PersistentState::kCatchupCursor));
+    std::string entry;
+    while (std::getline(in, entry, ','))
+    {
+        try
+        {
+            auto colon = entry.find(':');
+            auto ledger = std::stoul(entry.substr(0, colon));
+            cursor[static_cast<uint32_t>(ledger)] =
+                hexToBin256(entry.substr(colon + 1));
+        }
+        catch (std::exception&)
+        {
+            CLOG(WARNING, "History")
+                << "Ignoring unreadable catchup cursor entry '" << entry
+                << "'";
+            return {};
+        }
+    }
+    return cursor;
+}
+
+void
+ReplayLedgerSegmentsWork::saveCursor(Application& app, Cursor const& cursor)
+{
+    std::string state;
+    for (auto const& entry : cursor)
+    {
+        if (!state.empty())
+        {
+            state += ",";
+        }
+        state += fmt::format("{:d}:{:s}", entry.first, binToHex(entry.second));
+    }
+    app.getPersistentState().setState(PersistentState::kCatchupCursor, state);
+}
+
+ReplayLedgerSegmentsWork::ReplayLedgerSegmentsWork(
+    Application& app, WorkParent& parent, TmpDir const& downloadDir,
+    LedgerRange range, bool manualCatchup,
+    LedgerHeaderHistoryEntry& lastApplied)
+    : Work(app, parent, "replay-ledger-segments", RETRY_NEVER)
+    , mDownloadDir(downloadDir)
+    , mRange(range)
+    , mManualCatchup(manualCatchup)
+    , mLastApplied(lastApplied)
+    , mSegmentResumed(app.getMetrics().NewMeter(
+          {"history", "catchup-segment", "resumed"}, "segment"))
+    , mSegmentApplied(app.getMetrics().NewMeter(
+          {"history", "catchup-segment", "applied"}, "segment"))
+{
+    auto segmentLedgers =
+        uint64_t{app.getConfig().CATCHUP_SEGMENT_CHECKPOINTS} *
+        app.getHistoryManager().getCheckpointFrequency();
+    assert(segmentLedgers > 0);
+
+    // Segments end on every CATCHUP_SEGMENT_CHECKPOINTS-th checkpoint counted
+    // from genesis, so that runs started from different ledgers agree on them.
+    for (uint64_t first = mRange.first(); first <= mRange.last();)
+    {
+        auto last = std::min<uint64_t>(
+            (first / segmentLedgers + 1) * segmentLedgers - 1, mRange.last());
+        mSegments.emplace_back(static_cast<uint32_t>(first),
+                               static_cast<uint32_t>(last));
+        first = last + 1;
+    }
+}
+
+ReplayLedgerSegmentsWork::~ReplayLedgerSegmentsWork()
+{
+    clearChildren();
+}
+
+std::string
+ReplayLedgerSegmentsWork::getStatus() const
+{
+    if (mState == WORK_PENDING)
+    {
+        if (mApplyWork)
+        {
+            return mApplyWork->getStatus();
+        }
+        if (!mChainTrusted)
+        {
+            return fmt::format("verifying ledger segments: {:d}/{:d}",
+                               mVerified.size(),
+                               mSegments.size() - mFirstUntrusted);
+        }
+        return fmt::format("downloading ledger segment {:d}/{:d}",
+                           mNextApply + 1, mSegments.size());
+    }
+    return Work::getStatus();
+}
+
+void
+ReplayLedgerSegmentsWork::onReset()
+{
+    clearChildren();
+    mRunning.clear();
+    mVerified.clear();
+    mDownloaded.clear();
+    mApplyWork.reset();
+    mLastApplied = mApp.getLedgerManager().getLastClosedLedgerHeader();
+
+    auto lcl = mLastApplied.header.ledgerSeq;
+    mNextApply = 0;
+    while (mNextApply < mSegments.size() &&
+           mSegments[mNextApply].last() <= lcl)
+    {
+        ++mNextApply;
+    }
+
+    mTrusted.clear();
+    for (auto const& entry : loadCursor(mApp))
+    {
+        if (entry.first > lcl && entry.first <= mRange.last())
+        {
+            mTrusted.insert(entry);
+        }
+    }
+
+    mFirstUntrusted = mNextApply;
+    while (mFirstUntrusted < mSegments.size() &&
+           mTrusted.find(mSegments[mFirstUntrusted].last()) != mTrusted.end())
+    {
+        ++mFirstUntrusted;
+    }
+    if (mFirstUntrusted > mNextApply)
+    {
+        CLOG(INFO, "History")
+            << "Catchup resuming with " << mFirstUntrusted - mNextApply
+            << " ledger segments verified by a previous run";
+        mSegmentResumed.Mark(mFirstUntrusted - mNextApply);
+    }
+
+    mChainTrusted = mFirstUntrusted == mSegments.size();
+    mNext = mChainTrusted ? mNextApply : mFirstUntrusted;
+    CLOG(INFO, "History") << "Catchup replaying ledgers [" << mRange.first()
+                          << ".." << mRange.last() << "] in "
+                          << mSegments.size() - mNextApply << " segments";
+    addSegmentWork();
+}
+
+void
+ReplayLedgerSegmentsWork::addSegmentWork()
+{
+    auto maxSegments = mApp.getConfig().MAX_CONCURRENT_CATCHUP_SEGMENTS;
+
+    if (!mChainTrusted)
+    {
+        while (mRunning.size() < maxSegments && mNext < mSegments.size())
+        {
+            auto const& segment = mSegments[mNext];
+            auto trusted = mTrusted.find(segment.last());
+            auto w = addWork<LedgerSegmentWork>(
+                mDownloadDir, segment, true, false,
+                trusted == mTrusted.end() ? Hash{} : trusted->second);
+            mRunning.emplace(w->getUniqueName(), mNext++);
+        }
+        return;
+    }
+
+    // A segment counts against the limit from the time its download starts
+    // until it is applied, which also bounds the disk space it takes.
+    while (mNext < mSegments.size() && mNext - mNextApply < maxSegments)
+    {
+        auto const& segment = mSegments[mNext];
+        auto w = addWork<LedgerSegmentWork>(mDownloadDir, segment, true, true,
+                                            mTrusted.at(segment.last()));
+        mRunning.emplace(w->getUniqueName(), mNext++);
+    }
+
+    if (!mApplyWork && mDownloaded.find(mNextApply) != mDownloaded.end())
+    {
+        auto const& segment = mSegments[mNextApply];
+        CLOG(INFO, "History") << "Catchup applying transactions for segment ["
+                              << segment.first() << ".." << segment.last()
+                              << "]";
+        mApplyWork =
+            addWork<ApplyLedgerChainWork>(mDownloadDir, segment, mLastApplied);
+    }
+}
+
+void
+ReplayLedgerSegmentsWork::removeSegmentFiles(
+    size_t segment, std::vector<std::string> const& types)
+{
+    auto checkpoints =
+        CheckpointRange{mSegments[segment], mApp.getHistoryManager()};
+    for (auto checkpoint = checkpoints.first();
+         checkpoint <= checkpoints.last();
+         checkpoint += checkpoints.frequency())
+    {
+        for (auto const& type : types)
+        {
+            FileTransferInfo ft(mDownloadDir, type, checkpoint);
+            std::remove(ft.localPath_nogz().c_str());
+        }
+    }
+}
+
+bool
+ReplayLedgerSegmentsWork::trustVerifiedSegments()
+{
+    // Walk back from the target, which is the only ledger checked against the
+    // network, so that every segment is trusted through the one after it.
+    for (auto i = mSegments.size(); i-- > mFirstUntrusted;)
+    {
+        auto const& last = mVerified.at(i)->getLastVerified();
+        if (i + 1 < mSegments.size())
+        {
+            auto const& next = mVerified.at(i + 1)->getFirstVerified();
+            if (next.header.previousLedgerHash != last.hash)
+            {
+                CLOG(ERROR, "History")
+                    << "Bad hash-chain: " << LedgerManager::ledgerAbbrev(next)
+                    << " wants prev hash "
+                    << hexAbbrev(next.header.previousLedgerHash)
+                    << " but actual prev hash is " << hexAbbrev(last.hash);
+                return false;
+            }
+        }
+        else if (mTrusted.find(last.header.ledgerSeq) == mTrusted.end())
+        {
+            CLOG(INFO, "History") << "Verifying catchup candidate "
+                                  << last.header.ledgerSeq
+                                  << " with LedgerManager";
+            if (mApp.getLedgerManager().verifyCatchupCandidate(
+                    last, mManualCatchup) != HistoryManager::VERIFY_STATUS_OK)
+            {
+                return false;
+            }
+        }
+        mTrusted[last.header.ledgerSeq] = last.hash;
+    }
+
+    // And the first segment verified here must follow on from the last one
+    // that was trusted already.
+    if (mFirstUntrusted > mNextApply)
+    {
+        auto const& first = mVerified.at(mFirstUntrusted)->getFirstVerified();
+        auto const& prev = mTrusted.at(mSegments[mFirstUntrusted - 1].last());
+        if (first.header.previousLedgerHash != prev)
+        {
+            CLOG(ERROR, "History")
+                << "Bad hash-chain: " << LedgerManager::ledgerAbbrev(first)
+                << " wants prev hash "
+                << hexAbbrev(first.header.previousLedgerHash)
+                << " but catchup cursor has " << hexAbbrev(prev);
+            return false;
+        }
+    }
+
+    saveCursor(mApp, mTrusted);
+    return true;
+}
+
+void
+ReplayLedgerSegmentsWork::segmentApplied()
+{
+    auto const& segment = mSegments[mNextApply];
+    removeSegmentFiles(mNextApply, {HISTORY_FILE_TYPE_LEDGER,
+                                    HISTORY_FILE_TYPE_TRANSACTIONS});
+
+    // Only the hashes of segments still to be applied are worth keeping.
+    mTrusted.erase(mTrusted.begin(), mTrusted.upper_bound(segment.last()));
+    saveCursor(mApp, mTrusted);
+
+    mVerified.erase(mNextApply);
+    mDownloaded.erase(mNextApply);
+    mApplyWork.reset();
+    ++mNextApply;
+    mSegmentApplied.Mark();
+}
+
+Work::State
+ReplayLedgerSegmentsWork::onSuccess()
+{
+    if (!mChainTrusted)
+    {
+        if (!trustVerifiedSegments())
+        {
+            CLOG(ERROR, "History") << "Catchup material failed verification - "
+                                      "ledger segments do not knit up, "
+                                      "propagating failure";
+            return WORK_FAILURE_FATAL;
+        }
+
+        CLOG(INFO, "History") << "History chain [" << mRange.first() << ","
+                              << mRange.last() << "] verified";
+        mChainTrusted = true;
+        mNext = mNextApply;
+    }
+
+    if (mNextApply < mSegments.size())
+    {
+        addSegmentWork();
+        return WORK_PENDING;
+    }
+    return WORK_SUCCESS;
+}
+
+void
+ReplayLedgerSegmentsWork::onFailureRaise()
+{
+    // Material that failed verification may have been checked against a bad
+    // cursor entry: don't let that entry fail every later catchup as well.
+    if (mState == WORK_FAILURE_FATAL)
+    {
+        saveCursor(mApp, {});
+    }
+}
+
+void
+ReplayLedgerSegmentsWork::notify(std::string const& child)
+{
+    auto i = mChildren.find(child);
+    if (i == mChildren.end())
+    {
+        CLOG(WARNING, "Work")
+            << "ReplayLedgerSegmentsWork notified by unknown child " << child;
+        return;
+    }
+
+    if (i->second->getState() == WORK_SUCCESS)
+    {
+        if (i->second == mApplyWork)
+        {
+            mChildren.erase(i);
+            segmentApplied();
+        }
+        else
+        {
+            auto running = mRunning.find(child);
+            assert(running != mRunning.end());
+            if (mChainTrusted)
+            {
+                mDownloaded.insert(running->second);
+            }
+            else
+            {
+                // Only the segment's first and last headers are needed from
+                // here on, and the work holds them: the files would otherwise
+                // pile up for every untrusted segment until it is applied.
+                mVerified[running->second] =
+                    std::static_pointer_cast<LedgerSegmentWork>(i->second);
+                removeSegmentFiles(running->second, {HISTORY_FILE_TYPE_LEDGER});
+            }
+            mRunning.erase(running);
+            mChildren.erase(i);
+        }
+        addSegmentWork();
+    }
+
+    mApp.getCatchupManager().logAndUpdateCatchupStatus(true);
+    advance();
+}
+}
@@ -0,0 +1,104 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#pragma once
+
+#include "ledger/LedgerRange.h"
+#include "work/Work.h"
+#include "xdr/Stellar-ledger.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace medida
+{
+class Meter;
+}
+
+namespace stellar
+{
+
+class LedgerSegmentWork;
+class TmpDir;
+
+/**
+ * ReplayLedgerSegmentsWork downloads, verifies and applies the ledgers of a
+ * catchup that only replays transactions (catchup-complete) in segments of
+ * CATCHUP_SEGMENT_CHECKPOINTS checkpoints. Each segment is downloaded and
+ * checked by its own LedgerSegmentWork, which retries on its own, and at most
+ * MAX_CONCURRENT_CATCHUP_SEGMENTS segments are in flight at a time.
+ *
+ * It works in two phases:
+ *
+ * 1. The ledger headers of every segment whose last hash is not yet trusted
+ *    are downloaded and verified concurrently. The segments are then knit
+ *    together from the last one, which is checked against the network with
+ *    LedgerManager::verifyCatchupCandidate (as in VerifyLedgerChainWork),
+ *    back to the first, and the hash of every segment's last ledger is stored
+ *    in the catchup cursor. Knitting only needs the first and last header of
+ *    each segment, so its header files are deleted as soon as it is
+ *    verified.
+ *
+ * 2. Headers and transactions are downloaded for up to
+ *    MAX_CONCURRENT_CATCHUP_SEGMENTS segments, starting with the one to apply
+ *    next; the headers are checked again, against the hash recorded for the
+ *    segment in phase 1. Segments are applied in order with
+ *    ApplyLedgerChainWork, and the files of a segment are deleted once it is
+ *    applied.
+ *
+ * The cursor (PersistentState::kCatchupCursor) survives restarts. A catchup
+ * that is interrupted and started again trusts the hashes it recorded, so it
+ * only has to check each remaining segment against its own recorded hash --
+ * in phase 2, as the segment is downloaded -- instead of re-verifying the
+ * whole chain up to the network before applying anything.
+ */
+class ReplayLedgerSegmentsWork : public Work
+{
+  public:
+    // Last ledger of a segment -> the hash that ledger is known to have.
+    using Cursor = std::map<uint32_t, Hash>;
+
+    static Cursor loadCursor(Application& app);
+    static void saveCursor(Application& app, Cursor const& cursor);
+
+  private:
+    TmpDir const& mDownloadDir;
+    LedgerRange const mRange;
+    bool const mManualCatchup;
+    LedgerHeaderHistoryEntry& mLastApplied;
+    std::vector<LedgerRange> mSegments;
+
+    Cursor mTrusted;
+    bool mChainTrusted{false};
+    size_t mFirstUntrusted{0};
+    size_t mNext{0};
+    size_t mNextApply{0};
+    std::map<std::string, size_t> mRunning;
+    std::map<size_t, std::shared_ptr<LedgerSegmentWork>> mVerified;
+    std::set<size_t> mDownloaded;
+    std::shared_ptr<Work> mApplyWork;
+
+    medida::Meter& mSegmentResumed;
+    medida::Meter& mSegmentApplied;
+
+    void addSegmentWork();
+    void removeSegmentFiles(size_t segment,
+                            std::vector<std::string> const& types);
+    bool trustVerifiedSegments();
+    void segmentApplied();
+
+  public:
+    ReplayLedgerSegmentsWork(Application& app, WorkParent& parent,
+                             TmpDir const& downloadDir, LedgerRange range,
+                             bool manualCatchup,
+                             LedgerHeaderHistoryEntry& lastApplied);
+    ~ReplayLedgerSegmentsWork();
+    std::string getStatus() const override;
+    void onReset() override;
+    Work::State onSuccess() override;
+    void onFailureRaise() override;
+    void notify(std::string const& child) override;
+};
+}
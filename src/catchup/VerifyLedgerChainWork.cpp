@@ -4,6 +4,8 @@
 
 #include "catchup/VerifyLedgerChainWork.h"
 #include "history/FileTransferInfo.h"
+#include "history/HistoryArchiveManager.h"
+#include "history/HistoryFileCache.h"
 #include "historywork/Progress.h"
 #include "ledger/LedgerHeaderFrame.h"
 #include "ledger/LedgerManager.h"
@@ -15,7 +17,7 @@
 namespace stellar
 {
 
-static HistoryManager::LedgerVerificationStatus
+HistoryManager::LedgerVerificationStatus
 verifyLedgerHistoryEntry(LedgerHeaderHistoryEntry const& hhe)
 {
     LedgerHeaderFrame lFrame(hhe.header);
@@ -31,7 +33,7 @@ verifyLedgerHistoryEntry(LedgerHeaderHistoryEntry const& hhe)
     return HistoryManager::VERIFY_STATUS_OK;
 }
 
-static HistoryManager::LedgerVerificationStatus
+HistoryManager::LedgerVerificationStatus
 verifyLedgerHistoryLink(Hash const& prev, LedgerHeaderHistoryEntry const& curr)
 {
     auto entryResult = verifyLedgerHistoryEntry(curr);
@@ -270,4 +272,12 @@ VerifyLedgerChainWork::onSuccess()
         throw std::runtime_error("unexpected VerifyLedgerChainWork state");
     }
 }
+
+void
+VerifyLedgerChainWork::onFailureRaise()
+{
+    // the headers of the checkpoint being verified do not chain up
+    mApp.getHistoryArchiveManager().getFileCache().removeCheckpoint(
+        mCurrCheckpoint);
+}
 }
@@ -19,6 +19,13 @@ namespace stellar
 class TmpDir;
 struct LedgerHeaderHistoryEntry;
 
+// Check that a ledger-header history entry hashes to the hash it claims and,
+// for a link, that it names prev as the hash of its predecessor.
+HistoryManager::LedgerVerificationStatus
+verifyLedgerHistoryEntry(LedgerHeaderHistoryEntry const& hhe);
+HistoryManager::LedgerVerificationStatus
+verifyLedgerHistoryLink(Hash const& prev, LedgerHeaderHistoryEntry const& curr);
+
 class VerifyLedgerChainWork : public Work
 {
     TmpDir const& mDownloadDir;
@@ -49,5 +56,6 @@ class VerifyLedgerChainWork : public Work
     std::string getStatus() const override;
     void onReset() override;
     Work::State onSuccess() override;
+    void onFailureRaise() override;
 };
 }
@@ -54,7 +54,7 @@ using namespace std;
 
 bool Database::gDriversRegistered = false;
 
-static unsigned long const SCHEMA_VERSION = 7;
+static unsigned long const SCHEMA_VERSION = 9;
 
 static void
 setSerializable(soci::session& sess)
@@ -76,13 +76,14 @@ Database::registerDrivers()
     }
 }
 
-Database::Database(Application& app)
+Database::Database(Application& app, std::string const& queryMeterDomain)
     : mApp(app)
-    , mQueryMeter(
-          app.getMetrics().NewMeter({"database", "query", "exec"}, "query"))
+    , mQueryMeter(app.getMetrics().NewMeter(
+          {queryMeterDomain, "query", "exec"}, "query"))
     , mStatementsSize(
           app.getMetrics().NewCounter({"database", "memory", "statements"}))
     , mEntryCache(4096)
+    , mTrackingInflationVotes(true)
     , mExcludedQueryTime(0)
     , mExcludedTotalTime(0)
     , mLastIdleQueryTime(0)
@@ -158,6 +159,21 @@ Database::applySchemaUpgrade(unsigned long vers)
                     "CHECK (sellingliabilities >= 0)";
         break;
 
+    case 8:
+        mSession << "ALTER TABLE offers ADD assetpair BIGINT NOT NULL "
+                    "DEFAULT 0";
+        OfferFrame::backfillAssetPairs(*this);
+        // bestofferindex serves loadBestOffers with one index range scan per
+        // asset pair, already in (price, offerid) order
+        mSession << "DROP INDEX priceindex";
+        mSession << "CREATE INDEX bestofferindex ON offers "
+                    "(assetpair, price, offerid)";
+        break;
+
+    case 9:
+        AccountFrame::initializeInflationVotes(*this);
+        break;
+
     default:
         throw std::runtime_error("Unknown DB schema version");
         break;
@@ -278,6 +294,49 @@ Database::isSqlite() const
            std::string::npos;
 }
 
+bool
+Database::needsSavepoints() const
+{
+    return !isSqlite() ||
+           mApp.getConfig().ARTIFICIALLY_USE_SAVEPOINTS_FOR_TESTING;
+}
+
+bool
+Database::isTrackingInflationVotes() const
+{
+    return mTrackingInflationVotes;
+}
+
+void
+Database::setTrackingInflationVotes(bool tracking)
+{
+    if (tracking == mTrackingInflationVotes)
+    {
+        return;
+    }
+    // persisted so that a restart can tell the tally was left stale
+    mApp.getPersistentState().setState(PersistentState::kInflationVotesDirty,
+                                       tracking ? "false" : "true");
+    mTrackingInflationVotes = tracking;
+}
+
+void
+Database::repairInflationVotes()
+{
+    auto& ps = mApp.getPersistentState();
+    if (ps.getState(PersistentState::kInflationVotesDirty) != "true")
+    {
+        return;
+    }
+
+    CLOG(INFO, "Database")
+        << "Rebuilding inflation votes left stale by an interrupted bulk load";
+    soci::transaction sqlTx(mSession);
+    AccountFrame::rebuildInflationVotes(*this);
+    ps.setState(PersistentState::kInflationVotesDirty, "false");
+    sqlTx.commit();
+}
+
 bool
 Database::canUsePool() const
 {
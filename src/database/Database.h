@@ -95,6 +95,8 @@ class Database : NonMovableOrCopyable
     cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>
         mEntryCache;
 
+    bool mTrackingInflationVotes;
+
     // Helpers for maintaining the total query time and calculating
     // idle percentage.
     std::set<std::string> mEntityTypes;
@@ -109,8 +111,10 @@ class Database : NonMovableOrCopyable
 
   public:
     // Instantiate object and connect to app.getConfig().DATABASE;
-    // if there is a connection error, this will throw.
-    Database(Application& app);
+    // if there is a connection error, this will throw. Queries are counted
+    // by the meter {queryMeterDomain, "query", "exec"}.
+    explicit Database(Application& app,
+                      std::string const& queryMeterDomain = "database");
 
     // Return a crude meter of total queries to the db, for use in
     // overlay/LoadManager.
@@ -162,6 +166,13 @@ class Database : NonMovableOrCopyable
     // Return true if the Database target is SQLite, otherwise false.
     bool isSqlite() const;
 
+    // Return true if failed transactions and offers have to be contained in
+    // SQL savepoints, otherwise false, in which case LedgerDelta writes back
+    // what they changed. PostgreSQL aborts the whole SQL transaction on any
+    // statement error, so there only a savepoint keeps such an error from
+    // failing the ledger close.
+    bool needsSavepoints() const;
+
     // Return true if a connection pool is available for worker threads
     // to read from the database through, otherwise false.
     bool canUsePool() const;
@@ -195,6 +206,17 @@ class Database : NonMovableOrCopyable
     typedef cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>
         EntryCache;
     EntryCache& getEntryCache();
+
+    // Whether account writes keep the inflationvotes tally up to date. Bulk
+    // loads (bucket apply) turn this off and rebuild the tally once they are
+    // done, with AccountFrame::rebuildInflationVotes; until then inflation
+    // falls back to summing the accounts table. The switch is persisted, so
+    // that repairInflationVotes, run whenever the last known ledger is
+    // loaded, can rebuild a tally left stale by a bulk load that never
+    // finished.
+    bool isTrackingInflationVotes() const;
+    void setTrackingInflationVotes(bool tracking);
+    void repairInflationVotes();
 };
 
 class DBTimeExcluder : NonCopyable
@@ -70,6 +70,8 @@ class Herder
         TX_STATUS_PENDING = 0,
         TX_STATUS_DUPLICATE,
         TX_STATUS_ERROR,
+        // the queue is full of transactions paying a higher fee per operation
+        TX_STATUS_TRY_AGAIN_LATER,
         TX_STATUS_COUNT
     };
 
@@ -104,6 +106,15 @@ class Herder
     virtual bool recvSCPQuorumSet(Hash const& hash,
                                   SCPQuorumSet const& qset) = 0;
     virtual bool recvTxSet(Hash const& hash, TxSetFrame const& txset) = 0;
+    // We are learning about a tx set by the hashes of its transactions, from
+    // peer; returns the hashes of the ones we need to ask it for, none while
+    // another peer is already asked for them.
+    virtual std::vector<Hash>
+    recvCompactTxSet(CompactTransactionSet const& compact,
+                     Peer::pointer peer) = 0;
+    // We are receiving the transactions asked for after recvCompactTxSet.
+    virtual bool recvTxSetTransactions(TxSetTransactions const& txs,
+                                       Peer::pointer peer) = 0;
     // We are learning about a new transaction.
     virtual TransactionSubmitStatus recvTransaction(TransactionFramePtr tx) = 0;
     virtual void peerDoesntHave(stellar::MessageType type,
@@ -65,11 +65,16 @@ HerderImpl::SCPMetrics::SCPMetrics(Application& app)
           app.getMetrics().NewCounter({"herder", "pending-txs", "age2"}))
     , mHerderPendingTxs3(
           app.getMetrics().NewCounter({"herder", "pending-txs", "age3"}))
+    , mHerderPendingTxsBytes(
+          app.getMetrics().NewCounter({"herder", "pending-txs", "bytes"}))
+    , mHerderPendingTxsRejected(app.getMetrics().NewMeter(
+          {"herder", "pending-txs", "rejected"}, "transaction"))
 {
 }
 
 HerderImpl::HerderImpl(Application& app)
-    : mPendingTransactions(4)
+    : mTransactionQueue(4, app.getConfig().TRANSACTION_QUEUE_SIZE_LIMIT,
+                        app.getConfig().TRANSACTION_QUEUE_BYTES_LIMIT)
     , mPendingEnvelopes(app, *this)
     , mHerderSCPDriver(app, *this, mUpgrades, mPendingEnvelopes)
     , mLastSlotSaved(0)
@@ -136,34 +141,6 @@ HerderImpl::updateSCPCounters()
         getSCP().getCumulativeStatemtCount());
 }
 
-static uint64_t
-countTxs(HerderImpl::AccountTxMap const& acc)
-{
-    uint64_t sz = 0;
-    for (auto const& a : acc)
-    {
-        sz += a.second->mTransactions.size();
-    }
-    return sz;
-}
-
-static std::shared_ptr<HerderImpl::TxMap>
-findOrAdd(HerderImpl::AccountTxMap& acc, AccountID const& aid)
-{
-    std::shared_ptr<HerderImpl::TxMap> txmap = nullptr;
-    auto i = acc.find(aid);
-    if (i == acc.end())
-    {
-        txmap = std::make_shared<HerderImpl::TxMap>();
-        acc.insert(std::make_pair(aid, txmap));
-    }
-    else
-    {
-        txmap = i->second;
-    }
-    return txmap;
-}
-
 void
 HerderImpl::valueExternalized(uint64 slotIndex, StellarValue const& value)
 {
@@ -292,31 +269,6 @@ HerderImpl::emitEnvelope(SCPEnvelope const& envelope)
     startRebroadcastTimer();
 }
 
-void
-HerderImpl::TxMap::addTx(TransactionFramePtr tx)
-{
-    auto const& h = tx->getFullHash();
-    if (mTransactions.find(h) != mTransactions.end())
-    {
-        return;
-    }
-    mTransactions.insert(std::make_pair(h, tx));
-    mMaxSeq = std::max(tx->getSeqNum(), mMaxSeq);
-    mTotalFees += tx->getFee();
-}
-
-void
-HerderImpl::TxMap::recalculate()
-{
-    mMaxSeq = 0;
-    mTotalFees = 0;
-    for (auto const& pair : mTransactions)
-    {
-        mMaxSeq = std::max(pair.second->getSeqNum(), mMaxSeq);
-        mTotalFees += pair.second->getFee();
-    }
-}
-
 Herder::TransactionSubmitStatus
 HerderImpl::recvTransaction(TransactionFramePtr tx)
 {
@@ -328,25 +280,15 @@ HerderImpl::recvTransaction(TransactionFramePtr tx)
 
     // determine if we have seen this tx before and if not if it has the right
     // seq num
-    int64_t totFee = tx->getFee();
-    SequenceNumber highSeq = 0;
-
-    for (auto& map : mPendingTransactions)
+    if (mTransactionQueue.contains(txID))
     {
-        auto i = map.find(acc);
-        if (i != map.end())
-        {
-            auto& txmap = i->second;
-            auto j = txmap->mTransactions.find(txID);
-            if (j != txmap->mTransactions.end())
-            {
-                return TX_STATUS_DUPLICATE;
-            }
-            totFee += txmap->mTotalFees;
-            highSeq = std::max(highSeq, txmap->mMaxSeq);
-        }
+        return TX_STATUS_DUPLICATE;
     }
 
+    auto pending = mTransactionQueue.getAccountState(acc);
+    int64_t totFee = tx->getFee() + pending.mTotalFees;
+    SequenceNumber highSeq = pending.mMaxSeq;
+
     if (!tx->checkValid(mApp, highSeq))
     {
         return TX_STATUS_ERROR;
@@ -362,8 +304,12 @@ HerderImpl::recvTransaction(TransactionFramePtr tx)
         CLOG(TRACE, "Herder") << "recv transaction " << hexAbbrev(txID)
                               << " for " << KeyUtils::toShortString(acc);
 
-    auto txmap = findOrAdd(mPendingTransactions[0], acc);
-    txmap->addTx(tx);
+    if (!mTransactionQueue.tryAdd(tx))
+    {
+        // the queue is full of transactions paying more
+        mSCPMetrics.mHerderPendingTxsRejected.Mark();
+        return TX_STATUS_TRY_AGAIN_LATER;
+    }
 
     return TX_STATUS_PENDING;
 }
@@ -597,44 +543,7 @@ HerderImpl::ledgerClosed()
 void
 HerderImpl::removeReceivedTxs(std::vector<TransactionFramePtr> const& dropTxs)
 {
-    for (auto& m : mPendingTransactions)
-    {
-        if (m.empty())
-        {
-            continue;
-        }
-
-        std::set<std::shared_ptr<TxMap>> toRecalculate;
-
-        for (auto const& tx : dropTxs)
-        {
-            auto const& acc = tx->getSourceID();
-            auto const& txID = tx->getFullHash();
-            auto i = m.find(acc);
-            if (i != m.end())
-            {
-                auto& txs = i->second->mTransactions;
-                auto j = txs.find(txID);
-                if (j != txs.end())
-                {
-                    txs.erase(j);
-                    if (txs.empty())
-                    {
-                        m.erase(i);
-                    }
-                    else
-                    {
-                        toRecalculate.insert(i->second);
-                    }
-                }
-            }
-        }
-
-        for (auto txm : toRecalculate)
-        {
-            txm->recalculate();
-        }
-    }
+    mTransactionQueue.remove(dropTxs);
 }
 
 bool
@@ -650,6 +559,20 @@ HerderImpl::recvTxSet(Hash const& hash, const TxSetFrame& t)
     return mPendingEnvelopes.recvTxSet(hash, txset);
 }
 
+std::vector<Hash>
+HerderImpl::recvCompactTxSet(CompactTransactionSet const& compact,
+                             Peer::pointer peer)
+{
+    return mPendingEnvelopes.recvCompactTxSet(compact, peer);
+}
+
+bool
+HerderImpl::recvTxSetTransactions(TxSetTransactions const& txs,
+                                  Peer::pointer peer)
+{
+    return mPendingEnvelopes.recvTxSetTransactions(txs, peer);
+}
+
 void
 HerderImpl::peerDoesntHave(MessageType type, uint256 const& itemID,
                            Peer::pointer peer)
@@ -692,17 +615,13 @@ HerderImpl::getCurrentLedgerSeq() const
 SequenceNumber
 HerderImpl::getMaxSeqInPendingTxs(AccountID const& acc)
 {
-    SequenceNumber highSeq = 0;
-    for (auto const& m : mPendingTransactions)
-    {
-        auto i = m.find(acc);
-        if (i == m.end())
-        {
-            continue;
-        }
-        highSeq = std::max(i->second->mMaxSeq, highSeq);
-    }
-    return highSeq;
+    return mTransactionQueue.getAccountState(acc).mMaxSeq;
+}
+
+TransactionFramePtr
+HerderImpl::getPendingTransaction(Hash const& fullHash) const
+{
+    return mTransactionQueue.getTx(fullHash);
 }
 
 // called to take a position during the next round
@@ -723,15 +642,9 @@ HerderImpl::triggerNextLedger(uint32_t ledgerSeqToTrigger)
     auto const& lcl = mLedgerManager.getLastClosedLedgerHeader();
     auto proposedSet = std::make_shared<TxSetFrame>(lcl.hash);
 
-    for (auto const& m : mPendingTransactions)
+    for (auto const& tx : mTransactionQueue.getTransactions())
     {
-        for (auto const& pair : m)
-        {
-            for (auto const& tx : pair.second->mTransactions)
-            {
-                proposedSet->add(tx.second);
-            }
-        }
+        proposedSet->add(tx);
     }
 
     std::vector<TransactionFramePtr> removed;
@@ -1059,29 +972,20 @@ void
 HerderImpl::updatePendingTransactions(
     std::vector<TransactionFramePtr> const& applied)
 {
-    // remove all these tx from mPendingTransactions
+    // remove all these tx from mTransactionQueue
     removeReceivedTxs(applied);
 
-    // drop the highest level
-    mPendingTransactions.erase(--mPendingTransactions.end());
-
-    // shift entries up
-    mPendingTransactions.emplace_front();
+    // age the remaining ones, dropping the oldest
+    mTransactionQueue.shift();
 
     // rebroadcast entries, sorted in apply-order to maximize chances of
     // propagation
     {
         Hash h;
         TxSetFrame toBroadcast(h);
-        for (auto const& l : mPendingTransactions)
+        for (auto const& tx : mTransactionQueue.getTransactions())
         {
-            for (auto const& pair : l)
-            {
-                for (auto const& tx : pair.second->mTransactions)
-                {
-                    toBroadcast.add(tx.second);
-                }
-            }
+            toBroadcast.add(tx);
         }
         for (auto tx : toBroadcast.sortForApply())
         {
@@ -1090,10 +994,11 @@ HerderImpl::updatePendingTransactions(
         }
     }
 
-    mSCPMetrics.mHerderPendingTxs0.set_count(countTxs(mPendingTransactions[0]));
-    mSCPMetrics.mHerderPendingTxs1.set_count(countTxs(mPendingTransactions[1]));
-    mSCPMetrics.mHerderPendingTxs2.set_count(countTxs(mPendingTransactions[2]));
-    mSCPMetrics.mHerderPendingTxs3.set_count(countTxs(mPendingTransactions[3]));
+    mSCPMetrics.mHerderPendingTxs0.set_count(mTransactionQueue.countTxs(0));
+    mSCPMetrics.mHerderPendingTxs1.set_count(mTransactionQueue.countTxs(1));
+    mSCPMetrics.mHerderPendingTxs2.set_count(mTransactionQueue.countTxs(2));
+    mSCPMetrics.mHerderPendingTxs3.set_count(mTransactionQueue.countTxs(3));
+    mSCPMetrics.mHerderPendingTxsBytes.set_count(mTransactionQueue.sizeBytes());
 }
 
 void
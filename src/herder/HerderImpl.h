@@ -7,12 +7,11 @@
 #include "PendingEnvelopes.h"
 #include "herder/Herder.h"
 #include "herder/HerderSCPDriver.h"
+#include "herder/TransactionQueue.h"
 #include "herder/Upgrades.h"
 #include "util/Timer.h"
 #include "util/XDROperators.h"
-#include <deque>
 #include <memory>
-#include <unordered_map>
 #include <vector>
 
 namespace medida
@@ -68,6 +67,11 @@ class HerderImpl : public Herder
 
     bool recvSCPQuorumSet(Hash const& hash, const SCPQuorumSet& qset) override;
     bool recvTxSet(Hash const& hash, const TxSetFrame& txset) override;
+    std::vector<Hash>
+    recvCompactTxSet(CompactTransactionSet const& compact,
+                     Peer::pointer peer) override;
+    bool recvTxSetTransactions(TxSetTransactions const& txs,
+                               Peer::pointer peer) override;
     void peerDoesntHave(MessageType type, uint256 const& itemID,
                         Peer::pointer peer) override;
     TxSetFramePtr getTxSet(Hash const& hash) override;
@@ -79,6 +83,9 @@ class HerderImpl : public Herder
 
     SequenceNumber getMaxSeqInPendingTxs(AccountID const&) override;
 
+    // the received transaction with that full hash, if not applied yet
+    TransactionFramePtr getPendingTransaction(Hash const& fullHash) const;
+
     void triggerNextLedger(uint32_t ledgerSeqToTrigger) override;
 
     void setUpgrades(Upgrades::UpgradeParameters const& upgrades) override;
@@ -90,16 +97,6 @@ class HerderImpl : public Herder
     Json::Value getJsonQuorumInfo(NodeID const& id, bool summary,
                                   uint64 index) override;
 
-    struct TxMap
-    {
-        SequenceNumber mMaxSeq{0};
-        int64_t mTotalFees{0};
-        std::unordered_map<Hash, TransactionFramePtr> mTransactions;
-        void addTx(TransactionFramePtr);
-        void recalculate();
-    };
-    typedef std::unordered_map<AccountID, std::shared_ptr<TxMap>> AccountTxMap;
-
   private:
     void ledgerClosed();
     void removeReceivedTxs(std::vector<TransactionFramePtr> const& txs);
@@ -112,11 +109,9 @@ class HerderImpl : public Herder
 
     void processSCPQueueUpToIndex(uint64 slotIndex);
 
-    // 0- tx we got during ledger close
-    // 1- one ledger ago. rebroadcast
-    // 2- two ledgers ago. rebroadcast
-    // ...
-    std::deque<AccountTxMap> mPendingTransactions;
+    // transactions received but not applied yet, kept for 4 ledger closes
+    // and rebroadcast after each of them
+    TransactionQueue mTransactionQueue;
 
     void
     updatePendingTransactions(std::vector<TransactionFramePtr> const& applied);
@@ -178,6 +173,8 @@ class HerderImpl : public Herder
         medida::Counter& mHerderPendingTxs1;
         medida::Counter& mHerderPendingTxs2;
         medida::Counter& mHerderPendingTxs3;
+        medida::Counter& mHerderPendingTxsBytes;
+        medida::Meter& mHerderPendingTxsRejected;
 
         SCPMetrics(Application& app);
     };
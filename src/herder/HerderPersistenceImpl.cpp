@@ -7,11 +7,15 @@
 #include "database/Database.h"
 #include "database/DatabaseUtils.h"
 #include "herder/Herder.h"
+#include "history/CheckpointBuilder.h"
+#include "history/HistoryManager.h"
 #include "main/Application.h"
 #include "scp/Slot.h"
 #include "util/Decoder.h"
 #include "util/XDRStream.h"
 
+#include <algorithm>
+#include <map>
 #include <soci.h>
 #include <xdrpp/marshal.h>
 
@@ -137,6 +141,39 @@ HerderPersistenceImpl::saveSCPHistory(uint32_t seq,
     }
 
     txscope.commit();
+
+    // Hand the same messages to the history blocks streamed out for
+    // publishing, in the order copySCPHistoryToStream would read them back:
+    // envelopes by node and quorum sets by hash.
+    SCPHistoryEntry hEntryV;
+    hEntryV.v(0);
+    auto& hEntry = hEntryV.v0();
+    hEntry.ledgerMessages.ledgerSeq = seq;
+
+    std::vector<std::pair<std::string, SCPEnvelope const*>> byNode;
+    byNode.reserve(envs.size());
+    for (auto const& e : envs)
+    {
+        byNode.emplace_back(KeyUtils::toStrKey(e.statement.nodeID), &e);
+    }
+    std::stable_sort(byNode.begin(), byNode.end(),
+                     [](std::pair<std::string, SCPEnvelope const*> const& a,
+                        std::pair<std::string, SCPEnvelope const*> const& b) {
+                         return a.first < b.first;
+                     });
+    for (auto const& p : byNode)
+    {
+        hEntry.ledgerMessages.messages.push_back(*p.second);
+    }
+
+    std::map<Hash, SCPQuorumSetPtr> qSetsByHash(usedQSets.begin(),
+                                                usedQSets.end());
+    for (auto const& p : qSetsByHash)
+    {
+        hEntry.quorumSets.push_back(*p.second);
+    }
+
+    mApp.getHistoryManager().getCheckpointBuilder().appendSCPHistory(hEntryV);
 }
 
 size_t
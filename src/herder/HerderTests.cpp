@@ -13,6 +13,7 @@
 #include "test/test.h"
 
 #include "crypto/SHA.h"
+#include "crypto/SecretKey.h"
 #include "database/Database.h"
 #include "ledger/LedgerHeaderFrame.h"
 #include "ledger/LedgerManager.h"
@@ -21,6 +22,8 @@
 #include "overlay/OverlayManager.h"
 #include "test/TxTests.h"
 
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include "xdrpp/marshal.h"
 
 using namespace stellar;
@@ -303,6 +306,24 @@ TEST_CASE("txset", "[herder]")
             REQUIRE(txSet->checkValid(*app));
         }
     }
+    SECTION("signatures verified ahead of the checks")
+    {
+        txSet->sortForHash();
+        PubKeyUtils::clearVerifySigCache();
+        uint64_t hits, misses;
+        PubKeyUtils::flushVerifySigCacheCounts(hits, misses);
+
+        auto& checkValidTimer =
+            app->getMetrics().NewTimer({"herder", "txset", "check-valid"});
+        auto count = checkValidTimer.count();
+        REQUIRE(txSet->checkValid(*app));
+        REQUIRE(checkValidTimer.count() == count + 1);
+
+        // each signature was verified once, and then found in the cache
+        PubKeyUtils::flushVerifySigCacheCounts(hits, misses);
+        REQUIRE(misses == nbAccounts * nbTransactions);
+        REQUIRE(hits >= nbAccounts * nbTransactions);
+    }
     SECTION("invalid tx")
     {
         SECTION("no user")
@@ -18,6 +18,10 @@ using namespace std;
 #define TXSET_CACHE_SIZE 10000
 #define NODES_QUORUM_CACHE_SIZE 1000
 
+// how long the peer asked for the missing transactions of a tx set has to
+// send them before the next peer listing the set is asked instead
+static std::chrono::milliseconds const TX_SET_TXS_TIMEOUT{1500};
+
 namespace stellar
 {
 
@@ -33,6 +37,10 @@ PendingEnvelopes::PendingEnvelopes(Application& app, HerderImpl& herder)
     , mNodesInQuorum(NODES_QUORUM_CACHE_SIZE)
     , mReadyEnvelopesSize(
           app.getMetrics().NewCounter({"scp", "memory", "pending-envelopes"}))
+    , mCompactTxSetKnownMeter(app.getMetrics().NewMeter(
+          {"herder", "txset", "compact-known"}, "transaction"))
+    , mCompactTxSetMissingMeter(app.getMetrics().NewMeter(
+          {"herder", "txset", "compact-missing"}, "transaction"))
 {
 }
 
@@ -47,8 +55,16 @@ PendingEnvelopes::peerDoesntHave(MessageType type, Hash const& itemID,
     switch (type)
     {
     case TX_SET:
+    {
+        // also the answer to GET_TX_SET_TXS
+        auto it = mPartialTxSets.find(itemID);
+        if (it != mPartialTxSets.end() && it->second.mPeer == peer)
+        {
+            it->second.mPeer.reset();
+        }
         mTxSetFetcher.doesntHave(itemID, peer);
         break;
+    }
     case SCP_QUORUMSET:
         mQuorumSetFetcher.doesntHave(itemID, peer);
         break;
@@ -113,6 +129,7 @@ PendingEnvelopes::addTxSet(Hash hash, uint64 lastSeenSlotIndex,
     CLOG(TRACE, "Herder") << "Add TxSet " << hexAbbrev(hash);
 
     mTxSetCache.put(hash, std::make_pair(lastSeenSlotIndex, txset));
+    mPartialTxSets.erase(hash);
     mTxSetFetcher.recv(hash);
 }
 
@@ -131,6 +148,138 @@ PendingEnvelopes::recvTxSet(Hash hash, TxSetFramePtr txset)
     return true;
 }
 
+std::vector<Hash>
+PendingEnvelopes::recvCompactTxSet(CompactTransactionSet const& compact,
+                                   Peer::pointer peer)
+{
+    auto const& hash = compact.txSetHash;
+    CLOG(TRACE, "Herder") << "Got compact TxSet " << hexAbbrev(hash);
+
+    std::vector<Hash> missing;
+    auto lastSeenSlotIndex = mTxSetFetcher.getLastSeenSlotIndex(hash);
+    if (lastSeenSlotIndex == 0 || mTxSetCache.exists(hash))
+    {
+        return missing;
+    }
+
+    auto it = mPartialTxSets.find(hash);
+    if (it == mPartialTxSets.end())
+    {
+        PartialTxSet partial;
+        partial.mLastSeenSlotIndex = lastSeenSlotIndex;
+        partial.mPreviousLedgerHash = compact.previousLedgerHash;
+        partial.mTxHashes = compact.txHashes;
+        for (auto const& h : partial.mTxHashes)
+        {
+            if (auto tx = mHerder.getPendingTransaction(h))
+            {
+                partial.mTxs.emplace(h, tx);
+            }
+            else
+            {
+                partial.mMissing.emplace(h);
+            }
+        }
+        mCompactTxSetKnownMeter.Mark(partial.mTxs.size());
+        mCompactTxSetMissingMeter.Mark(partial.mMissing.size());
+        it = mPartialTxSets.emplace(hash, std::move(partial)).first;
+    }
+    else if (it->second.mPreviousLedgerHash != compact.previousLedgerHash ||
+             it->second.mTxHashes != compact.txHashes)
+    {
+        // another peer disagrees on the contents: only one of them can be
+        // right, start over with this one
+        mPartialTxSets.erase(it);
+        return recvCompactTxSet(compact, peer);
+    }
+
+    auto& partial = it->second;
+    if (partial.mMissing.empty())
+    {
+        partial.mPeer = peer;
+        completeTxSet(it);
+        return missing;
+    }
+
+    // ask for the missing transactions only once, unless the peer asked
+    // failed to send them or is taking too long
+    auto now = mApp.getClock().now();
+    if (partial.mPeer && now - partial.mAskedAt < TX_SET_TXS_TIMEOUT)
+    {
+        return missing;
+    }
+    partial.mPeer = peer;
+    partial.mAskedAt = now;
+    missing.assign(partial.mMissing.begin(), partial.mMissing.end());
+    return missing;
+}
+
+bool
+PendingEnvelopes::recvTxSetTransactions(TxSetTransactions const& txs,
+                                        Peer::pointer peer)
+{
+    auto it = mPartialTxSets.find(txs.txSetHash);
+    if (it == mPartialTxSets.end())
+    {
+        return false;
+    }
+
+    auto& partial = it->second;
+    bool useful = false;
+    for (auto const& env : txs.txs)
+    {
+        auto tx = TransactionFrame::makeTransactionFromWire(
+            mApp.getNetworkID(), env);
+        auto const& h = tx->getFullHash();
+        if (partial.mMissing.erase(h) != 0)
+        {
+            partial.mTxs.emplace(h, tx);
+            useful = true;
+        }
+    }
+
+    if (partial.mMissing.empty())
+    {
+        completeTxSet(it);
+    }
+    else if (partial.mPeer == peer)
+    {
+        // it listed transactions it does not send
+        partial.mPeer.reset();
+    }
+    return useful;
+}
+
+void
+PendingEnvelopes::completeTxSet(std::map<Hash, PartialTxSet>::iterator it)
+{
+    auto hash = it->first;
+    auto const& partial = it->second;
+    auto txSet = std::make_shared<TxSetFrame>(partial.mPreviousLedgerHash);
+    for (auto const& h : partial.mTxHashes)
+    {
+        txSet->add(partial.mTxs.find(h)->second);
+    }
+    auto peer = partial.mPeer;
+    mPartialTxSets.erase(it);
+
+    // the peer lied about the contents: as transactions are listed by their
+    // full hash, an honest peer cannot get them wrong
+    if (txSet->getContentsHash() != hash)
+    {
+        CLOG(INFO, "Herder") << "Compact TxSet " << hexAbbrev(hash)
+                             << " does not match its hash";
+        if (peer)
+        {
+            peer->drop(ERR_DATA, "sent a tx set that does not match its hash");
+            // ask another peer right away
+            mTxSetFetcher.doesntHave(hash, peer);
+        }
+        return;
+    }
+    recvTxSet(hash, txSet);
+}
+
 bool
 PendingEnvelopes::isNodeInQuorum(NodeID const& node)
 {
@@ -406,6 +555,17 @@ PendingEnvelopes::eraseBelow(uint64 slotIndex)
     mTxSetCache.erase_if([&](TxSetFramCacheItem const& i) {
         return i.first != 0 && i.first < slotIndex;
     });
+    for (auto it = mPartialTxSets.begin(); it != mPartialTxSets.end();)
+    {
+        if (it->second.mLastSeenSlotIndex < slotIndex)
+        {
+            it = mPartialTxSets.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
 }
 
 void
@@ -427,6 +587,17 @@ PendingEnvelopes::slotClosed(uint64 slotIndex)
 
         mTxSetCache.erase_if(
             [&](TxSetFramCacheItem const& i) { return i.first == slotIndex; });
+        for (auto it = mPartialTxSets.begin(); it != mPartialTxSets.end();)
+        {
+            if (it->second.mLastSeenSlotIndex == slotIndex)
+            {
+                it = mPartialTxSets.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
     }
 }
 
@@ -4,11 +4,14 @@
 #include "lib/json/json.h"
 #include "lib/util/lrucache.hpp"
 #include "overlay/ItemFetcher.h"
+#include "util/HashOfHash.h"
 #include <autocheck/function.hpp>
 #include <map>
 #include <medida/medida.h>
 #include <queue>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <util/optional.h>
 
 /*
@@ -51,14 +54,37 @@ class PendingEnvelopes
     // all the txsets we have learned about per ledger#
     cache::lru_cache<Hash, TxSetFramCacheItem> mTxSetCache;
 
+    // tx sets received as a list of transaction hashes, waiting for the
+    // transactions we did not have yet
+    struct PartialTxSet
+    {
+        uint64 mLastSeenSlotIndex;
+        Hash mPreviousLedgerHash;
+        std::vector<Hash> mTxHashes;
+        std::unordered_map<Hash, TransactionFramePtr> mTxs;
+        std::unordered_set<Hash> mMissing;
+        // the peer whose listing is used, asked for the missing transactions
+        // at mAskedAt; reset once it failed to send them all, so that the
+        // next peer listing the same transactions is asked instead
+        Peer::pointer mPeer;
+        VirtualClock::time_point mAskedAt;
+    };
+    std::map<Hash, PartialTxSet> mPartialTxSets;
+
     // NodeIDs that are in quorum
     cache::lru_cache<NodeID, bool> mNodesInQuorum;
 
     medida::Counter& mReadyEnvelopesSize;
+    medida::Meter& mCompactTxSetKnownMeter;
+    medida::Meter& mCompactTxSetMissingMeter;
 
     // returns true if we think that the node is in quorum
     bool isNodeInQuorum(NodeID const& node);
 
+    // builds the tx set once all the transactions of a partial one are known;
+    // the peer that listed them is dropped if the set does not match its hash
+    void completeTxSet(std::map<Hash, PartialTxSet>::iterator it);
+
     // discards all SCP envelopes thats use QSet with given hash,
     // as it is not sane QSet
     void discardSCPEnvelopesWithQSet(Hash hash);
@@ -107,6 +133,27 @@ class PendingEnvelopes
      * Return true if TxSet useful (was asked for).
      */
     bool recvTxSet(Hash hash, TxSetFramePtr txset);
+
+    /**
+     * Start rebuilding a requested tx set from @p compact, sent by @p peer,
+     * using the transactions of the herder's queue. Calls @see recvTxSet once
+     * all of them are known.
+     *
+     * Return the hashes of the transactions to ask the peer for. They are
+     * only asked from one peer at a time, so this is empty while another
+     * peer that listed the same transactions has yet to send them.
+     */
+    std::vector<Hash> recvCompactTxSet(CompactTransactionSet const& compact,
+                                       Peer::pointer peer);
+
+    /**
+     * Add the transactions of @p txs, sent by @p peer, to the tx set being
+     * rebuilt, calling @see recvTxSet once it is complete.
+     *
+     * Return true if the transactions were useful.
+     */
+    bool recvTxSetTransactions(TxSetTransactions const& txs,
+                               Peer::pointer peer);
     void discardSCPEnvelope(SCPEnvelope const& envelope);
 
     void peerDoesntHave(MessageType type, Hash const& itemID,
@@ -7,6 +7,7 @@
 #include "herder/PendingEnvelopes.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
+#include "overlay/LoopbackPeer.h"
 #include "test/TestAccount.h"
 #include "test/TestUtils.h"
 #include "test/TxTests.h"
@@ -221,6 +222,111 @@ TEST_CASE("PendingEnvelopes::recvSCPEnvelope", "[herder]")
         }
     }
 
+    SECTION("tx set rebuilt from a compact tx set")
+    {
+        auto txSetHash = p.second->getContentsHash();
+        REQUIRE(pendingEnvelopes.recvSCPEnvelope(saneEnvelope) ==
+                Herder::ENVELOPE_STATUS_FETCHING);
+        REQUIRE(pendingEnvelopes.recvSCPQuorumSet(saneQSetHash, saneQSet));
+
+        // the herder knows about all the transactions but the last 10
+        auto txs = p.second->mTransactions;
+        std::sort(txs.begin(), txs.end(),
+                  [](TransactionFramePtr const& a,
+                     TransactionFramePtr const& b) {
+                      return a->getSeqNum() < b->getSeqNum();
+                  });
+        for (size_t i = 0; i < 40; i++)
+        {
+            REQUIRE(app->getHerder().recvTransaction(txs[i]) ==
+                    Herder::TX_STATUS_PENDING);
+        }
+
+        CompactTransactionSet compact;
+        compact.txSetHash = txSetHash;
+        compact.previousLedgerHash = lcl.hash;
+        for (auto const& tx : p.second->mTransactions)
+        {
+            compact.txHashes.emplace_back(tx->getFullHash());
+        }
+
+        SECTION("with the missing transactions")
+        {
+            auto missing = pendingEnvelopes.recvCompactTxSet(compact, nullptr);
+            REQUIRE(missing.size() == 10);
+            REQUIRE(pendingEnvelopes.recvSCPEnvelope(saneEnvelope) ==
+                    Herder::ENVELOPE_STATUS_FETCHING);
+
+            TxSetTransactions missingTxs;
+            missingTxs.txSetHash = txSetHash;
+            for (size_t i = 40; i < txs.size(); i++)
+            {
+                missingTxs.txs.emplace_back(txs[i]->getEnvelope());
+            }
+            REQUIRE(
+                pendingEnvelopes.recvTxSetTransactions(missingTxs, nullptr));
+            REQUIRE(
+                !pendingEnvelopes.recvTxSetTransactions(missingTxs, nullptr));
+            REQUIRE(pendingEnvelopes.recvSCPEnvelope(saneEnvelope) ==
+                    Herder::ENVELOPE_STATUS_READY);
+            REQUIRE(pendingEnvelopes.getTxSet(txSetHash) != nullptr);
+        }
+
+        SECTION("missing transactions asked from one peer at a time")
+        {
+            auto other1 = createTestApplication(clock, getTestConfig(1));
+            auto other2 = createTestApplication(clock, getTestConfig(2));
+            LoopbackPeerConnection connection1(*app, *other1);
+            LoopbackPeerConnection connection2(*app, *other2);
+            auto peer1 = connection1.getInitiator();
+            auto peer2 = connection2.getInitiator();
+
+            REQUIRE(pendingEnvelopes.recvCompactTxSet(compact, peer1).size() ==
+                    10);
+            // peer2 lists the same transactions while peer1 sends them
+            REQUIRE(pendingEnvelopes.recvCompactTxSet(compact, peer2).empty());
+
+            SECTION("until it does not have them")
+            {
+                pendingEnvelopes.peerDoesntHave(TX_SET, txSetHash, peer1);
+            }
+            SECTION("until it sends only some of them")
+            {
+                TxSetTransactions someTxs;
+                someTxs.txSetHash = txSetHash;
+                someTxs.txs.emplace_back(txs[40]->getEnvelope());
+                REQUIRE(
+                    pendingEnvelopes.recvTxSetTransactions(someTxs, peer1));
+                txs.erase(txs.begin() + 40);
+            }
+            SECTION("until it takes too long")
+            {
+                clock.setCurrentTime(clock.now() + std::chrono::seconds(2));
+            }
+
+            auto missing = pendingEnvelopes.recvCompactTxSet(compact, peer2);
+            REQUIRE(missing.size() == txs.size() - 40);
+            TxSetTransactions missingTxs;
+            missingTxs.txSetHash = txSetHash;
+            for (size_t i = 40; i < txs.size(); i++)
+            {
+                missingTxs.txs.emplace_back(txs[i]->getEnvelope());
+            }
+            REQUIRE(pendingEnvelopes.recvTxSetTransactions(missingTxs, peer2));
+            REQUIRE(pendingEnvelopes.getTxSet(txSetHash) != nullptr);
+        }
+
+        SECTION("not matching its hash")
+        {
+            compact.txHashes.resize(40);
+            REQUIRE(
+                pendingEnvelopes.recvCompactTxSet(compact, nullptr).empty());
+            REQUIRE(!pendingEnvelopes.getTxSet(txSetHash));
+            REQUIRE(pendingEnvelopes.recvSCPEnvelope(saneEnvelope) ==
+                    Herder::ENVELOPE_STATUS_FETCHING);
+        }
+    }
+
     SECTION("envelopes from different slots asking for the same quorum set and "
             "tx set")
     {
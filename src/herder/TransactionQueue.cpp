@@ -0,0 +1,275 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "herder/TransactionQueue.h"
+#include "util/XDROperators.h"
+#include "util/numeric.h"
+#include "xdrpp/marshal.h"
+#include <algorithm>
+
+namespace stellar
+{
+
+TransactionQueue::TransactionQueue(uint32 depth, size_t maxSize,
+                                   size_t maxBytes)
+    : mDepth(depth), mMaxSize(maxSize), mMaxBytes(maxBytes)
+{
+}
+
+bool
+TransactionQueue::FeeRate::operator<(FeeRate const& other) const
+{
+    // mFee / mOps < other.mFee / other.mOps, without rounding; the totals of
+    // a large queue can overflow 64 bits once cross-multiplied
+    return bigMultiply(mFee, other.mOps) < bigMultiply(other.mFee, mOps);
+}
+
+uint64_t
+TransactionQueue::countOps(TransactionFramePtr const& tx)
+{
+    return std::max<size_t>(1, tx->getOperations().size());
+}
+
+TransactionQueue::FeeRate
+TransactionQueue::feeRate(AccountTxs const& acc)
+{
+    return FeeRate{static_cast<uint64_t>(acc.mTotalFees), acc.mTotalOps};
+}
+
+bool
+TransactionQueue::contains(Hash const& fullHash) const
+{
+    return mTxs.find(fullHash) != mTxs.end();
+}
+
+TransactionFramePtr
+TransactionQueue::getTx(Hash const& fullHash) const
+{
+    auto it = mTxs.find(fullHash);
+    return it == mTxs.end() ? TransactionFramePtr() : it->second.mTx;
+}
+
+TransactionQueue::AccountState
+TransactionQueue::getAccountState(AccountID const& acc) const
+{
+    AccountState res;
+    auto it = mAccounts.find(acc);
+    if (it != mAccounts.end())
+    {
+        res.mMaxSeq = it->second.mTxs.rbegin()->first;
+        res.mTotalFees = it->second.mTotalFees;
+    }
+    return res;
+}
+
+bool
+TransactionQueue::tryAdd(TransactionFramePtr tx)
+{
+    auto const& hash = tx->getFullHash();
+    if (contains(hash))
+    {
+        return false;
+    }
+
+    auto const& source = tx->getSourceID();
+    size_t bytes = xdr::xdr_size(tx->getEnvelope());
+
+    // what the queue and tx's account would look like with tx added,
+    // including when tx replaces a transaction with the same sequence number
+    size_t count = mTxs.size() + 1;
+    size_t totalBytes = mBytes + bytes;
+    FeeRate rate{static_cast<uint64_t>(tx->getFee()), countOps(tx)};
+    TransactionFramePtr replaced;
+    auto acc = mAccounts.find(source);
+    if (acc != mAccounts.end())
+    {
+        rate.mFee += acc->second.mTotalFees;
+        rate.mOps += acc->second.mTotalOps;
+        auto old = acc->second.mTxs.find(tx->getSeqNum());
+        if (old != acc->second.mTxs.end())
+        {
+            replaced = old->second;
+            rate.mFee -= replaced->getFee();
+            rate.mOps -= countOps(replaced);
+            count--;
+            totalBytes -= mTxs.find(replaced->getFullHash())->second.mBytes;
+        }
+    }
+
+    auto overBudget = [&]() {
+        return (mMaxSize != 0 && count > mMaxSize) ||
+               (mMaxBytes != 0 && totalBytes > mMaxBytes);
+    };
+
+    // pick what to evict before touching anything, as it may turn out that tx
+    // cannot get in
+    std::vector<AccountID> evicted;
+    for (auto it = mByFee.begin(); it != mByFee.end() && overBudget(); ++it)
+    {
+        if (it->second == source)
+        {
+            continue;
+        }
+        if (!(it->first < rate))
+        {
+            return false;
+        }
+        auto const& victim = mAccounts.find(it->second)->second;
+        count -= victim.mTxs.size();
+        totalBytes -= victim.mBytes;
+        evicted.emplace_back(it->second);
+    }
+    if (overBudget())
+    {
+        return false;
+    }
+
+    for (auto const& id : evicted)
+    {
+        removeAccount(id);
+    }
+    if (replaced)
+    {
+        removeTx(replaced->getFullHash());
+    }
+
+    auto& account = mAccounts[source];
+    if (!account.mTxs.empty())
+    {
+        mByFee.erase(std::make_pair(feeRate(account), source));
+    }
+    account.mTxs[tx->getSeqNum()] = tx;
+    account.mTotalFees += tx->getFee();
+    account.mTotalOps += countOps(tx);
+    account.mBytes += bytes;
+    mByFee.emplace(feeRate(account), source);
+
+    mTxs.emplace(hash, QueuedTx{tx, mGeneration, bytes});
+    mBytes += bytes;
+    mArrivals.emplace_back(mGeneration, hash);
+    mGenerationSizes[mGeneration]++;
+    return true;
+}
+
+void
+TransactionQueue::removeTx(Hash const& fullHash)
+{
+    auto it = mTxs.find(fullHash);
+    if (it == mTxs.end())
+    {
+        return;
+    }
+
+    auto const& tx = it->second.mTx;
+    auto acc = mAccounts.find(tx->getSourceID());
+    auto& account = acc->second;
+    mByFee.erase(std::make_pair(feeRate(account), acc->first));
+    account.mTxs.erase(tx->getSeqNum());
+    account.mTotalFees -= tx->getFee();
+    account.mTotalOps -= countOps(tx);
+    account.mBytes -= it->second.mBytes;
+    if (account.mTxs.empty())
+    {
+        mAccounts.erase(acc);
+    }
+    else
+    {
+        mByFee.emplace(feeRate(account), acc->first);
+    }
+
+    auto gen = mGenerationSizes.find(it->second.mGeneration);
+    if (--gen->second == 0)
+    {
+        mGenerationSizes.erase(gen);
+    }
+
+    mBytes -= it->second.mBytes;
+    mTxs.erase(it);
+}
+
+void
+TransactionQueue::removeAccount(AccountID const& acc)
+{
+    auto it = mAccounts.find(acc);
+    if (it == mAccounts.end())
+    {
+        return;
+    }
+
+    std::vector<Hash> hashes;
+    for (auto const& tx : it->second.mTxs)
+    {
+        hashes.emplace_back(tx.second->getFullHash());
+    }
+    for (auto const& h : hashes)
+    {
+        removeTx(h);
+    }
+}
+
+void
+TransactionQueue::remove(std::vector<TransactionFramePtr> const& txs)
+{
+    for (auto const& tx : txs)
+    {
+        removeTx(tx->getFullHash());
+    }
+}
+
+void
+TransactionQueue::shift()
+{
+    mGeneration++;
+    while (!mArrivals.empty() &&
+           mGeneration - mArrivals.front().first >= mDepth)
+    {
+        auto arrival = mArrivals.front();
+        mArrivals.pop_front();
+
+        auto it = mTxs.find(arrival.second);
+        if (it != mTxs.end() && it->second.mGeneration == arrival.first)
+        {
+            removeTx(arrival.second);
+        }
+    }
+}
+
+std::vector<TransactionFramePtr>
+TransactionQueue::getTransactions() const
+{
+    std::vector<TransactionFramePtr> res;
+    res.reserve(mTxs.size());
+    for (auto const& acc : mAccounts)
+    {
+        for (auto const& tx : acc.second.mTxs)
+        {
+            res.push_back(tx.second);
+        }
+    }
+    return res;
+}
+
+size_t
+TransactionQueue::size() const
+{
+    return mTxs.size();
+}
+
+size_t
+TransactionQueue::sizeBytes() const
+{
+    return mBytes;
+}
+
+size_t
+TransactionQueue::countTxs(uint32 age) const
+{
+    if (age > mGeneration)
+    {
+        return 0;
+    }
+    auto it = mGenerationSizes.find(mGeneration - age);
+    return it == mGenerationSizes.end() ? 0 : it->second;
+}
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/SecretKey.h"
+#include "transactions/TransactionFrame.h"
+#include "util/HashOfHash.h"
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * TransactionQueue holds the transactions the herder received and has not
+ * seen applied yet.
+ *
+ * Transactions are indexed by full hash, to find duplicates; by source
+ * account, in sequence number order, with the highest sequence number and
+ * the total fees of each account kept up to date, as both are needed to
+ * validate every new transaction; and accounts are indexed by the average fee
+ * per operation of their queued transactions, for eviction.
+ *
+ * Each transaction is stamped with the generation it was received in. shift()
+ * starts a new generation -- once per ledger close -- and drops the
+ * transactions that have been waiting for `depth` generations.
+ *
+ * The queue holds at most `maxSize` transactions, taking at most `maxBytes`
+ * once serialized (0 means no limit). Adding one to a full queue evicts all
+ * the transactions of the accounts with the lowest fee per operation: as
+ * later transactions of an account depend on the earlier ones, accounts are
+ * weighted the way TxSetFrame::surgePricingFilter weighs them.
+ */
+class TransactionQueue
+{
+  public:
+    struct AccountState
+    {
+        SequenceNumber mMaxSeq{0};
+        int64_t mTotalFees{0};
+    };
+
+    TransactionQueue(uint32 depth, size_t maxSize, size_t maxBytes);
+
+    bool contains(Hash const& fullHash) const;
+    // the queued transaction with that full hash, if any
+    TransactionFramePtr getTx(Hash const& fullHash) const;
+
+    // highest sequence number and total fees of the transactions queued for
+    // acc
+    AccountState getAccountState(AccountID const& acc) const;
+
+    // adds tx, whose sequence number must follow the ones queued for its
+    // account; if the queue is full, evicts the accounts whose transactions
+    // pay a lower fee per operation than the ones of tx's account would with
+    // tx added. Returns false, leaving the queue unchanged, if tx is already
+    // queued or if there are not enough such transactions to make room.
+    bool tryAdd(TransactionFramePtr tx);
+
+    void remove(std::vector<TransactionFramePtr> const& txs);
+
+    // starts a new generation, dropping the transactions received `depth`
+    // generations ago
+    void shift();
+
+    std::vector<TransactionFramePtr> getTransactions() const;
+
+    size_t size() const;
+    // serialized size of the queued transactions
+    size_t sizeBytes() const;
+    // number of transactions received `age` generations ago
+    size_t countTxs(uint32 age) const;
+
+  private:
+    // fee per operation, compared without rounding
+    struct FeeRate
+    {
+        uint64_t mFee;
+        uint64_t mOps;
+
+        bool operator<(FeeRate const& other) const;
+    };
+
+    struct QueuedTx
+    {
+        TransactionFramePtr mTx;
+        uint32 mGeneration;
+        size_t mBytes;
+    };
+
+    struct AccountTxs
+    {
+        std::map<SequenceNumber, TransactionFramePtr> mTxs;
+        int64_t mTotalFees{0};
+        uint64_t mTotalOps{0};
+        size_t mBytes{0};
+    };
+
+    static uint64_t countOps(TransactionFramePtr const& tx);
+    static FeeRate feeRate(AccountTxs const& acc);
+
+    void removeTx(Hash const& fullHash);
+    void removeAccount(AccountID const& acc);
+
+    uint32 const mDepth;
+    size_t const mMaxSize;
+    size_t const mMaxBytes;
+    uint32 mGeneration{0};
+    size_t mBytes{0};
+
+    std::unordered_map<Hash, QueuedTx> mTxs;
+    std::unordered_map<AccountID, AccountTxs> mAccounts;
+    // accounts by fee per operation of their queued transactions
+    std::set<std::pair<FeeRate, AccountID>> mByFee;
+    // (generation, hash) in arrival order; entries of transactions removed
+    // since are skipped by shift()
+    std::deque<std::pair<uint32, Hash>> mArrivals;
+    // generation -> number of transactions received in it
+    std::map<uint32, size_t> mGenerationSizes;
+};
+}
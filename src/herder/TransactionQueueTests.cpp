@@ -0,0 +1,142 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "herder/TransactionQueue.h"
+#include "lib/catch.hpp"
+#include "main/Application.h"
+#include "test/TestUtils.h"
+#include "test/TxTests.h"
+#include "test/test.h"
+#include "util/Timer.h"
+#include "xdrpp/marshal.h"
+
+using namespace stellar;
+using namespace stellar::txtest;
+
+static TransactionFramePtr
+makeTx(Application& app, SecretKey const& from, SequenceNumber seq,
+       uint32_t fee)
+{
+    auto tx = transactionFromOperations(app, from, seq,
+                                        {payment(from.getPublicKey(), 1)});
+    tx->getEnvelope().tx.fee = fee;
+    tx->clearCached();
+    return tx;
+}
+
+TEST_CASE("transaction queue", "[herder][txqueue]")
+{
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, getTestConfig());
+
+    auto a = getAccount("a");
+    auto b = getAccount("b");
+    auto c = getAccount("c");
+
+    SECTION("indexes")
+    {
+        TransactionQueue queue(4, 0, 0);
+        auto a1 = makeTx(*app, a, 1, 100);
+        auto a2 = makeTx(*app, a, 2, 200);
+        auto b1 = makeTx(*app, b, 1, 100);
+        REQUIRE(queue.tryAdd(a1));
+        REQUIRE(queue.tryAdd(a2));
+        REQUIRE(queue.tryAdd(b1));
+        REQUIRE(!queue.tryAdd(a1));
+        REQUIRE(queue.size() == 3);
+        REQUIRE(queue.contains(a2->getFullHash()));
+
+        auto state = queue.getAccountState(a.getPublicKey());
+        REQUIRE(state.mMaxSeq == 2);
+        REQUIRE(state.mTotalFees == 300);
+
+        auto txBytes = queue.sizeBytes() / 3;
+        REQUIRE(txBytes == xdr::xdr_size(a1->getEnvelope()));
+
+        queue.remove({a1, b1});
+        REQUIRE(queue.size() == 1);
+        REQUIRE(queue.sizeBytes() == txBytes);
+        REQUIRE(!queue.contains(a1->getFullHash()));
+        state = queue.getAccountState(a.getPublicKey());
+        REQUIRE(state.mMaxSeq == 2);
+        REQUIRE(state.mTotalFees == 200);
+        REQUIRE(queue.getAccountState(b.getPublicKey()).mMaxSeq == 0);
+        auto txs = queue.getTransactions();
+        REQUIRE(txs == std::vector<TransactionFramePtr>{a2});
+    }
+
+    SECTION("aging")
+    {
+        TransactionQueue queue(4, 0, 0);
+        REQUIRE(queue.tryAdd(makeTx(*app, a, 1, 100)));
+        for (uint32 age = 1; age < 4; age++)
+        {
+            queue.shift();
+            REQUIRE(queue.countTxs(0) == 0);
+            REQUIRE(queue.countTxs(age) == 1);
+        }
+        REQUIRE(queue.tryAdd(makeTx(*app, b, 1, 100)));
+        queue.shift();
+        REQUIRE(queue.size() == 1);
+        REQUIRE(queue.countTxs(1) == 1);
+        REQUIRE(queue.getAccountState(a.getPublicKey()).mMaxSeq == 0);
+    }
+
+    SECTION("eviction")
+    {
+        TransactionQueue queue(4, 3, 0);
+        auto a1 = makeTx(*app, a, 1, 100);
+        auto a2 = makeTx(*app, a, 2, 150);
+        auto b1 = makeTx(*app, b, 1, 200);
+        REQUIRE(queue.tryAdd(a1));
+        REQUIRE(queue.tryAdd(a2));
+        REQUIRE(queue.tryAdd(b1));
+
+        SECTION("cheaper transaction is rejected")
+        {
+            REQUIRE(!queue.tryAdd(makeTx(*app, c, 1, 50)));
+            REQUIRE(queue.size() == 3);
+        }
+        SECTION("account staying the cheapest is rejected")
+        {
+            REQUIRE(!queue.tryAdd(makeTx(*app, a, 3, 100)));
+            REQUIRE(queue.size() == 3);
+        }
+        SECTION("account paying more on average evicts the others")
+        {
+            auto a3 = makeTx(*app, a, 3, 1000);
+            REQUIRE(queue.tryAdd(a3));
+            REQUIRE(queue.size() == 3);
+            REQUIRE(!queue.contains(b1->getFullHash()));
+            REQUIRE(queue.getAccountState(a.getPublicKey()).mMaxSeq == 3);
+        }
+        SECTION("cheapest account is evicted as a whole")
+        {
+            auto c1 = makeTx(*app, c, 1, 300);
+            REQUIRE(queue.tryAdd(c1));
+            REQUIRE(queue.size() == 2);
+            REQUIRE(!queue.contains(a1->getFullHash()));
+            REQUIRE(!queue.contains(a2->getFullHash()));
+            REQUIRE(queue.contains(b1->getFullHash()));
+            REQUIRE(queue.contains(c1->getFullHash()));
+            REQUIRE(queue.getAccountState(a.getPublicKey()).mTotalFees == 0);
+        }
+    }
+
+    SECTION("bytes budget")
+    {
+        auto a1 = makeTx(*app, a, 1, 100);
+        auto b1 = makeTx(*app, b, 1, 200);
+        size_t txBytes = xdr::xdr_size(a1->getEnvelope());
+
+        TransactionQueue queue(4, 0, 2 * txBytes);
+        REQUIRE(queue.tryAdd(a1));
+        REQUIRE(queue.tryAdd(b1));
+        REQUIRE(!queue.tryAdd(makeTx(*app, c, 1, 50)));
+        REQUIRE(queue.tryAdd(makeTx(*app, c, 1, 300)));
+        REQUIRE(queue.size() == 2);
+        REQUIRE(queue.sizeBytes() == 2 * txBytes);
+        REQUIRE(!queue.contains(a1->getFullHash()));
+    }
+}
@@ -14,7 +14,12 @@
 #include "util/XDROperators.h"
 #include "xdrpp/marshal.h"
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include "xdrpp/printer.h"
 
 namespace stellar
@@ -275,12 +280,76 @@ TxSetFrame::trimInvalid(Application& app,
     checkOrTrim(app, processInvalidTxLambda, processInsufficientBalance);
 }
 
+// Signature checks of a set are spread over the worker threads in batches
+// of at least this many transactions.
+static const size_t MIN_PREFETCH_BATCH = 16;
+
+// Verifies the signatures of txs on the worker threads ahead of the checks
+// proper, which then find them in the signature cache. The calling thread
+// takes its share of the work, so busy workers cannot hold it up for longer
+// than the transactions they already picked.
+static void
+prefetchSignatures(Application& app, vector<TransactionFramePtr> const& txs)
+{
+    // The frames stay owned by the caller, which waits for all of them to
+    // be done: a worker that only starts afterwards must not be the one to
+    // destroy them.
+    struct PrefetchState
+    {
+        vector<TransactionFrame*> mTxs;
+        atomic<size_t> mNext{0};
+        size_t mDone{0};
+        mutex mMutex;
+        condition_variable mCond;
+    };
+
+    auto state = make_shared<PrefetchState>();
+    for (auto const& tx : txs)
+    {
+        // computed here, so that the workers only read the frames
+        tx->getContentsHash();
+        state->mTxs.push_back(tx.get());
+    }
+
+    auto work = [state]() {
+        size_t done = 0;
+        size_t i;
+        while ((i = state->mNext++) < state->mTxs.size())
+        {
+            state->mTxs[i]->prefetchSignatures();
+            done++;
+        }
+        if (done != 0)
+        {
+            lock_guard<mutex> lock(state->mMutex);
+            state->mDone += done;
+            state->mCond.notify_all();
+        }
+    };
+
+    size_t workers = min<size_t>(app.getConfig().WORKER_THREADS,
+                                 txs.size() / MIN_PREFETCH_BATCH);
+    for (size_t i = 0; i < workers; i++)
+    {
+        app.postOnBackgroundThread(work);
+    }
+    work();
+
+    unique_lock<mutex> lock(state->mMutex);
+    state->mCond.wait(lock,
+                      [&]() { return state->mDone == state->mTxs.size(); });
+}
+
 // need to make sure every account that is submitting a tx has enough to pay
 // the fees of all the tx it has submitted in this set
 // check seq num
 bool
 TxSetFrame::checkValid(Application& app)
 {
+    auto& checkValidTimer =
+        app.getMetrics().NewTimer({"herder", "txset", "check-valid"});
+    auto timer = checkValidTimer.TimeScope();
+
     // Establish read-only transaction for duration of checkValid
     soci::transaction sqltx(app.getDatabase().getSession());
     app.getDatabase().setCurrentTransactionReadOnly();
@@ -305,6 +374,8 @@ TxSetFrame::checkValid(Application& app)
         return false;
     }
 
+    prefetchSignatures(app, mTransactions);
+
     auto processInvalidTxLambda = [&](TransactionFramePtr tx,
                                       SequenceNumber const& lastSeq) {
         CLOG(DEBUG, "Herder")
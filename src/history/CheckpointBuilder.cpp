@@ -0,0 +1,267 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "history/CheckpointBuilder.h"
+#include "herder/TxSetFrame.h"
+#include "history/FileTransferInfo.h"
+#include "history/HistoryArchiveManager.h"
+#include "history/HistoryManager.h"
+#include "lib/util/format.h"
+#include "main/Application.h"
+#include "util/Fs.h"
+#include "util/Logging.h"
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
+#include <cstdio>
+
+namespace stellar
+{
+
+size_t const CheckpointBuilder::kMaxFinishedCheckpoints = 16;
+
+CheckpointBuilder::CheckpointBuilder(Application& app)
+    : mApp(app)
+    , mStreamed(app.getMetrics().NewMeter({"history", "checkpoint", "streamed"},
+                                          "checkpoint"))
+    , mAbandoned(app.getMetrics().NewMeter(
+          {"history", "checkpoint", "abandoned"}, "checkpoint"))
+{
+}
+
+CheckpointBuilder::~CheckpointBuilder()
+{
+    mLedgerOut.close();
+    mTxOut.close();
+    mResultOut.close();
+    mSCPOut.close();
+}
+
+bool
+CheckpointBuilder::isEnabled() const
+{
+    // Nothing will ever take the files without an archive to publish to.
+    return mApp.getHistoryArchiveManager().hasAnyWritableHistoryArchive();
+}
+
+std::string const&
+CheckpointBuilder::getDir()
+{
+    if (!mDir)
+    {
+        TmpDir t = mApp.getTmpDirManager().tmpDir("checkpoint");
+        mDir = std::make_unique<TmpDir>(std::move(t));
+    }
+    return mDir->getName();
+}
+
+void
+CheckpointBuilder::startCheckpoint(uint32_t firstLedger, uint32_t checkpoint)
+{
+    auto hexStr = fs::hexStr(checkpoint);
+    auto name = [&](char const* type) {
+        return getDir() + "/" + fs::baseName(type, hexStr, "xdr");
+    };
+
+    mFiles.mLedgerHeaders = name(HISTORY_FILE_TYPE_LEDGER);
+    mFiles.mTransactions = name(HISTORY_FILE_TYPE_TRANSACTIONS);
+    mFiles.mResults = name(HISTORY_FILE_TYPE_RESULTS);
+    mFiles.mSCPMessages = name(HISTORY_FILE_TYPE_SCP);
+
+    mLedgerOut.open(mFiles.mLedgerHeaders);
+    mTxOut.open(mFiles.mTransactions);
+    mResultOut.open(mFiles.mResults);
+    mSCPOut.open(mFiles.mSCPMessages);
+
+    mOpen = true;
+    mFirstLedger = firstLedger;
+    mCheckpoint = checkpoint;
+    mNextLedger = firstLedger;
+    mSCPEntries = 0;
+
+    CLOG(DEBUG, "History") << "Streaming history blocks of checkpoint "
+                           << checkpoint << " from ledger " << firstLedger;
+}
+
+void
+CheckpointBuilder::finishCheckpoint()
+{
+    mLedgerOut.close();
+    mTxOut.close();
+    mResultOut.close();
+    mSCPOut.close();
+    mOpen = false;
+
+    if (mSCPEntries == 0)
+    {
+        // don't upload empty files
+        std::remove(mFiles.mSCPMessages.c_str());
+        mFiles.mSCPMessages.clear();
+    }
+
+    mFinished[mCheckpoint] = mFiles;
+    while (mFinished.size() > kMaxFinishedCheckpoints)
+    {
+        auto oldest = mFinished.begin();
+        CLOG(DEBUG, "History") << "Dropping streamed history blocks of "
+                               << "checkpoint " << oldest->first
+                               << ", publish queue is too long";
+        removeFiles(oldest->second);
+        mFinished.erase(oldest);
+        mAbandoned.Mark();
+    }
+}
+
+void
+CheckpointBuilder::abandonCheckpoint(std::string const& reason)
+{
+    mLedgerOut.close();
+    mTxOut.close();
+    mResultOut.close();
+    mSCPOut.close();
+    mOpen = false;
+
+    removeFiles(mFiles);
+    mAbandoned.Mark();
+    CLOG(INFO, "History") << "Not streaming history blocks of checkpoint "
+                          << mCheckpoint << " (" << reason
+                          << "), it will be published from the database";
+}
+
+void
+CheckpointBuilder::removeFiles(Files const& files)
+{
+    for (auto const& f : {files.mLedgerHeaders, files.mTransactions,
+                          files.mResults, files.mSCPMessages})
+    {
+        if (!f.empty())
+        {
+            std::remove(f.c_str());
+        }
+    }
+}
+
+void
+CheckpointBuilder::appendSCPHistory(SCPHistoryEntry const& entry)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    auto& hm = mApp.getHistoryManager();
+    uint32_t seq = entry.v0().ledgerMessages.ledgerSeq;
+
+    // Messages for a ledger that was already written would be missing from
+    // (or out of order in) the streamed files, so those checkpoints go back to
+    // the database, which has them.
+    if (mOpen && seq >= mFirstLedger && seq < mNextLedger)
+    {
+        abandonCheckpoint(fmt::format(
+            "SCP messages for ledger {} arrived after it closed", seq));
+        return;
+    }
+    auto finished = mFinished.find(hm.checkpointContainingLedger(seq));
+    if (finished != mFinished.end())
+    {
+        CLOG(INFO, "History") << "Dropping streamed history blocks of "
+                              << "checkpoint " << finished->first
+                              << ", SCP messages for ledger " << seq
+                              << " arrived after it closed";
+        removeFiles(finished->second);
+        mFinished.erase(finished);
+        mAbandoned.Mark();
+        return;
+    }
+
+    mPendingSCP[seq] = entry;
+}
+
+void
+CheckpointBuilder::appendLedger(LedgerHeaderHistoryEntry const& lcl,
+                                TxSetFrame const& txSet,
+                                TransactionResultSet const& results)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    auto& hm = mApp.getHistoryManager();
+    uint32_t seq = lcl.header.ledgerSeq;
+
+    if (mOpen && seq != mNextLedger)
+    {
+        abandonCheckpoint(fmt::format("expected ledger {}, closed ledger {}",
+                                      mNextLedger, seq));
+    }
+    // A checkpoint can only be streamed if we close its very first ledger.
+    if (!mOpen && seq == hm.prevCheckpointLedger(seq))
+    {
+        startCheckpoint(seq, hm.checkpointContainingLedger(seq));
+    }
+
+    if (mOpen)
+    {
+        bool ok = mLedgerOut.writeOne(lcl);
+
+        // Same shape as TransactionFrame::copyTransactionsToStream: only
+        // ledgers with transactions get entries, and the set is written in
+        // hash order while results stay in apply order.
+        if (!txSet.mTransactions.empty())
+        {
+            TxSetFrame sorted(txSet);
+            sorted.sortForHash();
+            TransactionHistoryEntry txEntry;
+            txEntry.ledgerSeq = seq;
+            sorted.toXDR(txEntry.txSet);
+
+            TransactionHistoryResultEntry resultEntry;
+            resultEntry.ledgerSeq = seq;
+            resultEntry.txResultSet = results;
+
+            ok = ok && mTxOut.writeOne(txEntry) &&
+                 mResultOut.writeOne(resultEntry);
+        }
+
+        auto scp = mPendingSCP.find(seq);
+        if (ok && scp != mPendingSCP.end())
+        {
+            ok = mSCPOut.writeOne(scp->second);
+            ++mSCPEntries;
+        }
+
+        if (!ok)
+        {
+            abandonCheckpoint(
+                fmt::format("failed to write ledger {} to {}", seq, getDir()));
+        }
+        else
+        {
+            mNextLedger = seq + 1;
+            if (seq == mCheckpoint)
+            {
+                finishCheckpoint();
+            }
+        }
+    }
+
+    mPendingSCP.erase(mPendingSCP.begin(), mPendingSCP.upper_bound(seq));
+}
+
+bool
+CheckpointBuilder::takeCheckpoint(uint32_t checkpoint, Files& files)
+{
+    auto it = mFinished.find(checkpoint);
+    if (it == mFinished.end())
+    {
+        return false;
+    }
+    files = it->second;
+    mFinished.erase(it);
+    mStreamed.Mark();
+    return true;
+}
+}
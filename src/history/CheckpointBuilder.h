@@ -0,0 +1,106 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/StellarXDR.h"
+#include "util/TmpDir.h"
+#include "util/XDRStream.h"
+#include <map>
+#include <memory>
+#include <string>
+
+namespace medida
+{
+class Meter;
+}
+
+namespace stellar
+{
+
+class Application;
+class TxSetFrame;
+
+/**
+ * CheckpointBuilder writes the history blocks of the checkpoint in progress --
+ * ledger headers, transaction sets, transaction results and SCP messages -- to
+ * files as each ledger closes, so that publishing a checkpoint only has to
+ * compress and upload them rather than stream 64 ledgers back out of the
+ * database.
+ *
+ * Files are only handed out for checkpoints this process saw in full: every
+ * ledger from the first of the checkpoint to the last closed here, in order,
+ * and no SCP messages arrived for a ledger after it closed. Anything else (a
+ * restart, catchup, the genesis checkpoint, a forced early checkpoint) is left
+ * to the SQL path in StateSnapshot::writeHistoryBlocks, which remains the
+ * source of truth.
+ */
+class CheckpointBuilder
+{
+  public:
+    struct Files
+    {
+        std::string mLedgerHeaders;
+        std::string mTransactions;
+        std::string mResults;
+        // Empty if no SCP messages were recorded for the checkpoint.
+        std::string mSCPMessages;
+    };
+
+  private:
+    Application& mApp;
+    std::unique_ptr<TmpDir> mDir;
+
+    // The checkpoint currently being written, if any.
+    bool mOpen{false};
+    uint32_t mFirstLedger{0};
+    uint32_t mCheckpoint{0};
+    uint32_t mNextLedger{0};
+    Files mFiles;
+    XDROutputFileStream mLedgerOut;
+    XDROutputFileStream mTxOut;
+    XDROutputFileStream mResultOut;
+    XDROutputFileStream mSCPOut;
+    size_t mSCPEntries{0};
+
+    // SCP messages of ledgers that externalized but have not closed yet.
+    std::map<uint32_t, SCPHistoryEntry> mPendingSCP;
+
+    // Complete checkpoints waiting to be taken by a snapshot.
+    std::map<uint32_t, Files> mFinished;
+
+    medida::Meter& mStreamed;
+    medida::Meter& mAbandoned;
+
+    bool isEnabled() const;
+    std::string const& getDir();
+    void startCheckpoint(uint32_t firstLedger, uint32_t checkpoint);
+    void finishCheckpoint();
+    void abandonCheckpoint(std::string const& reason);
+    static void removeFiles(Files const& files);
+
+  public:
+    // At most this many complete checkpoints are kept waiting for a stalled
+    // publish queue; older ones are published through the SQL path instead.
+    static size_t const kMaxFinishedCheckpoints;
+
+    CheckpointBuilder(Application& app);
+    ~CheckpointBuilder();
+
+    // Record the SCP messages (and their quorum sets) that externalized a
+    // ledger. Must be called before that ledger is passed to appendLedger.
+    void appendSCPHistory(SCPHistoryEntry const& entry);
+
+    // Append a just-closed ledger, with the transaction set and results it
+    // was closed with, to the checkpoint in progress.
+    void appendLedger(LedgerHeaderHistoryEntry const& lcl,
+                      TxSetFrame const& txSet,
+                      TransactionResultSet const& results);
+
+    // If every history block of `checkpoint` was written as its ledgers
+    // closed, hand the files over to the caller (who becomes responsible for
+    // them) and return true.
+    bool takeCheckpoint(uint32_t checkpoint, Files& files);
+};
+}
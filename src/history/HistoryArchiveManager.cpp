@@ -4,6 +4,7 @@
 
 #include "history/HistoryArchiveManager.h"
 #include "history/HistoryArchive.h"
+#include "history/HistoryFileCache.h"
 #include "historywork/GetHistoryArchiveStateWork.h"
 #include "historywork/PutHistoryArchiveStateWork.h"
 #include "main/Application.h"
@@ -18,13 +19,18 @@
 namespace stellar
 {
 
-HistoryArchiveManager::HistoryArchiveManager(Application& app) : mApp{app}
+HistoryArchiveManager::HistoryArchiveManager(Application& app)
+    : mApp{app}, mFileCache{std::make_unique<HistoryFileCache>(app)}
 {
     for (auto const& archiveConfiguration : mApp.getConfig().HISTORY)
         mArchives.push_back(
             std::make_shared<HistoryArchive>(archiveConfiguration.second));
 }
 
+HistoryArchiveManager::~HistoryArchiveManager()
+{
+}
+
 bool
 HistoryArchiveManager::checkSensibleConfig() const
 {
@@ -246,4 +252,10 @@ HistoryArchiveManager::getJsonInfo() const
 
     return info;
 }
+
+HistoryFileCache&
+HistoryArchiveManager::getFileCache()
+{
+    return *mFileCache;
+}
 }
@@ -17,11 +17,13 @@ namespace stellar
 class Application;
 class Config;
 class HistoryArchive;
+class HistoryFileCache;
 
 class HistoryArchiveManager
 {
   public:
     explicit HistoryArchiveManager(Application& app);
+    ~HistoryArchiveManager();
 
     // Check that config settings are at least somewhat reasonable.
     bool checkSensibleConfig() const;
@@ -49,8 +51,13 @@ class HistoryArchiveManager
 
     Json::Value getJsonInfo() const;
 
+    // Local cache of downloaded archive files (HISTORY_CACHE_DIR_PATH); does
+    // nothing if that is not set.
+    HistoryFileCache& getFileCache();
+
   private:
     Application& mApp;
     std::vector<std::shared_ptr<HistoryArchive>> mArchives;
+    std::unique_ptr<HistoryFileCache> mFileCache;
 };
 }
@@ -0,0 +1,209 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "history/HistoryFileCache.h"
+#include "crypto/Hex.h"
+#include "crypto/SHA.h"
+#include "history/FileTransferInfo.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "util/Fs.h"
+#include "util/Logging.h"
+#include <lib/util/format.h>
+#include <medida/meter.h>
+#include <medida/metrics_registry.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+namespace stellar
+{
+
+namespace
+{
+char const* ENTRY_SUFFIX = ".xdr.gz";
+char const* TMP_INFIX = ".tmp-";
+}
+
+HistoryFileCache::HistoryFileCache(Application& app)
+    : mApp(app)
+    , mDir(app.getConfig().HISTORY_CACHE_DIR_PATH)
+    , mMaxBytes(app.getConfig().HISTORY_CACHE_SIZE_MB * 1024 * 1024)
+    , mCacheHit(app.getMetrics().NewMeter({"history", "file-cache", "hit"},
+                                          "file"))
+    , mCacheMiss(app.getMetrics().NewMeter({"history", "file-cache", "miss"},
+                                           "file"))
+    , mCacheEvict(app.getMetrics().NewMeter(
+          {"history", "file-cache", "evict"}, "file"))
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    if (!fs::exists(mDir) && !fs::mkpath(mDir))
+    {
+        throw std::runtime_error("Unable to create history cache directory " +
+                                 mDir);
+    }
+    trim();
+}
+
+std::string
+HistoryFileCache::entryPath(std::string const& remote) const
+{
+    auto key = mApp.getConfig().NETWORK_PASSPHRASE + "\n" + remote;
+    return mDir + "/" + binToHex(sha256(key)) + ENTRY_SUFFIX;
+}
+
+bool
+HistoryFileCache::fetch(std::string const& remote, std::string const& local)
+{
+    if (!isEnabled())
+    {
+        return false;
+    }
+
+    // The entry may be evicted by another process at any time; linking it
+    // either succeeds, and we hold the whole file, or fails like a miss.
+    auto entry = entryPath(remote);
+    std::remove(local.c_str());
+    if (!fs::linkOrCopy(entry, local))
+    {
+        mCacheMiss.Mark();
+        return false;
+    }
+
+    fs::touch(entry);
+    mCacheHit.Mark();
+    CLOG(DEBUG, "History") << "Found " << remote << " in history cache";
+    return true;
+}
+
+void
+HistoryFileCache::insert(std::string const& remote, std::string const& local)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    auto entry = entryPath(remote);
+    auto tmp = fmt::format("{}{}{}-{}", entry, TMP_INFIX, fs::getCurrentPid(),
+                           mTmpCounter++);
+    uint64_t size;
+    std::time_t mtime;
+    if (!fs::fileStat(local, size, mtime) || !fs::linkOrCopy(local, tmp))
+    {
+        CLOG(WARNING, "History") << "Unable to add " << remote
+                                 << " to history cache";
+        return;
+    }
+
+    // Whoever renames last wins; both files hold the same content.
+    if (std::rename(tmp.c_str(), entry.c_str()) != 0)
+    {
+        CLOG(WARNING, "History") << "Unable to add " << remote
+                                 << " to history cache";
+        std::remove(tmp.c_str());
+        return;
+    }
+
+    mBytes += size;
+    if (mBytes > mMaxBytes)
+    {
+        trim();
+    }
+}
+
+void
+HistoryFileCache::remove(std::string const& remote)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    auto entry = entryPath(remote);
+    if (std::remove(entry.c_str()) == 0)
+    {
+        CLOG(INFO, "History") << "Removed " << remote << " from history cache";
+        mCacheEvict.Mark();
+    }
+}
+
+void
+HistoryFileCache::removeCheckpoint(uint32_t checkpoint)
+{
+    for (auto type : {HISTORY_FILE_TYPE_LEDGER, HISTORY_FILE_TYPE_TRANSACTIONS})
+    {
+        remove(fs::remoteName(type, fs::hexStr(checkpoint), "xdr.gz"));
+    }
+}
+
+void
+HistoryFileCache::trim()
+{
+    // (mtime, size, name) of every entry
+    std::vector<std::tuple<std::time_t, uint64_t, std::string>> entries;
+    mBytes = 0;
+
+    auto names = fs::findfiles(mDir, [](std::string const& name) {
+        return name != "." && name != "..";
+    });
+    for (auto const& name : names)
+    {
+        auto path = mDir + "/" + name;
+        uint64_t size;
+        std::time_t mtime;
+        if (!fs::fileStat(path, size, mtime))
+        {
+            continue;
+        }
+
+        auto tmp = name.find(TMP_INFIX);
+        if (tmp != std::string::npos)
+        {
+            // Leftover of a process that died while inserting.
+            auto pid = std::strtol(name.c_str() + tmp + strlen(TMP_INFIX),
+                                   nullptr, 10);
+            if (pid != 0 && !fs::processExists(pid))
+            {
+                std::remove(path.c_str());
+            }
+            continue;
+        }
+
+        mBytes += size;
+        entries.emplace_back(mtime, size, path);
+    }
+
+    if (mBytes <= mMaxBytes)
+    {
+        return;
+    }
+
+    // Trim a little further than needed, so that the next few inserts do not
+    // each have to rescan the directory.
+    auto target = mMaxBytes - mMaxBytes / 10;
+    std::sort(entries.begin(), entries.end());
+    for (auto const& e : entries)
+    {
+        if (mBytes <= target)
+        {
+            break;
+        }
+        if (std::remove(std::get<2>(e).c_str()) == 0)
+        {
+            mCacheEvict.Mark();
+        }
+        mBytes -= std::get<1>(e);
+    }
+    CLOG(DEBUG, "History") << "Trimmed history cache to " << mBytes
+                           << " bytes";
+}
+}
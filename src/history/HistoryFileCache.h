@@ -0,0 +1,81 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include <cstdint>
+#include <string>
+
+namespace medida
+{
+class Meter;
+}
+
+namespace stellar
+{
+
+class Application;
+
+/**
+ * HistoryFileCache keeps the gzipped files downloaded from history archives in
+ * HISTORY_CACHE_DIR_PATH, so that later catchups -- of this process or of any
+ * other on the same host -- can take them from there instead of running the
+ * archive's get command again.
+ *
+ * Files are named after the hash of the network passphrase and of their path
+ * in the archive; every archive of a network publishes the same content at
+ * the same path, and buckets carry their own hash in their path anyway.
+ * Nothing in the cache is trusted: whatever is taken from it is verified like
+ * a fresh download, and callers remove entries that fail.
+ *
+ * The cache is safe to share between processes without locking: entries are
+ * written to a temporary file and renamed into place, and are hard-linked (or
+ * copied) out of the cache, so they never change while being read. Reading an
+ * entry touches its modification time, and once the cache grows past
+ * HISTORY_CACHE_SIZE_MB the least recently used entries are removed.
+ */
+class HistoryFileCache
+{
+    Application& mApp;
+    std::string const mDir;
+    uint64_t const mMaxBytes;
+    // Estimate of the size of the cache, rescanned when it goes over
+    // mMaxBytes: other processes may have added or removed files too.
+    uint64_t mBytes{0};
+    uint64_t mTmpCounter{0};
+
+    medida::Meter& mCacheHit;
+    medida::Meter& mCacheMiss;
+    medida::Meter& mCacheEvict;
+
+    std::string entryPath(std::string const& remote) const;
+    void trim();
+
+  public:
+    explicit HistoryFileCache(Application& app);
+
+    bool
+    isEnabled() const
+    {
+        return !mDir.empty();
+    }
+
+    // Put the cached copy of archive file `remote` at `local`; false if there
+    // is none.
+    bool fetch(std::string const& remote, std::string const& local);
+
+    // Add `local`, just downloaded from archive path `remote`, to the cache.
+    void insert(std::string const& remote, std::string const& local);
+
+    // Drop the cached copy of `remote`, if any, e.g. when it turned out to
+    // be corrupt.
+    void remove(std::string const& remote);
+
+    // Drop the cached ledger and transactions files of `checkpoint`, when
+    // verifying or replaying it failed. The failure may come from a copy
+    // corrupted on disk; served from the cache again, it would fail every
+    // later catchup the same way, while a fresh download can succeed.
+    void removeCheckpoint(uint32_t checkpoint);
+};
+}
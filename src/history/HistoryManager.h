@@ -176,6 +176,7 @@ namespace stellar
 class Application;
 class Bucket;
 class BucketList;
+class CheckpointBuilder;
 class Config;
 class Database;
 class HistoryArchive;
@@ -270,15 +271,13 @@ class HistoryManager
     // queue.
     virtual std::vector<std::string> getBucketsReferencedByPublishQueue() = 0;
 
-    // Callback from Publication, indicates that a given snapshot was
-    // published. The `success` parameter indicates whether _all_ the
-    // configured archives published correctly; if so the snapshot
-    // can be dequeued, otherwise it should remain and be tried again
-    // later.
-    virtual void
-    historyPublished(uint32_t ledgerSeq,
-                     std::vector<std::string> const& originalBuckets,
-                     bool success) = 0;
+    // Callback from Publication, indicates that the snapshot of a given
+    // checkpoint was (or, if `success` is false, failed to be) published to
+    // the archive named `archiveName`. Once every writable archive has the
+    // checkpoint it is dequeued; until then it remains queued and is tried
+    // again later on the archives still missing it.
+    virtual void historyPublished(std::string const& archiveName,
+                                  uint32_t ledgerSeq, bool success) = 0;
 
     virtual void downloadMissingBuckets(
         HistoryArchiveState desiredState,
@@ -290,6 +289,10 @@ class HistoryManager
     // Infer a quorum set by reading SCP messages in history archives.
     virtual InferredQuorum inferQuorum() = 0;
 
+    // Return the writer that streams the history blocks of the checkpoint in
+    // progress to disk as ledgers close, for publishing to pick up.
+    virtual CheckpointBuilder& getCheckpointBuilder() = 0;
+
     // Return the name of the HistoryManager's tmpdir (used for storing files in
     // transit).
     virtual std::string const& getTmpDir() = 0;
@@ -304,14 +307,16 @@ class HistoryManager
     virtual uint64_t getPublishQueueCount() = 0;
 
     // Return the number of enqueued checkpoints that have been delayed due to
-    // the publish system being busy with a previous checkpoint. This indicates
+    // every archive being busy with a previous checkpoint. This indicates
     // a degree of overloading in the publish system.
     virtual uint64_t getPublishDelayCount() = 0;
 
-    // Return the number of checkpoints that completed publication successfully.
+    // Return the number of checkpoints that completed publication successfully
+    // to every writable archive.
     virtual uint64_t getPublishSuccessCount() = 0;
 
-    // Return the number of checkpoints that failed publication.
+    // Return the number of attempts to publish a checkpoint to an archive that
+    // failed. Per-archive counts are in the history.publish-failure metrics.
     virtual uint64_t getPublishFailureCount() = 0;
 
     virtual ~HistoryManager(){};
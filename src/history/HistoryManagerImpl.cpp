@@ -12,6 +12,7 @@
 #include "crypto/Hex.h"
 #include "crypto/SHA.h"
 #include "herder/HerderImpl.h"
+#include "history/CheckpointBuilder.h"
 #include "history/HistoryArchive.h"
 #include "history/HistoryArchiveManager.h"
 #include "history/HistoryManagerImpl.h"
@@ -23,6 +24,7 @@
 #include "lib/util/format.h"
 #include "main/Application.h"
 #include "main/Config.h"
+#include "medida/counter.h"
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
 #include "overlay/StellarXDR.h"
@@ -34,6 +36,7 @@
 #include "work/WorkManager.h"
 #include "xdrpp/marshal.h"
 
+#include <algorithm>
 #include <fstream>
 #include <system_error>
 
@@ -64,7 +67,7 @@ HistoryManager::create(Application& app)
 HistoryManagerImpl::HistoryManagerImpl(Application& app)
     : mApp(app)
     , mWorkDir(nullptr)
-    , mPublishWork(nullptr)
+    , mCheckpointBuilder(std::make_unique<CheckpointBuilder>(app))
 
     , mPublishSkip(
           app.getMetrics().NewMeter({"history", "publish", "skip"}, "event"))
@@ -85,6 +88,35 @@ HistoryManagerImpl::~HistoryManagerImpl()
 {
 }
 
+HistoryManagerImpl::ArchivePublishState::ArchivePublishState(
+    medida::Meter& success, medida::Meter& failure,
+    medida::Counter& lastPublished)
+    : mSuccess(success), mFailure(failure), mLastPublishedCount(lastPublished)
+{
+}
+
+HistoryManagerImpl::ArchivePublishState&
+HistoryManagerImpl::getArchivePublishState(std::string const& name)
+{
+    auto i = mArchivePublishStates.find(name);
+    if (i == mArchivePublishStates.end())
+    {
+        auto& metrics = mApp.getMetrics();
+        i = mArchivePublishStates
+                .emplace(name, ArchivePublishState(
+                                   metrics.NewMeter(
+                                       {"history", "publish-success", name},
+                                       "checkpoint"),
+                                   metrics.NewMeter(
+                                       {"history", "publish-failure", name},
+                                       "checkpoint"),
+                                   metrics.NewCounter(
+                                       {"history", "publish-ledger", name})))
+                .first;
+    }
+    return i->second;
+}
+
 uint32_t
 HistoryManagerImpl::getCheckpointFrequency() const
 {
@@ -124,13 +156,29 @@ void
 HistoryManagerImpl::logAndUpdatePublishStatus()
 {
     std::stringstream stateStr;
-    if (mPublishWork)
+    if (isPublishing())
     {
         auto qlen = publishQueueLength();
         stateStr << "Publishing " << qlen << " queued checkpoints"
                  << " [" << getMinLedgerQueuedToPublish() << "-"
-                 << getMaxLedgerQueuedToPublish() << "]"
-                 << ": " << mPublishWork->getStatus();
+                 << getMaxLedgerQueuedToPublish() << "]";
+        for (auto const& a : mArchivePublishStates)
+        {
+            if (a.second.mPublishing == 0)
+            {
+                continue;
+            }
+            stateStr << ", " << a.first << ": ";
+            auto w = mPublishWork.find(a.second.mPublishing);
+            if (w != mPublishWork.end() && !w->second->isDone())
+            {
+                stateStr << w->second->getStatus();
+            }
+            else
+            {
+                stateStr << "uploading checkpoint " << a.second.mPublishing;
+            }
+        }
 
         auto current = stateStr.str();
         auto existing = mApp.getStatusManager().getStatusMessage(
@@ -281,47 +329,144 @@ HistoryManagerImpl::queueCurrentHistory()
 
     mPublishQueue.Mark();
     mPublishQueueBuckets.addBuckets(has.allBuckets());
-    takeSnapshotAndPublish(has);
+    if (!takeSnapshotAndPublish(has, getPublishQueueLedgers()))
+    {
+        mPublishDelay.Mark();
+    }
 }
 
-void
-HistoryManagerImpl::takeSnapshotAndPublish(HistoryArchiveState const& has)
+bool
+HistoryManagerImpl::isPublishing() const
 {
-    if (mPublishWork)
+    for (auto const& a : mArchivePublishStates)
     {
-        mPublishDelay.Mark();
-        return;
+        if (a.second.mPublishing != 0)
+        {
+            return true;
+        }
     }
+    return false;
+}
+
+std::vector<uint32_t>
+HistoryManagerImpl::getPublishQueueLedgers()
+{
+    std::vector<uint32_t> ledgers;
+    uint32_t ledger;
+    auto prep = mApp.getDatabase().getPreparedStatement(
+        "SELECT ledger FROM publishqueue ORDER BY ledger ASC;");
+    auto& st = prep.statement();
+    st.exchange(soci::into(ledger));
+    st.define_and_bind();
+    st.execute(true);
+    while (st.got_data())
+    {
+        ledgers.push_back(ledger);
+        st.fetch();
+    }
+    return ledgers;
+}
+
+std::vector<std::shared_ptr<HistoryArchive>>
+HistoryManagerImpl::getArchivesReadyToPublish(
+    uint32_t ledger, std::vector<uint32_t> const& queued)
+{
+    // An archive is ready for `ledger` when it is idle and `ledger` is the
+    // oldest queued checkpoint it does not have yet.
+    std::vector<std::shared_ptr<HistoryArchive>> ready;
+    for (auto const& archive :
+         mApp.getHistoryArchiveManager().getWritableHistoryArchives())
+    {
+        auto& state = getArchivePublishState(archive->getName());
+        if (state.mPublishing != 0 || state.mLastPublished >= ledger)
+        {
+            continue;
+        }
+        auto next = std::upper_bound(queued.begin(), queued.end(),
+                                     state.mLastPublished);
+        if (next != queued.end() && *next == ledger)
+        {
+            ready.push_back(archive);
+        }
+    }
+    return ready;
+}
+
+bool
+HistoryManagerImpl::takeSnapshotAndPublish(HistoryArchiveState const& has,
+                                           std::vector<uint32_t> const& queued)
+{
     auto ledgerSeq = has.currentLedger;
-    CLOG(DEBUG, "History") << "Activating publish for ledger " << ledgerSeq;
+    auto archives = getArchivesReadyToPublish(ledgerSeq, queued);
+    if (archives.empty())
+    {
+        return false;
+    }
+    for (auto const& archive : archives)
+    {
+        getArchivePublishState(archive->getName()).mPublishing = ledgerSeq;
+    }
+
+    // Archives that become ready while the snapshot of this checkpoint is
+    // still being written share it rather than writing their own.
+    auto existing = mPublishWork.find(ledgerSeq);
+    if (existing != mPublishWork.end() && !existing->second->isDone())
+    {
+        for (auto const& archive : archives)
+        {
+            existing->second->addArchive(archive);
+        }
+        return true;
+    }
+
+    CLOG(DEBUG, "History") << "Activating publish for ledger " << ledgerSeq
+                           << " to " << archives.size() << " archives";
     auto snap = std::make_shared<StateSnapshot>(mApp, has);
 
     mPublishStart.Mark();
-    mPublishWork = mApp.getWorkManager().addWork<PublishWork>(snap);
+    mPublishWork[ledgerSeq] =
+        mApp.getWorkManager().addWork<PublishWork>(snap, archives);
     mApp.getWorkManager().advanceChildren();
+    return true;
 }
 
 size_t
 HistoryManagerImpl::publishQueuedHistory()
 {
-    std::string state;
+    for (auto i = mPublishWork.begin(); i != mPublishWork.end();)
+    {
+        i = i->second->isDone() ? mPublishWork.erase(i) : std::next(i);
+    }
 
-    auto prep = mApp.getDatabase().getPreparedStatement(
-        "SELECT state FROM publishqueue"
-        " ORDER BY ledger ASC LIMIT 1;");
-    auto& st = prep.statement();
-    soci::indicator stateIndicator;
-    st.exchange(soci::into(state, stateIndicator));
-    st.define_and_bind();
-    st.execute(true);
-    if (st.got_data() && stateIndicator == soci::indicator::i_ok)
+    auto queued = getPublishQueueLedgers();
+    size_t started = 0;
+    for (auto ledger : queued)
     {
-        HistoryArchiveState has;
-        has.fromString(state);
-        takeSnapshotAndPublish(has);
-        return 1;
+        if (getArchivesReadyToPublish(ledger, queued).empty())
+        {
+            continue;
+        }
+
+        std::string state;
+        auto prep = mApp.getDatabase().getPreparedStatement(
+            "SELECT state FROM publishqueue WHERE ledger = :lg;");
+        auto& st = prep.statement();
+        soci::indicator stateIndicator;
+        st.exchange(soci::into(state, stateIndicator));
+        st.exchange(soci::use(ledger));
+        st.define_and_bind();
+        st.execute(true);
+        if (st.got_data() && stateIndicator == soci::indicator::i_ok)
+        {
+            HistoryArchiveState has;
+            has.fromString(state);
+            if (takeSnapshotAndPublish(has, queued))
+            {
+                ++started;
+            }
+        }
     }
-    return 0;
+    return started;
 }
 
 std::vector<HistoryArchiveState>
@@ -392,28 +537,64 @@ HistoryManagerImpl::getMissingBucketsReferencedByPublishQueue()
 }
 
 void
-HistoryManagerImpl::historyPublished(
-    uint32_t ledgerSeq, std::vector<std::string> const& originalBuckets,
-    bool success)
+HistoryManagerImpl::historyPublished(std::string const& archiveName,
+                                     uint32_t ledgerSeq, bool success)
 {
-    if (success)
+    auto& archiveState = getArchivePublishState(archiveName);
+    archiveState.mPublishing = 0;
+    if (!success)
     {
-        this->mPublishSuccess.Mark();
-        auto timer = mApp.getDatabase().getDeleteTimer("publishqueue");
-        auto prep = mApp.getDatabase().getPreparedStatement(
-            "DELETE FROM publishqueue WHERE ledger = :lg;");
-        auto& st = prep.statement();
-        st.exchange(soci::use(ledgerSeq));
-        st.define_and_bind();
-        st.execute(true);
+        archiveState.mFailure.Mark();
+        this->mPublishFailure.Mark();
+        mApp.postOnMainThread([this]() { this->publishQueuedHistory(); });
+        return;
+    }
 
-        mPublishQueueBuckets.removeBuckets(originalBuckets);
+    archiveState.mSuccess.Mark();
+    archiveState.mLastPublished =
+        std::max(archiveState.mLastPublished, ledgerSeq);
+    archiveState.mLastPublishedCount.set_count(archiveState.mLastPublished);
+
+    bool everywhere = true;
+    for (auto const& archive :
+         mApp.getHistoryArchiveManager().getWritableHistoryArchives())
+    {
+        if (getArchivePublishState(archive->getName()).mLastPublished <
+            ledgerSeq)
+        {
+            everywhere = false;
+            break;
+        }
     }
-    else
+
+    if (everywhere)
     {
-        this->mPublishFailure.Mark();
+        std::string state;
+        {
+            auto prep = mApp.getDatabase().getPreparedStatement(
+                "SELECT state FROM publishqueue WHERE ledger = :lg;");
+            auto& st = prep.statement();
+            st.exchange(soci::into(state));
+            st.exchange(soci::use(ledgerSeq));
+            st.define_and_bind();
+            st.execute(true);
+        }
+        if (!state.empty())
+        {
+            this->mPublishSuccess.Mark();
+            auto timer = mApp.getDatabase().getDeleteTimer("publishqueue");
+            auto prep = mApp.getDatabase().getPreparedStatement(
+                "DELETE FROM publishqueue WHERE ledger = :lg;");
+            auto& st = prep.statement();
+            st.exchange(soci::use(ledgerSeq));
+            st.define_and_bind();
+            st.execute(true);
+
+            HistoryArchiveState has;
+            has.fromString(state);
+            mPublishQueueBuckets.removeBuckets(has.allBuckets());
+        }
     }
-    mPublishWork.reset();
     mApp.postOnMainThread([this]() { this->publishQueuedHistory(); });
 }
 
@@ -7,10 +7,12 @@
 #include "bucket/PublishQueueBuckets.h"
 #include "history/HistoryManager.h"
 #include "util/TmpDir.h"
+#include <map>
 #include <memory>
 
 namespace medida
 {
+class Counter;
 class Meter;
 }
 
@@ -18,13 +20,36 @@ namespace stellar
 {
 
 class Application;
-class Work;
+class CheckpointBuilder;
+class HistoryArchive;
+class PublishWork;
 
 class HistoryManagerImpl : public HistoryManager
 {
+    // Publishing progress of one writable archive. Every archive receives the
+    // queued checkpoints in order, but independently of the other archives, so
+    // a slow or failing archive only holds up itself.
+    struct ArchivePublishState
+    {
+        // Last checkpoint known (to this process) to be in the archive.
+        uint32_t mLastPublished{0};
+        // Checkpoint currently being published to the archive, or 0.
+        uint32_t mPublishing{0};
+
+        medida::Meter& mSuccess;
+        medida::Meter& mFailure;
+        medida::Counter& mLastPublishedCount;
+
+        ArchivePublishState(medida::Meter& success, medida::Meter& failure,
+                            medida::Counter& lastPublished);
+    };
+
     Application& mApp;
     std::unique_ptr<TmpDir> mWorkDir;
-    std::shared_ptr<Work> mPublishWork;
+    std::map<std::string, ArchivePublishState> mArchivePublishStates;
+    // Checkpoints whose snapshot is being written, keyed by ledger.
+    std::map<uint32_t, std::shared_ptr<PublishWork>> mPublishWork;
+    std::unique_ptr<CheckpointBuilder> mCheckpointBuilder;
     PublishQueueBuckets mPublishQueueBuckets;
     bool mPublishQueueBucketsFilled{false};
 
@@ -37,6 +62,13 @@ class HistoryManagerImpl : public HistoryManager
 
     PublishQueueBuckets::BucketCount loadBucketsReferencedByPublishQueue();
 
+    ArchivePublishState& getArchivePublishState(std::string const& name);
+    std::vector<uint32_t> getPublishQueueLedgers();
+    std::vector<std::shared_ptr<HistoryArchive>>
+    getArchivesReadyToPublish(uint32_t ledger,
+                              std::vector<uint32_t> const& queued);
+    bool isPublishing() const;
+
   public:
     HistoryManagerImpl(Application& app);
     ~HistoryManagerImpl() override;
@@ -54,7 +86,8 @@ class HistoryManagerImpl : public HistoryManager
 
     void queueCurrentHistory() override;
 
-    void takeSnapshotAndPublish(HistoryArchiveState const& has);
+    bool takeSnapshotAndPublish(HistoryArchiveState const& has,
+                                std::vector<uint32_t> const& queued);
 
     uint32_t getMinLedgerQueuedToPublish() override;
 
@@ -69,8 +102,7 @@ class HistoryManagerImpl : public HistoryManager
 
     std::vector<HistoryArchiveState> getPublishQueueStates();
 
-    void historyPublished(uint32_t ledgerSeq,
-                          std::vector<std::string> const& originalBuckets,
+    void historyPublished(std::string const& archiveName, uint32_t ledgerSeq,
                           bool success) override;
 
     void downloadMissingBuckets(
@@ -81,6 +113,8 @@ class HistoryManagerImpl : public HistoryManager
 
     InferredQuorum inferQuorum() override;
 
+    CheckpointBuilder& getCheckpointBuilder() override;
+
     std::string const& getTmpDir() override;
 
     std::string localFilename(std::string const& basename) override;
@@ -4,15 +4,24 @@
 
 #include "bucket/BucketManager.h"
 #include "catchup/CatchupWorkTests.h"
+#include "catchup/ReplayLedgerSegmentsWork.h"
+#include "crypto/Hex.h"
+#include "crypto/Random.h"
+#include "history/FileTransferInfo.h"
 #include "history/HistoryArchiveManager.h"
+#include "history/HistoryFileCache.h"
 #include "history/HistoryManager.h"
 #include "history/HistoryTestsUtils.h"
+#include "history/StateSnapshot.h"
 #include "historywork/GetHistoryArchiveStateWork.h"
 #include "historywork/GunzipFileWork.h"
 #include "historywork/GzipFileWork.h"
 #include "historywork/PutHistoryArchiveStateWork.h"
+#include "ledger/LedgerHeaderFrame.h"
 #include "ledger/LedgerManager.h"
 #include "main/ExternalQueue.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
 #include "main/PersistentState.h"
 #include "process/ProcessManager.h"
 #include "test/TestUtils.h"
@@ -20,6 +29,7 @@
 #include "util/Fs.h"
 #include "work/WorkManager.h"
 
+#include <fstream>
 #include <lib/catch.hpp>
 #include <lib/util/format.h>
 
@@ -101,6 +111,119 @@ TEST_CASE("History publish", "[history]")
     catchupSimulation.generateAndPublishInitialHistory(1);
 }
 
+TEST_CASE("History blocks streamed as ledgers close", "[history]")
+{
+    CatchupSimulation catchupSimulation{};
+    auto& app = catchupSimulation.getApp();
+    auto& hm = app.getHistoryManager();
+    auto& wm = app.getWorkManager();
+    auto& streamed = app.getMetrics().NewMeter(
+        {"history", "checkpoint", "streamed"}, "checkpoint");
+
+    // The first checkpoint starts before the genesis ledger, so it can never
+    // be streamed and is published from the database.
+    catchupSimulation.generateAndPublishInitialHistory(1);
+    REQUIRE(streamed.count() == 0);
+
+    catchupSimulation.generateAndPublishHistory(1);
+    REQUIRE(streamed.count() == 1);
+
+    // What was published from the streamed files must match what the database
+    // path writes for the same checkpoint.
+    uint32_t checkpoint = 2 * hm.getCheckpointFrequency() - 1;
+    HistoryArchiveState has;
+    has.currentLedger = checkpoint;
+    auto fromDatabase = std::make_shared<StateSnapshot>(app, has);
+    REQUIRE(!fromDatabase->mStreamedHistoryBlocks);
+    REQUIRE(fromDatabase->writeHistoryBlocks());
+
+    auto readFile = [](std::string const& name) {
+        std::ifstream in(name, std::ifstream::binary);
+        REQUIRE(in);
+        return std::string(std::istreambuf_iterator<char>(in),
+                           std::istreambuf_iterator<char>());
+    };
+
+    for (auto const& f :
+         {fromDatabase->mLedgerSnapFile, fromDatabase->mTransactionSnapFile,
+          fromDatabase->mTransactionResultSnapFile})
+    {
+        auto published = catchupSimulation.getHistoryConfigurator()
+                             .getArchiveDirName() +
+                         "/" + f->remoteName();
+        auto local = hm.localFilename(f->baseName_nogz());
+        {
+            std::ofstream out(local + ".gz", std::ofstream::binary);
+            out << readFile(published);
+        }
+        auto gunzip = wm.executeWork<GunzipFileWork>(local + ".gz");
+        REQUIRE(gunzip->getState() == Work::WORK_SUCCESS);
+        CHECK(readFile(local) == readFile(f->localPath_nogz()));
+    }
+}
+
+namespace
+{
+// The usual tmpdir archive, plus a second writable archive on which every
+// command fails.
+class BrokenSecondArchiveConfigurator : public TmpDirHistoryConfigurator
+{
+  public:
+    Config&
+    configure(Config& cfg, bool writable) const override
+    {
+        TmpDirHistoryConfigurator::configure(cfg, writable);
+        cfg.HISTORY["broken"] =
+            HistoryArchiveConfiguration{"broken", "false", "false", "false"};
+        return cfg;
+    }
+};
+}
+
+TEST_CASE("Publish to one archive is not held up by another", "[history]")
+{
+    CatchupSimulation catchupSimulation{
+        std::make_shared<BrokenSecondArchiveConfigurator>()};
+    auto& app = catchupSimulation.getApp();
+    auto& hm = app.getHistoryManager();
+    auto& metrics = app.getMetrics();
+    auto& goodSuccess = metrics.NewMeter(
+        {"history", "publish-success", "test"}, "checkpoint");
+    auto& brokenSuccess = metrics.NewMeter(
+        {"history", "publish-success", "broken"}, "checkpoint");
+    auto& brokenFailure = metrics.NewMeter(
+        {"history", "publish-failure", "broken"}, "checkpoint");
+
+    app.start();
+    while (hm.getPublishQueueCount() < 2)
+    {
+        catchupSimulation.generateRandomLedger();
+    }
+
+    auto& clock = catchupSimulation.getClock();
+    for (size_t i = 0; i < 100000 && (goodSuccess.count() < 2 ||
+                                       brokenFailure.count() == 0);
+         ++i)
+    {
+        clock.crank(true);
+    }
+
+    // Both checkpoints reached the working archive, in order, even though
+    // the first never reached the broken one; and both stay queued for it.
+    REQUIRE(goodSuccess.count() == 2);
+    REQUIRE(brokenFailure.count() > 0);
+    REQUIRE(brokenSuccess.count() == 0);
+    REQUIRE(hm.getPublishSuccessCount() == 0);
+    REQUIRE(hm.publishQueueLength() == 2);
+
+    HistoryArchiveState has;
+    auto archive = app.getHistoryArchiveManager().getHistoryArchive("test");
+    auto get = app.getWorkManager().executeWork<GetHistoryArchiveStateWork>(
+        "get-history-archive-state", has, 0, archive);
+    REQUIRE(get->getState() == Work::WORK_SUCCESS);
+    REQUIRE(has.currentLedger == hm.getMaxLedgerQueuedToPublish());
+}
+
 static std::string
 resumeModeName(uint32_t count)
 {
@@ -168,6 +291,176 @@ TEST_CASE("Full history catchup", "[history][historycatchup]")
     }
 }
 
+namespace
+{
+// The usual tmpdir archive, with catchup split into segments of one
+// checkpoint, two of them at a time.
+class SegmentedCatchupConfigurator : public TmpDirHistoryConfigurator
+{
+  public:
+    Config&
+    configure(Config& cfg, bool writable) const override
+    {
+        TmpDirHistoryConfigurator::configure(cfg, writable);
+        cfg.CATCHUP_SEGMENT_CHECKPOINTS = 1;
+        cfg.MAX_CONCURRENT_CATCHUP_SEGMENTS = 2;
+        return cfg;
+    }
+};
+}
+
+TEST_CASE("Segmented catchup resumes from cursor",
+          "[history][historycatchup][catchupsegments]")
+{
+    CatchupSimulation catchupSimulation{
+        std::make_shared<SegmentedCatchupConfigurator>()};
+    auto& app = catchupSimulation.getApp();
+
+    catchupSimulation.generateAndPublishInitialHistory(3);
+    auto app2 = catchupSimulation.catchupNewApplication(
+        app.getLedgerManager().getLastClosedLedgerNum() - 2,
+        std::numeric_limits<uint32_t>::max(), false,
+        Config::TESTDB_IN_MEMORY_SQLITE, "segmented catchup");
+
+    auto& resumed = app2->getMetrics().NewMeter(
+        {"history", "catchup-segment", "resumed"}, "segment");
+    auto& applied = app2->getMetrics().NewMeter(
+        {"history", "catchup-segment", "applied"}, "segment");
+    auto& ps = app2->getPersistentState();
+    REQUIRE(resumed.count() == 0);
+    REQUIRE(applied.count() == 3);
+    REQUIRE(ps.getState(PersistentState::kCatchupCursor).empty());
+
+    // Leave app2 as if it had been interrupted after verifying the chain up
+    // to the end of the next segment: only the segment after that has to be
+    // verified against the network.
+    catchupSimulation.generateAndPublishHistory(2);
+    uint32_t segmentEnd =
+        4 * app.getHistoryManager().getCheckpointFrequency() - 1;
+    auto header = LedgerHeaderFrame::loadBySequence(
+        segmentEnd, app.getDatabase(), app.getDatabase().getSession());
+    REQUIRE(header);
+    ReplayLedgerSegmentsWork::saveCursor(*app2,
+                                         {{segmentEnd, header->getHash()}});
+
+    REQUIRE(catchupSimulation.catchupApplication(
+        app.getLedgerManager().getLastClosedLedgerNum() - 2,
+        std::numeric_limits<uint32_t>::max(), false, app2));
+    REQUIRE(resumed.count() == 1);
+    REQUIRE(applied.count() == 5);
+    REQUIRE(ps.getState(PersistentState::kCatchupCursor).empty());
+}
+
+namespace
+{
+// The usual tmpdir archive, with every app sharing a history file cache.
+class CachedHistoryConfigurator : public TmpDirHistoryConfigurator
+{
+    TmpDirManager mCacheTmp;
+    TmpDir mCacheDir;
+
+  public:
+    CachedHistoryConfigurator()
+        : mCacheTmp("histcache-" + binToHex(randomBytes(8)))
+        , mCacheDir(mCacheTmp.tmpDir("cache"))
+    {
+    }
+
+    std::string
+    getCacheDirName() const
+    {
+        return mCacheDir.getName();
+    }
+
+    Config&
+    configure(Config& cfg, bool writable) const override
+    {
+        TmpDirHistoryConfigurator::configure(cfg, writable);
+        cfg.HISTORY_CACHE_DIR_PATH = mCacheDir.getName();
+        return cfg;
+    }
+};
+}
+
+TEST_CASE("History file cache shared between catchups",
+          "[history][historycatchup][historycache]")
+{
+    auto configurator = std::make_shared<CachedHistoryConfigurator>();
+    CatchupSimulation catchupSimulation{configurator};
+    auto& app = catchupSimulation.getApp();
+
+    catchupSimulation.generateAndPublishInitialHistory(3);
+    auto initLedger = app.getLedgerManager().getLastClosedLedgerNum() - 2;
+
+    auto app2 = catchupSimulation.catchupNewApplication(
+        initLedger, std::numeric_limits<uint32_t>::max(), false,
+        Config::TESTDB_IN_MEMORY_SQLITE, "catchup filling cache");
+    auto& hit2 = app2->getMetrics().NewMeter(
+        {"history", "file-cache", "hit"}, "file");
+    auto& miss2 = app2->getMetrics().NewMeter(
+        {"history", "file-cache", "miss"}, "file");
+    REQUIRE(hit2.count() == 0);
+    REQUIRE(miss2.count() != 0);
+    auto cached = fs::findfiles(configurator->getCacheDirName(),
+                                [](std::string const& name) {
+                                    return name != "." && name != "..";
+                                });
+    REQUIRE(cached.size() == miss2.count());
+
+    // A second node catching up the same range downloads nothing.
+    auto app3 = catchupSimulation.catchupNewApplication(
+        initLedger, std::numeric_limits<uint32_t>::max(), false,
+        Config::TESTDB_IN_MEMORY_SQLITE, "catchup from cache");
+    auto& hit3 = app3->getMetrics().NewMeter(
+        {"history", "file-cache", "hit"}, "file");
+    auto& miss3 = app3->getMetrics().NewMeter(
+        {"history", "file-cache", "miss"}, "file");
+    REQUIRE(hit3.count() == miss2.count());
+    REQUIRE(miss3.count() == 0);
+
+    // Entries are dropped once the cache no longer trusts them.
+    auto& cache = app3->getHistoryArchiveManager().getFileCache();
+    auto firstCheckpoint = app.getHistoryManager().getCheckpointFrequency() - 1;
+    auto remote = fs::remoteName(HISTORY_FILE_TYPE_LEDGER,
+                                 fs::hexStr(firstCheckpoint), "xdr.gz");
+    TmpDir dl(app3->getTmpDirManager().tmpDir("cache-fetch"));
+    REQUIRE(cache.fetch(remote, dl.getName() + "/ledger.xdr.gz"));
+    cache.remove(remote);
+    REQUIRE(!cache.fetch(remote, dl.getName() + "/ledger.xdr.gz"));
+
+    // A transactions file that fails replay is evicted too. Replace the
+    // cached transactions of the first checkpoint with an empty (but
+    // well-formed) gzip file: its ledgers then replay with empty tx sets,
+    // whose hashes do not match their headers.
+    auto txRemote = fs::remoteName(HISTORY_FILE_TYPE_TRANSACTIONS,
+                                   fs::hexStr(firstCheckpoint), "xdr.gz");
+    auto emptyGz = dl.getName() + "/empty.xdr.gz";
+    {
+        static unsigned char const kEmptyGzip[] = {
+            0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+            0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+        std::ofstream out(emptyGz, std::ios::binary);
+        out.write(reinterpret_cast<char const*>(kEmptyGzip),
+                  sizeof(kEmptyGzip));
+    }
+    cache.insert(txRemote, emptyGz);
+
+    auto app4 = catchupSimulation.createCatchupApplication(
+        std::numeric_limits<uint32_t>::max(),
+        Config::TESTDB_IN_MEMORY_SQLITE, "catchup from corrupt cache");
+    catchupSimulation.catchupApplication(
+        initLedger, std::numeric_limits<uint32_t>::max(), false, app4);
+    auto& evict4 = app4->getMetrics().NewMeter(
+        {"history", "file-cache", "evict"}, "file");
+    REQUIRE(evict4.count() != 0);
+
+    // whatever is cached now is what the archive holds, so the next
+    // catchup sharing the cache succeeds
+    catchupSimulation.catchupNewApplication(
+        initLedger, std::numeric_limits<uint32_t>::max(), false,
+        Config::TESTDB_IN_MEMORY_SQLITE, "catchup after eviction");
+}
+
 TEST_CASE("History publish queueing", "[history][historydelay][historycatchup]")
 {
     CatchupSimulation catchupSimulation{};
@@ -273,6 +566,11 @@ TEST_CASE("Publish/catchup alternation, with stall",
         CHECK(app3->getLedgerManager().getLedgerNum() == lm.getLedgerNum());
     }
 
+    // app3 only applied the bucket levels that changed between catchups.
+    auto& skipped = app3->getMetrics().NewMeter(
+        {"history", "bucket-apply", "skipped"}, "event");
+    CHECK(skipped.count() != 0);
+
     // By now we should have had 3 + 1 + 2 + 3 = 9 publishes, and should
     // have advanced 1 ledger in to the 9th block.
     uint32_t freq = app2->getHistoryManager().getCheckpointFrequency();
@@ -368,6 +368,18 @@ CatchupSimulation::catchupNewApplication(uint32_t initLedger, uint32_t count,
                           << "'";
     CLOG(INFO, "History") << "****";
 
+    auto app2 = createCatchupApplication(count, dbMode, appName);
+    REQUIRE(catchupApplication(initLedger, count, manual, app2));
+    return app2;
+}
+
+Application::pointer
+CatchupSimulation::createCatchupApplication(uint32_t count,
+                                            Config::TestDbMode dbMode,
+                                            std::string const& appName)
+{
+    CLOG(INFO, "History") << "Creating app '" << appName << "' for catchup";
+
     mCfgs.emplace_back(
         getTestConfig(static_cast<int>(mCfgs.size()) + 1, dbMode));
     mCfgs.back().CATCHUP_COMPLETE =
@@ -380,7 +392,6 @@ CatchupSimulation::catchupNewApplication(uint32_t initLedger, uint32_t count,
         mClock, mHistoryConfigurator->configure(mCfgs.back(), false));
 
     app2->start();
-    REQUIRE(catchupApplication(initLedger, count, manual, app2));
     return app2;
 }
 
@@ -169,6 +169,9 @@ class CatchupSimulation
     void generateAndPublishHistory(size_t nPublishes);
     void generateAndPublishInitialHistory(size_t nPublishes);
 
+    Application::pointer createCatchupApplication(uint32_t count,
+                                                  Config::TestDbMode dbMode,
+                                                  std::string const& appName);
     Application::pointer catchupNewApplication(uint32_t initLedger,
                                                uint32_t count, bool manual,
                                                Config::TestDbMode dbMode,
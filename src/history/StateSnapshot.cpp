@@ -9,6 +9,7 @@
 #include "crypto/Hex.h"
 #include "database/Database.h"
 #include "herder/HerderPersistence.h"
+#include "history/CheckpointBuilder.h"
 #include "history/FileTransferInfo.h"
 #include "history/HistoryArchive.h"
 #include "history/HistoryManager.h"
@@ -16,12 +17,14 @@
 #include "main/Application.h"
 #include "main/Config.h"
 #include "transactions/TransactionFrame.h"
+#include "util/Fs.h"
 #include "util/Logging.h"
 #include "util/XDRStream.h"
 
 #include "medida/counter.h"
 #include "medida/metrics_registry.h"
 
+#include <cstdio>
 #include <soci.h>
 
 namespace stellar
@@ -43,8 +46,10 @@ StateSnapshot::StateSnapshot(Application& app, HistoryArchiveState const& state)
     , mSCPHistorySnapFile(std::make_shared<FileTransferInfo>(
           mSnapDir, HISTORY_FILE_TYPE_SCP, mLocalState.currentLedger))
 
+    , mStreamedHistoryBlocks(false)
 {
     makeLive();
+    mStreamedHistoryBlocks = takeStreamedHistoryBlocks();
 }
 
 void
@@ -56,14 +61,57 @@ StateSnapshot::makeLive()
         auto& hb = mLocalState.currentBuckets[i];
         if (hb.next.hasHashes() && !hb.next.isLive())
         {
-            hb.next.makeLive(mApp, BucketList::keepDeadEntries(i));
+            hb.next.makeLive(
+                mApp, BucketList::keepDeadEntries(i),
+                BucketList::mergeDeadline(mLocalState.currentLedger, i));
         }
     }
 }
 
+bool
+StateSnapshot::takeStreamedHistoryBlocks()
+{
+    CheckpointBuilder::Files files;
+    if (!mApp.getHistoryManager().getCheckpointBuilder().takeCheckpoint(
+            mLocalState.currentLedger, files))
+    {
+        return false;
+    }
+
+    bool ok =
+        std::rename(files.mLedgerHeaders.c_str(),
+                    mLedgerSnapFile->localPath_nogz().c_str()) == 0 &&
+        std::rename(files.mTransactions.c_str(),
+                    mTransactionSnapFile->localPath_nogz().c_str()) == 0 &&
+        std::rename(files.mResults.c_str(),
+                    mTransactionResultSnapFile->localPath_nogz().c_str()) == 0;
+    if (ok && !files.mSCPMessages.empty())
+    {
+        ok = std::rename(files.mSCPMessages.c_str(),
+                         mSCPHistorySnapFile->localPath_nogz().c_str()) == 0;
+    }
+    if (!ok)
+    {
+        CLOG(WARNING, "History")
+            << "Failed to move streamed history blocks of checkpoint "
+            << mLocalState.currentLedger << " into " << mSnapDir.getName()
+            << ", will read them from the database";
+    }
+    return ok;
+}
+
 bool
 StateSnapshot::writeHistoryBlocks() const
 {
+    if (mStreamedHistoryBlocks &&
+        fs::exists(mLedgerSnapFile->localPath_nogz()))
+    {
+        CLOG(DEBUG, "History") << "Using history blocks streamed as ledgers "
+                               << "closed for checkpoint "
+                               << mLocalState.currentLedger;
+        return true;
+    }
+
     std::unique_ptr<soci::session> snapSess(
         mApp.getDatabase().canUsePool()
             ? std::make_unique<soci::session>(mApp.getDatabase().getPool())
@@ -27,8 +27,13 @@ struct StateSnapshot : public std::enable_shared_from_this<StateSnapshot>
     std::shared_ptr<FileTransferInfo> mTransactionResultSnapFile;
     std::shared_ptr<FileTransferInfo> mSCPHistorySnapFile;
 
+    // Set when the history blocks were already written as the checkpoint's
+    // ledgers closed, so writeHistoryBlocks() needs no database reads.
+    bool mStreamedHistoryBlocks;
+
     StateSnapshot(Application& app, HistoryArchiveState const& state);
     void makeLive();
+    bool takeStreamedHistoryBlocks();
     bool writeHistoryBlocks() const;
 };
 }
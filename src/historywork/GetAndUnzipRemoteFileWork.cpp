@@ -4,8 +4,11 @@
 
 #include "historywork/GetAndUnzipRemoteFileWork.h"
 #include "history/FileTransferInfo.h"
+#include "history/HistoryArchiveManager.h"
+#include "history/HistoryFileCache.h"
 #include "historywork/GetRemoteFileWork.h"
 #include "historywork/GunzipFileWork.h"
+#include "main/Application.h"
 #include "util/Logging.h"
 
 namespace stellar
@@ -51,6 +54,17 @@ GetAndUnzipRemoteFileWork::onReset()
     mGetRemoteFileWork.reset();
     mGunzipFileWork.reset();
 
+    // Without children this goes straight to onSuccess, which unzips the
+    // cached copy like a downloaded one.
+    mFromCache = mApp.getHistoryArchiveManager().getFileCache().fetch(
+        mFt.remoteName(), mFt.localPath_gz_tmp());
+    if (mFromCache)
+    {
+        CLOG(DEBUG, "History") << "Downloading and unzipping "
+                               << mFt.remoteName() << ": found in cache";
+        return;
+    }
+
     CLOG(DEBUG, "History") << "Downloading and unzipping " << mFt.remoteName()
                            << ": downloading";
     mGetRemoteFileWork = addWork<GetRemoteFileWork>(
@@ -70,6 +84,7 @@ GetAndUnzipRemoteFileWork::onSuccess()
         }
         else
         {
+            std::remove(mFt.localPath_gz().c_str());
             return WORK_SUCCESS;
         }
     }
@@ -100,6 +115,12 @@ GetAndUnzipRemoteFileWork::onSuccess()
         CLOG(TRACE, "History")
             << "Downloading and unzipping " << mFt.remoteName()
             << ": renamed .gz.tmp to .gz";
+
+        if (!mFromCache)
+        {
+            mApp.getHistoryArchiveManager().getFileCache().insert(
+                mFt.remoteName(), mFt.localPath_gz());
+        }
     }
 
     if (!fs::exists(mFt.localPath_gz()))
@@ -111,14 +132,34 @@ GetAndUnzipRemoteFileWork::onSuccess()
 
     CLOG(DEBUG, "History") << "Downloading and unzipping " << mFt.remoteName()
                            << ": unzipping";
+    // gzip refuses to unzip in place a file hard-linked with the cache.
+    auto keepGz = mApp.getHistoryArchiveManager().getFileCache().isEnabled();
     mGunzipFileWork =
-        addWork<GunzipFileWork>(mFt.localPath_gz(), false, RETRY_NEVER);
+        addWork<GunzipFileWork>(mFt.localPath_gz(), keepGz, RETRY_NEVER);
     return WORK_PENDING;
 }
 
+void
+GetAndUnzipRemoteFileWork::evictFromCache()
+{
+    // A file that failed to unzip may have come from, or gone into, the cache.
+    if (mFromCache || mGunzipFileWork)
+    {
+        mApp.getHistoryArchiveManager().getFileCache().remove(
+            mFt.remoteName());
+    }
+}
+
+void
+GetAndUnzipRemoteFileWork::onFailureRetry()
+{
+    evictFromCache();
+}
+
 void
 GetAndUnzipRemoteFileWork::onFailureRaise()
 {
+    evictFromCache();
     std::remove(mFt.localPath_nogz().c_str());
     std::remove(mFt.localPath_gz().c_str());
     std::remove(mFt.localPath_gz_tmp().c_str());
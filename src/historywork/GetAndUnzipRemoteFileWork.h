@@ -20,6 +20,9 @@ class GetAndUnzipRemoteFileWork : public Work
 
     FileTransferInfo mFt;
     std::shared_ptr<HistoryArchive> mArchive;
+    bool mFromCache{false};
+
+    void evictFromCache();
 
   public:
     // Passing `nullptr` for the archive argument will cause the work to
@@ -33,6 +36,7 @@ class GetAndUnzipRemoteFileWork : public Work
     std::string getStatus() const override;
     void onReset() override;
     Work::State onSuccess() override;
+    void onFailureRetry() override;
     void onFailureRaise() override;
 };
 }
@@ -3,25 +3,31 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "historywork/PublishWork.h"
-#include "history/HistoryArchiveManager.h"
+#include "history/FileTransferInfo.h"
+#include "history/HistoryArchive.h"
 #include "history/HistoryManager.h"
 #include "history/StateSnapshot.h"
+#include "historywork/GzipFileWork.h"
 #include "historywork/PutSnapshotFilesWork.h"
 #include "historywork/ResolveSnapshotWork.h"
 #include "historywork/WriteSnapshotWork.h"
 #include "lib/util/format.h"
 #include "main/Application.h"
+#include "util/Fs.h"
 #include "util/Logging.h"
+#include "work/WorkManager.h"
 
 namespace stellar
 {
 
-PublishWork::PublishWork(Application& app, WorkParent& parent,
-                         std::shared_ptr<StateSnapshot> snapshot)
+PublishWork::PublishWork(
+    Application& app, WorkParent& parent,
+    std::shared_ptr<StateSnapshot> snapshot,
+    std::vector<std::shared_ptr<HistoryArchive>> const& archives)
     : Work(app, parent,
            fmt::format("publish-{:08x}", snapshot->mLocalState.currentLedger))
     , mSnapshot(snapshot)
-    , mOriginalBuckets(mSnapshot->mLocalState.allBuckets())
+    , mArchives(archives)
 {
 }
 
@@ -30,6 +36,12 @@ PublishWork::~PublishWork()
     clearChildren();
 }
 
+void
+PublishWork::addArchive(std::shared_ptr<HistoryArchive> archive)
+{
+    mArchives.push_back(archive);
+}
+
 std::string
 PublishWork::getStatus() const
 {
@@ -43,9 +55,9 @@ PublishWork::getStatus() const
         {
             return mWriteSnapshotWork->getStatus();
         }
-        else if (mUpdateArchivesWork)
+        else if (mCompressSnapshotWork)
         {
-            return mUpdateArchivesWork->getStatus();
+            return mCompressSnapshotWork->getStatus();
         }
     }
     return Work::getStatus();
@@ -58,7 +70,7 @@ PublishWork::onReset()
 
     mResolveSnapshotWork.reset();
     mWriteSnapshotWork.reset();
-    mUpdateArchivesWork.reset();
+    mCompressSnapshotWork.reset();
 }
 
 Work::State
@@ -78,32 +90,42 @@ PublishWork::onSuccess()
         return WORK_PENDING;
     }
 
-    // Phase 3: update archives
-    if (!mUpdateArchivesWork)
+    // Phase 3: compress snapshot files, once for all archives
+    if (!mCompressSnapshotWork)
     {
-        mUpdateArchivesWork = addWork<Work>("update-archives");
-        for (auto& writableArchive :
-             mApp.getHistoryArchiveManager().getWritableHistoryArchives())
+        mCompressSnapshotWork = addWork<Work>("compress-snapshot-files");
+        for (auto const& f :
+             {mSnapshot->mLedgerSnapFile, mSnapshot->mTransactionSnapFile,
+              mSnapshot->mTransactionResultSnapFile,
+              mSnapshot->mSCPHistorySnapFile})
         {
-            mUpdateArchivesWork->addWork<PutSnapshotFilesWork>(writableArchive,
-                                                               mSnapshot);
+            if (fs::exists(f->localPath_nogz()))
+            {
+                mCompressSnapshotWork->addWork<GzipFileWork>(
+                    f->localPath_nogz(), true);
+            }
         }
         return WORK_PENDING;
     }
 
-    // use mOriginalBuckets as mSnapshot->mLocalState.allBuckets() could change
-    // in meantime
-    mApp.getHistoryManager().historyPublished(
-        mSnapshot->mLocalState.currentLedger, mOriginalBuckets, true);
+    // Phase 4: update archives, each on its own so that they neither wait for
+    // nor fail with one another
+    auto& wm = mApp.getWorkManager();
+    for (auto const& archive : mArchives)
+    {
+        wm.addWork<PutSnapshotFilesWork>(archive, mSnapshot);
+    }
+    wm.advanceChildren();
     return WORK_SUCCESS;
 }
 
 void
 PublishWork::onFailureRaise()
 {
-    // use mOriginalBuckets as mSnapshot->mLocalState.allBuckets() could change
-    // in meantime
-    mApp.getHistoryManager().historyPublished(
-        mSnapshot->mLocalState.currentLedger, mOriginalBuckets, false);
+    for (auto const& archive : mArchives)
+    {
+        mApp.getHistoryManager().historyPublished(
+            archive->getName(), mSnapshot->mLocalState.currentLedger, false);
+    }
 }
 }
@@ -5,25 +5,39 @@
 #pragma once
 
 #include "work/Work.h"
+#include <vector>
 
 namespace stellar
 {
 
+class HistoryArchive;
 struct StateSnapshot;
 
+/**
+ * PublishWork prepares the snapshot of one checkpoint -- resolving its
+ * buckets, writing and compressing its history blocks -- once, and then starts
+ * an independent PutSnapshotFilesWork for each archive it is published to.
+ * Each of those reports back to the HistoryManager on its own, so one slow or
+ * failing archive does not hold up the upload to the others.
+ */
 class PublishWork : public Work
 {
     std::shared_ptr<StateSnapshot> mSnapshot;
-    std::vector<std::string> mOriginalBuckets;
+    std::vector<std::shared_ptr<HistoryArchive>> mArchives;
 
     std::shared_ptr<Work> mResolveSnapshotWork;
     std::shared_ptr<Work> mWriteSnapshotWork;
-    std::shared_ptr<Work> mUpdateArchivesWork;
+    std::shared_ptr<Work> mCompressSnapshotWork;
 
   public:
     PublishWork(Application& app, WorkParent& parent,
-                std::shared_ptr<StateSnapshot> snapshot);
+                std::shared_ptr<StateSnapshot> snapshot,
+                std::vector<std::shared_ptr<HistoryArchive>> const& archives);
     ~PublishWork();
+
+    // Also publish the snapshot to `archive` once it is written.
+    void addArchive(std::shared_ptr<HistoryArchive> archive);
+
     std::string getStatus() const override;
     void onReset() override;
     void onFailureRaise() override;
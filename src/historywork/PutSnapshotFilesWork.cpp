@@ -5,6 +5,7 @@
 #include "historywork/PutSnapshotFilesWork.h"
 #include "bucket/BucketManager.h"
 #include "history/FileTransferInfo.h"
+#include "history/HistoryManager.h"
 #include "history/StateSnapshot.h"
 #include "historywork/GetHistoryArchiveStateWork.h"
 #include "historywork/GzipFileWork.h"
@@ -57,10 +58,29 @@ PutSnapshotFilesWork::onSuccess()
     {
         mPutFilesWork = addWork<Work>("put-files");
 
-        std::vector<std::shared_ptr<FileTransferInfo>> files = {
-            mSnapshot->mLedgerSnapFile, mSnapshot->mTransactionSnapFile,
-            mSnapshot->mTransactionResultSnapFile,
-            mSnapshot->mSCPHistorySnapFile};
+        auto putFile = [&](std::shared_ptr<FileTransferInfo> f, bool gzip) {
+            auto put = mPutFilesWork->addWork<PutRemoteFileWork>(
+                f->localPath_gz(), f->remoteName(), mArchive);
+            auto mkdir =
+                put->addWork<MakeRemoteDirWork>(f->remoteDir(), mArchive);
+            if (gzip)
+            {
+                mkdir->addWork<GzipFileWork>(f->localPath_nogz(), true);
+            }
+        };
+
+        // PublishWork has already compressed the history blocks, once for
+        // every archive; which buckets to send depends on this archive.
+        for (auto const& f :
+             {mSnapshot->mLedgerSnapFile, mSnapshot->mTransactionSnapFile,
+              mSnapshot->mTransactionResultSnapFile,
+              mSnapshot->mSCPHistorySnapFile})
+        {
+            if (fs::exists(f->localPath_nogz()))
+            {
+                putFile(f, !fs::exists(f->localPath_gz()));
+            }
+        }
 
         std::vector<std::string> bucketsToSend =
             mSnapshot->mLocalState.differingBuckets(mRemoteState);
@@ -69,17 +89,10 @@ PutSnapshotFilesWork::onSuccess()
         {
             auto b = mApp.getBucketManager().getBucketByHash(hexToBin256(hash));
             assert(b);
-            files.push_back(std::make_shared<FileTransferInfo>(*b));
-        }
-        for (auto f : files)
-        {
-            if (f && fs::exists(f->localPath_nogz()))
+            auto f = std::make_shared<FileTransferInfo>(*b);
+            if (fs::exists(f->localPath_nogz()))
             {
-                auto put = mPutFilesWork->addWork<PutRemoteFileWork>(
-                    f->localPath_gz(), f->remoteName(), mArchive);
-                auto mkdir =
-                    put->addWork<MakeRemoteDirWork>(f->remoteDir(), mArchive);
-                mkdir->addWork<GzipFileWork>(f->localPath_nogz(), true);
+                putFile(f, true);
             }
         }
         return WORK_PENDING;
@@ -93,6 +106,15 @@ PutSnapshotFilesWork::onSuccess()
         return WORK_PENDING;
     }
 
+    mApp.getHistoryManager().historyPublished(
+        mArchive->getName(), mSnapshot->mLocalState.currentLedger, true);
     return WORK_SUCCESS;
 }
+
+void
+PutSnapshotFilesWork::onFailureRaise()
+{
+    mApp.getHistoryManager().historyPublished(
+        mArchive->getName(), mSnapshot->mLocalState.currentLedger, false);
+}
 }
@@ -28,6 +28,7 @@ class PutSnapshotFilesWork : public Work
                          std::shared_ptr<StateSnapshot> snapshot);
     ~PutSnapshotFilesWork();
     void onReset() override;
+    void onFailureRaise() override;
     Work::State onSuccess() override;
 };
 }
@@ -6,6 +6,9 @@
 #include "bucket/BucketManager.h"
 #include "crypto/Hex.h"
 #include "crypto/SHA.h"
+#include "history/FileTransferInfo.h"
+#include "history/HistoryArchiveManager.h"
+#include "history/HistoryFileCache.h"
 #include "main/Application.h"
 #include "util/Fs.h"
 #include "util/Logging.h"
@@ -79,6 +82,14 @@ VerifyBucketWork::onStart()
     });
 }
 
+void
+VerifyBucketWork::evictFromCache()
+{
+    auto remote = fs::remoteName(HISTORY_FILE_TYPE_BUCKET, binToHex(mHash),
+                                 "xdr.gz");
+    mApp.getHistoryArchiveManager().getFileCache().remove(remote);
+}
+
 void
 VerifyBucketWork::onRun()
 {
@@ -98,6 +109,7 @@ void
 VerifyBucketWork::onFailureRetry()
 {
     mVerifyBucketFailure.Mark();
+    evictFromCache();
     Work::onFailureRetry();
 }
 
@@ -105,6 +117,7 @@ void
 VerifyBucketWork::onFailureRaise()
 {
     mVerifyBucketFailure.Mark();
+    evictFromCache();
     Work::onFailureRaise();
 }
 }
@@ -26,6 +26,8 @@ class VerifyBucketWork : public Work
     medida::Meter& mVerifyBucketSuccess;
     medida::Meter& mVerifyBucketFailure;
 
+    void evictFromCache();
+
   public:
     VerifyBucketWork(Application& app, WorkParent& parent,
                      std::map<std::string, std::shared_ptr<Bucket>>& buckets,
@@ -31,6 +31,8 @@ class AccountSubEntriesCountIsValid : public Invariant
                           OperationResult const& result,
                           LedgerDelta const& delta) override;
 
+    virtual bool checksOnlyDelta() const override;
+
   private:
     struct SubEntriesChange
     {
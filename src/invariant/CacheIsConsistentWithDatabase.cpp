@@ -35,17 +35,32 @@ CacheIsConsistentWithDatabase::checkOnOperationApply(
     Operation const& operation, OperationResult const& result,
     LedgerDelta const& delta)
 {
-    for (auto const& l : delta.getLiveEntries())
+    return checkAgainstDatabase(delta.getLiveEntries(), delta.getDeadEntries(),
+                                mDb);
+}
+
+bool
+CacheIsConsistentWithDatabase::readsDatabase() const
+{
+    return true;
+}
+
+std::string
+CacheIsConsistentWithDatabase::checkAgainstDatabase(
+    std::vector<LedgerEntry> const& live, std::vector<LedgerKey> const& dead,
+    Database& db)
+{
+    for (auto const& l : live)
     {
-        auto s = EntryFrame::checkAgainstDatabase(l, mDb);
+        auto s = EntryFrame::checkAgainstDatabase(l, db);
         if (!s.empty())
         {
             return s;
         }
     }
-    for (auto const& d : delta.getDeadEntries())
+    for (auto const& d : dead)
     {
-        if (EntryFrame::exists(mDb, d))
+        if (EntryFrame::exists(db, d))
         {
             return fmt::format(
                 "Inconsistent state; entry should not exist in database: {}",
@@ -36,6 +36,13 @@ class CacheIsConsistentWithDatabase : public Invariant
                           OperationResult const& result,
                           LedgerDelta const& delta) override;
 
+    virtual bool readsDatabase() const override;
+
+    virtual std::string
+    checkAgainstDatabase(std::vector<LedgerEntry> const& live,
+                         std::vector<LedgerKey> const& dead,
+                         Database& db) override;
+
   private:
     Database& mDb;
 };
@@ -7,6 +7,7 @@
 #include "invariant/InvariantDoesNotHold.h"
 #include "invariant/InvariantManager.h"
 #include "ledger/LedgerDelta.h"
+#include "ledger/LedgerManager.h"
 #include "ledger/LedgerTestUtils.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
@@ -168,3 +169,51 @@ TEST_CASE("Check cache is consistent", "[invariant][cacheisconsistent]")
         }
     }
 }
+
+TEST_CASE("Check cache is consistent with a database snapshot",
+          "[invariant][cacheisconsistent]")
+{
+    VirtualClock clock;
+    Config cfg = getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE);
+    cfg.INVARIANT_CHECKS = {"CacheIsConsistentWithDatabase"};
+    cfg.INVARIANT_CHECKS_ASYNC = true;
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto& im = app->getInvariantManager();
+
+    // the snapshot is only compared with the ledger it was taken after
+    LedgerHeader lh(app->getLedgerManager().getLastClosedLedgerHeader().header);
+    LedgerDelta ld(lh, app->getDatabase(), false);
+    std::map<LedgerKey, LedgerEntry> liveEntries;
+    std::default_random_engine gen;
+    OperationResult res;
+
+    SECTION("consistent")
+    {
+        LedgerDelta opDelta(ld);
+        generateLedger(*app, opDelta, liveEntries, lh.ledgerSeq, 10, gen);
+        REQUIRE_NOTHROW(im.checkOnOperationApply({}, res, opDelta));
+        opDelta.commit();
+
+        im.checkOnLedgerCommit(ld);
+        REQUIRE_NOTHROW(im.waitForPendingChecks());
+    }
+    SECTION("inconsistent")
+    {
+        {
+            soci::transaction sqlTx(app->getDatabase().getSession());
+            LedgerDelta opDelta(ld);
+            generateLedger(*app, opDelta, liveEntries, lh.ledgerSeq, 10, gen);
+            // not compared with the database until the ledger commits
+            REQUIRE_NOTHROW(im.checkOnOperationApply({}, res, opDelta));
+            opDelta.commit();
+        }
+
+        im.checkOnLedgerCommit(ld);
+        REQUIRE_THROWS_AS(im.waitForPendingChecks(), InvariantDoesNotHold);
+
+        auto message = im.getJsonInfo()["CacheIsConsistentWithDatabase"]
+                                       ["last_failed_with_message"]
+                                           .asString();
+        REQUIRE(message.find("operation") != std::string::npos);
+    }
+}
@@ -28,6 +28,12 @@ ConservationOfLumens::getName() const
     return "ConservationOfLumens";
 }
 
+bool
+ConservationOfLumens::checksOnlyDelta() const
+{
+    return true;
+}
+
 int64_t
 ConservationOfLumens::calculateDeltaBalance(LedgerEntry const* current,
                                             LedgerEntry const* previous) const
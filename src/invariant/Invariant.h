@@ -6,12 +6,16 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace stellar
 {
 
 class Bucket;
+class Database;
 class LedgerDelta;
+struct LedgerEntry;
+struct LedgerKey;
 struct Operation;
 struct OperationResult;
 
@@ -53,5 +57,32 @@ class Invariant
     {
         return std::string{};
     }
+
+    // Returns true if checkOnOperationApply depends on nothing but its
+    // arguments, so that it can be run on a worker thread against a snapshot
+    // of the delta (see INVARIANT_CHECKS_ASYNC).
+    virtual bool
+    checksOnlyDelta() const
+    {
+        return false;
+    }
+
+    // Invariants that compare ledger entries against SQL return true from
+    // readsDatabase and implement checkAgainstDatabase, which is handed the
+    // entries left live or dead by some operations and a database to compare
+    // them with. With INVARIANT_CHECKS_ASYNC it replaces checkOnOperationApply
+    // and is given a read-only snapshot taken when the ledger committed.
+    virtual bool
+    readsDatabase() const
+    {
+        return false;
+    }
+
+    virtual std::string
+    checkAgainstDatabase(std::vector<LedgerEntry> const& live,
+                         std::vector<LedgerKey> const& dead, Database& db)
+    {
+        return std::string{};
+    }
 };
 }
@@ -44,6 +44,14 @@ class InvariantManager
                                        OperationResult const& opres,
                                        LedgerDelta const& delta) = 0;
 
+    // Called once the SQL transaction of a ledger close has committed, with
+    // the committed delta of that ledger. With INVARIANT_CHECKS_ASYNC this
+    // starts the checks deferred by checkOnOperationApply on a worker thread.
+    virtual void checkOnLedgerCommit(LedgerDelta const& ledgerDelta) = 0;
+
+    // Waits for checks running on a worker thread and reports their failures.
+    virtual void waitForPendingChecks() = 0;
+
     virtual void registerInvariant(std::shared_ptr<Invariant> invariant) = 0;
 
     virtual void enableInvariant(std::string const& name) = 0;
@@ -2,21 +2,25 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "util/asio.h"
 #include "invariant/InvariantManagerImpl.h"
 #include "bucket/Bucket.h"
 #include "bucket/BucketList.h"
 #include "crypto/Hex.h"
+#include "database/Database.h"
 #include "invariant/Invariant.h"
 #include "invariant/InvariantDoesNotHold.h"
 #include "invariant/InvariantManagerImpl.h"
 #include "ledger/LedgerDelta.h"
 #include "lib/util/format.h"
 #include "main/Application.h"
+#include "main/Config.h"
 #include "util/Logging.h"
 #include "xdrpp/printer.h"
 
 #include "medida/counter.h"
 #include "medida/metrics_registry.h"
+#include "medida/timer.h"
 
 #include <memory>
 #include <numeric>
@@ -25,14 +29,31 @@
 namespace stellar
 {
 
+namespace
+{
+std::string
+operationFailure(Invariant const& invariant, uint32_t ledger,
+                 std::string const& result, Operation const& operation)
+{
+    return fmt::format(
+        R"(Invariant "{}" does not hold on ledger {} operation: {}{}{})",
+        invariant.getName(), ledger, result, "\n",
+        xdr::xdr_to_string(operation));
+}
+}
+
 std::unique_ptr<InvariantManager>
 InvariantManager::create(Application& app)
 {
-    return std::make_unique<InvariantManagerImpl>(app.getMetrics());
+    return std::make_unique<InvariantManagerImpl>(app);
 }
 
-InvariantManagerImpl::InvariantManagerImpl(medida::MetricsRegistry& registry)
-    : mMetricsRegistry(registry)
+InvariantManagerImpl::InvariantManagerImpl(Application& app)
+    : mApp(app)
+    , mMetricsRegistry(app.getMetrics())
+    , mDeferredCheckTime(
+          app.getMetrics().NewTimer({"invariant", "deferred-check", "time"}))
+    , mDeferredLedger(0)
 {
 }
 
@@ -101,13 +122,24 @@ InvariantManagerImpl::checkOnOperationApply(Operation const& operation,
                                             OperationResult const& opres,
                                             LedgerDelta const& delta)
 {
-    if (delta.getHeader().ledgerVersion < 8)
+    auto const& header = delta.getHeader();
+    if (header.ledgerVersion < 8)
     {
         return;
     }
 
+    // checks run during ledger close always run; only deferred ones are
+    // sampled
+    bool sampled = shouldCheckLedger(header.ledgerSeq);
+    bool deferred = false;
     for (auto invariant : mEnabled)
     {
+        if (isDeferred(*invariant))
+        {
+            deferred = deferred || sampled;
+            continue;
+        }
+
         auto result = invariant->checkOnOperationApply(operation, opres, delta);
         if (result.empty())
         {
@@ -117,8 +149,280 @@ InvariantManagerImpl::checkOnOperationApply(Operation const& operation,
         auto message = fmt::format(
             R"(Invariant "{}" does not hold on operation: {}{}{})",
             invariant->getName(), result, "\n", xdr::xdr_to_string(operation));
-        onInvariantFailure(invariant, message, delta.getHeader().ledgerSeq);
+        onInvariantFailure(invariant, message, header.ledgerSeq);
+    }
+
+    if (deferred)
+    {
+        // operations left over from a ledger that failed to close are dropped
+        if (mDeferredLedger != header.ledgerSeq)
+        {
+            mDeferred.clear();
+            mDeferredLedger = header.ledgerSeq;
+        }
+        mDeferred.push_back({operation, opres, delta.snapshot()});
+    }
+}
+
+void
+InvariantManagerImpl::checkOnLedgerCommit(LedgerDelta const& ledgerDelta)
+{
+    auto const& header = ledgerDelta.getHeader();
+    std::vector<DeferredOperation> operations;
+    if (mDeferredLedger == header.ledgerSeq)
+    {
+        operations.swap(mDeferred);
+    }
+    mDeferred.clear();
+    mDeferredLedger = 0;
+
+    std::vector<std::shared_ptr<Invariant>> invariants;
+    bool readsDatabase = false;
+    for (auto const& invariant : mEnabled)
+    {
+        if (isDeferred(*invariant))
+        {
+            invariants.push_back(invariant);
+            readsDatabase = readsDatabase || invariant->readsDatabase();
+        }
+    }
+    // the database is compared against the whole ledger, so it is checked
+    // even if no operation was deferred (for example when all of them failed)
+    bool checkDatabase = readsDatabase && header.ledgerVersion >= 8 &&
+                         shouldCheckLedger(header.ledgerSeq);
+    if (operations.empty() && !checkDatabase)
+    {
+        return;
+    }
+
+    // Only one ledger is checked at a time: if checking falls behind, ledger
+    // close waits here rather than letting deferred work pile up.
+    waitForPendingChecks();
+
+    std::shared_ptr<soci::transaction> snapshotTx;
+    std::vector<LedgerEntry> live;
+    std::vector<LedgerKey> dead;
+    if (checkDatabase)
+    {
+        snapshotTx = openSnapshot(header.ledgerSeq);
+        if (snapshotTx)
+        {
+            live = ledgerDelta.getLiveEntries();
+            dead = ledgerDelta.getDeadEntries();
+        }
+    }
+
+    auto ledger = header.ledgerSeq;
+    auto snapshot = snapshotTx ? mSnapshotDatabase.get() : nullptr;
+    auto task =
+        std::make_shared<std::packaged_task<std::vector<DeferredFailure>()>>(
+            [ledger, operations = std::move(operations), invariants,
+             live = std::move(live), dead = std::move(dead), snapshot,
+             snapshotTx]() {
+                auto failures = runDeferredChecks(ledger, operations,
+                                                  invariants, live, dead,
+                                                  snapshot);
+                if (snapshotTx)
+                {
+                    snapshotTx->rollback();
+                }
+                return failures;
+            });
+    mPendingChecks = task->get_future();
+    mApp.getWorkerIOService().post([this, task]() {
+        {
+            auto timer = mDeferredCheckTime.TimeScope();
+            (*task)();
+        }
+        mApp.postOnMainThread([this]() { reportFinishedChecks(); });
+    });
+}
+
+void
+InvariantManagerImpl::waitForPendingChecks()
+{
+    if (mPendingChecks.valid())
+    {
+        mPendingChecks.wait();
+        reportFinishedChecks();
+    }
+}
+
+bool
+InvariantManagerImpl::shouldCheckLedger(uint32_t ledger) const
+{
+    // 61 is coprime with 100, so any 100 consecutive ledgers are spread over
+    // all residues and the sampled ones are evenly spaced among them
+    return (uint64_t(ledger) * 61) % 100 <
+           mApp.getConfig().INVARIANT_CHECKS_SAMPLE_PERCENT;
+}
+
+bool
+InvariantManagerImpl::isDeferred(Invariant const& invariant) const
+{
+    if (!mApp.getConfig().INVARIANT_CHECKS_ASYNC)
+    {
+        return false;
+    }
+    return invariant.checksOnlyDelta() ||
+           (invariant.readsDatabase() && mApp.getDatabase().canUsePool());
+}
+
+std::shared_ptr<soci::transaction>
+InvariantManagerImpl::openSnapshot(uint32_t ledger)
+{
+    if (!mSnapshotDatabase)
+    {
+        // counted apart so the main database's meter, which LoadManager
+        // charges to peers, only sees ledger close and overlay queries
+        mSnapshotDatabase = std::make_unique<Database>(mApp, "invariant");
+    }
+
+    auto& sess = mSnapshotDatabase->getSession();
+    auto tx = std::make_shared<soci::transaction>(sess);
+    mSnapshotDatabase->setCurrentTransactionReadOnly();
+
+    // the first read of the transaction fixes the snapshot, which must be the
+    // ledger that just committed
+    uint32_t lastLedger = 0;
+    sess << "SELECT MAX(ledgerseq) FROM ledgerheaders", soci::into(lastLedger);
+    if (lastLedger != ledger)
+    {
+        CLOG(WARNING, "Invariant")
+            << "Database snapshot is at ledger " << lastLedger
+            << " instead of " << ledger << ", not checking it";
+        tx->rollback();
+        return nullptr;
     }
+
+    mSnapshotDatabase->getEntryCache().clear();
+    return tx;
+}
+
+void
+InvariantManagerImpl::reportFinishedChecks()
+{
+    if (!mPendingChecks.valid() ||
+        mPendingChecks.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready)
+    {
+        return;
+    }
+
+    auto failures = mPendingChecks.get();
+    for (auto const& f : failures)
+    {
+        onInvariantFailure(f.invariant, f.message, f.ledger);
+    }
+}
+
+std::vector<InvariantManagerImpl::DeferredFailure>
+InvariantManagerImpl::runDeferredChecks(
+    uint32_t ledger, std::vector<DeferredOperation> const& operations,
+    std::vector<std::shared_ptr<Invariant>> const& invariants,
+    std::vector<LedgerEntry> const& live, std::vector<LedgerKey> const& dead,
+    Database* snapshot)
+{
+    std::vector<DeferredFailure> failures;
+    try
+    {
+        for (auto const& op : operations)
+        {
+            for (auto const& invariant : invariants)
+            {
+                if (!invariant->checksOnlyDelta())
+                {
+                    continue;
+                }
+                auto result = invariant->checkOnOperationApply(
+                    op.operation, op.result, *op.delta);
+                if (result.empty())
+                {
+                    continue;
+                }
+
+                failures.push_back(
+                    {invariant,
+                     operationFailure(*invariant, ledger, result, op.operation),
+                     ledger});
+            }
+        }
+
+        if (!snapshot)
+        {
+            return failures;
+        }
+
+        // Compare the final state of each entry with the snapshot, grouped by
+        // the last operation that changed it so that a failure names it;
+        // entries only changed outside of operations (fees, upgrades) form
+        // the group at operations.size().
+        std::map<LedgerKey, size_t, LedgerEntryIdCmp> lastChange;
+        for (size_t i = 0; i < operations.size(); ++i)
+        {
+            for (auto const& e : operations[i].delta->getLiveEntries())
+            {
+                lastChange[LedgerEntryKey(e)] = i;
+            }
+            for (auto const& k : operations[i].delta->getDeadEntries())
+            {
+                lastChange[k] = i;
+            }
+        }
+        auto groupOf = [&](LedgerKey const& k) {
+            auto it = lastChange.find(k);
+            return it == lastChange.end() ? operations.size() : it->second;
+        };
+
+        std::map<size_t,
+                 std::pair<std::vector<LedgerEntry>, std::vector<LedgerKey>>>
+            groups;
+        for (auto const& e : live)
+        {
+            groups[groupOf(LedgerEntryKey(e))].first.push_back(e);
+        }
+        for (auto const& k : dead)
+        {
+            groups[groupOf(k)].second.push_back(k);
+        }
+
+        for (auto const& g : groups)
+        {
+            for (auto const& invariant : invariants)
+            {
+                if (!invariant->readsDatabase())
+                {
+                    continue;
+                }
+                auto result = invariant->checkAgainstDatabase(
+                    g.second.first, g.second.second, *snapshot);
+                if (result.empty())
+                {
+                    continue;
+                }
+
+                std::string message;
+                if (g.first < operations.size())
+                {
+                    message = operationFailure(*invariant, ledger, result,
+                                               operations[g.first].operation);
+                }
+                else
+                {
+                    message = fmt::format(
+                        R"(Invariant "{}" does not hold on ledger {}: {})",
+                        invariant->getName(), ledger, result);
+                }
+                failures.push_back({invariant, message, ledger});
+            }
+        }
+    }
+    catch (std::exception& e)
+    {
+        CLOG(ERROR, "Invariant") << "Could not check ledger " << ledger
+                                 << " in the background: " << e.what();
+    }
+    return failures;
 }
 
 void
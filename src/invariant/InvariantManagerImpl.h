@@ -5,22 +5,33 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "invariant/InvariantManager.h"
+#include <future>
 #include <map>
 #include <vector>
 
 namespace medida
 {
 class MetricsRegistry;
+class Timer;
+}
+
+namespace soci
+{
+class transaction;
 }
 
 namespace stellar
 {
 
+class Database;
+
 class InvariantManagerImpl : public InvariantManager
 {
+    Application& mApp;
     std::map<std::string, std::shared_ptr<Invariant>> mInvariants;
     std::vector<std::shared_ptr<Invariant>> mEnabled;
     medida::MetricsRegistry& mMetricsRegistry;
+    medida::Timer& mDeferredCheckTime;
 
     struct InvariantFailureInformation
     {
@@ -29,8 +40,32 @@ class InvariantManagerImpl : public InvariantManager
     };
     std::map<std::string, InvariantFailureInformation> mFailureInformation;
 
+    // With INVARIANT_CHECKS_ASYNC, the operations of the ledger being closed
+    // are kept here, each with a snapshot of its delta, until the ledger
+    // commits and they are checked on a worker thread. Failures found there
+    // are handed back through mPendingChecks.
+    struct DeferredOperation
+    {
+        Operation operation;
+        OperationResult result;
+        std::shared_ptr<LedgerDelta const> delta;
+    };
+    struct DeferredFailure
+    {
+        std::shared_ptr<Invariant> invariant;
+        std::string message;
+        uint32_t ledger;
+    };
+    uint32_t mDeferredLedger;
+    std::vector<DeferredOperation> mDeferred;
+    std::future<std::vector<DeferredFailure>> mPendingChecks;
+
+    // Second connection, only ever used by one check at a time, through which
+    // readsDatabase() invariants see the database as of a ledger commit.
+    std::unique_ptr<Database> mSnapshotDatabase;
+
   public:
-    InvariantManagerImpl(medida::MetricsRegistry& registry);
+    InvariantManagerImpl(Application& app);
 
     virtual Json::Value getJsonInfo() override;
 
@@ -40,6 +75,10 @@ class InvariantManagerImpl : public InvariantManager
                                        OperationResult const& opres,
                                        LedgerDelta const& delta) override;
 
+    virtual void checkOnLedgerCommit(LedgerDelta const& ledgerDelta) override;
+
+    virtual void waitForPendingChecks() override;
+
     virtual void checkOnBucketApply(std::shared_ptr<Bucket const> bucket,
                                     uint32_t ledger, uint32_t level,
                                     bool isCurr) override;
@@ -50,6 +89,18 @@ class InvariantManagerImpl : public InvariantManager
     virtual void enableInvariant(std::string const& name) override;
 
   private:
+    bool shouldCheckLedger(uint32_t ledger) const;
+    bool isDeferred(Invariant const& invariant) const;
+
+    std::shared_ptr<soci::transaction> openSnapshot(uint32_t ledger);
+    void reportFinishedChecks();
+
+    static std::vector<DeferredFailure> runDeferredChecks(
+        uint32_t ledger, std::vector<DeferredOperation> const& operations,
+        std::vector<std::shared_ptr<Invariant>> const& invariants,
+        std::vector<LedgerEntry> const& live,
+        std::vector<LedgerKey> const& dead, Database* snapshot);
+
     void onInvariantFailure(std::shared_ptr<Invariant> invariant,
                             std::string const& message, uint32_t ledger);
 
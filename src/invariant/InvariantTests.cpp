@@ -72,6 +72,18 @@ class TestInvariant : public Invariant
     int mInvariantID;
     bool mShouldFail;
 };
+
+class TestDeltaOnlyInvariant : public TestInvariant
+{
+  public:
+    using TestInvariant::TestInvariant;
+
+    virtual bool
+    checksOnlyDelta() const override
+    {
+        return true;
+    }
+};
 }
 
 using namespace InvariantTests;
@@ -213,3 +225,95 @@ TEST_CASE("onOperationApply fail/succeed", "[invariant]")
             app->getInvariantManager().checkOnOperationApply({}, res, ld));
     }
 }
+
+TEST_CASE("onOperationApply deferred to ledger commit", "[invariant]")
+{
+    VirtualClock clock;
+    Config cfg = getTestConfig();
+    cfg.INVARIANT_CHECKS = {};
+    cfg.INVARIANT_CHECKS_ASYNC = true;
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    OperationResult res;
+    LedgerHeader lh(app->getLedgerManager().getCurrentLedgerHeader());
+    LedgerDelta ld(lh, app->getDatabase());
+
+    auto& im = app->getInvariantManager();
+    SECTION("Fail")
+    {
+        im.registerInvariant<TestDeltaOnlyInvariant>(0, true);
+        im.enableInvariant(TestInvariant::toString(0, true));
+        REQUIRE_NOTHROW(im.checkOnOperationApply({}, res, ld));
+        im.checkOnLedgerCommit(ld);
+        REQUIRE_THROWS_AS(im.waitForPendingChecks(), InvariantDoesNotHold);
+
+        auto info = im.getJsonInfo()[TestInvariant::toString(0, true)];
+        REQUIRE(info["last_failed_on_ledger"].asUInt() == lh.ledgerSeq);
+    }
+    SECTION("Succeed")
+    {
+        im.registerInvariant<TestDeltaOnlyInvariant>(0, false);
+        im.enableInvariant(TestInvariant::toString(0, false));
+        REQUIRE_NOTHROW(im.checkOnOperationApply({}, res, ld));
+        im.checkOnLedgerCommit(ld);
+        REQUIRE_NOTHROW(im.waitForPendingChecks());
+    }
+    SECTION("Dropped if the ledger does not commit")
+    {
+        im.registerInvariant<TestDeltaOnlyInvariant>(0, true);
+        im.enableInvariant(TestInvariant::toString(0, true));
+        REQUIRE_NOTHROW(im.checkOnOperationApply({}, res, ld));
+
+        LedgerHeader nextLh(lh);
+        nextLh.ledgerSeq++;
+        LedgerDelta nextLd(nextLh, app->getDatabase());
+        im.checkOnLedgerCommit(nextLd);
+        REQUIRE_NOTHROW(im.waitForPendingChecks());
+    }
+}
+
+TEST_CASE("onOperationApply sampled ledgers", "[invariant]")
+{
+    VirtualClock clock;
+    Config cfg = getTestConfig();
+    cfg.INVARIANT_CHECKS = {};
+    cfg.INVARIANT_CHECKS_ASYNC = true;
+    cfg.INVARIANT_CHECKS_SAMPLE_PERCENT = 10;
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto& im = app->getInvariantManager();
+
+    OperationResult res;
+    LedgerHeader lh(app->getLedgerManager().getCurrentLedgerHeader());
+    auto countFailures = [&]() {
+        int failed = 0;
+        for (uint32_t seq = 1000; seq < 1100; ++seq)
+        {
+            lh.ledgerSeq = seq;
+            LedgerDelta ld(lh, app->getDatabase());
+            try
+            {
+                im.checkOnOperationApply({}, res, ld);
+                im.checkOnLedgerCommit(ld);
+                im.waitForPendingChecks();
+            }
+            catch (InvariantDoesNotHold&)
+            {
+                ++failed;
+            }
+        }
+        return failed;
+    };
+
+    SECTION("Synchronous checks are not sampled")
+    {
+        im.registerInvariant<TestInvariant>(0, true);
+        im.enableInvariant(TestInvariant::toString(0, true));
+        REQUIRE(countFailures() == 100);
+    }
+    SECTION("Deferred checks are sampled")
+    {
+        im.registerInvariant<TestDeltaOnlyInvariant>(0, true);
+        im.enableInvariant(TestInvariant::toString(0, true));
+        REQUIRE(countFailures() == 10);
+    }
+}
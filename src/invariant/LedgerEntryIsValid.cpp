@@ -28,6 +28,12 @@ LedgerEntryIsValid::getName() const
     return "LedgerEntryIsValid";
 }
 
+bool
+LedgerEntryIsValid::checksOnlyDelta() const
+{
+    return true;
+}
+
 std::string
 LedgerEntryIsValid::checkOnOperationApply(Operation const& operation,
                                           OperationResult const& result,
@@ -32,6 +32,8 @@ class LedgerEntryIsValid : public Invariant
                           OperationResult const& result,
                           LedgerDelta const& delta) override;
 
+    virtual bool checksOnlyDelta() const override;
+
   private:
     template <typename IterType>
     std::string check(IterType iter, IterType const& end, uint32_t ledgerSeq,
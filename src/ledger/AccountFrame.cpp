@@ -52,6 +52,17 @@ const char* AccountFrame::kSQLCreateStatement4 = "CREATE INDEX accountbalances "
                                                  "ON accounts (balance) WHERE "
                                                  "balance >= 1000000000";
 
+// Sum of the balances voting for each inflation destination, as counted by
+// processForInflation: only accounts holding at least 100 XLM vote.
+static const char* kSQLCreateInflationVotes =
+    "CREATE TABLE inflationvotes"
+    "("
+    "inflationdest   VARCHAR(56)  PRIMARY KEY,"
+    "votes           BIGINT       NOT NULL CHECK (votes >= 0)"
+    ");";
+
+static const int64_t kMinInflationVoteBalance = 1000000000;
+
 AccountFrame::AccountFrame()
     : EntryFrame(ACCOUNT), mAccountEntry(mEntry.data.account())
 {
@@ -356,12 +367,21 @@ AccountFrame::loadAccount(AccountID const& accountID, Database& db)
     AccountFrame::pointer res = make_shared<AccountFrame>(accountID);
     AccountEntry& account = res->getAccount();
 
-    auto prep =
-        db.getPreparedStatement("SELECT balance, seqnum, numsubentries, "
-                                "inflationdest, homedomain, thresholds, "
-                                "flags, lastmodified, buyingliabilities, "
-                                "sellingliabilities "
-                                "FROM accounts WHERE accountid=:v1");
+    // The signers are joined in so that an account is loaded in a single
+    // round trip: one row per signer, or a single row with NULL signer
+    // columns if the account has none.
+    std::string signerStrKey;
+    Signer signer;
+    soci::indicator signerInd, weightInd;
+    std::vector<Signer> signers;
+
+    auto prep = db.getPreparedStatement(
+        "SELECT balance, seqnum, numsubentries, inflationdest, homedomain, "
+        "thresholds, flags, lastmodified, buyingliabilities, "
+        "sellingliabilities, signers.publickey, signers.weight "
+        "FROM accounts LEFT OUTER JOIN signers "
+        "ON signers.accountid = accounts.accountid "
+        "WHERE accounts.accountid=:v1");
     auto& st = prep.statement();
     st.exchange(into(account.balance));
     st.exchange(into(account.seqNum));
@@ -373,16 +393,27 @@ AccountFrame::loadAccount(AccountID const& accountID, Database& db)
     st.exchange(into(res->getLastModified()));
     st.exchange(into(liabilities.buying, buyingLiabilitiesInd));
     st.exchange(into(liabilities.selling, sellingLiabilitiesInd));
+    st.exchange(into(signerStrKey, signerInd));
+    st.exchange(into(signer.weight, weightInd));
     st.exchange(use(actIDStrKey));
     st.define_and_bind();
     {
         auto timer = db.getSelectTimer("account");
         st.execute(true);
-    }
-    if (!st.got_data())
-    {
-        putCachedEntry(key, nullptr, db);
-        return nullptr;
+        if (!st.got_data())
+        {
+            putCachedEntry(key, nullptr, db);
+            return nullptr;
+        }
+        while (st.got_data())
+        {
+            if (signerInd == soci::i_ok)
+            {
+                signer.key = KeyUtils::fromStrKey<SignerKey>(signerStrKey);
+                signers.push_back(signer);
+            }
+            st.fetch();
+        }
     }
 
     account.homeDomain = homeDomain;
@@ -396,14 +427,10 @@ AccountFrame::loadAccount(AccountID const& accountID, Database& db)
             KeyUtils::fromStrKey<PublicKey>(inflationDest);
     }
 
+    std::sort(signers.begin(), signers.end(), &AccountFrame::signerCompare);
     account.signers.clear();
-
-    if (account.numSubEntries != 0)
-    {
-        auto signers = loadSigners(db, actIDStrKey);
-        account.signers.insert(account.signers.begin(), signers.begin(),
-                               signers.end());
-    }
+    account.signers.insert(account.signers.begin(), signers.begin(),
+                           signers.end());
 
     assert(buyingLiabilitiesInd == sellingLiabilitiesInd);
     if (buyingLiabilitiesInd == soci::i_ok)
@@ -518,6 +545,10 @@ AccountFrame::deleteAccountsModifiedOnOrAfterLedger(Database& db,
         st.define_and_bind();
         st.execute(true);
     }
+    if (db.isTrackingInflationVotes())
+    {
+        rebuildInflationVotes(db);
+    }
 }
 
 void
@@ -530,6 +561,13 @@ void
 AccountFrame::storeDelete(LedgerDelta& delta, Database& db,
                           LedgerKey const& key)
 {
+    delta.prepareStore(key, false);
+
+    EntryFrame::pointer before;
+    if (delta.tracksInflationVotes())
+    {
+        before = delta.loadCurrentEntry(key);
+    }
     flushCachedEntry(key, db);
 
     std::string actIDStrKey = KeyUtils::toStrKey(key.account().accountID);
@@ -551,12 +589,26 @@ AccountFrame::storeDelete(LedgerDelta& delta, Database& db,
         st.define_and_bind();
         st.execute(true);
     }
+    if (before)
+    {
+        updateInflationVotes(delta, &before->mEntry.data.account(), nullptr);
+    }
     delta.deleteEntry(key);
 }
 
 void
 AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
 {
+    delta.prepareStore(getKey(), insert);
+
+    // the votes this account currently gives, to be replaced by its new ones
+    bool trackVotes = delta.tracksInflationVotes();
+    EntryFrame::pointer before;
+    if (trackVotes && !insert)
+    {
+        before = delta.loadCurrentEntry(getKey());
+    }
+
     touch(delta);
 
     flushCachedEntry(db);
@@ -629,6 +681,12 @@ AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
         {
             throw std::runtime_error("Could not update data in SQL");
         }
+        if (trackVotes)
+        {
+            updateInflationVotes(
+                delta, before ? &before->mEntry.data.account() : nullptr,
+                &mAccountEntry);
+        }
         if (insert)
         {
             delta.addEntry(*this);
@@ -779,21 +837,31 @@ AccountFrame::storeAdd(LedgerDelta& delta, Database& db)
 void
 AccountFrame::processForInflation(
     std::function<bool(AccountFrame::InflationVotes const&)> inflationProcessor,
-    int maxWinners, Database& db)
+    int maxWinners, Database& db, bool fromAccounts)
 {
     soci::session& session = db.getSession();
 
     InflationVotes v;
     std::string inflationDest;
 
-    soci::statement st =
-        (session.prepare
-             << "SELECT"
-                " sum(balance) AS votes, inflationdest FROM accounts WHERE"
-                " inflationdest IS NOT NULL"
-                " AND balance >= 1000000000 GROUP BY inflationdest"
-                " ORDER BY votes DESC, inflationdest DESC LIMIT :lim",
-         into(v.mVotes), into(inflationDest), use(maxWinners));
+    std::string sql;
+    if (fromAccounts || !db.isTrackingInflationVotes())
+    {
+        sql = "SELECT"
+              " sum(balance) AS votes, inflationdest FROM accounts WHERE"
+              " inflationdest IS NOT NULL"
+              " AND balance >= 1000000000 GROUP BY inflationdest"
+              " ORDER BY votes DESC, inflationdest DESC LIMIT :lim";
+    }
+    else
+    {
+        sql = "SELECT votes, inflationdest FROM inflationvotes"
+              " WHERE votes > 0"
+              " ORDER BY votes DESC, inflationdest DESC LIMIT :lim";
+    }
+
+    soci::statement st = (session.prepare << sql, into(v.mVotes),
+                          into(inflationDest), use(maxWinners));
 
     st.execute(true);
 
@@ -808,6 +876,142 @@ AccountFrame::processForInflation(
     }
 }
 
+void
+AccountFrame::updateInflationVotes(LedgerDelta& delta,
+                                   AccountEntry const* before,
+                                   AccountEntry const* after)
+{
+    auto votesOf = [](AccountEntry const* a) -> int64_t {
+        if (a && a->inflationDest && a->balance >= kMinInflationVoteBalance)
+        {
+            return a->balance;
+        }
+        return 0;
+    };
+
+    int64_t beforeVotes = votesOf(before);
+    int64_t afterVotes = votesOf(after);
+    if (beforeVotes != 0 && afterVotes != 0 &&
+        *before->inflationDest == *after->inflationDest)
+    {
+        if (beforeVotes != afterVotes)
+        {
+            delta.addInflationVotes(*after->inflationDest,
+                                    afterVotes - beforeVotes);
+        }
+        return;
+    }
+    if (beforeVotes != 0)
+    {
+        delta.addInflationVotes(*before->inflationDest, -beforeVotes);
+    }
+    if (afterVotes != 0)
+    {
+        delta.addInflationVotes(*after->inflationDest, afterVotes);
+    }
+}
+
+void
+AccountFrame::adjustInflationVotes(Database& db, AccountID const& dest,
+                                   int64_t votes)
+{
+    std::string destStrKey = KeyUtils::toStrKey(dest);
+    {
+        auto timer = db.getUpdateTimer("inflationvotes");
+        auto prep = db.getPreparedStatement("UPDATE inflationvotes SET votes = "
+                                            "votes + :v WHERE inflationdest "
+                                            "= :d");
+        auto& st = prep.statement();
+        st.exchange(use(votes));
+        st.exchange(use(destStrKey));
+        st.define_and_bind();
+        st.execute(true);
+        if (st.get_affected_rows() == 1)
+        {
+            return;
+        }
+    }
+    {
+        // first vote for dest; a negative count here means the tally was
+        // already wrong, and the CHECK constraint reports it
+        auto timer = db.getInsertTimer("inflationvotes");
+        auto prep = db.getPreparedStatement("INSERT INTO inflationvotes "
+                                            "(inflationdest, votes) "
+                                            "VALUES (:d, :v)");
+        auto& st = prep.statement();
+        st.exchange(use(destStrKey));
+        st.exchange(use(votes));
+        st.define_and_bind();
+        st.execute(true);
+    }
+}
+
+void
+AccountFrame::rebuildInflationVotes(Database& db)
+{
+    db.getSession() << "DELETE FROM inflationvotes";
+    db.getSession() << "INSERT INTO inflationvotes (inflationdest, votes)"
+                       " SELECT inflationdest, sum(balance) FROM accounts"
+                       " WHERE inflationdest IS NOT NULL"
+                       " AND balance >= 1000000000 GROUP BY inflationdest";
+}
+
+void
+AccountFrame::initializeInflationVotes(Database& db)
+{
+    db.getSession() << "DROP TABLE IF EXISTS inflationvotes;";
+    db.getSession() << kSQLCreateInflationVotes;
+    rebuildInflationVotes(db);
+}
+
+void
+AccountFrame::checkInflationVotes(Database& db)
+{
+    std::map<std::string, int64_t> tally;
+    std::map<std::string, int64_t> scanned;
+    auto loadVotes = [&db](std::string const& sql,
+                           std::map<std::string, int64_t>& votes) {
+        int64_t v;
+        std::string dest;
+        soci::statement st =
+            (db.getSession().prepare << sql, into(v), into(dest));
+        st.execute(true);
+        while (st.got_data())
+        {
+            votes[dest] = v;
+            st.fetch();
+        }
+    };
+    loadVotes("SELECT votes, inflationdest FROM inflationvotes"
+              " WHERE votes > 0",
+              tally);
+    loadVotes("SELECT sum(balance), inflationdest FROM accounts"
+              " WHERE inflationdest IS NOT NULL"
+              " AND balance >= 1000000000 GROUP BY inflationdest",
+              scanned);
+
+    for (auto const& s : scanned)
+    {
+        auto it = tally.find(s.first);
+        int64_t counted = (it == tally.end()) ? 0 : it->second;
+        if (counted != s.second)
+        {
+            throw std::runtime_error(
+                fmt::format("Mismatch in inflation votes for {}: tally says "
+                            "{} but accounts sum to {}",
+                            s.first, counted, s.second));
+        }
+    }
+    for (auto const& t : tally)
+    {
+        if (scanned.find(t.first) == scanned.end())
+        {
+            throw std::runtime_error(fmt::format(
+                "Found extra inflation votes for {}: {}", t.first, t.second));
+        }
+    }
+}
+
 std::unordered_map<AccountID, AccountFrame::pointer>
 AccountFrame::checkDB(Database& db)
 {
@@ -857,6 +1061,11 @@ AccountFrame::checkDB(Database& db)
             st.fetch();
         }
     }
+
+    if (db.isTrackingInflationVotes())
+    {
+        checkInflationVotes(db);
+    }
     return state;
 }
 
@@ -39,6 +39,12 @@ class AccountFrame : public EntryFrame
                                            std::string const& actIDStrKey);
     void applySigners(Database& db, bool insert);
 
+    // moves the votes of `before` to `after` in the inflationvotes tally
+    // through `delta`; either may be null for an account that does not exist
+    static void updateInflationVotes(LedgerDelta& delta,
+                                     AccountEntry const* before,
+                                     AccountEntry const* after);
+
   public:
     typedef std::shared_ptr<AccountFrame> pointer;
 
@@ -154,9 +160,25 @@ class AccountFrame : public EntryFrame
     };
 
     // inflationProcessor returns true to continue processing, false otherwise
+    // votes are read from the inflationvotes tally, which account writes keep
+    // current as their transaction commits; fromAccounts sums the accounts
+    // table instead (slow)
     static void processForInflation(
         std::function<bool(InflationVotes const&)> inflationProcessor,
-        int maxWinners, Database& db);
+        int maxWinners, Database& db, bool fromAccounts = false);
+
+    // adds `votes` to the tally of `dest` in the inflationvotes table
+    static void adjustInflationVotes(Database& db, AccountID const& dest,
+                                     int64_t votes);
+
+    // recomputes the inflationvotes tally from the accounts table
+    static void rebuildInflationVotes(Database& db);
+
+    // (re)creates and fills the inflationvotes tally
+    static void initializeInflationVotes(Database& db);
+
+    // throws if the inflationvotes tally does not match the accounts table
+    static void checkInflationVotes(Database& db);
 
     // loads all accounts from database and checks for consistency (slow!)
     static std::unordered_map<AccountID, AccountFrame::pointer>
@@ -216,6 +216,7 @@ DataFrame::storeDelete(LedgerDelta& delta, Database& db) const
 void
 DataFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
 {
+    delta.prepareStore(key, false);
     std::string actIDStrKey = KeyUtils::toStrKey(key.data().accountID);
     std::string dataName = key.data().dataName;
     auto timer = db.getDeleteTimer("data");
@@ -244,6 +245,7 @@ DataFrame::storeAdd(LedgerDelta& delta, Database& db)
 void
 DataFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
 {
+    delta.prepareStore(getKey(), insert);
     touch(delta);
 
     std::string actIDStrKey = KeyUtils::toStrKey(mData.accountID);
@@ -3,6 +3,8 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "ledger/LedgerDelta.h"
+#include "database/Database.h"
+#include "ledger/AccountFrame.h"
 #include "main/Application.h"
 #include "main/Config.h"
 #include "medida/meter.h"
@@ -13,13 +15,15 @@
 
 namespace stellar
 {
-LedgerDelta::LedgerDelta(LedgerDelta& outerDelta)
+LedgerDelta::LedgerDelta(LedgerDelta& outerDelta, bool undoSQLOnRollback)
     : mOuterDelta(&outerDelta)
     , mHeader(&outerDelta.getHeader())
     , mCurrentHeader(outerDelta.getHeader())
     , mPreviousHeaderValue(outerDelta.getHeader())
     , mDb(outerDelta.mDb)
     , mUpdateLastModified(outerDelta.mUpdateLastModified)
+    , mUndoSQL(undoSQLOnRollback || outerDelta.mUndoSQL)
+    , mTrackInflationVotes(outerDelta.mTrackInflationVotes)
 {
 }
 
@@ -31,6 +35,8 @@ LedgerDelta::LedgerDelta(LedgerHeader& header, Database& db,
     , mPreviousHeaderValue(header)
     , mDb(db)
     , mUpdateLastModified(updateLastModified)
+    , mUndoSQL(false)
+    , mTrackInflationVotes(true)
 {
 }
 
@@ -38,7 +44,9 @@ LedgerDelta::~LedgerDelta()
 {
     if (mHeader)
     {
-        rollback();
+        // never issue SQL from here: writes still to be undone are left to
+        // the explicit rollback of an outer delta
+        discard();
     }
 }
 
@@ -76,6 +84,120 @@ LedgerDelta::checkState()
     }
 }
 
+bool
+LedgerDelta::findCurrentEntry(LedgerKey const& key,
+                              EntryFrame::pointer& entry) const
+{
+    for (auto d = this; d; d = d->mOuterDelta)
+    {
+        auto it = d->mNew.find(key);
+        if (it != d->mNew.end())
+        {
+            entry = it->second;
+            return true;
+        }
+        it = d->mMod.find(key);
+        if (it != d->mMod.end())
+        {
+            entry = it->second;
+            return true;
+        }
+        if (d->mDelete.find(key) != d->mDelete.end())
+        {
+            entry = nullptr;
+            return true;
+        }
+    }
+    // Not changed anywhere up the chain, so a value loaded through any of
+    // these deltas is still what SQL holds.
+    for (auto d = this; d; d = d->mOuterDelta)
+    {
+        auto it = d->mPrevious.find(key);
+        if (it != d->mPrevious.end())
+        {
+            entry = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+EntryFrame::pointer
+LedgerDelta::loadCurrentEntry(LedgerKey const& key) const
+{
+    EntryFrame::pointer entry;
+    if (!findCurrentEntry(key, entry))
+    {
+        entry = EntryFrame::storeLoad(key, mDb);
+    }
+    return entry;
+}
+
+void
+LedgerDelta::prepareStore(LedgerKey const& key, bool insert)
+{
+    checkState();
+    if (!mUndoSQL || mBeforeImages.find(key) != mBeforeImages.end())
+    {
+        return;
+    }
+
+    // The entry is about to be written for the first time through this
+    // delta, so SQL still holds its value as the outer deltas see it. Only
+    // entries that were neither stored nor loaded through this chain of
+    // deltas need to be read back from the database. findCurrentEntry also
+    // looks at this delta's own changes, but with SQL undo on, a key found
+    // there (stored here or merged from a nested delta) already has a before
+    // image and never gets this far.
+    EntryFrame::pointer before;
+    if (!findCurrentEntry(key, before) && !insert)
+    {
+        before = EntryFrame::storeLoad(key, mDb);
+    }
+    mBeforeImages.insert(
+        std::make_pair(key, before ? before->copy() : EntryFrame::pointer()));
+}
+
+bool
+LedgerDelta::tracksInflationVotes() const
+{
+    return mTrackInflationVotes && mDb.isTrackingInflationVotes();
+}
+
+void
+LedgerDelta::addInflationVotes(AccountID const& dest, int64_t votes)
+{
+    checkState();
+    if (votes == 0)
+    {
+        return;
+    }
+    if (!mOuterDelta)
+    {
+        AccountFrame::adjustInflationVotes(mDb, dest, votes);
+        return;
+    }
+    auto it = mInflationVotes.insert(std::make_pair(dest, 0)).first;
+    it->second += votes;
+    if (it->second == 0)
+    {
+        mInflationVotes.erase(it);
+    }
+}
+
+bool
+LedgerDelta::hasPendingInflationVotes() const
+{
+    for (auto d = this; d; d = d->mOuterDelta)
+    {
+        if (!d->mInflationVotes.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 void
 LedgerDelta::addEntry(EntryFrame const& entry)
 {
@@ -189,6 +311,15 @@ LedgerDelta::mergeEntries(LedgerDelta& other)
 {
     checkState();
 
+    // an older before image recorded here wins over the inner one
+    mBeforeImages.insert(other.mBeforeImages.begin(),
+                         other.mBeforeImages.end());
+
+    for (auto const& v : other.mInflationVotes)
+    {
+        addInflationVotes(v.first, v.second);
+    }
+
     // propagates mPrevious for deleted & modified entries
     for (auto& d : other.mDelete)
     {
@@ -238,8 +369,27 @@ void
 LedgerDelta::rollback()
 {
     checkState();
+    if (!mBeforeImages.empty())
+    {
+        undoSQL();
+    }
+    discard();
+}
+
+void
+LedgerDelta::discard()
+{
     mHeader = nullptr;
 
+    if (mOuterDelta && mOuterDelta->mUndoSQL)
+    {
+        // an older before image recorded there wins over ours
+        mOuterDelta->mBeforeImages.insert(mBeforeImages.begin(),
+                                          mBeforeImages.end());
+    }
+    mBeforeImages.clear();
+    mInflationVotes.clear();
+
     for (auto& d : mDelete)
     {
         EntryFrame::flushCachedEntry(d, mDb);
@@ -254,6 +404,33 @@ LedgerDelta::rollback()
     }
 }
 
+void
+LedgerDelta::undoSQL()
+{
+    // Restore through a throwaway top level delta that leaves lastModified
+    // alone and tracks nothing of its own. The current SQL state is checked
+    // rather than inferred from mNew/mMod, since entries handed over by an
+    // inner delta that unwound are not recorded there.
+    LedgerHeader header = mCurrentHeader.mHeader;
+    LedgerDelta restoreDelta(header, mDb, false);
+    // the tally changes of the writes undone here are dropped with this
+    // delta, so the tally already matches what is restored
+    restoreDelta.mTrackInflationVotes = false;
+    for (auto const& b : mBeforeImages)
+    {
+        if (b.second)
+        {
+            EntryFrame::FromXDR(b.second->mEntry)
+                ->storeAddOrChange(restoreDelta, mDb);
+        }
+        else if (EntryFrame::exists(mDb, b.first))
+        {
+            EntryFrame::storeDelete(restoreDelta, mDb, b.first);
+        }
+    }
+    mBeforeImages.clear();
+}
+
 void
 LedgerDelta::addCurrentMeta(LedgerEntryChanges& changes,
                             LedgerKey const& key) const
@@ -294,6 +471,29 @@ LedgerDelta::getChanges() const
     return changes;
 }
 
+std::shared_ptr<LedgerDelta const>
+LedgerDelta::snapshot() const
+{
+    LedgerHeader previous = mPreviousHeaderValue;
+    auto res =
+        std::make_shared<LedgerDelta>(previous, mDb, mUpdateLastModified);
+    // detach from `previous` so the copy never commits or rolls back
+    res->mHeader = nullptr;
+    res->mCurrentHeader = mCurrentHeader;
+
+    auto copyEntries = [](KeyEntryMap const& from, KeyEntryMap& to) {
+        for (auto const& e : from)
+        {
+            to.emplace(e.first, e.second ? e.second->copy() : nullptr);
+        }
+    };
+    copyEntries(mNew, res->mNew);
+    copyEntries(mMod, res->mMod);
+    copyEntries(mPrevious, res->mPrevious);
+    res->mDelete = mDelete;
+    return res;
+}
+
 std::vector<LedgerEntry>
 LedgerDelta::getLiveEntries() const
 {
@@ -301,13 +501,22 @@ LedgerDelta::getLiveEntries() const
 
     live.reserve(mNew.size() + mMod.size());
 
-    for (auto const& k : mNew)
-    {
-        live.push_back(k.second->mEntry);
-    }
-    for (auto const& k : mMod)
+    // mNew and mMod are disjoint and each ordered by identity; interleave them
+    // so the result is already in bucket order and Bucket::fresh need not
+    // sort it again.
+    LedgerEntryIdCmp cmp;
+    auto n = mNew.begin();
+    auto m = mMod.begin();
+    while (n != mNew.end() || m != mMod.end())
     {
-        live.push_back(k.second->mEntry);
+        if (m == mMod.end() || (n != mNew.end() && cmp(n->first, m->first)))
+        {
+            live.push_back((n++)->second->mEntry);
+        }
+        else
+        {
+            live.push_back((m++)->second->mEntry);
+        }
     }
 
     return live;
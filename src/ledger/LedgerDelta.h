@@ -37,10 +37,23 @@ class LedgerDelta
     std::set<LedgerKey, LedgerEntryIdCmp> mDelete;
     KeyEntryMap mPrevious;
 
-    Database& mDb; // Used strictly for rollback of db entry cache.
+    Database& mDb; // Used for rollback of db entry cache and SQL state.
 
     bool mUpdateLastModified;
 
+    // When set (on this delta or any delta it is nested in), the state each
+    // entry had in SQL before this delta first stored it is kept here, with
+    // nullptr for entries that did not exist, so that rollback can restore
+    // SQL without the caller holding a savepoint open.
+    bool mUndoSQL;
+    KeyEntryMap mBeforeImages;
+
+    // Changes to the inflationvotes tally made through a nested delta are
+    // held here until it commits, so that every transaction writes each
+    // destination it touches once; a top level delta writes them at once.
+    std::map<AccountID, int64_t> mInflationVotes;
+    bool mTrackInflationVotes;
+
     void checkState();
     void addEntry(EntryFrame::pointer entry);
     void deleteEntry(EntryFrame::pointer entry);
@@ -50,6 +63,20 @@ class LedgerDelta
     // merge "other" into current ledgerDelta
     void mergeEntries(LedgerDelta& other);
 
+    // current value of `key` as known to this delta and the deltas it is
+    // nested in, from their stored changes or else from recorded loads;
+    // returns false if none of them knows it.
+    bool findCurrentEntry(LedgerKey const& key,
+                          EntryFrame::pointer& entry) const;
+
+    // writes the before images back to SQL
+    void undoSQL();
+
+    // rollback without touching SQL: before images are handed to the outer
+    // delta if it undoes SQL, and dropped otherwise, in which case the
+    // caller must hold a savepoint
+    void discard();
+
     // helper method that adds a meta entry to "changes"
     // with the previous value of an entry if needed
     void addCurrentMeta(LedgerEntryChanges& changes,
@@ -57,8 +84,11 @@ class LedgerDelta
 
   public:
     // keeps an internal reference to the outerDelta,
-    // will apply changes to the outer scope on commit
-    explicit LedgerDelta(LedgerDelta& outerDelta);
+    // will apply changes to the outer scope on commit.
+    // undoSQLOnRollback: if true, rollback also reverts the SQL writes made
+    // through this delta and the deltas nested in it.
+    explicit LedgerDelta(LedgerDelta& outerDelta,
+                         bool undoSQLOnRollback = false);
 
     // keeps an internal reference to ledgerHeader,
     // will apply changes to ledgerHeader on commit,
@@ -75,6 +105,24 @@ class LedgerDelta
 
     LedgerHeader const& getPreviousHeader() const;
 
+    // value `key` has in SQL right now, taken from this delta and the deltas
+    // it is nested in when they know it and loaded otherwise; nullptr if the
+    // entry does not exist
+    EntryFrame::pointer loadCurrentEntry(LedgerKey const& key) const;
+
+    // must be called by EntryFrame store methods before they write `key` to
+    // SQL; `insert` is true when the entry is known not to exist yet.
+    void prepareStore(LedgerKey const& key, bool insert);
+
+    // whether account writes through this delta maintain the inflationvotes
+    // tally (see Database::isTrackingInflationVotes)
+    bool tracksInflationVotes() const;
+    // adds `votes` to the tally of `dest`
+    void addInflationVotes(AccountID const& dest, int64_t votes);
+    // true if this delta or one it is nested in holds tally changes that are
+    // not in SQL yet
+    bool hasPendingInflationVotes() const;
+
     // methods to register changes in the ledger entries
     void addEntry(EntryFrame const& entry);
     void deleteEntry(EntryFrame const& entry);
@@ -84,19 +132,29 @@ class LedgerDelta
 
     // commits this delta into outer delta
     void commit();
-    // aborts any changes pending, flush db cache entries
+    // aborts any changes pending, flush db cache entries, and if SQL undo is
+    // enabled restores the SQL state of every entry stored through this delta.
+    // A delta destroyed without commit or rollback never issues SQL; see
+    // discard().
     void rollback();
 
     bool updateLastModified() const;
 
     void markMeters(Application& app) const;
 
-    // helper methods for generating data compatible with bucketlist
+    // helper methods for generating data compatible with bucketlist;
+    // these copy, as the invariants still read the delta after it has been
+    // added to the bucket list. Live entries come out in identity order.
     std::vector<LedgerEntry> getLiveEntries() const;
     std::vector<LedgerKey> getDeadEntries() const;
 
     LedgerEntryChanges getChanges() const;
 
+    // returns a copy of the header and entry changes of this delta that
+    // shares no state with it, so that it can be inspected from another
+    // thread; the copy is not tied to any ledger and cannot be committed
+    std::shared_ptr<LedgerDelta const> snapshot() const;
+
     template <typename IterType, typename ValueType>
     class Iterator : public std::iterator<std::input_iterator_tag, ValueType>
     {
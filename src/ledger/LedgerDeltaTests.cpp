@@ -332,3 +332,103 @@ TEST_CASE("Ledger delta", "[ledger][ledgerdelta]")
         }
     }
 }
+
+TEST_CASE("Ledger delta SQL rollback", "[ledger][ledgerdelta]")
+{
+    Config cfg(getTestConfig());
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+    app->start();
+    auto& db = app->getDatabase();
+    LedgerHeader& curHeader = app->getLedgerManager().getCurrentLedgerHeader();
+
+    LedgerDelta delta(curHeader, db);
+
+    std::vector<AccountFrame::pointer> accounts;
+    for (auto const& a : LedgerTestUtils::generateValidAccountEntries(3))
+    {
+        LedgerEntry le;
+        le.data.type(ACCOUNT);
+        le.data.account() = a;
+        accounts.emplace_back(std::make_shared<AccountFrame>(le));
+    }
+    auto modified = accounts[0];
+    auto deleted = accounts[1];
+    auto added = accounts[2];
+    modified->storeAdd(delta, db);
+    deleted->storeAdd(delta, db);
+
+    auto storeChanges = [&](LedgerDelta& d) {
+        auto a = AccountFrame::loadAccount(d, modified->getID(), db);
+        REQUIRE(a);
+        a->setSeqNum(a->getSeqNum() + 1);
+        a->storeChange(d, db);
+        deleted->storeDelete(d, db);
+        added->storeAdd(d, db);
+    };
+
+    auto checkOriginalState = [&]() {
+        REQUIRE(EntryFrame::checkAgainstDatabase(modified->mEntry, db) == "");
+        REQUIRE(EntryFrame::checkAgainstDatabase(deleted->mEntry, db) == "");
+        REQUIRE(!AccountFrame::exists(db, added->getKey()));
+    };
+
+    SECTION("rollback restores entries stored by committed inner deltas")
+    {
+        LedgerDelta txDelta(delta, true);
+        {
+            LedgerDelta opDelta(txDelta);
+            storeChanges(opDelta);
+            opDelta.commit();
+        }
+        txDelta.rollback();
+        checkOriginalState();
+    }
+
+    SECTION("destroying a delta leaves SQL to the outer rollback")
+    {
+        LedgerDelta txDelta(delta, true);
+        {
+            LedgerDelta opDelta(txDelta);
+            storeChanges(opDelta);
+        }
+        REQUIRE(AccountFrame::exists(db, added->getKey()));
+        REQUIRE(!AccountFrame::exists(db, deleted->getKey()));
+        txDelta.rollback();
+        checkOriginalState();
+    }
+
+    SECTION("rollback of an inner delta leaves outer changes alone")
+    {
+        LedgerDelta txDelta(delta, true);
+        auto a = AccountFrame::loadAccount(txDelta, modified->getID(), db);
+        a->setSeqNum(a->getSeqNum() + 10);
+        a->storeChange(txDelta, db);
+        {
+            LedgerDelta opDelta(txDelta, true);
+            storeChanges(opDelta);
+            opDelta.rollback();
+        }
+        REQUIRE(EntryFrame::checkAgainstDatabase(a->mEntry, db) == "");
+        REQUIRE(EntryFrame::checkAgainstDatabase(deleted->mEntry, db) == "");
+        REQUIRE(!AccountFrame::exists(db, added->getKey()));
+        txDelta.rollback();
+        checkOriginalState();
+    }
+
+    SECTION("inner delta unwound by an exception")
+    {
+        LedgerDelta txDelta(delta, true);
+        try
+        {
+            LedgerDelta opDelta(txDelta);
+            storeChanges(opDelta);
+            throw std::runtime_error("op failed");
+        }
+        catch (std::runtime_error&)
+        {
+            txDelta.rollback();
+        }
+        checkOriginalState();
+    }
+}
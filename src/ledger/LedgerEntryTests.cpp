@@ -6,18 +6,23 @@
 #include "LedgerDelta.h"
 #include "OfferFrame.h"
 #include "TrustFrame.h"
+#include "crypto/KeyUtils.h"
 #include "crypto/SecretKey.h"
+#include "crypto/SignerKey.h"
 #include "database/Database.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerTestUtils.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "test/TestUtils.h"
+#include "test/TxTests.h"
 #include "test/test.h"
 #include "util/Logging.h"
 #include "util/Timer.h"
 #include "xdrpp/autocheck.h"
 #include "xdrpp/marshal.h"
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <unordered_map>
 #include <utility>
@@ -274,4 +279,227 @@ TEST_CASE("Ledger Entry tests", "[ledgerentry]")
         app->getLedgerManager().checkDbState();
     }
 }
+
+// The account load path used before signers were joined in: one query for
+// the account row and a second one for its signers.
+static void
+loadAccountTwoQueries(Database& db, std::string const& actIDStrKey,
+                      AccountEntry& account)
+{
+    std::string inflationDest, homeDomain, thresholds;
+    soci::indicator inflationDestInd, buyingInd, sellingInd;
+    uint32_t lastModified;
+    Liabilities liabilities;
+    {
+        auto prep = db.getPreparedStatement(
+            "SELECT balance, seqnum, numsubentries, inflationdest, "
+            "homedomain, thresholds, flags, lastmodified, buyingliabilities, "
+            "sellingliabilities FROM accounts WHERE accountid=:v1");
+        auto& st = prep.statement();
+        st.exchange(soci::into(account.balance));
+        st.exchange(soci::into(account.seqNum));
+        st.exchange(soci::into(account.numSubEntries));
+        st.exchange(soci::into(inflationDest, inflationDestInd));
+        st.exchange(soci::into(homeDomain));
+        st.exchange(soci::into(thresholds));
+        st.exchange(soci::into(account.flags));
+        st.exchange(soci::into(lastModified));
+        st.exchange(soci::into(liabilities.buying, buyingInd));
+        st.exchange(soci::into(liabilities.selling, sellingInd));
+        st.exchange(soci::use(actIDStrKey));
+        st.define_and_bind();
+        st.execute(true);
+        REQUIRE(st.got_data());
+    }
+
+    account.signers.clear();
+    if (account.numSubEntries == 0)
+    {
+        return;
+    }
+    std::string pubKey;
+    Signer signer;
+    auto prep = db.getPreparedStatement(
+        "SELECT publickey, weight FROM signers WHERE accountid =:id");
+    auto& st = prep.statement();
+    st.exchange(soci::use(actIDStrKey));
+    st.exchange(soci::into(pubKey));
+    st.exchange(soci::into(signer.weight));
+    st.define_and_bind();
+    st.execute(true);
+    while (st.got_data())
+    {
+        signer.key = KeyUtils::fromStrKey<SignerKey>(pubKey);
+        account.signers.push_back(signer);
+        st.fetch();
+    }
+    std::sort(account.signers.begin(), account.signers.end(),
+              &AccountFrame::signerCompare);
+}
+
+static void
+benchAccountLoads(Config::TestDbMode mode)
+{
+    size_t const nAccounts = 2000;
+    size_t const nRounds = 5;
+
+    VirtualClock clock;
+    Application::pointer app =
+        createTestApplication(clock, getTestConfig(0, mode));
+    app->start();
+    Database& db = app->getDatabase();
+
+    LedgerHeader lh;
+    LedgerDelta delta(lh, db, false);
+    std::vector<AccountFrame::pointer> accounts;
+    {
+        soci::transaction sqlTx(db.getSession());
+        for (size_t i = 0; i < nAccounts; ++i)
+        {
+            LedgerEntry le;
+            le.data.type(ACCOUNT);
+            le.data.account() = LedgerTestUtils::generateValidAccountEntry(5);
+            auto af = std::make_shared<AccountFrame>(le);
+            if (AccountFrame::loadAccount(af->getID(), db))
+            {
+                continue;
+            }
+            af->storeAdd(delta, db);
+            accounts.emplace_back(af);
+        }
+        sqlTx.commit();
+    }
+
+    using namespace std::chrono;
+    nanoseconds twoQueries(0), joined(0);
+    for (size_t round = 0; round < nRounds; ++round)
+    {
+        for (auto const& af : accounts)
+        {
+            auto strKey = KeyUtils::toStrKey(af->getID());
+            AccountEntry account;
+            auto start = steady_clock::now();
+            loadAccountTwoQueries(db, strKey, account);
+            twoQueries += steady_clock::now() - start;
+
+            EntryFrame::flushCachedEntry(af->getKey(), db);
+            start = steady_clock::now();
+            auto fromDb = AccountFrame::loadAccount(af->getID(), db);
+            joined += steady_clock::now() - start;
+
+            REQUIRE(fromDb->getAccount().signers == account.signers);
+        }
+    }
+
+    auto loads = accounts.size() * nRounds;
+    LOG(INFO) << "Loaded " << accounts.size() << " accounts " << nRounds
+              << " times from " << (db.isSqlite() ? "sqlite" : "postgres")
+              << ": two queries " << twoQueries.count() / loads
+              << "ns/account, joined " << joined.count() / loads
+              << "ns/account";
+}
+
+TEST_CASE("best offers by asset pair", "[ledgerentry]")
+{
+    Config cfg(getTestConfig(0));
+
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+    app->start();
+    Database& db = app->getDatabase();
+
+    auto issuer = txtest::getAccount("issuer");
+    auto native = txtest::makeNativeAsset();
+    auto usd = txtest::makeAsset(issuer, "USD");
+    auto eur = txtest::makeAsset(issuer, "EUR");
+
+    LedgerHeader lh;
+    LedgerDelta delta(lh, db, false);
+
+    uint64_t nextID = 1;
+    auto addOffer = [&](Asset const& selling, Asset const& buying, int32_t n,
+                        int32_t d) {
+        LedgerEntry le;
+        le.data.type(OFFER);
+        auto& oe = le.data.offer();
+        oe = LedgerTestUtils::generateValidOfferEntry();
+        oe.offerID = nextID++;
+        oe.selling = selling;
+        oe.buying = buying;
+        oe.price.n = n;
+        oe.price.d = d;
+        OfferFrame(le).storeAdd(delta, db);
+        return oe.offerID;
+    };
+
+    // 1/3 and 2/6 are the same price, 3/1 is the worst
+    auto o1 = addOffer(usd, native, 3, 1);
+    auto o2 = addOffer(usd, native, 1, 3);
+    auto o3 = addOffer(usd, native, 1, 2);
+    auto o4 = addOffer(usd, native, 2, 6);
+    // same assets on other books
+    addOffer(native, usd, 1, 10);
+    addOffer(usd, eur, 1, 10);
+    addOffer(eur, native, 1, 10);
+
+    auto bestOffers = [&](size_t n, size_t offset) {
+        std::vector<OfferFrame::pointer> offers;
+        OfferFrame::loadBestOffers(n, offset, usd, native, offers, db);
+        std::vector<uint64_t> ids;
+        for (auto const& o : offers)
+        {
+            REQUIRE(o->getSelling() == usd);
+            REQUIRE(o->getBuying() == native);
+            ids.emplace_back(o->getOfferID());
+        }
+        return ids;
+    };
+
+    std::vector<uint64_t> expected{o2, o4, o3, o1};
+
+    SECTION("ordered by price then offer id")
+    {
+        REQUIRE(bestOffers(10, 0) == expected);
+        REQUIRE(bestOffers(2, 1) == std::vector<uint64_t>{o4, o3});
+    }
+
+    SECTION("asset pairs are directional")
+    {
+        REQUIRE(OfferFrame::computeAssetPair(usd, native) !=
+                OfferFrame::computeAssetPair(native, usd));
+        std::vector<OfferFrame::pointer> offers;
+        OfferFrame::loadBestOffers(10, 0, native, usd, offers, db);
+        REQUIRE(offers.size() == 1);
+        REQUIRE(offers[0]->getSelling() == native);
+    }
+
+    SECTION("backfill restores pairs")
+    {
+        db.getSession() << "UPDATE offers SET assetpair = 0";
+        REQUIRE(bestOffers(10, 0).empty());
+        OfferFrame::backfillAssetPairs(db);
+        REQUIRE(bestOffers(10, 0) == expected);
+    }
+}
+
+TEST_CASE("account load bench", "[ledgerentry][bench][!hide]")
+{
+    SECTION("in-memory sqlite")
+    {
+        benchAccountLoads(Config::TESTDB_IN_MEMORY_SQLITE);
+    }
+    SECTION("on-disk sqlite")
+    {
+        benchAccountLoads(Config::TESTDB_ON_DISK_SQLITE);
+    }
+#ifdef USE_POSTGRES
+    if (!force_sqlite)
+    {
+        SECTION("postgresql")
+        {
+            benchAccountLoads(Config::TESTDB_POSTGRESQL);
+        }
+    }
+#endif
+}
 }
@@ -17,6 +17,7 @@
 #include "herder/LedgerCloseData.h"
 #include "herder/TxSetFrame.h"
 #include "herder/Upgrades.h"
+#include "history/CheckpointBuilder.h"
 #include "history/HistoryManager.h"
 #include "invariant/InvariantDoesNotHold.h"
 #include "invariant/InvariantManager.h"
@@ -252,6 +253,10 @@ LedgerManagerImpl::loadLastKnownLedger(
     else
     {
         LOG(INFO) << "Loading last known ledger";
+        // Every way of bringing up the ledger (run, offline catchup, info
+        // and so on) comes through here, before anything reads the tally.
+        getDatabase().repairInflationVotes();
+
         Hash lastLedgerHash = hexToBin256(lastLedger);
 
         mCurrentLedger =
@@ -908,6 +913,12 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     ledgerDelta.commit();
     ledgerClosed(ledgerDelta);
 
+    // Append this ledger to the history blocks streamed out for publishing
+    // while its transactions and results are still at hand. This has to
+    // happen before step 1, which may snapshot the checkpoint it completes.
+    mApp.getHistoryManager().getCheckpointBuilder().appendLedger(
+        getLastClosedLedgerHeader(), *ledgerData.getTxSet(), txResultSet);
+
     // The next 4 steps happen in a relatively non-obvious, subtle order.
     // This is unfortunate and it would be nice if we could make it not
     // be so subtle, but for the time being this is where we are.
@@ -932,6 +943,8 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     // step 2
     mApp.getDatabase().clearPreparedStatementCache();
     txscope.commit();
+    // deferred invariant checks snapshot the database as of this commit
+    mApp.getInvariantManager().checkOnLedgerCommit(ledgerDelta);
 
     // step 3
     hm.publishQueuedHistory();
@@ -1042,15 +1055,18 @@ LedgerManagerImpl::processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
     int index = 0;
     try
     {
-        soci::transaction sqlTx(mApp.getDatabase().getSession());
+        // No savepoint needed: any failure here aborts the whole ledger
+        // close, and with it the enclosing SQL transaction. Collecting all
+        // fees in one delta writes the inflation votes they change once.
+        LedgerDelta feesDelta(delta);
         for (auto tx : txs)
         {
-            LedgerDelta thisTxDelta(delta);
+            LedgerDelta thisTxDelta(feesDelta);
             tx->processFeeSeqNum(thisTxDelta, *this);
             tx->storeTransactionFee(*this, thisTxDelta.getChanges(), ++index);
             thisTxDelta.commit();
         }
-        sqlTx.commit();
+        feesDelta.commit();
     }
     catch (std::exception& e)
     {
@@ -13,6 +13,7 @@
 #include "transactions/ManageOfferOpFrame.h"
 #include "transactions/OfferExchange.h"
 #include "util/types.h"
+#include "xdrpp/marshal.h"
 
 using namespace std;
 using namespace soci;
@@ -70,6 +71,21 @@ getBuyingLiabilities(OfferEntry const& oe)
     return res.numSheepSend;
 }
 
+int64_t
+OfferFrame::computeAssetPair(Asset const& selling, Asset const& buying)
+{
+    auto hasher = SHA256::create();
+    hasher->add(xdr::xdr_to_opaque(selling));
+    hasher->add(xdr::xdr_to_opaque(buying));
+    auto h = hasher->finish();
+    uint64_t pair = 0;
+    for (size_t i = 0; i < sizeof(pair); ++i)
+    {
+        pair = (pair << 8) | h[i];
+    }
+    return static_cast<int64_t>(pair);
+}
+
 OfferFrame::OfferFrame() : EntryFrame(OFFER), mOffer(mEntry.data.offer())
 {
 }
@@ -277,6 +293,12 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
 {
     std::string sql = offerColumnSelector;
 
+    // assetpair narrows the scan to this pair through bestofferindex; the
+    // asset columns are still compared so that a hash collision between two
+    // pairs can never mix their books.
+    int64_t assetPair = computeAssetPair(selling, buying);
+    sql += " WHERE assetpair = :ap";
+
     std::string sellingAssetCode, sellingIssuerStrKey;
     std::string buyingAssetCode, buyingIssuerStrKey;
 
@@ -285,7 +307,7 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
 
     if (selling.type() == ASSET_TYPE_NATIVE)
     {
-        sql += " WHERE sellingassettype = 0 AND sellingissuer IS NULL";
+        sql += " AND sellingassettype = 0 AND sellingissuer IS NULL";
     }
     else
     {
@@ -307,7 +329,7 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
         }
 
         useSellingAsset = true;
-        sql += " WHERE sellingassetcode = :pcur AND sellingissuer = :pi";
+        sql += " AND sellingassetcode = :pcur AND sellingissuer = :pi";
     }
 
     if (buying.type() == ASSET_TYPE_NATIVE)
@@ -337,11 +359,15 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
 
     // price is an approximation of the actual n/d (truncated math, 15 digits)
     // ordering by offerid gives precendence to older offers for fairness
+    // this order decides which offers get crossed, so it is part of consensus
+    // and must not change to exact n/d ordering without a protocol upgrade
     sql += " ORDER BY price, offerid LIMIT :n OFFSET :o";
 
     auto prep = db.getPreparedStatement(sql);
     auto& st = prep.statement();
 
+    st.exchange(use(assetPair));
+
     if (useSellingAsset)
     {
         st.exchange(use(sellingAssetCode));
@@ -490,6 +516,7 @@ OfferFrame::storeDelete(LedgerDelta& delta, Database& db) const
 void
 OfferFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
 {
+    delta.prepareStore(key, false);
     auto timer = db.getDeleteTimer("offer");
     auto prep = db.getPreparedStatement("DELETE FROM offers WHERE offerid=:s");
     auto& st = prep.statement();
@@ -520,6 +547,7 @@ OfferFrame::storeAdd(LedgerDelta& delta, Database& db)
 void
 OfferFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
 {
+    delta.prepareStore(getKey(), insert);
     touch(delta);
 
     std::string actIDStrKey = KeyUtils::toStrKey(mOffer.sellerID);
@@ -567,16 +595,17 @@ OfferFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
         sql = "INSERT INTO offers (sellerid,offerid,"
               "sellingassettype,sellingassetcode,sellingissuer,"
               "buyingassettype,buyingassetcode,buyingissuer,"
-              "amount,pricen,priced,price,flags,lastmodified) VALUES "
-              "(:sid,:oid,:sat,:sac,:si,:bat,:bac,:bi,:a,:pn,:pd,:p,:f,:l)";
+              "amount,pricen,priced,price,assetpair,flags,lastmodified) "
+              "VALUES (:sid,:oid,:sat,:sac,:si,:bat,:bac,:bi,:a,:pn,:pd,:p,"
+              ":ap,:f,:l)";
     }
     else
     {
         sql = "UPDATE offers SET sellingassettype=:sat "
               ",sellingassetcode=:sac,sellingissuer=:si,"
               "buyingassettype=:bat,buyingassetcode=:bac,buyingissuer=:bi,"
-              "amount=:a,pricen=:pn,priced=:pd,price=:p,flags=:f,"
-              "lastmodified=:l WHERE offerid=:oid";
+              "amount=:a,pricen=:pn,priced=:pd,price=:p,assetpair=:ap,"
+              "flags=:f,lastmodified=:l WHERE offerid=:oid";
     }
 
     auto prep = db.getPreparedStatement(sql);
@@ -598,6 +627,8 @@ OfferFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
     st.exchange(use(mOffer.price.d, "pd"));
     auto price = computePrice();
     st.exchange(use(price, "p"));
+    auto assetPair = computeAssetPair(mOffer.selling, mOffer.buying);
+    st.exchange(use(assetPair, "ap"));
     st.exchange(use(mOffer.flags, "f"));
     st.exchange(use(getLastModified(), "l"));
     st.define_and_bind();
@@ -631,6 +662,33 @@ OfferFrame::dropAll(Database& db)
     db.getSession() << kSQLCreateStatement4;
 }
 
+void
+OfferFrame::backfillAssetPairs(Database& db)
+{
+    std::vector<std::pair<uint64_t, int64_t>> pairs;
+    {
+        auto prep = db.getPreparedStatement(offerColumnSelector);
+        loadOffers(prep, [&pairs](LedgerEntry const& of) {
+            auto const& oe = of.data.offer();
+            pairs.emplace_back(oe.offerID,
+                               computeAssetPair(oe.selling, oe.buying));
+        });
+    }
+
+    soci::transaction tx(db.getSession());
+    for (auto const& p : pairs)
+    {
+        auto prep = db.getPreparedStatement(
+            "UPDATE offers SET assetpair = :ap WHERE offerid = :oid");
+        auto& st = prep.statement();
+        st.exchange(use(p.second));
+        st.exchange(use(p.first));
+        st.define_and_bind();
+        st.execute(true);
+    }
+    tx.commit();
+}
+
 void
 OfferFrame::releaseLiabilities(AccountFrame::pointer const& account,
                                TrustFrame::pointer const& buyingTrust,
@@ -111,6 +111,13 @@ class OfferFrame : public EntryFrame
 
     static void dropAll(Database& db);
 
+    // Compact identifier of the (selling, buying) pair stored in the
+    // assetpair column; see bestofferindex.
+    static int64_t computeAssetPair(Asset const& selling, Asset const& buying);
+
+    // Fill assetpair for offers written before the column existed.
+    static void backfillAssetPairs(Database& db);
+
     void releaseLiabilities(AccountFrame::pointer const& account,
                             TrustFrame::pointer const& buyingTrust,
                             TrustFrame::pointer const& sellingTrust,
@@ -343,6 +343,7 @@ TrustFrame::storeDelete(LedgerDelta& delta, Database& db) const
 void
 TrustFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
 {
+    delta.prepareStore(key, false);
     flushCachedEntry(key, db);
 
     std::string actIDStrKey, issuerStrKey, assetCode;
@@ -365,6 +366,7 @@ TrustFrame::storeChange(LedgerDelta& delta, Database& db)
     if (mIsIssuer)
         return;
 
+    delta.prepareStore(key, false);
     touch(delta);
 
     std::string actIDStrKey, issuerStrKey, assetCode;
@@ -415,6 +417,7 @@ TrustFrame::storeAdd(LedgerDelta& delta, Database& db)
     if (mIsIssuer)
         return;
 
+    delta.prepareStore(key, true);
     touch(delta);
 
     std::string actIDStrKey, issuerStrKey, assetCode;
@@ -117,6 +117,10 @@ void validateNetworkPassphrase(std::shared_ptr<Application> app);
  * thread's io_service (held in the VirtualClock), or else deliver their results
  * to the Application through std::futures or similar standard
  * thread-synchronization primitives.
+ *
+ * Decoding of incoming overlay messages runs on a dedicated "overlay" thread
+ * rather than in the worker pool, so that it never waits behind long tasks
+ * such as bucket merges.
  */
 
 class Application
@@ -216,6 +220,7 @@ class Application
     virtual void postOnMainThread(std::function<void()>&& f) = 0;
     virtual void postOnMainThreadWithDelay(std::function<void()>&& f) = 0;
     virtual void postOnBackgroundThread(std::function<void()>&& f) = 0;
+    virtual void postOnOverlayThread(std::function<void()>&& f) = 0;
 
     // Perform actions necessary to transition from BOOTING_STATE to other
     // states. In particular: either reload or reinitialize the database, and
@@ -59,8 +59,10 @@ namespace stellar
 ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
     : mVirtualClock(clock)
     , mConfig(cfg)
-    , mWorkerIOService(std::thread::hardware_concurrency())
+    , mWorkerIOService(cfg.WORKER_THREADS)
     , mWork(std::make_unique<asio::io_service::work>(mWorkerIOService))
+    , mOverlayIOService(1)
+    , mOverlayWork(std::make_unique<asio::io_service::work>(mOverlayIOService))
     , mWorkerThreads()
     , mStopSignals(clock.getIOService(), SIGINT)
     , mStopping(false)
@@ -82,7 +84,7 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
 
     mNetworkID = sha256(mConfig.NETWORK_PASSPHRASE);
 
-    unsigned t = std::thread::hardware_concurrency();
+    auto t = static_cast<unsigned>(mConfig.WORKER_THREADS);
     LOG(DEBUG) << "Application constructing "
                << "(worker threads: " << t << ")";
     mStopSignals.async_wait([this](asio::error_code const& ec, int sig) {
@@ -97,6 +99,7 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
     {
         mWorkerThreads.emplace_back([this, t]() { this->runWorkerThread(t); });
     }
+    mOverlayThread = std::thread([this]() { mOverlayIOService.run(); });
 }
 
 void
@@ -458,11 +461,19 @@ ApplicationImpl::joinAllThreads()
     {
         mWork.reset();
     }
+    if (mOverlayWork)
+    {
+        mOverlayWork.reset();
+    }
     LOG(DEBUG) << "Joining " << mWorkerThreads.size() << " worker threads";
     for (auto& w : mWorkerThreads)
     {
         w.join();
     }
+    if (mOverlayThread.joinable())
+    {
+        mOverlayThread.join();
+    }
     LOG(DEBUG) << "Joined all " << mWorkerThreads.size() << " threads";
 }
 
@@ -764,6 +775,12 @@ ApplicationImpl::postOnBackgroundThread(std::function<void()>&& f)
     getWorkerIOService().post(std::move(f));
 }
 
+void
+ApplicationImpl::postOnOverlayThread(std::function<void()>&& f)
+{
+    mOverlayIOService.post(std::move(f));
+}
+
 void
 ApplicationImpl::enableInvariantsFromConfig()
 {
@@ -75,6 +75,7 @@ class ApplicationImpl : public Application
     virtual void postOnMainThread(std::function<void()>&& f) override;
     virtual void postOnMainThreadWithDelay(std::function<void()>&& f) override;
     virtual void postOnBackgroundThread(std::function<void()>&& f) override;
+    virtual void postOnOverlayThread(std::function<void()>&& f) override;
 
     void newDB() override;
 
@@ -133,6 +134,8 @@ class ApplicationImpl : public Application
 
     asio::io_service mWorkerIOService;
     std::unique_ptr<asio::io_service::work> mWork;
+    asio::io_service mOverlayIOService;
+    std::unique_ptr<asio::io_service::work> mOverlayWork;
 
     std::unique_ptr<Database> mDatabase;
     std::unique_ptr<TmpDirManager> mTmpDirManager;
@@ -154,6 +157,7 @@ class ApplicationImpl : public Application
     std::unique_ptr<StatusManager> mStatusManager;
 
     std::vector<std::thread> mWorkerThreads;
+    std::thread mOverlayThread;
 
     asio::signal_set mStopSignals;
 
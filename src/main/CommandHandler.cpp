@@ -5,6 +5,7 @@
 #include "main/CommandHandler.h"
 #include "crypto/Hex.h"
 #include "crypto/KeyUtils.h"
+#include "crypto/SecretKey.h"
 #include "herder/Herder.h"
 #include "ledger/LedgerManager.h"
 #include "lib/http/server.hpp"
@@ -15,6 +16,7 @@
 #include "main/Maintainer.h"
 #include "overlay/BanManager.h"
 #include "overlay/OverlayManager.h"
+#include "transactions/TransactionFrame.h"
 #include "util/Logging.h"
 #include "util/StatusManager.h"
 
@@ -28,6 +30,7 @@
 
 #include "test/TestAccount.h"
 #include "test/TxTests.h"
+#include <algorithm>
 #include <regex>
 
 using namespace stellar::txtest;
@@ -57,7 +60,8 @@ CommandHandler::CommandHandler(Application& app) : mApp(app)
 
         mServer = std::make_unique<http::server::server>(
             app.getClock().getIOService(), ipStr, mApp.getConfig().HTTP_PORT,
-            httpMaxClient);
+            httpMaxClient,
+            std::chrono::seconds(mApp.getConfig().HTTP_IDLE_TIMEOUT));
     }
     else
     {
@@ -89,6 +93,7 @@ CommandHandler::CommandHandler(Application& app) : mApp(app)
     addRoute("testacc", &CommandHandler::testAcc);
     addRoute("testtx", &CommandHandler::testTx);
     addRoute("tx", &CommandHandler::tx);
+    addAsyncRoute("txbatch", &CommandHandler::txBatch);
     addRoute("upgrades", &CommandHandler::upgrades);
     addRoute("unban", &CommandHandler::unban);
 }
@@ -100,6 +105,25 @@ CommandHandler::addRoute(std::string const& name, HandlerRoute route)
         name, std::bind(&CommandHandler::safeRouter, this, route, _1, _2));
 }
 
+void
+CommandHandler::addAsyncRoute(std::string const& name, AsyncHandlerRoute route)
+{
+    mServer->addAsyncRoute(
+        name, [this, route](http::server::request const& request,
+                            std::function<void(std::string const&)> done) {
+            try
+            {
+                route(this, request, done);
+            }
+            catch (std::exception& e)
+            {
+                Json::Value root;
+                root["exception"] = e.what();
+                done(root.toStyledString());
+            }
+        });
+}
+
 void
 CommandHandler::safeRouter(CommandHandler::HandlerRoute route,
                            std::string const& params, std::string& retStr)
@@ -224,6 +248,9 @@ CommandHandler::testTx(std::string const& params, std::string& retStr)
             root["detail"] =
                 xdr::xdr_to_string(txFrame->getResult().result.code());
             break;
+        case Herder::TX_STATUS_TRY_AGAIN_LATER:
+            root["status"] = "try_again_later";
+            break;
         default:
             assert(false);
         }
@@ -302,6 +329,13 @@ CommandHandler::fileNotFound(std::string const& params, std::string& retStr)
         "returns a JSON object<br>"
         "wasReceived: boolean, true if transaction was queued properly<br>"
         "result: base64 encoded, XDR serialized 'TransactionResult'<br>"
+        "</p><p><h1> POST /txbatch</h1>"
+        "submit a batch of transactions to the network.<br>"
+        "The body holds one base64 encoded 'TransactionEnvelope' per line, "
+        "or, with Content-Type: application/octet-stream, XDR records framed "
+        "as in history archive files.<br>"
+        "returns a JSON array with the result of each transaction, as /tx "
+        "does<br>"
         "</p><p><h1> /upgrades?mode=(get|set|clear)&[upgradetime=DATETIME]&"
         "[basefee=NUM]&[basereserve=NUM]&[maxtxsize=NUM]&[protocolversion=NUM]"
         "</h1>"
@@ -905,6 +939,166 @@ CommandHandler::tx(std::string const& params, std::string& retStr)
     retStr = output.str();
 }
 
+namespace
+{
+// A transaction of a txbatch request, decoded and pre-checked off the main
+// thread.
+struct BatchedTx
+{
+    TransactionEnvelope mEnvelope;
+    TransactionFramePtr mTransaction;
+    std::string mError;
+};
+
+// Split a txbatch body into encoded envelopes: XDR records framed as in
+// history files (a 4-byte big-endian length with the high bit set) for
+// application/octet-stream, otherwise one base64 envelope per line.
+std::vector<std::vector<uint8_t>>
+splitTxBatch(std::string const& body, bool binary)
+{
+    std::vector<std::vector<uint8_t>> res;
+    size_t pos = 0;
+    while (pos < body.size())
+    {
+        if (binary)
+        {
+            if (body.size() - pos < 4)
+            {
+                throw std::invalid_argument("truncated record header");
+            }
+            uint32_t sz = 0;
+            for (size_t i = 0; i < 4; ++i)
+            {
+                sz = (sz << 8) | static_cast<uint8_t>(body[pos + i]);
+            }
+            sz &= 0x7fffffff;
+            pos += 4;
+            if (body.size() - pos < sz)
+            {
+                throw std::invalid_argument("truncated record");
+            }
+            res.emplace_back(body.begin() + pos, body.begin() + pos + sz);
+            pos += sz;
+        }
+        else
+        {
+            auto eol = body.find('\n', pos);
+            auto line = body.substr(pos, eol == std::string::npos
+                                             ? std::string::npos
+                                             : eol - pos);
+            pos = (eol == std::string::npos) ? body.size() : eol + 1;
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (!line.empty())
+            {
+                res.emplace_back();
+                decoder::decode_b64(line, res.back());
+            }
+        }
+    }
+    return res;
+}
+}
+
+void
+CommandHandler::txBatch(http::server::request const& request,
+                        std::function<void(std::string const&)> done)
+{
+    if (request.method != "POST")
+    {
+        throw std::invalid_argument("txbatch expects a POST of envelopes");
+    }
+
+    bool binary = false;
+    for (auto const& h : request.headers)
+    {
+        auto name = h.name;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name == "content-type")
+        {
+            binary = h.value == "application/octet-stream";
+        }
+    }
+
+    // Decoding, hashing and signature checks run on a background thread;
+    // only the submission itself is left to the main thread.
+    auto body = std::make_shared<std::string>(request.body);
+    auto& app = mApp;
+    app.postOnBackgroundThread([&app, body, binary, done]() {
+        auto txs = std::make_shared<std::vector<BatchedTx>>();
+        std::string batchError;
+        try
+        {
+            for (auto& bin : splitTxBatch(*body, binary))
+            {
+                txs->emplace_back();
+                auto& btx = txs->back();
+                try
+                {
+                    xdr::xdr_from_opaque(bin, btx.mEnvelope);
+                    auto tx = TransactionFrame::makeTransactionFromWire(
+                        app.getNetworkID(), btx.mEnvelope);
+                    tx->getFullHash();
+                    tx->prefetchSignatures();
+                    btx.mTransaction = tx;
+                }
+                catch (std::exception& e)
+                {
+                    btx.mError = e.what();
+                }
+            }
+        }
+        catch (std::exception& e)
+        {
+            batchError = e.what();
+        }
+
+        app.postOnMainThread([&app, txs, batchError, done]() {
+            Json::Value root;
+            if (!batchError.empty())
+            {
+                root["exception"] = batchError;
+                done(root.toStyledString());
+                return;
+            }
+
+            root = Json::Value(Json::arrayValue);
+            for (auto const& btx : *txs)
+            {
+                Json::Value res;
+                if (!btx.mTransaction)
+                {
+                    res["exception"] = btx.mError;
+                    root.append(res);
+                    continue;
+                }
+
+                auto status =
+                    app.getHerder().recvTransaction(btx.mTransaction);
+                if (status == Herder::TX_STATUS_PENDING)
+                {
+                    StellarMessage msg;
+                    msg.type(TRANSACTION);
+                    msg.transaction() = btx.mEnvelope;
+                    app.getOverlayManager().broadcastMessage(msg);
+                }
+
+                res["status"] = Herder::TX_STATUS_STRING[status];
+                if (status == Herder::TX_STATUS_ERROR)
+                {
+                    auto resultBin =
+                        xdr::xdr_to_opaque(btx.mTransaction->getResult());
+                    res["error"] = decoder::encode_b64(resultBin);
+                }
+                root.append(res);
+            }
+            done(root.toStyledString());
+        });
+    });
+}
+
 void
 CommandHandler::dropcursor(std::string const& params, std::string& retStr)
 {
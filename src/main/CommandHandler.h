@@ -20,11 +20,15 @@ class CommandHandler
     typedef std::function<void(CommandHandler*, std::string const&,
                                std::string&)>
         HandlerRoute;
+    typedef std::function<void(CommandHandler*, http::server::request const&,
+                               std::function<void(std::string const&)>)>
+        AsyncHandlerRoute;
 
     Application& mApp;
     std::unique_ptr<http::server::server> mServer;
 
     void addRoute(std::string const& name, HandlerRoute route);
+    void addAsyncRoute(std::string const& name, AsyncHandlerRoute route);
     void safeRouter(HandlerRoute route, std::string const& params,
                     std::string& retStr);
 
@@ -55,6 +59,8 @@ class CommandHandler
     void getcursor(std::string const& params, std::string& retStr);
     void scpInfo(std::string const& params, std::string& retStr);
     void tx(std::string const& params, std::string& retStr);
+    void txBatch(http::server::request const& request,
+                 std::function<void(std::string const&)> done);
     void testAcc(std::string const& params, std::string& retStr);
     void testTx(std::string const& params, std::string& retStr);
     void unban(std::string const& params, std::string& retStr);
@@ -0,0 +1,441 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/asio.h"
+#include "herder/Herder.h"
+#include "lib/catch.hpp"
+#include "lib/json/json.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "test/TestAccount.h"
+#include "test/TestUtils.h"
+#include "test/TxTests.h"
+#include "test/test.h"
+#include "transactions/TransactionFrame.h"
+#include "util/Decoder.h"
+#include "util/Timer.h"
+#include "xdrpp/marshal.h"
+#include <thread>
+
+using namespace stellar;
+using namespace stellar::txtest;
+
+namespace
+{
+
+struct HttpReply
+{
+    std::string mStatus;
+    std::string mConnection;
+    std::string mContent;
+};
+
+// A raw HTTP client running on the application's io_service, so that tests
+// control exactly how requests are split, pipelined and kept alive.
+class HttpTestClient
+{
+    struct State
+    {
+        explicit State(asio::io_service& io) : mSocket(io)
+        {
+        }
+
+        asio::ip::tcp::socket mSocket;
+        std::array<char, 4096> mBuffer;
+        std::string mReceived;
+        bool mConnected{false};
+        bool mClosed{false};
+    };
+
+    VirtualClock& mClock;
+    std::shared_ptr<State> mState;
+    size_t mParsed{0};
+
+    template <typename F>
+    void
+    crankUntil(F const& done)
+    {
+        auto deadline = mClock.now() + std::chrono::seconds(10);
+        while (!done() && mClock.now() < deadline)
+        {
+            mClock.crank(false);
+        }
+    }
+
+    static void
+    read(std::shared_ptr<State> state)
+    {
+        state->mSocket.async_read_some(
+            asio::buffer(state->mBuffer),
+            [state](asio::error_code ec, std::size_t bytes) {
+                if (ec)
+                {
+                    state->mClosed = true;
+                    return;
+                }
+                state->mReceived.append(state->mBuffer.data(), bytes);
+                read(state);
+            });
+    }
+
+    // Parse the next complete reply out of what was received, if any.
+    bool
+    parseReply(HttpReply& reply)
+    {
+        auto const& data = mState->mReceived;
+        auto headersEnd = data.find("\r\n\r\n", mParsed);
+        if (headersEnd == std::string::npos)
+        {
+            return false;
+        }
+
+        auto statusEnd = data.find("\r\n", mParsed);
+        reply.mStatus = data.substr(mParsed, statusEnd - mParsed);
+        size_t length = 0;
+        auto pos = statusEnd + 2;
+        while (pos < headersEnd + 2)
+        {
+            auto lineEnd = data.find("\r\n", pos);
+            auto line = data.substr(pos, lineEnd - pos);
+            auto colon = line.find(": ");
+            auto name = line.substr(0, colon);
+            auto value = line.substr(colon + 2);
+            if (name == "Content-Length")
+            {
+                length = std::stoul(value);
+            }
+            else if (name == "Connection")
+            {
+                reply.mConnection = value;
+            }
+            pos = lineEnd + 2;
+        }
+
+        auto contentStart = headersEnd + 4;
+        if (data.size() < contentStart + length)
+        {
+            return false;
+        }
+        reply.mContent = data.substr(contentStart, length);
+        mParsed = contentStart + length;
+        return true;
+    }
+
+  public:
+    explicit HttpTestClient(Application& app)
+        : mClock(app.getClock())
+        , mState(std::make_shared<State>(app.getClock().getIOService()))
+    {
+        asio::ip::tcp::endpoint endpoint(
+            asio::ip::address::from_string("127.0.0.1"),
+            app.getConfig().HTTP_PORT);
+        auto state = mState;
+        mState->mSocket.async_connect(endpoint, [state](asio::error_code ec) {
+            if (ec)
+            {
+                state->mClosed = true;
+                return;
+            }
+            state->mConnected = true;
+            read(state);
+        });
+        crankUntil([&]() { return mState->mConnected || mState->mClosed; });
+        REQUIRE(mState->mConnected);
+    }
+
+    ~HttpTestClient()
+    {
+        asio::error_code ec;
+        mState->mSocket.close(ec);
+    }
+
+    void
+    send(std::string const& data)
+    {
+        auto buf = std::make_shared<std::string>(data);
+        auto sent = std::make_shared<bool>(false);
+        asio::async_write(mState->mSocket, asio::buffer(*buf),
+                          [buf, sent](asio::error_code, std::size_t) {
+                              *sent = true;
+                          });
+        crankUntil([&]() { return *sent; });
+        REQUIRE(*sent);
+    }
+
+    // Wait for the next `n` replies; fails if the server closes the
+    // connection or does not answer in time.
+    std::vector<HttpReply>
+    receive(size_t n)
+    {
+        std::vector<HttpReply> replies;
+        crankUntil([&]() {
+            HttpReply reply;
+            while (replies.size() < n && parseReply(reply))
+            {
+                replies.push_back(reply);
+            }
+            return replies.size() == n || mState->mClosed;
+        });
+        REQUIRE(replies.size() == n);
+        return replies;
+    }
+
+    // Whether the server closed the connection, after giving it time to.
+    bool
+    closed()
+    {
+        crankUntil([&]() { return mState->mClosed; });
+        return mState->mClosed;
+    }
+};
+
+std::string
+request(std::string const& method, std::string const& uri,
+        std::string const& body = "", bool keepAlive = false,
+        std::string const& contentType = "")
+{
+    std::string res = method + " " + uri + " HTTP/1.1\r\n";
+    res += "Host: localhost\r\n";
+    if (keepAlive)
+    {
+        res += "Connection: keep-alive\r\n";
+    }
+    if (!contentType.empty())
+    {
+        res += "Content-Type: " + contentType + "\r\n";
+    }
+    if (!body.empty())
+    {
+        res += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    return res + "\r\n" + body;
+}
+
+Json::Value
+parseJson(std::string const& content)
+{
+    Json::Value root;
+    Json::Reader reader;
+    REQUIRE(reader.parse(content, root));
+    return root;
+}
+
+std::string
+toBase64(TransactionFramePtr const& tx)
+{
+    return decoder::encode_b64(xdr::xdr_to_opaque(tx->getEnvelope()));
+}
+
+// Frame an envelope as in history archive files: a 4-byte big-endian length
+// with the high bit set, then the XDR record.
+std::string
+toRecord(TransactionFramePtr const& tx)
+{
+    auto bin = xdr::xdr_to_opaque(tx->getEnvelope());
+    uint32_t sz = static_cast<uint32_t>(bin.size()) | 0x80000000;
+    std::string res;
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        res.push_back(static_cast<char>((sz >> shift) & 0xff));
+    }
+    return res + std::string(bin.begin(), bin.end());
+}
+}
+
+TEST_CASE("http server connections", "[commandhandler][http]")
+{
+    VirtualClock clock(VirtualClock::REAL_TIME);
+    auto app = createTestApplication(clock, getTestConfig());
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto a1 = getAccount("A");
+    auto tx = root.tx({createAccount(a1.getPublicKey(), 1000000000)});
+
+    HttpTestClient client(*app);
+
+    SECTION("connection closes after a reply by default")
+    {
+        client.send(request("GET", "/info"));
+        auto replies = client.receive(1);
+        REQUIRE(replies[0].mStatus == "HTTP/1.0 200 OK");
+        REQUIRE(replies[0].mConnection == "close");
+        REQUIRE(parseJson(replies[0].mContent).isMember("info"));
+        REQUIRE(client.closed());
+    }
+
+    SECTION("connection stays open when asked to")
+    {
+        client.send(request("GET", "/info", "", true));
+        auto replies = client.receive(1);
+        REQUIRE(replies[0].mConnection == "keep-alive");
+        REQUIRE(parseJson(replies[0].mContent).isMember("info"));
+
+        client.send(request("GET", "/info"));
+        replies = client.receive(1);
+        REQUIRE(replies[0].mConnection == "close");
+        REQUIRE(parseJson(replies[0].mContent).isMember("info"));
+        REQUIRE(client.closed());
+    }
+
+    SECTION("request body is read up to its Content-Length")
+    {
+        // headers and body arrive separately, the body in two parts
+        auto body = toBase64(tx) + "\n";
+        auto req = request("POST", "/txbatch", body);
+        auto split = req.size() - body.size();
+        client.send(req.substr(0, split));
+        client.send(req.substr(split, body.size() / 2));
+        client.send(req.substr(split + body.size() / 2));
+
+        auto replies = client.receive(1);
+        REQUIRE(replies[0].mStatus == "HTTP/1.0 200 OK");
+        auto res = parseJson(replies[0].mContent);
+        REQUIRE(res.size() == 1);
+        REQUIRE(res[0]["status"].asString() == "PENDING");
+    }
+
+    SECTION("requests over the size limit are rejected")
+    {
+        auto req = request("POST", "/txbatch", "", true);
+        req.insert(req.size() - 2, "Content-Length: 10485761\r\n");
+        client.send(req);
+        auto replies = client.receive(1);
+        REQUIRE(replies[0].mStatus == "HTTP/1.0 400 Bad Request");
+        REQUIRE(replies[0].mConnection == "close");
+        REQUIRE(client.closed());
+    }
+
+    SECTION("malformed Content-Length is rejected")
+    {
+        auto req = request("POST", "/txbatch");
+        req.insert(req.size() - 2, "Content-Length: 12ab\r\n");
+        client.send(req);
+        auto replies = client.receive(1);
+        REQUIRE(replies[0].mStatus == "HTTP/1.0 400 Bad Request");
+        REQUIRE(client.closed());
+    }
+
+    SECTION("pipelined requests are answered in order")
+    {
+        // the asynchronous route is first, so its reply must hold back the
+        // ones after it
+        client.send(request("POST", "/txbatch", toBase64(tx), true) +
+                    request("GET", "/info", "", true) +
+                    request("GET", "/info"));
+        auto replies = client.receive(3);
+        auto res = parseJson(replies[0].mContent);
+        REQUIRE(res.isArray());
+        REQUIRE(res[0]["status"].asString() == "PENDING");
+        REQUIRE(replies[0].mConnection == "keep-alive");
+        REQUIRE(parseJson(replies[1].mContent).isMember("info"));
+        REQUIRE(replies[1].mConnection == "keep-alive");
+        REQUIRE(parseJson(replies[2].mContent).isMember("info"));
+        REQUIRE(replies[2].mConnection == "close");
+        REQUIRE(client.closed());
+    }
+}
+
+TEST_CASE("http server closes idle connections", "[commandhandler][http]")
+{
+    VirtualClock clock(VirtualClock::REAL_TIME);
+    auto cfg = getTestConfig();
+    cfg.HTTP_IDLE_TIMEOUT = 1;
+    auto app = createTestApplication(clock, cfg);
+    app->start();
+
+    SECTION("before the first request")
+    {
+        HttpTestClient client(*app);
+        REQUIRE(client.closed());
+    }
+
+    SECTION("between keep-alive requests")
+    {
+        HttpTestClient client(*app);
+        client.send(request("GET", "/info", "", true));
+        auto replies = client.receive(1);
+        REQUIRE(replies[0].mConnection == "keep-alive");
+        REQUIRE(client.closed());
+    }
+
+    SECTION("not while a request keeps arriving")
+    {
+        HttpTestClient client(*app);
+        auto req = request("GET", "/info");
+        for (auto c : req)
+        {
+            client.send(std::string(1, c));
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        auto replies = client.receive(1);
+        REQUIRE(replies[0].mStatus == "HTTP/1.0 200 OK");
+    }
+}
+
+TEST_CASE("txbatch", "[commandhandler][herder]")
+{
+    VirtualClock clock(VirtualClock::REAL_TIME);
+    auto app = createTestApplication(clock, getTestConfig());
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto a1 = getAccount("A");
+    auto b1 = getAccount("B");
+    auto tx1 = root.tx({createAccount(a1.getPublicKey(), 1000000000)});
+    auto tx2 = root.tx({createAccount(b1.getPublicKey(), 1000000000)});
+    // leaves a gap after tx2
+    auto badSeq = root.tx({payment(a1.getPublicKey(), 100)},
+                          root.getLastSequenceNumber() + 10);
+
+    HttpTestClient client(*app);
+
+    SECTION("one status per base64 envelope")
+    {
+        client.send(request("POST", "/txbatch",
+                            toBase64(tx1) + "\n" + toBase64(tx1) + "\r\n" +
+                                "AAAA\n\n" + toBase64(badSeq) + "\n" +
+                                toBase64(tx2)));
+        auto res = parseJson(client.receive(1)[0].mContent);
+        REQUIRE(res.size() == 5);
+        REQUIRE(res[0]["status"].asString() == "PENDING");
+        REQUIRE(res[1]["status"].asString() == "DUPLICATE");
+        REQUIRE(res[2].isMember("exception"));
+        REQUIRE(res[3]["status"].asString() == "ERROR");
+        REQUIRE(res[3].isMember("error"));
+        REQUIRE(res[4]["status"].asString() == "PENDING");
+        REQUIRE(app->getHerder().getMaxSeqInPendingTxs(root) ==
+                tx2->getSeqNum());
+    }
+
+    SECTION("one status per binary record")
+    {
+        client.send(request("POST", "/txbatch",
+                            toRecord(tx1) + toRecord(badSeq) + toRecord(tx2),
+                            false, "application/octet-stream"));
+        auto res = parseJson(client.receive(1)[0].mContent);
+        REQUIRE(res.size() == 3);
+        REQUIRE(res[0]["status"].asString() == "PENDING");
+        REQUIRE(res[1]["status"].asString() == "ERROR");
+        REQUIRE(res[2]["status"].asString() == "PENDING");
+    }
+
+    SECTION("truncated binary record fails the batch")
+    {
+        auto body = toRecord(tx1) + toRecord(tx2);
+        body.pop_back();
+        client.send(request("POST", "/txbatch", body, false,
+                            "application/octet-stream"));
+        auto res = parseJson(client.receive(1)[0].mContent);
+        REQUIRE(res.isMember("exception"));
+        REQUIRE(app->getHerder().getMaxSeqInPendingTxs(root) == 0);
+    }
+
+    SECTION("only POST is accepted")
+    {
+        client.send(request("GET", "/txbatch"));
+        auto res = parseJson(client.receive(1)[0].mContent);
+        REQUIRE(res.isMember("exception"));
+    }
+}
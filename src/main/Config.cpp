@@ -20,6 +20,7 @@
 #include <functional>
 #include <lib/util/format.h>
 #include <sstream>
+#include <thread>
 #include <unordered_set>
 
 namespace stellar
@@ -45,7 +46,7 @@ Config::Config() : NODE_SEED(SecretKey::random())
     LEDGER_PROTOCOL_VERSION = CURRENT_LEDGER_PROTOCOL_VERSION;
 
     OVERLAY_PROTOCOL_MIN_VERSION = 6;
-    OVERLAY_PROTOCOL_VERSION = 7;
+    OVERLAY_PROTOCOL_VERSION = 9;
 
     VERSION_STR = STELLAR_CORE_VERSION;
 
@@ -54,12 +55,15 @@ Config::Config() : NODE_SEED(SecretKey::random())
     MANUAL_CLOSE = false;
     CATCHUP_COMPLETE = false;
     CATCHUP_RECENT = 0;
+    CATCHUP_SEGMENT_CHECKPOINTS = 0;
+    MAX_CONCURRENT_CATCHUP_SEGMENTS = 4;
     AUTOMATIC_MAINTENANCE_PERIOD = std::chrono::seconds{14400};
     AUTOMATIC_MAINTENANCE_COUNT = 50000;
     ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING = false;
     ARTIFICIALLY_ACCELERATE_TIME_FOR_TESTING = false;
     ARTIFICIALLY_SET_CLOSE_TIME_FOR_TESTING = 0;
     ARTIFICIALLY_PESSIMIZE_MERGES_FOR_TESTING = false;
+    ARTIFICIALLY_USE_SAVEPOINTS_FOR_TESTING = false;
     ALLOW_LOCALHOST_FOR_TESTING = false;
     USE_CONFIG_FOR_GENESIS = false;
     FAILURE_SAFETY = -1;
@@ -67,6 +71,8 @@ Config::Config() : NODE_SEED(SecretKey::random())
 
     LOG_FILE_PATH = "stellar-core.%datetime{%Y.%M.%d-%H:%m:%s}.log";
     BUCKET_DIR_PATH = "buckets";
+    HISTORY_CACHE_DIR_PATH = "";
+    HISTORY_CACHE_SIZE_MB = 4096;
 
     TESTING_UPGRADE_DESIRED_FEE = LedgerManager::GENESIS_LEDGER_BASE_FEE;
     TESTING_UPGRADE_RESERVE = LedgerManager::GENESIS_LEDGER_BASE_RESERVE;
@@ -75,6 +81,9 @@ Config::Config() : NODE_SEED(SecretKey::random())
     HTTP_PORT = DEFAULT_PEER_PORT + 1;
     PUBLIC_HTTP_PORT = false;
     HTTP_MAX_CLIENT = 128;
+    HTTP_IDLE_TIMEOUT = 30;
+    TRANSACTION_QUEUE_SIZE_LIMIT = 10000;
+    TRANSACTION_QUEUE_BYTES_LIMIT = 32 * 1024 * 1024;
     PEER_PORT = DEFAULT_PEER_PORT;
     TARGET_PEER_CONNECTIONS = 8;
     MAX_ADDITIONAL_PEER_CONNECTIONS = -1;
@@ -83,10 +92,17 @@ Config::Config() : NODE_SEED(SecretKey::random())
     PEER_AUTHENTICATION_TIMEOUT = 2;
     PEER_TIMEOUT = 30;
     PREFERRED_PEERS_ONLY = false;
+    ENABLE_PULL_MODE = false;
+    FETCH_FANOUT = 2;
 
     MINIMUM_IDLE_PERCENT = 0;
 
     MAX_CONCURRENT_SUBPROCESSES = 16;
+    WORKER_THREADS = std::thread::hardware_concurrency();
+    MAX_CONCURRENT_BUCKET_MERGES = 4;
+    INVARIANT_CHECKS_ASYNC = false;
+    INVARIANT_CHECKS_SAMPLE_PERCENT = 100;
+    VERIFY_INFLATION_VOTES = false;
     NODE_IS_VALIDATOR = false;
 
     DATABASE = SecretValue{"sqlite3://:memory:"};
@@ -282,6 +298,19 @@ Config::load(std::string const& filename)
             {
                 HTTP_MAX_CLIENT = readInt<unsigned short>(item, 0, UINT16_MAX);
             }
+            else if (item.first == "HTTP_IDLE_TIMEOUT")
+            {
+                HTTP_IDLE_TIMEOUT =
+                    readInt<unsigned short>(item, 1, UINT16_MAX);
+            }
+            else if (item.first == "TRANSACTION_QUEUE_SIZE_LIMIT")
+            {
+                TRANSACTION_QUEUE_SIZE_LIMIT = readInt<uint32_t>(item, 0);
+            }
+            else if (item.first == "TRANSACTION_QUEUE_BYTES_LIMIT")
+            {
+                TRANSACTION_QUEUE_BYTES_LIMIT = readInt<uint32_t>(item, 0);
+            }
             else if (item.first == "PUBLIC_HTTP_PORT")
             {
                 PUBLIC_HTTP_PORT = readBool(item);
@@ -318,6 +347,15 @@ Config::load(std::string const& filename)
             {
                 CATCHUP_RECENT = readInt<uint32_t>(item, 0, UINT32_MAX - 1);
             }
+            else if (item.first == "CATCHUP_SEGMENT_CHECKPOINTS")
+            {
+                CATCHUP_SEGMENT_CHECKPOINTS = readInt<uint32_t>(item, 0);
+            }
+            else if (item.first == "MAX_CONCURRENT_CATCHUP_SEGMENTS")
+            {
+                MAX_CONCURRENT_CATCHUP_SEGMENTS =
+                    static_cast<size_t>(readInt<int>(item, 1));
+            }
             else if (item.first == "ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING")
             {
                 ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING = readBool(item);
@@ -362,6 +400,14 @@ Config::load(std::string const& filename)
             {
                 BUCKET_DIR_PATH = readString(item);
             }
+            else if (item.first == "HISTORY_CACHE_DIR_PATH")
+            {
+                HISTORY_CACHE_DIR_PATH = readString(item);
+            }
+            else if (item.first == "HISTORY_CACHE_SIZE_MB")
+            {
+                HISTORY_CACHE_SIZE_MB = readInt<uint32_t>(item, 1);
+            }
             else if (item.first == "NODE_NAMES")
             {
                 auto names = readStringArray(item);
@@ -419,6 +465,14 @@ Config::load(std::string const& filename)
             {
                 PREFERRED_PEERS_ONLY = readBool(item);
             }
+            else if (item.first == "ENABLE_PULL_MODE")
+            {
+                ENABLE_PULL_MODE = readBool(item);
+            }
+            else if (item.first == "FETCH_FANOUT")
+            {
+                FETCH_FANOUT = readInt<unsigned short>(item, 1, UINT16_MAX);
+            }
             else if (item.first == "KNOWN_PEERS")
             {
                 KNOWN_PEERS = readStringArray(item);
@@ -436,6 +490,15 @@ Config::load(std::string const& filename)
                 MAX_CONCURRENT_SUBPROCESSES =
                     static_cast<size_t>(readInt<int>(item, 1));
             }
+            else if (item.first == "WORKER_THREADS")
+            {
+                WORKER_THREADS = static_cast<size_t>(readInt<int>(item, 1));
+            }
+            else if (item.first == "MAX_CONCURRENT_BUCKET_MERGES")
+            {
+                MAX_CONCURRENT_BUCKET_MERGES =
+                    static_cast<size_t>(readInt<int>(item, 1));
+            }
             else if (item.first == "MINIMUM_IDLE_PERCENT")
             {
                 MINIMUM_IDLE_PERCENT = readInt<uint32_t>(item, 0, 100);
@@ -504,6 +567,19 @@ Config::load(std::string const& filename)
             {
                 INVARIANT_CHECKS = readStringArray(item);
             }
+            else if (item.first == "INVARIANT_CHECKS_ASYNC")
+            {
+                INVARIANT_CHECKS_ASYNC = readBool(item);
+            }
+            else if (item.first == "INVARIANT_CHECKS_SAMPLE_PERCENT")
+            {
+                INVARIANT_CHECKS_SAMPLE_PERCENT =
+                    readInt<uint32_t>(item, 1, 100);
+            }
+            else if (item.first == "VERIFY_INFLATION_VOTES")
+            {
+                VERIFY_INFLATION_VOTES = readBool(item);
+            }
             else
             {
                 std::string err("Unknown configuration entry: '");
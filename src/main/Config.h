@@ -85,6 +85,18 @@ class Config : public std::enable_shared_from_this<Config>
     // If you want, say, a week of history, set this to 120000.
     uint32_t CATCHUP_RECENT;
 
+    // Number of checkpoints in each segment of a catchup that replays
+    // transactions without applying buckets first (always the case with
+    // CATCHUP_COMPLETE). Segments are downloaded and verified independently,
+    // and a cursor of verified segments is kept in the database so that an
+    // interrupted catchup can resume. Default is 0, meaning catchup downloads
+    // and verifies the whole range at once.
+    uint32_t CATCHUP_SEGMENT_CHECKPOINTS;
+
+    // Number of catchup segments downloaded, verified or waiting to be
+    // applied at a time.
+    size_t MAX_CONCURRENT_CATCHUP_SEGMENTS;
+
     // Interval between automatic maintenance executions
     std::chrono::seconds AUTOMATIC_MAINTENANCE_PERIOD;
 
@@ -113,6 +125,11 @@ class Config : public std::enable_shared_from_this<Config>
     // and should be false in all normal cases.
     bool ARTIFICIALLY_PESSIMIZE_MERGES_FOR_TESTING;
 
+    // A config parameter that contains failed transactions and offers in SQL
+    // savepoints on SQLite too, as is always done on PostgreSQL; this option
+    // exists only to compare both ways of rolling back in benchmarks.
+    bool ARTIFICIALLY_USE_SAVEPOINTS_FOR_TESTING;
+
     // A config to allow connections to localhost
     // this should only be enabled when testing as it's a security issue
     bool ALLOW_LOCALHOST_FOR_TESTING;
@@ -146,14 +163,30 @@ class Config : public std::enable_shared_from_this<Config>
     std::string VERSION_STR;
     std::string LOG_FILE_PATH;
     std::string BUCKET_DIR_PATH;
+
+    // Directory of a cache of files downloaded from history archives, which
+    // can be shared by several stellar-core processes on the same host.
+    // Default is "", meaning no cache.
+    std::string HISTORY_CACHE_DIR_PATH;
+    // Size the history cache is trimmed back to, least recently used files
+    // first.
+    uint64_t HISTORY_CACHE_SIZE_MB;
     uint32_t TESTING_UPGRADE_DESIRED_FEE; // in stroops
     uint32_t TESTING_UPGRADE_RESERVE;     // in stroops
     uint32_t TESTING_UPGRADE_MAX_TX_PER_LEDGER;
     unsigned short HTTP_PORT; // what port to listen for commands
     bool PUBLIC_HTTP_PORT;    // if you accept commands from not localhost
     int HTTP_MAX_CLIENT;      // maximum number of http clients, i.e backlog
+    unsigned short HTTP_IDLE_TIMEOUT; // seconds before an idle client is
+                                      // disconnected
     std::string NETWORK_PASSPHRASE; // identifier for the network
 
+    // Maximum number and serialized size of the transactions waiting to be
+    // included in a ledger. Past either, the accounts whose transactions pay
+    // the lowest fee per operation are dropped.
+    uint32_t TRANSACTION_QUEUE_SIZE_LIMIT;
+    uint32_t TRANSACTION_QUEUE_BYTES_LIMIT;
+
     // overlay config
     unsigned short PEER_PORT;
     unsigned short TARGET_PEER_CONNECTIONS;
@@ -173,6 +206,14 @@ class Config : public std::enable_shared_from_this<Config>
     // Whether to exclude peers that are not preferred.
     bool PREFERRED_PEERS_ONLY;
 
+    // Whether to flood transactions by advertising their hashes to the peers
+    // that support it, and letting them ask for the ones they miss, instead
+    // of sending the transactions themselves.
+    bool ENABLE_PULL_MODE;
+
+    // Number of peers asked in parallel for a missing tx set or quorum set.
+    unsigned short FETCH_FANOUT;
+
     // Percentage, between 0 and 100, of system activity (measured in terms
     // of both event-loop cycles and database time) below-which the system
     // will consider itself "loaded" and attempt to shed load. Set this
@@ -184,6 +225,12 @@ class Config : public std::enable_shared_from_this<Config>
     // process-management config
     size_t MAX_CONCURRENT_SUBPROCESSES;
 
+    // Number of threads serving the worker io_service.
+    size_t WORKER_THREADS;
+
+    // Number of threads dedicated to merging buckets in the BucketList.
+    size_t MAX_CONCURRENT_BUCKET_MERGES;
+
     // SCP config
     SecretKey NODE_SEED;
     bool NODE_IS_VALIDATOR;
@@ -191,6 +238,16 @@ class Config : public std::enable_shared_from_this<Config>
 
     // Invariants
     std::vector<std::string> INVARIANT_CHECKS;
+    // Check the per-operation invariants that allow it on a worker thread,
+    // against copies of each operation's changes and a database snapshot
+    // taken when the ledger commits, instead of during ledger close.
+    bool INVARIANT_CHECKS_ASYNC;
+    // Percentage of ledgers whose operations are checked by the invariants
+    // deferred by INVARIANT_CHECKS_ASYNC.
+    uint32_t INVARIANT_CHECKS_SAMPLE_PERCENT;
+    // Have inflation also sum the votes from the accounts table and stop if
+    // the result differs from the incrementally maintained tally.
+    bool VERIFY_INFLATION_VOTES;
 
     std::map<std::string, std::string> VALIDATOR_NAMES;
 
@@ -15,7 +15,7 @@ using namespace std;
 string PersistentState::mapping[kLastEntry] = {
     "lastclosedledger", "historyarchivestate", "forcescponnextlaunch",
     "lastscpdata",      "databaseschema",      "networkpassphrase",
-    "ledgerupgrades"};
+    "ledgerupgrades",   "catchupcursor",       "inflationvotesdirty"};
 
 string PersistentState::kSQLCreateStatement =
     "CREATE TABLE IF NOT EXISTS storestate ("
@@ -24,6 +24,8 @@ class PersistentState
         kDatabaseSchema,
         kNetworkPassphrase,
         kLedgerUpgrades,
+        kCatchupCursor,
+        kInflationVotesDirty,
         kLastEntry,
     };
 
@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "TCPPeer.h"
+#include "crypto/SHA.h"
 #include "herder/Herder.h"
 #include "herder/HerderImpl.h"
 #include "ledger/LedgerDelta.h"
@@ -10,16 +11,22 @@
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/Config.h"
+#include "overlay/LoopbackPeer.h"
 #include "overlay/OverlayManager.h"
 #include "overlay/PeerDoor.h"
 #include "simulation/Simulation.h"
 #include "simulation/Topologies.h"
 #include "test/TestAccount.h"
+#include "test/TestUtils.h"
 #include "test/TxTests.h"
 #include "test/test.h"
 #include "util/Logging.h"
 #include "util/Timer.h"
 
+#include "medida/counter.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
 namespace stellar
 {
 using namespace txtest;
@@ -29,10 +36,13 @@ TEST_CASE("Flooding", "[flood][overlay]")
     Hash networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
     Simulation::pointer simulation;
 
+    bool pullMode = false;
+
     // make closing very slow
-    auto cfgGen = [](int cfgNum) {
+    auto cfgGen = [&](int cfgNum) {
         Config cfg = getTestConfig(cfgNum);
         cfg.ARTIFICIALLY_SET_CLOSE_TIME_FOR_TESTING = 10000;
+        cfg.ENABLE_PULL_MODE = pullMode;
         return cfg;
     };
 
@@ -47,6 +57,7 @@ TEST_CASE("Flooding", "[flood][overlay]")
                     std::function<bool(std::shared_ptr<Application>)> acked) {
         simulation->startAllNodes();
 
+        sources.clear();
         nodes = simulation->getNodes();
         std::shared_ptr<Application> app0 = nodes[0];
 
@@ -181,6 +192,52 @@ TEST_CASE("Flooding", "[flood][overlay]")
             }
         }
 
+        SECTION("pull mode")
+        {
+            pullMode = true;
+            SECTION("core")
+            {
+                simulation = Topologies::core(
+                    4, .666f, Simulation::OVER_LOOPBACK, networkID, cfgGen);
+                test(injectTransaction, ackedTransactions);
+            }
+            SECTION("outer nodes")
+            {
+                simulation = Topologies::hierarchicalQuorumSimplified(
+                    5, 10, Simulation::OVER_LOOPBACK, networkID, cfgGen);
+                test(injectTransaction, ackedTransactions);
+            }
+        }
+
+        SECTION("bytes per transaction")
+        {
+            // bytes spent flooding the transactions, over all nodes
+            auto run = [&](bool pull) {
+                nodes.clear();
+                simulation.reset();
+                pullMode = pull;
+                simulation = Topologies::core(
+                    4, .666f, Simulation::OVER_LOOPBACK, networkID, cfgGen);
+                test(injectTransaction, ackedTransactions);
+
+                double bytes = 0;
+                for (auto n : simulation->getNodes())
+                {
+                    bytes += n->getMetrics()
+                                 .NewMeter({"overlay", "byte", "tx-flood"},
+                                           "byte")
+                                 .count();
+                }
+                return bytes / nbTx;
+            };
+
+            auto pushBytes = run(false);
+            auto pullBytes = run(true);
+            LOG(INFO) << "bytes per transaction: " << pushBytes
+                      << " pushed, " << pullBytes << " pulled";
+            REQUIRE(pullBytes < pushBytes);
+        }
+
         SECTION("outer nodes")
         {
             SECTION("loopback")
@@ -341,4 +398,49 @@ TEST_CASE("Flooding", "[flood][overlay]")
         }
     }
 }
+
+TEST_CASE("Flood adverts past the demand limits are ignored",
+          "[flood][overlay]")
+{
+    VirtualClock clock;
+    auto app1 = createTestApplication(clock, getTestConfig(0));
+    auto app2 = createTestApplication(clock, getTestConfig(1));
+
+    LoopbackPeerConnection conn(*app1, *app2);
+    testutil::crankSome(clock);
+    REQUIRE(conn.getAcceptor()->isAuthenticated());
+
+    auto& demands =
+        app2->getMetrics().NewCounter({"overlay", "memory", "flood-demands"});
+    auto& ignored = app2->getMetrics().NewMeter(
+        {"overlay", "flood", "advert-ignored"}, "transaction");
+
+    // made up hashes, that will never be delivered
+    uint32_t n = 0;
+    std::vector<StellarMessage> adverts(5);
+    for (auto& msg : adverts)
+    {
+        msg.type(FLOOD_ADVERT);
+        for (uint32_t j = 0; j < TX_ADVERT_VECTOR_MAX_SIZE; j++)
+        {
+            msg.floodAdvert().txHashes.push_back(
+                sha256(std::to_string(n++)));
+        }
+        conn.getInitiator()->sendMessage(msg);
+    }
+    testutil::crankSome(clock);
+
+    REQUIRE(demands.count() == 4 * TX_ADVERT_VECTOR_MAX_SIZE);
+    REQUIRE(ignored.count() == TX_ADVERT_VECTOR_MAX_SIZE);
+
+    // hashes already advertised by the peer do not count twice
+    conn.getInitiator()->sendMessage(adverts[0]);
+    testutil::crankSome(clock);
+    REQUIRE(demands.count() == 4 * TX_ADVERT_VECTOR_MAX_SIZE);
+    REQUIRE(ignored.count() == TX_ADVERT_VECTOR_MAX_SIZE);
+
+    conn.getAcceptor()->drop();
+    testutil::crankSome(clock);
+    REQUIRE(demands.count() == 0);
+}
 }
@@ -7,15 +7,27 @@
 #include "crypto/SHA.h"
 #include "herder/Herder.h"
 #include "main/Application.h"
+#include "main/Config.h"
 #include "medida/counter.h"
 #include "medida/metrics_registry.h"
 #include "overlay/OverlayManager.h"
 #include "util/Logging.h"
 #include "util/XDROperators.h"
 #include "xdrpp/marshal.h"
+#include <algorithm>
 
 namespace stellar
 {
+
+// how long adverts and demands are held, so that they are sent in batches
+static const std::chrono::milliseconds FLOOD_FLUSH_PERIOD(100);
+// how long to wait for a demanded transaction before asking another peer
+static const std::chrono::milliseconds FLOOD_DEMAND_TIMEOUT(1000);
+// how many advertised transactions we wait for, from a single peer and
+// overall, so that adverts of made up hashes cannot take unbounded memory
+static const size_t FLOOD_DEMANDS_PER_PEER_MAX = 4 * TX_ADVERT_VECTOR_MAX_SIZE;
+static const size_t FLOOD_DEMANDS_MAX = 40 * TX_ADVERT_VECTOR_MAX_SIZE;
+
 Floodgate::FloodRecord::FloodRecord(StellarMessage const& msg, uint32_t ledger,
                                     Peer::pointer peer)
     : mLedgerSeq(ledger), mMessage(msg)
@@ -25,11 +37,23 @@ Floodgate::FloodRecord::FloodRecord(StellarMessage const& msg, uint32_t ledger,
 }
 
 Floodgate::Floodgate(Application& app)
-    : mApp(app)
+    : mFlushTimer(app)
+    , mFlushPending(false)
+    , mApp(app)
     , mFloodMapSize(
           app.getMetrics().NewCounter({"overlay", "memory", "flood-map"}))
     , mSendFromBroadcast(app.getMetrics().NewMeter(
           {"overlay", "message", "send-from-broadcast"}, "message"))
+    , mAdvertsSent(app.getMetrics().NewMeter(
+          {"overlay", "flood", "advert-sent"}, "message"))
+    , mDemandsSent(app.getMetrics().NewMeter(
+          {"overlay", "flood", "demand-sent"}, "message"))
+    , mDemandsFulfilled(app.getMetrics().NewMeter(
+          {"overlay", "flood", "demand-fulfilled"}, "transaction"))
+    , mDemandsSize(
+          app.getMetrics().NewCounter({"overlay", "memory", "flood-demands"}))
+    , mAdvertsIgnored(app.getMetrics().NewMeter(
+          {"overlay", "flood", "advert-ignored"}, "transaction"))
     , mShuttingDown(false)
 {
 }
@@ -50,22 +74,78 @@ Floodgate::clearBelow(uint32_t currentLedger)
             ++it;
         }
     }
+    for (auto it = mDemands.begin(); it != mDemands.end();)
+    {
+        if (it->second.mLedgerSeq + 10 < currentLedger)
+        {
+            it = eraseDemand(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
     mFloodMapSize.set_count(mFloodMap.size());
+    mDemandsSize.set_count(mDemands.size());
+}
+
+std::map<uint256, Floodgate::DemandRecord>::iterator
+Floodgate::eraseDemand(std::map<uint256, DemandRecord>::iterator it)
+{
+    for (auto const& peer : it->second.mAdvertisers)
+    {
+        auto count = mDemandsPerPeer.find(peer);
+        if (count != mDemandsPerPeer.end() && --count->second == 0)
+        {
+            mDemandsPerPeer.erase(count);
+        }
+    }
+    return mDemands.erase(it);
+}
+
+Floodgate::FloodRecord::pointer
+Floodgate::newRecord(uint256 const& index, StellarMessage const& msg,
+                     Peer::pointer peer)
+{
+    auto record = std::make_shared<FloodRecord>(
+        msg, mApp.getHerder().getCurrentLedgerSeq(), peer);
+
+    // peers that advertised the message already have it
+    auto demand = mDemands.find(index);
+    if (demand != mDemands.end())
+    {
+        record->mPeersTold.insert(demand->second.mAdvertisers.begin(),
+                                  demand->second.mAdvertisers.end());
+        eraseDemand(demand);
+        mDemandsSize.set_count(mDemands.size());
+    }
+    return record;
+}
+
+Hash
+Floodgate::messageHash(StellarMessage const& msg)
+{
+    return sha256(xdr::xdr_to_opaque(msg));
 }
 
 bool
 Floodgate::addRecord(StellarMessage const& msg, Peer::pointer peer)
+{
+    return addRecord(msg, peer, messageHash(msg));
+}
+
+bool
+Floodgate::addRecord(StellarMessage const& msg, Peer::pointer peer,
+                     Hash const& index)
 {
     if (mShuttingDown)
     {
         return false;
     }
-    Hash index = sha256(xdr::xdr_to_opaque(msg));
     auto result = mFloodMap.find(index);
     if (result == mFloodMap.end())
     { // we have never seen this message
-        mFloodMap[index] = std::make_shared<FloodRecord>(
-            msg, mApp.getHerder().getCurrentLedgerSeq(), peer);
+        mFloodMap[index] = newRecord(index, msg, peer);
         mFloodMapSize.set_count(mFloodMap.size());
         return true;
     }
@@ -79,19 +159,23 @@ Floodgate::addRecord(StellarMessage const& msg, Peer::pointer peer)
 // send message to anyone you haven't gotten it from
 void
 Floodgate::broadcast(StellarMessage const& msg, bool force)
+{
+    broadcast(msg, force, messageHash(msg));
+}
+
+void
+Floodgate::broadcast(StellarMessage const& msg, bool force, Hash const& index)
 {
     if (mShuttingDown)
     {
         return;
     }
-    Hash index = sha256(xdr::xdr_to_opaque(msg));
     CLOG(TRACE, "Overlay") << "broadcast " << hexAbbrev(index);
 
     auto result = mFloodMap.find(index);
     if (result == mFloodMap.end() || force)
     { // no one has sent us this message
-        FloodRecord::pointer record = std::make_shared<FloodRecord>(
-            msg, mApp.getHerder().getCurrentLedgerSeq(), Peer::pointer());
+        FloodRecord::pointer record = newRecord(index, msg, Peer::pointer());
         result = mFloodMap.insert(std::make_pair(index, record)).first;
         mFloodMapSize.set_count(mFloodMap.size());
     }
@@ -101,13 +185,22 @@ Floodgate::broadcast(StellarMessage const& msg, bool force)
     // make a copy, in case peers gets modified
     auto peers = mApp.getOverlayManager().getAuthenticatedPeers();
 
+    bool pull =
+        msg.type() == TRANSACTION && mApp.getConfig().ENABLE_PULL_MODE;
     for (auto peer : peers)
     {
         assert(peer.second->isAuthenticated());
         if (peersTold.find(peer.second) == peersTold.end())
         {
             mSendFromBroadcast.Mark();
-            peer.second->sendMessage(msg);
+            if (pull && peer.second->supportsAdverts())
+            {
+                queueAdvert(peer.second, index);
+            }
+            else
+            {
+                peer.second->sendMessage(msg);
+            }
             peersTold.insert(peer.second);
         }
     }
@@ -127,10 +220,228 @@ Floodgate::getPeersKnows(Hash const& h)
     return res;
 }
 
+void
+Floodgate::queueAdvert(Peer::pointer peer, Hash const& h)
+{
+    auto& hashes = mPendingAdverts[peer];
+    hashes.emplace_back(h);
+    if (hashes.size() >= TX_ADVERT_VECTOR_MAX_SIZE)
+    {
+        sendAdvert(peer, hashes);
+    }
+    else
+    {
+        scheduleFlush();
+    }
+}
+
+void
+Floodgate::sendAdvert(Peer::pointer peer, std::vector<Hash>& hashes)
+{
+    if (peer->isAuthenticated() && !hashes.empty())
+    {
+        StellarMessage msg;
+        msg.type(FLOOD_ADVERT);
+        msg.floodAdvert().txHashes.assign(hashes.begin(), hashes.end());
+        mAdvertsSent.Mark();
+        peer->sendMessage(msg);
+    }
+    hashes.clear();
+}
+
+void
+Floodgate::scheduleFlush()
+{
+    if (mFlushPending || mShuttingDown)
+    {
+        return;
+    }
+    mFlushPending = true;
+    mFlushTimer.expires_from_now(FLOOD_FLUSH_PERIOD);
+    mFlushTimer.async_wait(
+        [this]() {
+            mFlushPending = false;
+            flush();
+        },
+        &VirtualTimer::onFailureNoop);
+}
+
+void
+Floodgate::flush()
+{
+    if (mShuttingDown)
+    {
+        return;
+    }
+
+    for (auto& adverts : mPendingAdverts)
+    {
+        sendAdvert(adverts.first, adverts.second);
+    }
+    mPendingAdverts.clear();
+
+    auto now = mApp.getClock().now();
+    std::map<Peer::pointer, std::vector<Hash>> demands;
+    bool waiting = false;
+    for (auto& d : mDemands)
+    {
+        auto& record = d.second;
+        if (record.mDemanded &&
+            now < record.mLastDemand + FLOOD_DEMAND_TIMEOUT)
+        {
+            waiting = waiting || !record.mToAsk.empty();
+            continue;
+        }
+        while (!record.mToAsk.empty())
+        {
+            auto peer = record.mToAsk.front();
+            record.mToAsk.pop_front();
+            if (peer->isAuthenticated())
+            {
+                demands[peer].emplace_back(d.first);
+                record.mDemanded = true;
+                record.mLastDemand = now;
+                waiting = waiting || !record.mToAsk.empty();
+                break;
+            }
+        }
+    }
+
+    for (auto const& d : demands)
+    {
+        auto const& hashes = d.second;
+        for (size_t i = 0; i < hashes.size(); i += TX_DEMAND_VECTOR_MAX_SIZE)
+        {
+            auto end = std::min<size_t>(hashes.size(),
+                                        i + TX_DEMAND_VECTOR_MAX_SIZE);
+            StellarMessage msg;
+            msg.type(FLOOD_DEMAND);
+            msg.floodDemand().txHashes.assign(hashes.begin() + i,
+                                              hashes.begin() + end);
+            mDemandsSent.Mark();
+            d.first->sendMessage(msg);
+        }
+    }
+
+    if (waiting)
+    {
+        scheduleFlush();
+    }
+}
+
+void
+Floodgate::recvFloodAdvert(FloodAdvert const& advert, Peer::pointer peer)
+{
+    if (mShuttingDown)
+    {
+        return;
+    }
+
+    auto& peerDemands = mDemandsPerPeer[peer];
+    for (auto const& h : advert.txHashes)
+    {
+        auto record = mFloodMap.find(h);
+        if (record != mFloodMap.end())
+        {
+            record->second->mPeersTold.insert(peer);
+            continue;
+        }
+
+        auto demand = mDemands.find(h);
+        if (demand != mDemands.end() &&
+            demand->second.mAdvertisers.count(peer) != 0)
+        {
+            continue;
+        }
+        if (peerDemands >= FLOOD_DEMANDS_PER_PEER_MAX ||
+            (demand == mDemands.end() && mDemands.size() >= FLOOD_DEMANDS_MAX))
+        {
+            mAdvertsIgnored.Mark();
+            continue;
+        }
+
+        if (demand == mDemands.end())
+        {
+            demand = mDemands.emplace(h, DemandRecord()).first;
+            demand->second.mLedgerSeq = mApp.getHerder().getCurrentLedgerSeq();
+        }
+        demand->second.mAdvertisers.insert(peer);
+        demand->second.mToAsk.emplace_back(peer);
+        peerDemands++;
+    }
+    if (peerDemands == 0)
+    {
+        mDemandsPerPeer.erase(peer);
+    }
+    mDemandsSize.set_count(mDemands.size());
+    scheduleFlush();
+}
+
+void
+Floodgate::recvFloodDemand(FloodDemand const& demand, Peer::pointer peer)
+{
+    if (mShuttingDown)
+    {
+        return;
+    }
+
+    for (auto const& h : demand.txHashes)
+    {
+        auto record = mFloodMap.find(h);
+        if (record != mFloodMap.end() &&
+            record->second->mMessage.type() == TRANSACTION)
+        {
+            mDemandsFulfilled.Mark();
+            peer->sendMessage(record->second->mMessage);
+        }
+    }
+}
+
+void
+Floodgate::forgetPeer(Peer* peer)
+{
+    auto isPeer = [peer](Peer::pointer const& p) { return p.get() == peer; };
+    for (auto it = mDemands.begin(); it != mDemands.end();)
+    {
+        auto& record = it->second;
+        record.mToAsk.erase(
+            std::remove_if(record.mToAsk.begin(), record.mToAsk.end(), isPeer),
+            record.mToAsk.end());
+        for (auto a = record.mAdvertisers.begin();
+             a != record.mAdvertisers.end();)
+        {
+            a = isPeer(*a) ? record.mAdvertisers.erase(a) : std::next(a);
+        }
+
+        if (record.mAdvertisers.empty())
+        {
+            it = mDemands.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    mDemandsSize.set_count(mDemands.size());
+
+    for (auto it = mDemandsPerPeer.begin(); it != mDemandsPerPeer.end();)
+    {
+        it = isPeer(it->first) ? mDemandsPerPeer.erase(it) : std::next(it);
+    }
+    for (auto it = mPendingAdverts.begin(); it != mPendingAdverts.end();)
+    {
+        it = isPeer(it->first) ? mPendingAdverts.erase(it) : std::next(it);
+    }
+}
+
 void
 Floodgate::shutdown()
 {
     mShuttingDown = true;
+    mFlushTimer.cancel();
     mFloodMap.clear();
+    mDemands.clear();
+    mDemandsPerPeer.clear();
+    mPendingAdverts.clear();
 }
 }
@@ -6,6 +6,8 @@
 
 #include "overlay/Peer.h"
 #include "overlay/StellarXDR.h"
+#include "util/Timer.h"
+#include <deque>
 #include <map>
 
 /**
@@ -19,6 +21,15 @@
  * All messages are marked with the ledger sequence number to which they
  * relate, and all flood-management information for a given ledger number
  * is purged from the FloodGate when the ledger closes.
+ *
+ * In pull mode (ENABLE_PULL_MODE), transactions are not sent to the peers
+ * that support FLOOD_ADVERT: their hashes are queued per peer and sent in
+ * batches. A peer receiving an advert for a transaction it does not know asks
+ * one of the advertisers for it with a FLOOD_DEMAND, and moves on to the next
+ * advertiser if the transaction does not show up in time. Hashes in adverts
+ * and demands are the same as the flood map's: the hash of the TRANSACTION
+ * message. Advertised hashes are only tracked up to a limit, per peer and
+ * overall; adverts past it are ignored.
  */
 
 namespace medida
@@ -44,24 +55,73 @@ class Floodgate
                     Peer::pointer peer);
     };
 
+    // transaction advertised to us that we do not have yet
+    struct DemandRecord
+    {
+        uint32_t mLedgerSeq;
+        bool mDemanded{false};
+        VirtualClock::time_point mLastDemand;
+        // advertisers not asked yet, in advert order
+        std::deque<Peer::pointer> mToAsk;
+        // all the advertisers, that need not be told about it
+        std::set<Peer::pointer> mAdvertisers;
+    };
+
     std::map<uint256, FloodRecord::pointer> mFloodMap;
+    std::map<uint256, DemandRecord> mDemands;
+    // number of records of mDemands each peer advertised
+    std::map<Peer::pointer, size_t> mDemandsPerPeer;
+    std::map<Peer::pointer, std::vector<Hash>> mPendingAdverts;
+    VirtualTimer mFlushTimer;
+    bool mFlushPending;
     Application& mApp;
     medida::Counter& mFloodMapSize;
     medida::Meter& mSendFromBroadcast;
+    medida::Meter& mAdvertsSent;
+    medida::Meter& mDemandsSent;
+    medida::Meter& mDemandsFulfilled;
+    medida::Counter& mDemandsSize;
+    medida::Meter& mAdvertsIgnored;
     bool mShuttingDown;
 
+    FloodRecord::pointer newRecord(uint256 const& index,
+                                   StellarMessage const& msg,
+                                   Peer::pointer peer);
+    std::map<uint256, DemandRecord>::iterator
+    eraseDemand(std::map<uint256, DemandRecord>::iterator it);
+    void queueAdvert(Peer::pointer peer, Hash const& h);
+    void sendAdvert(Peer::pointer peer, std::vector<Hash>& hashes);
+    void scheduleFlush();
+    // sends the queued adverts, and demands for the advertised transactions
+    // we are not waiting for anymore
+    void flush();
+
   public:
     Floodgate(Application& app);
     // Floodgate will be cleared after every ledger close
     void clearBelow(uint32_t currentLedger);
     // returns true if this is a new record
     bool addRecord(StellarMessage const& msg, Peer::pointer fromPeer);
+    // same, with messageHash(msg) already computed
+    bool addRecord(StellarMessage const& msg, Peer::pointer fromPeer,
+                   Hash const& index);
 
     void broadcast(StellarMessage const& msg, bool force);
+    void broadcast(StellarMessage const& msg, bool force, Hash const& index);
+
+    // key of msg in the flood map; does not touch any state, so that it can
+    // be computed off the main thread
+    static Hash messageHash(StellarMessage const& msg);
 
     // returns the list of peers that sent us the item with hash `h`
     std::set<Peer::pointer> getPeersKnows(Hash const& h);
 
+    void recvFloodAdvert(FloodAdvert const& advert, Peer::pointer peer);
+    void recvFloodDemand(FloodDemand const& demand, Peer::pointer peer);
+
+    // drops what is kept about a disconnected peer's adverts
+    void forgetPeer(Peer* peer);
+
     void shutdown();
 };
 }
@@ -11,10 +11,14 @@
 #include "overlay/ItemFetcher.h"
 #include "overlay/LoopbackPeer.h"
 #include "overlay/OverlayManager.h"
+#include "scp/LocalNode.h"
 #include "test/TestUtils.h"
 #include "test/test.h"
 #include "xdr/Stellar-types.h"
 
+#include <algorithm>
+#include <set>
+
 namespace stellar
 {
 
@@ -231,10 +235,24 @@ TEST_CASE("ItemFetcher fetches", "[overlay][ItemFetcher]")
             }
             REQUIRE(asked.size() == 0);
 
+            while (asked.size() < 2)
+            {
+                clock.crank(true);
+            }
+            REQUIRE(asked[0] != asked[1]);
+
+            // once both peers said they do not have it, the next round only
+            // starts after a while
+            itemFetcher.doesntHave(zero, asked[0]);
+            itemFetcher.doesntHave(zero, asked[1]);
+            REQUIRE(asked.size() == 2);
+            auto roundDone = clock.now();
+
             while (asked.size() < 4)
             {
                 clock.crank(true);
             }
+            REQUIRE(clock.now() - roundDone >= std::chrono::milliseconds(1500));
 
             itemFetcher.recv(zero);
 
@@ -248,6 +266,68 @@ TEST_CASE("ItemFetcher fetches", "[overlay][ItemFetcher]")
             REQUIRE(std::count(asked.begin(), asked.end(), peer2) == 2);
         }
 
+        SECTION("asks several peers at once, fastest first")
+        {
+            auto other1 = createTestApplication(clock, getTestConfig(1));
+            auto other2 = createTestApplication(clock, getTestConfig(2));
+            auto other3 = createTestApplication(clock, getTestConfig(3));
+            LoopbackPeerConnection connection1(*app, *other1);
+            LoopbackPeerConnection connection2(*app, *other2);
+            LoopbackPeerConnection connection3(*app, *other3);
+            testutil::crankSome(clock);
+            REQUIRE(connection1.getInitiator()->isAuthenticated());
+            REQUIRE(connection2.getInitiator()->isAuthenticated());
+            REQUIRE(connection3.getInitiator()->isAuthenticated());
+
+            auto peer1 = connection1.getInitiator();
+            auto initialLatency = peer1->getFetchLatency();
+
+            // only other1 has its own quorum set
+            auto qSetHash = static_cast<HerderImpl&>(other1->getHerder())
+                                .getSCP()
+                                .getLocalNode()
+                                ->getQuorumSetHash();
+            auto fanout = app->getConfig().FETCH_FANOUT;
+            REQUIRE(fanout == 2);
+            itemFetcher.fetch(qSetHash, makeEnvelope(0));
+            REQUIRE(asked.size() == fanout);
+            REQUIRE(asked[0] != asked[1]);
+
+            // the others answer DONT_HAVE right away, which leaves their
+            // latency alone, while peer1 delivers and becomes the fastest
+            testutil::crankSome(clock);
+            for (auto const& peer : std::vector<Peer::pointer>(asked))
+            {
+                if (peer != peer1)
+                {
+                    itemFetcher.doesntHave(qSetHash, peer);
+                }
+            }
+            testutil::crankSome(clock);
+            REQUIRE(asked.size() == 3);
+            REQUIRE(std::count(asked.begin(), asked.end(), peer1) == 1);
+            for (auto const& peer : asked)
+            {
+                if (peer == peer1)
+                {
+                    REQUIRE(peer->getFetchLatency() < initialLatency);
+                }
+                else
+                {
+                    REQUIRE(peer->getFetchLatency() == initialLatency);
+                }
+            }
+
+            // no one else is asked once the item is there
+            itemFetcher.recv(qSetHash);
+            testutil::crankSome(clock);
+            REQUIRE(asked.size() == 3);
+
+            itemFetcher.fetch(fourteen, makeEnvelope(14));
+            REQUIRE(asked.size() == 3 + fanout);
+            REQUIRE(asked[3] == peer1);
+        }
+
         SECTION("ignore not asked items")
         {
             itemFetcher.recv(zero);
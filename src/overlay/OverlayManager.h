@@ -28,6 +28,9 @@
  *  - One-way broadcast messages informing other peers of an event:
  *    TRANSACTION and SCP_MESSAGE
  *
+ *  - In pull mode, transactions are announced by hash and requested by the
+ *    peers missing them instead: FLOOD_ADVERT, FLOOD_DEMAND
+ *
  *  - Two-way anycast messages requesting a value (by hash) or providing it:
  *    GET_TX_SET, TX_SET, GET_SCP_QUORUMSET, SCP_QUORUMSET, GET_SCP_STATE
  *
@@ -68,6 +71,10 @@ class OverlayManager
     // Herder.
     virtual void broadcastMessage(StellarMessage const& msg,
                                   bool force = false) = 0;
+    // Same as above, with the FloodGate hash of msg (Floodgate::messageHash)
+    // already computed.
+    virtual void broadcastMessage(StellarMessage const& msg, bool force,
+                                  Hash const& index) = 0;
 
     // Make a note in the FloodGate that a given peer has provided us with a
     // given broadcast message, so that it is inhibited from being resent to
@@ -75,6 +82,17 @@ class OverlayManager
     // that, call broadcastMessage, above.
     virtual void recvFloodedMsg(StellarMessage const& msg,
                                 Peer::pointer peer) = 0;
+    virtual void recvFloodedMsg(StellarMessage const& msg, Peer::pointer peer,
+                                Hash const& index) = 0;
+
+    // Handle the transaction hashes a peer advertised, asking it for the
+    // ones we do not have.
+    virtual void recvFloodAdvert(FloodAdvert const& advert,
+                                 Peer::pointer peer) = 0;
+
+    // Send a peer the advertised transactions it asked for.
+    virtual void recvFloodDemand(FloodDemand const& demand,
+                                 Peer::pointer peer) = 0;
 
     // Return a list of random peers from the set of authenticated peers.
     virtual std::vector<Peer::pointer> getRandomAuthenticatedPeers() = 0;
@@ -392,6 +392,7 @@ OverlayManagerImpl::dropPeer(Peer* peer)
             CLOG(WARNING, "Overlay") << "Dropping unlisted peer";
         }
     }
+    mFloodGate.forgetPeer(peer);
     updateSizeCounters();
 }
 
@@ -532,6 +533,28 @@ OverlayManagerImpl::recvFloodedMsg(StellarMessage const& msg,
     mFloodGate.addRecord(msg, peer);
 }
 
+void
+OverlayManagerImpl::recvFloodedMsg(StellarMessage const& msg,
+                                   Peer::pointer peer, Hash const& index)
+{
+    mMessagesReceived.Mark();
+    mFloodGate.addRecord(msg, peer, index);
+}
+
+void
+OverlayManagerImpl::recvFloodAdvert(FloodAdvert const& advert,
+                                    Peer::pointer peer)
+{
+    mFloodGate.recvFloodAdvert(advert, peer);
+}
+
+void
+OverlayManagerImpl::recvFloodDemand(FloodDemand const& demand,
+                                    Peer::pointer peer)
+{
+    mFloodGate.recvFloodDemand(demand, peer);
+}
+
 void
 OverlayManagerImpl::broadcastMessage(StellarMessage const& msg, bool force)
 {
@@ -539,6 +562,14 @@ OverlayManagerImpl::broadcastMessage(StellarMessage const& msg, bool force)
     mFloodGate.broadcast(msg, force);
 }
 
+void
+OverlayManagerImpl::broadcastMessage(StellarMessage const& msg, bool force,
+                                     Hash const& index)
+{
+    mMessagesBroadcast.Mark();
+    mFloodGate.broadcast(msg, force, index);
+}
+
 void
 OverlayManager::dropAll(Database& db)
 {
@@ -71,8 +71,16 @@ class OverlayManagerImpl : public OverlayManager
 
     void ledgerClosed(uint32_t lastClosedledgerSeq) override;
     void recvFloodedMsg(StellarMessage const& msg, Peer::pointer peer) override;
+    void recvFloodedMsg(StellarMessage const& msg, Peer::pointer peer,
+                        Hash const& index) override;
+    void recvFloodAdvert(FloodAdvert const& advert,
+                         Peer::pointer peer) override;
+    void recvFloodDemand(FloodDemand const& demand,
+                         Peer::pointer peer) override;
     void broadcastMessage(StellarMessage const& msg,
                           bool force = false) override;
+    void broadcastMessage(StellarMessage const& msg, bool force,
+                          Hash const& index) override;
     void connectTo(std::string const& addr) override;
     void connectTo(PeerRecord& pr) override;
     void connectTo(PeerBareAddress const& address) override;
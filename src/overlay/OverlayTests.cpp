@@ -4,7 +4,12 @@
 
 #include "BanManager.h"
 #include "crypto/KeyUtils.h"
+#include "crypto/SHA.h"
 #include "crypto/SecretKey.h"
+#include "herder/Herder.h"
+#include "herder/LedgerCloseData.h"
+#include "herder/TxSetFrame.h"
+#include "ledger/LedgerManager.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/Config.h"
@@ -13,7 +18,9 @@
 #include "overlay/PeerRecord.h"
 #include "overlay/TCPPeer.h"
 #include "simulation/Simulation.h"
+#include "test/TestAccount.h"
 #include "test/TestUtils.h"
+#include "test/TxTests.h"
 #include "test/test.h"
 #include "util/Logging.h"
 #include "util/Timer.h"
@@ -22,6 +29,7 @@
 #include "medida/metrics_registry.h"
 #include "medida/timer.h"
 #include "util/format.h"
+#include "xdrpp/marshal.h"
 #include <numeric>
 
 using namespace stellar;
@@ -512,3 +520,134 @@ TEST_CASE("preferred peers always connect", "[overlay]")
     REQUIRE(numberOfAppConnections(*simulation->getNode(vNode2NodeID)) == 1);
     REQUIRE(numberOfAppConnections(*simulation->getNode(vNode3NodeID)) == 1);
 }
+
+TEST_CASE("tx sets are fetched whole from peers of any version", "[overlay]")
+{
+    VirtualClock clock;
+    Config cfg0 = getTestConfig(0);
+    Config cfg1 = getTestConfig(1);
+    Config cfg2 = getTestConfig(2);
+    cfg2.OVERLAY_PROTOCOL_VERSION = 8;
+    REQUIRE(cfg1.OVERLAY_PROTOCOL_VERSION == 9);
+    auto app0 = createTestApplication(clock, cfg0);
+    auto app1 = createTestApplication(clock, cfg1);
+    auto app2 = createTestApplication(clock, cfg2);
+
+    // app0 has a tx set, whose first transactions app1 and app2 already know
+    auto const& lcl = app0->getLedgerManager().getLastClosedLedgerHeader();
+    auto root = TestAccount::createRoot(*app0);
+    auto a1 = txtest::getAccount("A");
+    std::vector<TransactionFramePtr> txs;
+    auto txSet = std::make_shared<TxSetFrame>(lcl.hash);
+    for (int i = 0; i < 50; i++)
+    {
+        txs.emplace_back(
+            root.tx({txtest::createAccount(a1.getPublicKey(), 10000000)}));
+        txSet->add(txs.back());
+    }
+    txSet->sortForHash();
+    auto txSetHash = txSet->getContentsHash();
+    for (auto app : {app1, app2})
+    {
+        for (size_t i = 0; i < 40; i++)
+        {
+            REQUIRE(app->getHerder().recvTransaction(txs[i]) ==
+                    Herder::TX_STATUS_PENDING);
+        }
+    }
+
+    // an envelope of some other node for that tx set
+    auto otherNode = SecretKey::fromSeed(sha256("other node"));
+    SCPQuorumSet qSet;
+    qSet.threshold = 1;
+    qSet.validators.push_back(otherNode.getPublicKey());
+    SCPEnvelope envelope;
+    envelope.statement.nodeID = otherNode.getPublicKey();
+    envelope.statement.slotIndex = lcl.header.ledgerSeq + 1;
+    envelope.statement.pledges.type(SCP_ST_PREPARE);
+    envelope.statement.pledges.prepare().ballot.value = xdr::xdr_to_opaque(
+        StellarValue{txSetHash, 10, emptyUpgradeSteps, 0});
+    envelope.statement.pledges.prepare().quorumSetHash =
+        sha256(xdr::xdr_to_opaque(qSet));
+    envelope.signature =
+        otherNode.sign(xdr::xdr_to_opaque(envelope.statement));
+    app0->getHerder().recvSCPEnvelope(envelope, qSet, *txSet);
+    REQUIRE(app0->getHerder().getTxSet(txSetHash));
+
+    auto compactTxSets = [](Application::pointer app) {
+        return app->getMetrics()
+            .NewTimer({"overlay", "recv", "compact-txset"})
+            .count();
+    };
+    auto crankUntilFetched = [&](std::vector<Application::pointer> apps) {
+        for (int i = 0; i < 10; i++)
+        {
+            testutil::crankSome(clock);
+        }
+        for (auto app : apps)
+        {
+            REQUIRE(app->getHerder().getTxSet(txSetHash));
+        }
+    };
+
+    SECTION("from a version 9 and a version 8 peer")
+    {
+        LoopbackPeerConnection conn1(*app1, *app0);
+        LoopbackPeerConnection conn2(*app2, *app0);
+        testutil::crankSome(clock);
+        REQUIRE(conn1.getInitiator()->isAuthenticated());
+        REQUIRE(conn2.getInitiator()->isAuthenticated());
+
+        app1->getHerder().recvSCPEnvelope(envelope);
+        app2->getHerder().recvSCPEnvelope(envelope);
+        crankUntilFetched({app1, app2});
+
+        // app1 got the hashes and asked for the 10 transactions it missed;
+        // app2 got the whole set
+        REQUIRE(compactTxSets(app1) == 1);
+        REQUIRE(app1->getMetrics()
+                    .NewMeter({"herder", "txset", "compact-missing"},
+                              "transaction")
+                    .count() == 10);
+        REQUIRE(compactTxSets(app2) == 0);
+        REQUIRE(app2->getMetrics()
+                    .NewTimer({"overlay", "recv", "txset"})
+                    .count() == 1);
+        REQUIRE(app1->getHerder().getTxSet(txSetHash)->getContentsHash() ==
+                txSetHash);
+        REQUIRE(app2->getHerder().getTxSet(txSetHash)->getContentsHash() ==
+                txSetHash);
+    }
+
+    SECTION("from another peer when one lists the wrong transactions")
+    {
+        // app2 gets the set first, app1 then asks either of app0 and app2
+        LoopbackPeerConnection conn2(*app2, *app0);
+        testutil::crankSome(clock);
+        app2->getHerder().recvSCPEnvelope(envelope);
+        crankUntilFetched({app2});
+
+        LoopbackPeerConnection conn1(*app1, *app0);
+        LoopbackPeerConnection conn3(*app1, *app2);
+        testutil::crankSome(clock);
+        REQUIRE(conn1.getInitiator()->isAuthenticated());
+        REQUIRE(conn3.getInitiator()->isAuthenticated());
+
+        // before anyone answers, app0 lists only the transactions app1
+        // knows, which does not make up the set
+        app1->getHerder().recvSCPEnvelope(envelope);
+        StellarMessage wrong;
+        wrong.type(COMPACT_TX_SET);
+        wrong.compactTxSet().txSetHash = txSetHash;
+        wrong.compactTxSet().previousLedgerHash = lcl.hash;
+        for (size_t i = 0; i < 40; i++)
+        {
+            wrong.compactTxSet().txHashes.emplace_back(txs[i]->getFullHash());
+        }
+        conn1.getAcceptor()->sendMessage(wrong);
+        crankUntilFetched({app1});
+
+        REQUIRE(!conn1.getInitiator()->isConnected());
+        REQUIRE(conn3.getInitiator()->isAuthenticated());
+    }
+}
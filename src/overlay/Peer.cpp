@@ -14,11 +14,13 @@
 #include "ledger/LedgerManager.h"
 #include "main/Application.h"
 #include "main/Config.h"
+#include "overlay/Floodgate.h"
 #include "overlay/LoadManager.h"
 #include "overlay/OverlayManager.h"
 #include "overlay/PeerAuth.h"
 #include "overlay/PeerRecord.h"
 #include "overlay/StellarXDR.h"
+#include "util/HashOfHash.h"
 #include "util/Logging.h"
 #include "util/XDROperators.h"
 
@@ -30,6 +32,7 @@
 
 #include <soci.h>
 #include <time.h>
+#include <unordered_map>
 
 // LATER: need to add some way of docking peers that are misbehaving by sending
 // you bad data
@@ -40,6 +43,15 @@ namespace stellar
 using namespace std;
 using namespace soci;
 
+// overlay version introducing FLOOD_ADVERT and FLOOD_DEMAND
+static const uint32_t FIRST_OVERLAY_VERSION_WITH_ADVERTS = 8;
+// overlay version introducing COMPACT_TX_SET, GET_TX_SET_TXS and TX_SET_TXS
+static const uint32_t FIRST_OVERLAY_VERSION_WITH_COMPACT_TX_SETS = 9;
+
+// fetch latency assumed for peers that were never asked for anything, so
+// that they are tried before the ones known to be slow
+static const std::chrono::milliseconds INITIAL_FETCH_LATENCY{250};
+
 medida::Meter&
 Peer::getByteReadMeter(Application& app)
 {
@@ -95,6 +107,16 @@ Peer::Peer(Application& app, PeerRole role)
           app.getMetrics().NewTimer({"overlay", "recv", "scp-message"}))
     , mRecvGetSCPStateTimer(
           app.getMetrics().NewTimer({"overlay", "recv", "get-scp-state"}))
+    , mRecvFloodAdvertTimer(
+          app.getMetrics().NewTimer({"overlay", "recv", "flood-advert"}))
+    , mRecvFloodDemandTimer(
+          app.getMetrics().NewTimer({"overlay", "recv", "flood-demand"}))
+    , mRecvCompactTxSetTimer(
+          app.getMetrics().NewTimer({"overlay", "recv", "compact-txset"}))
+    , mRecvGetTxSetTxsTimer(
+          app.getMetrics().NewTimer({"overlay", "recv", "get-txset-txs"}))
+    , mRecvTxSetTxsTimer(
+          app.getMetrics().NewTimer({"overlay", "recv", "txset-txs"}))
 
     , mRecvSCPPrepareTimer(
           app.getMetrics().NewTimer({"overlay", "recv", "scp-prepare"}))
@@ -131,6 +153,18 @@ Peer::Peer(Application& app, PeerRole role)
           {"overlay", "send", "scp-message"}, "message"))
     , mSendGetSCPStateMeter(app.getMetrics().NewMeter(
           {"overlay", "send", "get-scp-state"}, "message"))
+    , mSendFloodAdvertMeter(app.getMetrics().NewMeter(
+          {"overlay", "send", "flood-advert"}, "message"))
+    , mSendFloodDemandMeter(app.getMetrics().NewMeter(
+          {"overlay", "send", "flood-demand"}, "message"))
+    , mSendCompactTxSetMeter(app.getMetrics().NewMeter(
+          {"overlay", "send", "compact-txset"}, "message"))
+    , mSendGetTxSetTxsMeter(app.getMetrics().NewMeter(
+          {"overlay", "send", "get-txset-txs"}, "message"))
+    , mSendTxSetTxsMeter(app.getMetrics().NewMeter(
+          {"overlay", "send", "txset-txs"}, "message"))
+    , mSendTxFloodByteMeter(
+          app.getMetrics().NewMeter({"overlay", "byte", "tx-flood"}, "byte"))
     , mDropInConnectHandlerMeter(app.getMetrics().NewMeter(
           {"overlay", "drop", "connect-handler"}, "drop"))
     , mDropInRecvMessageDecodeMeter(app.getMetrics().NewMeter(
@@ -165,6 +199,9 @@ Peer::Peer(Application& app, PeerRole role)
           {"overlay", "drop", "recv-auth-invalid-peer"}, "drop"))
     , mDropInRecvErrorMeter(
           app.getMetrics().NewMeter({"overlay", "drop", "recv-error"}, "drop"))
+    , mFetchLatencyTimer(
+          app.getMetrics().NewTimer({"overlay", "fetch", "latency"}))
+    , mFetchLatency(INITIAL_FETCH_LATENCY)
 {
     auto bytes = randomBytes(mSendNonce.size());
     std::copy(bytes.begin(), bytes.end(), mSendNonce.begin());
@@ -337,6 +374,7 @@ Peer::sendGetTxSet(uint256 const& setID)
     newMsg.type(GET_TX_SET);
     newMsg.txSetHash() = setID;
 
+    fetchRequested(setID);
     sendMessage(newMsg);
 }
 void
@@ -349,9 +387,57 @@ Peer::sendGetQuorumSet(uint256 const& setID)
     newMsg.type(GET_SCP_QUORUMSET);
     newMsg.qSetHash() = setID;
 
+    fetchRequested(setID);
     sendMessage(newMsg);
 }
 
+void
+Peer::fetchRequested(Hash const& hash)
+{
+    mFetchRequests.emplace(hash, mApp.getClock().now());
+}
+
+void
+Peer::fetchAnswered(Hash const& hash)
+{
+    auto it = mFetchRequests.find(hash);
+    if (it != mFetchRequests.end())
+    {
+        addFetchLatencySample(it->second);
+        mFetchRequests.erase(it);
+    }
+}
+
+void
+Peer::fetchAbandoned(Hash const& hash, bool timedOut)
+{
+    auto it = mFetchRequests.find(hash);
+    if (it != mFetchRequests.end())
+    {
+        if (timedOut)
+        {
+            addFetchLatencySample(it->second);
+        }
+        mFetchRequests.erase(it);
+    }
+}
+
+void
+Peer::addFetchLatencySample(VirtualClock::time_point requested)
+{
+    auto sample = std::chrono::duration_cast<std::chrono::microseconds>(
+        mApp.getClock().now() - requested);
+    mFetchLatencyTimer.Update(sample);
+    // exponential moving average, giving 1/4 of the weight to the new sample
+    mFetchLatency += (sample - mFetchLatency) / 4;
+}
+
+std::chrono::microseconds
+Peer::getFetchLatency() const
+{
+    return mFetchLatency;
+}
+
 void
 Peer::sendGetPeers()
 {
@@ -451,6 +537,16 @@ msgSummary(StellarMessage const& msg)
         }
     case GET_SCP_STATE:
         return "GET_SCP_STATE";
+    case FLOOD_ADVERT:
+        return "FLOODADVERT";
+    case FLOOD_DEMAND:
+        return "FLOODDEMAND";
+    case COMPACT_TX_SET:
+        return "COMPACTTXSET";
+    case GET_TX_SET_TXS:
+        return "GETTXSETTXS";
+    case TX_SET_TXS:
+        return "TXSETTXS";
     }
     return "UNKNOWN";
 }
@@ -507,6 +603,21 @@ Peer::sendMessage(StellarMessage const& msg)
     case GET_SCP_STATE:
         mSendGetSCPStateMeter.Mark();
         break;
+    case FLOOD_ADVERT:
+        mSendFloodAdvertMeter.Mark();
+        break;
+    case FLOOD_DEMAND:
+        mSendFloodDemandMeter.Mark();
+        break;
+    case COMPACT_TX_SET:
+        mSendCompactTxSetMeter.Mark();
+        break;
+    case GET_TX_SET_TXS:
+        mSendGetTxSetTxsMeter.Mark();
+        break;
+    case TX_SET_TXS:
+        mSendTxSetTxsMeter.Mark();
+        break;
     };
 
     AuthenticatedMessage amsg;
@@ -519,6 +630,11 @@ Peer::sendMessage(StellarMessage const& msg)
         ++mSendMacSeq;
     }
     xdr::msg_ptr xdrBytes(xdr::xdr_to_msg(amsg));
+    if (msg.type() == TRANSACTION || msg.type() == FLOOD_ADVERT ||
+        msg.type() == FLOOD_DEMAND)
+    {
+        mSendTxFloodByteMeter.Mark(xdrBytes->raw_size());
+    }
     this->sendMessage(std::move(xdrBytes));
 }
 
@@ -560,6 +676,23 @@ Peer::isAuthenticated() const
     return mState == GOT_AUTH;
 }
 
+bool
+Peer::supportsAdverts() const
+{
+    // both ends must speak an overlay version that knows about them
+    return std::min(mRemoteOverlayVersion,
+                    mApp.getConfig().OVERLAY_PROTOCOL_VERSION) >=
+           FIRST_OVERLAY_VERSION_WITH_ADVERTS;
+}
+
+bool
+Peer::supportsCompactTxSets() const
+{
+    return std::min(mRemoteOverlayVersion,
+                    mApp.getConfig().OVERLAY_PROTOCOL_VERSION) >=
+           FIRST_OVERLAY_VERSION_WITH_COMPACT_TX_SETS;
+}
+
 bool
 Peer::shouldAbort() const
 {
@@ -576,32 +709,74 @@ Peer::recvMessage(AuthenticatedMessage const& msg)
 
     if (mState >= GOT_HELLO && msg.v0().message.type() != ERROR_MSG)
     {
-        if (msg.v0().sequence != mRecvMacSeq)
+        if (!handleMessageAuth(verifyMessageAuth(msg)))
         {
-            CLOG(ERROR, "Overlay") << "Unexpected message-auth sequence";
-            mDropInRecvMessageSeqMeter.Mark();
-            ++mRecvMacSeq;
-            drop(ERR_AUTH, "unexpected auth sequence");
             return;
         }
+    }
+    recvMessage(msg.v0().message);
+}
 
-        if (!hmacSha256Verify(
-                msg.v0().mac, mRecvMacKey,
-                xdr::xdr_to_opaque(msg.v0().sequence, msg.v0().message)))
-        {
-            CLOG(ERROR, "Overlay") << "Message-auth check failed";
-            mDropInRecvMessageMacMeter.Mark();
-            ++mRecvMacSeq;
-            drop(ERR_AUTH, "unexpected MAC");
-            return;
-        }
+Peer::MessageAuthStatus
+Peer::verifyMessageAuth(AuthenticatedMessage const& msg)
+{
+    if (msg.v0().sequence != mRecvMacSeq)
+    {
         ++mRecvMacSeq;
+        return MESSAGE_AUTH_BAD_SEQUENCE;
     }
-    recvMessage(msg.v0().message);
+
+    if (!hmacSha256Verify(
+            msg.v0().mac, mRecvMacKey,
+            xdr::xdr_to_opaque(msg.v0().sequence, msg.v0().message)))
+    {
+        ++mRecvMacSeq;
+        return MESSAGE_AUTH_BAD_MAC;
+    }
+    ++mRecvMacSeq;
+    return MESSAGE_AUTH_OK;
+}
+
+bool
+Peer::handleMessageAuth(MessageAuthStatus status)
+{
+    switch (status)
+    {
+    case MESSAGE_AUTH_OK:
+        return true;
+    case MESSAGE_AUTH_BAD_SEQUENCE:
+        CLOG(ERROR, "Overlay") << "Unexpected message-auth sequence";
+        mDropInRecvMessageSeqMeter.Mark();
+        drop(ERR_AUTH, "unexpected auth sequence");
+        return false;
+    case MESSAGE_AUTH_BAD_MAC:
+        CLOG(ERROR, "Overlay") << "Message-auth check failed";
+        mDropInRecvMessageMacMeter.Mark();
+        drop(ERR_AUTH, "unexpected MAC");
+        return false;
+    }
+    return false;
+}
+
+Hash
+Peer::computeFloodHash(StellarMessage const& msg)
+{
+    // only messages going through the FloodGate need one
+    if (msg.type() == TRANSACTION || msg.type() == SCP_MESSAGE)
+    {
+        return Floodgate::messageHash(msg);
+    }
+    return Hash();
 }
 
 void
 Peer::recvMessage(StellarMessage const& stellarMsg)
+{
+    recvMessage(stellarMsg, computeFloodHash(stellarMsg));
+}
+
+void
+Peer::recvMessage(StellarMessage const& stellarMsg, Hash const& floodHash)
 {
     if (shouldAbort())
     {
@@ -690,7 +865,7 @@ Peer::recvMessage(StellarMessage const& stellarMsg)
     case TRANSACTION:
     {
         auto t = mRecvTransactionTimer.TimeScope();
-        recvTransaction(stellarMsg);
+        recvTransaction(stellarMsg, floodHash);
     }
     break;
 
@@ -711,7 +886,7 @@ Peer::recvMessage(StellarMessage const& stellarMsg)
     case SCP_MESSAGE:
     {
         auto t = mRecvSCPMessageTimer.TimeScope();
-        recvSCPMessage(stellarMsg);
+        recvSCPMessage(stellarMsg, floodHash);
     }
     break;
 
@@ -721,12 +896,49 @@ Peer::recvMessage(StellarMessage const& stellarMsg)
         recvGetSCPState(stellarMsg);
     }
     break;
+
+    case FLOOD_ADVERT:
+    {
+        auto t = mRecvFloodAdvertTimer.TimeScope();
+        recvFloodAdvert(stellarMsg);
+    }
+    break;
+
+    case FLOOD_DEMAND:
+    {
+        auto t = mRecvFloodDemandTimer.TimeScope();
+        recvFloodDemand(stellarMsg);
+    }
+    break;
+
+    case COMPACT_TX_SET:
+    {
+        auto t = mRecvCompactTxSetTimer.TimeScope();
+        recvCompactTxSet(stellarMsg);
+    }
+    break;
+
+    case GET_TX_SET_TXS:
+    {
+        auto t = mRecvGetTxSetTxsTimer.TimeScope();
+        recvGetTxSetTxs(stellarMsg);
+    }
+    break;
+
+    case TX_SET_TXS:
+    {
+        auto t = mRecvTxSetTxsTimer.TimeScope();
+        recvTxSetTxs(stellarMsg);
+    }
+    break;
     }
 }
 
 void
 Peer::recvDontHave(StellarMessage const& msg)
 {
+    // only the peers that deliver items are ranked by how fast they do it
+    fetchAbandoned(msg.dontHave().reqHash, false);
     mApp.getHerder().peerDoesntHave(msg.dontHave().type, msg.dontHave().reqHash,
                                     shared_from_this());
 }
@@ -738,8 +950,23 @@ Peer::recvGetTxSet(StellarMessage const& msg)
     if (auto txSet = mApp.getHerder().getTxSet(msg.txSetHash()))
     {
         StellarMessage newMsg;
-        newMsg.type(TX_SET);
-        txSet->toXDR(newMsg.txSet());
+        if (supportsCompactTxSets())
+        {
+            // the peer most likely has most of the transactions already
+            newMsg.type(COMPACT_TX_SET);
+            auto& compact = newMsg.compactTxSet();
+            compact.txSetHash = msg.txSetHash();
+            compact.previousLedgerHash = txSet->previousLedgerHash();
+            for (auto const& tx : txSet->mTransactions)
+            {
+                compact.txHashes.emplace_back(tx->getFullHash());
+            }
+        }
+        else
+        {
+            newMsg.type(TX_SET);
+            txSet->toXDR(newMsg.txSet());
+        }
 
         self->sendMessage(newMsg);
     }
@@ -753,11 +980,68 @@ void
 Peer::recvTxSet(StellarMessage const& msg)
 {
     TxSetFrame frame(mApp.getNetworkID(), msg.txSet());
-    mApp.getHerder().recvTxSet(frame.getContentsHash(), frame);
+    auto hash = frame.getContentsHash();
+    fetchAnswered(hash);
+    mApp.getHerder().recvTxSet(hash, frame);
+}
+
+void
+Peer::recvCompactTxSet(StellarMessage const& msg)
+{
+    auto const& compact = msg.compactTxSet();
+    fetchAnswered(compact.txSetHash);
+    auto missing =
+        mApp.getHerder().recvCompactTxSet(compact, shared_from_this());
+    if (!missing.empty())
+    {
+        StellarMessage newMsg;
+        newMsg.type(GET_TX_SET_TXS);
+        newMsg.getTxSetTxs().txSetHash = compact.txSetHash;
+        newMsg.getTxSetTxs().txHashes.assign(missing.begin(), missing.end());
+        sendMessage(newMsg);
+    }
 }
 
 void
-Peer::recvTransaction(StellarMessage const& msg)
+Peer::recvGetTxSetTxs(StellarMessage const& msg)
+{
+    auto const& req = msg.getTxSetTxs();
+    auto txSet = mApp.getHerder().getTxSet(req.txSetHash);
+    if (!txSet)
+    {
+        sendDontHave(TX_SET, req.txSetHash);
+        return;
+    }
+
+    std::unordered_map<Hash, TransactionFramePtr> txs;
+    for (auto const& tx : txSet->mTransactions)
+    {
+        txs.emplace(tx->getFullHash(), tx);
+    }
+
+    StellarMessage newMsg;
+    newMsg.type(TX_SET_TXS);
+    newMsg.txSetTxs().txSetHash = req.txSetHash;
+    for (auto const& h : req.txHashes)
+    {
+        auto it = txs.find(h);
+        if (it != txs.end())
+        {
+            newMsg.txSetTxs().txs.emplace_back(it->second->getEnvelope());
+        }
+    }
+    sendMessage(newMsg);
+}
+
+void
+Peer::recvTxSetTxs(StellarMessage const& msg)
+{
+    mApp.getHerder().recvTxSetTransactions(msg.txSetTxs(),
+                                           shared_from_this());
+}
+
+void
+Peer::recvTransaction(StellarMessage const& msg, Hash const& floodHash)
 {
     TransactionFramePtr transaction = TransactionFrame::makeTransactionFromWire(
         mApp.getNetworkID(), msg.transaction());
@@ -771,17 +1055,33 @@ Peer::recvTransaction(StellarMessage const& msg)
             recvRes == Herder::TX_STATUS_DUPLICATE)
         {
             // record that this peer sent us this transaction
-            mApp.getOverlayManager().recvFloodedMsg(msg, shared_from_this());
+            mApp.getOverlayManager().recvFloodedMsg(msg, shared_from_this(),
+                                                    floodHash);
 
             if (recvRes == Herder::TX_STATUS_PENDING)
             {
                 // if it's a new transaction, broadcast it
-                mApp.getOverlayManager().broadcastMessage(msg);
+                mApp.getOverlayManager().broadcastMessage(msg, false,
+                                                          floodHash);
             }
         }
     }
 }
 
+void
+Peer::recvFloodAdvert(StellarMessage const& msg)
+{
+    mApp.getOverlayManager().recvFloodAdvert(msg.floodAdvert(),
+                                             shared_from_this());
+}
+
+void
+Peer::recvFloodDemand(StellarMessage const& msg)
+{
+    mApp.getOverlayManager().recvFloodDemand(msg.floodDemand(),
+                                             shared_from_this());
+}
+
 void
 Peer::recvGetSCPQuorumSet(StellarMessage const& msg)
 {
@@ -804,11 +1104,12 @@ void
 Peer::recvSCPQuorumSet(StellarMessage const& msg)
 {
     Hash hash = sha256(xdr::xdr_to_opaque(msg.qSet()));
+    fetchAnswered(hash);
     mApp.getHerder().recvSCPQuorumSet(hash, msg.qSet());
 }
 
 void
-Peer::recvSCPMessage(StellarMessage const& msg)
+Peer::recvSCPMessage(StellarMessage const& msg, Hash const& floodHash)
 {
     SCPEnvelope const& envelope = msg.envelope();
     if (Logging::logTrace("Overlay"))
@@ -816,7 +1117,8 @@ Peer::recvSCPMessage(StellarMessage const& msg)
             << "recvSCPMessage node: "
             << mApp.getConfig().toShortString(msg.envelope().statement.nodeID);
 
-    mApp.getOverlayManager().recvFloodedMsg(msg, shared_from_this());
+    mApp.getOverlayManager().recvFloodedMsg(msg, shared_from_this(),
+                                            floodHash);
 
     auto type = msg.envelope().statement.pledges.type();
     auto t = (type == SCP_ST_PREPARE
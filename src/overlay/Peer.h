@@ -12,6 +12,8 @@
 #include "util/Timer.h"
 #include "xdrpp/message.h"
 
+#include <map>
+
 namespace medida
 {
 class Timer;
@@ -98,6 +100,11 @@ class Peer : public std::enable_shared_from_this<Peer>,
     medida::Timer& mRecvSCPQuorumSetTimer;
     medida::Timer& mRecvSCPMessageTimer;
     medida::Timer& mRecvGetSCPStateTimer;
+    medida::Timer& mRecvFloodAdvertTimer;
+    medida::Timer& mRecvFloodDemandTimer;
+    medida::Timer& mRecvCompactTxSetTimer;
+    medida::Timer& mRecvGetTxSetTxsTimer;
+    medida::Timer& mRecvTxSetTxsTimer;
 
     medida::Timer& mRecvSCPPrepareTimer;
     medida::Timer& mRecvSCPConfirmTimer;
@@ -117,6 +124,13 @@ class Peer : public std::enable_shared_from_this<Peer>,
     medida::Meter& mSendSCPQuorumSetMeter;
     medida::Meter& mSendSCPMessageSetMeter;
     medida::Meter& mSendGetSCPStateMeter;
+    medida::Meter& mSendFloodAdvertMeter;
+    medida::Meter& mSendFloodDemandMeter;
+    medida::Meter& mSendCompactTxSetMeter;
+    medida::Meter& mSendGetTxSetTxsMeter;
+    medida::Meter& mSendTxSetTxsMeter;
+    // bytes spent flooding transactions, whether pushed or pulled
+    medida::Meter& mSendTxFloodByteMeter;
 
     medida::Meter& mDropInConnectHandlerMeter;
     medida::Meter& mDropInRecvMessageDecodeMeter;
@@ -135,12 +149,41 @@ class Peer : public std::enable_shared_from_this<Peer>,
     medida::Meter& mDropInRecvAuthRejectMeter;
     medida::Meter& mDropInRecvAuthInvalidPeerMeter;
     medida::Meter& mDropInRecvErrorMeter;
+    medida::Timer& mFetchLatencyTimer;
+
+    // GET_TX_SET and GET_SCP_QUORUMSET sent and not answered yet, with when
+    // they were sent
+    std::map<Hash, VirtualClock::time_point> mFetchRequests;
+    // moving average of the time it takes to deliver them
+    std::chrono::microseconds mFetchLatency;
+
+    void fetchRequested(Hash const& hash);
+    void fetchAnswered(Hash const& hash);
+    void addFetchLatencySample(VirtualClock::time_point requested);
+
+    enum MessageAuthStatus
+    {
+        MESSAGE_AUTH_OK,
+        MESSAGE_AUTH_BAD_SEQUENCE,
+        MESSAGE_AUTH_BAD_MAC
+    };
 
     bool shouldAbort() const;
     void recvMessage(StellarMessage const& msg);
+    // floodHash is Floodgate::messageHash(msg) for flooded messages
+    void recvMessage(StellarMessage const& msg, Hash const& floodHash);
     void recvMessage(AuthenticatedMessage const& msg);
     void recvMessage(xdr::msg_ptr const& xdrBytes);
 
+    // checks the sequence number and MAC of msg, consuming a sequence number.
+    // Once authenticated, it only touches mRecvMacSeq: it can run off the
+    // main thread, as long as messages are checked one at a time and in order
+    MessageAuthStatus verifyMessageAuth(AuthenticatedMessage const& msg);
+    // drops the peer if the check failed; returns whether it passed
+    bool handleMessageAuth(MessageAuthStatus status);
+    // Floodgate::messageHash(msg) for flooded messages, zero otherwise
+    static Hash computeFloodHash(StellarMessage const& msg);
+
     virtual void recvError(StellarMessage const& msg);
     // returns false if we should drop this peer
     void noteHandshakeSuccessInPeerRecord();
@@ -152,11 +195,16 @@ class Peer : public std::enable_shared_from_this<Peer>,
 
     void recvGetTxSet(StellarMessage const& msg);
     void recvTxSet(StellarMessage const& msg);
-    void recvTransaction(StellarMessage const& msg);
+    void recvTransaction(StellarMessage const& msg, Hash const& floodHash);
     void recvGetSCPQuorumSet(StellarMessage const& msg);
     void recvSCPQuorumSet(StellarMessage const& msg);
-    void recvSCPMessage(StellarMessage const& msg);
+    void recvSCPMessage(StellarMessage const& msg, Hash const& floodHash);
     void recvGetSCPState(StellarMessage const& msg);
+    void recvFloodAdvert(StellarMessage const& msg);
+    void recvFloodDemand(StellarMessage const& msg);
+    void recvCompactTxSet(StellarMessage const& msg);
+    void recvGetTxSetTxs(StellarMessage const& msg);
+    void recvTxSetTxs(StellarMessage const& msg);
 
     void sendHello();
     void sendAuth();
@@ -236,6 +284,18 @@ class Peer : public std::enable_shared_from_this<Peer>,
         return mRemoteOverlayVersion;
     }
 
+    // whether FLOOD_ADVERT and FLOOD_DEMAND can be sent to this peer
+    bool supportsAdverts() const;
+    // whether GET_TX_SET can be answered with COMPACT_TX_SET
+    bool supportsCompactTxSets() const;
+
+    // how fast this peer answers GET_TX_SET and GET_SCP_QUORUMSET with the
+    // item, DONT_HAVE not counting; until then it gets a default estimate
+    std::chrono::microseconds getFetchLatency() const;
+    // stops waiting for the answer to the request for hash; if it timed
+    // out, the time waited counts against the peer
+    void fetchAbandoned(Hash const& hash, bool timedOut);
+
     PeerBareAddress const&
     getAddress()
     {
@@ -415,9 +415,31 @@ TCPPeer::readBodyHandler(asio::error_code const& error,
     if (!error)
     {
         receivedBytes(bytes_transferred, true);
-        recvMessage();
         mIncomingHeader.clear();
-        startRead();
+        if (!isAuthenticated())
+        {
+            // the handshake changes how the next messages are authenticated:
+            // process it right away
+            recvMessage();
+            startRead();
+            return;
+        }
+
+        mDecodeQueue.emplace_back(std::move(mIncomingBody));
+        mIncomingBody.clear();
+        mPendingRecv++;
+        if (!mDecoding)
+        {
+            startDecode();
+        }
+        if (mPendingRecv < MAX_PENDING_RECV_MESSAGES)
+        {
+            startRead();
+        }
+        else
+        {
+            mReadPaused = true;
+        }
     }
     else
     {
@@ -453,6 +475,105 @@ TCPPeer::recvMessage()
     }
 }
 
+void
+TCPPeer::startDecode()
+{
+    assertThreadIsMain();
+    mDecoding = true;
+
+    auto bodies = std::make_shared<BodyBatch>();
+    bodies->swap(mDecodeQueue);
+    auto self = static_pointer_cast<TCPPeer>(shared_from_this());
+    mApp.postOnOverlayThread([self, bodies]() mutable {
+        auto decoded = std::make_shared<std::vector<DecodedMessage>>(
+            self->decodeMessages(*bodies));
+        auto batchSize = bodies->size();
+        auto& app = self->getApp();
+        // the last reference to the peer must not go away on this thread
+        app.postOnMainThread([self = std::move(self), decoded, batchSize]() {
+            self->recvDecodedMessages(*decoded, batchSize);
+        });
+    });
+}
+
+std::vector<TCPPeer::DecodedMessage>
+TCPPeer::decodeMessages(BodyBatch const& bodies)
+{
+    std::vector<DecodedMessage> res;
+    res.reserve(bodies.size());
+    for (auto const& body : bodies)
+    {
+        res.emplace_back();
+        auto& d = res.back();
+        try
+        {
+            xdr::xdr_get g(body.data(), body.data() + body.size());
+            xdr::xdr_argpack_archive(g, d.mMessage);
+        }
+        catch (xdr::xdr_runtime_error& e)
+        {
+            CLOG(ERROR, "Overlay")
+                << "recvMessage got a corrupt xdr: " << e.what();
+            d.mCorrupt = true;
+            break;
+        }
+
+        auto const& msg = d.mMessage.v0().message;
+        if (msg.type() != ERROR_MSG)
+        {
+            d.mAuthStatus = verifyMessageAuth(d.mMessage);
+            if (d.mAuthStatus != MESSAGE_AUTH_OK)
+            {
+                break;
+            }
+        }
+        d.mFloodHash = computeFloodHash(msg);
+    }
+    return res;
+}
+
+void
+TCPPeer::recvDecodedMessages(std::vector<DecodedMessage> const& decoded,
+                             size_t batchSize)
+{
+    assertThreadIsMain();
+    mDecoding = false;
+    mPendingRecv -= batchSize;
+
+    for (auto const& d : decoded)
+    {
+        if (shouldAbort())
+        {
+            return;
+        }
+        if (d.mCorrupt)
+        {
+            Peer::drop(ERR_DATA, "received corrupt XDR");
+            return;
+        }
+        auto const& msg = d.mMessage.v0().message;
+        if (msg.type() != ERROR_MSG && !handleMessageAuth(d.mAuthStatus))
+        {
+            return;
+        }
+        Peer::recvMessage(msg, d.mFloodHash);
+    }
+
+    if (shouldAbort())
+    {
+        return;
+    }
+    if (!mDecodeQueue.empty())
+    {
+        startDecode();
+    }
+    if (mReadPaused && mPendingRecv < MAX_PENDING_RECV_MESSAGES)
+    {
+        mReadPaused = false;
+        startRead();
+    }
+}
+
 void
 TCPPeer::drop(bool force)
 {
@@ -18,6 +18,9 @@ namespace stellar
 
 static auto const MAX_UNAUTH_MESSAGE_SIZE = 0x1000;
 static auto const MAX_MESSAGE_SIZE = 0x1000000;
+// messages received from a peer and not processed yet past which we stop
+// reading from it
+static auto const MAX_PENDING_RECV_MESSAGES = 64;
 
 // Peer that communicates via a TCP socket.
 class TCPPeer : public Peer
@@ -35,6 +38,32 @@ class TCPPeer : public Peer
     bool mDelayedShutdown{false};
     bool mShutdownScheduled{false};
 
+    // Once authenticated, incoming messages are decoded, authenticated and
+    // hashed for the FloodGate on the overlay thread, in batches. A peer has
+    // at most one batch in flight, which keeps its messages in order, and the
+    // main thread only gets messages ready to be processed.
+    struct DecodedMessage
+    {
+        AuthenticatedMessage mMessage;
+        MessageAuthStatus mAuthStatus{MESSAGE_AUTH_OK};
+        Hash mFloodHash;
+        bool mCorrupt{false};
+    };
+    typedef std::vector<std::vector<uint8_t>> BodyBatch;
+
+    BodyBatch mDecodeQueue;
+    // messages queued, being decoded or waiting for the main thread
+    size_t mPendingRecv{0};
+    bool mDecoding{false};
+    bool mReadPaused{false};
+
+    void startDecode();
+    // runs on the overlay thread; stops at the first message that cannot be
+    // processed
+    std::vector<DecodedMessage> decodeMessages(BodyBatch const& bodies);
+    void recvDecodedMessages(std::vector<DecodedMessage> const& decoded,
+                             size_t batchSize);
+
     PeerBareAddress makeAddress(int remoteListeningPort) const override;
 
     void recvMessage();
@@ -14,6 +14,13 @@
 #include "util/Logging.h"
 #include "util/Timer.h"
 
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
 namespace stellar
 {
 
@@ -51,6 +58,79 @@ TEST_CASE("TCPPeer can communicate", "[overlay]")
     REQUIRE(p1);
     REQUIRE(p0->isAuthenticated());
     REQUIRE(p1->isAuthenticated());
+
+    SECTION("messages stay in order through the receive pipeline")
+    {
+        // more than MAX_PENDING_RECV_MESSAGES, so that reading pauses; any
+        // reordering would break the MAC sequence and drop the connection
+        auto& received =
+            n1->getMetrics().NewTimer({"overlay", "recv", "dont-have"});
+        auto before = received.count();
+        size_t const nbMessages = 10 * MAX_PENDING_RECV_MESSAGES;
+
+        StellarMessage msg;
+        msg.type(DONT_HAVE);
+        msg.dontHave().type = TX_SET;
+        for (size_t i = 0; i < nbMessages; i++)
+        {
+            msg.dontHave().reqHash = sha256(std::to_string(i));
+            p0->sendMessage(msg);
+        }
+
+        s->crankUntil(
+            [&]() { return received.count() == before + nbMessages; },
+            std::chrono::seconds(10), false);
+        REQUIRE(received.count() == before + nbMessages);
+        REQUIRE(p0->isAuthenticated());
+        REQUIRE(p1->isAuthenticated());
+    }
+
+    SECTION("busy worker threads do not hold up received messages")
+    {
+        // keeps every worker thread of n1 blocked until it goes out of scope;
+        // the tasks share the state, as they only wake up after that
+        struct BlockedWorkers
+        {
+            struct State
+            {
+                std::mutex mMutex;
+                std::condition_variable mCond;
+                bool mReleased{false};
+            };
+            std::shared_ptr<State> mState{std::make_shared<State>()};
+
+            ~BlockedWorkers()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mState->mMutex);
+                    mState->mReleased = true;
+                }
+                mState->mCond.notify_all();
+            }
+        } blocked;
+        for (size_t i = 0; i < n1->getConfig().WORKER_THREADS; i++)
+        {
+            auto state = blocked.mState;
+            n1->postOnBackgroundThread([state]() {
+                std::unique_lock<std::mutex> lock(state->mMutex);
+                state->mCond.wait(lock, [&]() { return state->mReleased; });
+            });
+        }
+
+        auto& received =
+            n1->getMetrics().NewTimer({"overlay", "recv", "dont-have"});
+        auto before = received.count();
+        StellarMessage msg;
+        msg.type(DONT_HAVE);
+        msg.dontHave().type = TX_SET;
+        msg.dontHave().reqHash = sha256("busy");
+        p0->sendMessage(msg);
+
+        s->crankUntil([&]() { return received.count() == before + 1; },
+                      std::chrono::seconds(10), false);
+        REQUIRE(received.count() == before + 1);
+    }
+
     s->stopAllNodes();
 }
 }
@@ -8,12 +8,15 @@
 #include "crypto/SHA.h"
 #include "herder/Herder.h"
 #include "main/Application.h"
+#include "main/Config.h"
 #include "medida/medida.h"
 #include "overlay/OverlayManager.h"
 #include "util/Logging.h"
 #include "util/XDROperators.h"
 #include "xdrpp/marshal.h"
 
+#include <algorithm>
+
 namespace stellar
 {
 
@@ -30,6 +33,8 @@ Tracker::Tracker(Application& app, Hash const& hash, AskPeer& askPeer)
           {"overlay", "item-fetcher", "reset-fetcher"}, "item-fetcher"))
     , mTryNextPeer(app.getMetrics().NewMeter(
           {"overlay", "item-fetcher", "next-peer"}, "item-fetcher"))
+    , mFetchTimeout(app.getMetrics().NewMeter(
+          {"overlay", "item-fetcher", "timeout"}, "item-fetcher"))
 {
     assert(mAskPeer);
 }
@@ -69,7 +74,7 @@ Tracker::clearEnvelopesBelow(uint64 slotIndex)
     }
 
     mTimer.cancel();
-    mLastAskedPeer = nullptr;
+    abandonRequests(false);
 
     return false;
 }
@@ -77,94 +82,141 @@ Tracker::clearEnvelopesBelow(uint64 slotIndex)
 void
 Tracker::doesntHave(Peer::pointer peer)
 {
-    if (mLastAskedPeer == peer)
+    auto it = mAskedPeers.find(peer);
+    if (it != mAskedPeers.end())
     {
         CLOG(TRACE, "Overlay") << "Does not have " << hexAbbrev(mItemHash);
+        mAskedPeers.erase(it);
         tryNextPeer();
     }
 }
 
+void
+Tracker::rebuildPeersToAsk()
+{
+    std::set<std::shared_ptr<Peer>> peersWithEnvelope;
+    for (auto const& e : mWaitingEnvelopes)
+    {
+        auto const& s = mApp.getOverlayManager().getPeersKnows(e.first);
+        peersWithEnvelope.insert(s.begin(), s.end());
+    }
+
+    // ask the peers that have the envelope first, the fastest ones first;
+    // ties stay in random order
+    auto peers = mApp.getOverlayManager().getRandomAuthenticatedPeers();
+    std::stable_sort(peers.begin(), peers.end(),
+                     [&](Peer::pointer const& a, Peer::pointer const& b) {
+                         bool aHas = peersWithEnvelope.count(a) != 0;
+                         bool bHas = peersWithEnvelope.count(b) != 0;
+                         if (aHas != bHas)
+                         {
+                             return aHas;
+                         }
+                         return a->getFetchLatency() < b->getFetchLatency();
+                     });
+    mPeersToAsk.assign(peers.begin(), peers.end());
+
+    mNumListRebuild++;
+
+    CLOG(TRACE, "Overlay") << "tryNextPeer " << hexAbbrev(mItemHash)
+                           << " attempt " << mNumListRebuild << " reset to #"
+                           << mPeersToAsk.size();
+    mTryNextPeerReset.Mark();
+}
+
 void
 Tracker::tryNextPeer()
 {
     // will be called by some timer or when we get a
     // response saying they don't have it
-    Peer::pointer peer;
-
     CLOG(TRACE, "Overlay") << "tryNextPeer " << hexAbbrev(mItemHash)
-                           << " last: "
-                           << (mLastAskedPeer ? mLastAskedPeer->toString()
-                                              : "<none>");
+                           << " waiting for: " << mAskedPeers.size();
 
-    // if we don't have a list of peers to ask and we're not
-    // currently asking peers, build a new list
-    if (mPeersToAsk.empty() && !mLastAskedPeer)
+    // give up on the peers that did not answer in time
+    auto now = mApp.getClock().now();
+    for (auto it = mAskedPeers.begin(); it != mAskedPeers.end();)
     {
-        std::set<std::shared_ptr<Peer>> peersWithEnvelope;
-        for (auto const& e : mWaitingEnvelopes)
+        if (now - it->second >= MS_TO_WAIT_FOR_FETCH_REPLY)
         {
-            auto const& s = mApp.getOverlayManager().getPeersKnows(e.first);
-            peersWithEnvelope.insert(s.begin(), s.end());
+            CLOG(TRACE, "Overlay") << "Timed out asking for "
+                                   << hexAbbrev(mItemHash) << " to "
+                                   << it->first->toString();
+            mFetchTimeout.Mark();
+            it->first->fetchAbandoned(mItemHash, true);
+            it = mAskedPeers.erase(it);
         }
-
-        // move the peers that have the envelope to the back,
-        // to be processed first
-        for (auto const& p :
-             mApp.getOverlayManager().getRandomAuthenticatedPeers())
+        else
         {
-            if (peersWithEnvelope.find(p) != peersWithEnvelope.end())
-            {
-                mPeersToAsk.emplace_back(p);
-            }
-            else
-            {
-                mPeersToAsk.emplace_front(p);
-            }
+            ++it;
         }
-
-        mNumListRebuild++;
-
-        CLOG(TRACE, "Overlay")
-            << "tryNextPeer " << hexAbbrev(mItemHash) << " attempt "
-            << mNumListRebuild << " reset to #" << mPeersToAsk.size();
-        mTryNextPeerReset.Mark();
     }
 
-    while (!peer && !mPeersToAsk.empty())
+    // if we don't have a list of peers to ask and we're not
+    // currently asking peers, build a new list once the wait that follows
+    // each round is over
+    if (mPeersToAsk.empty() && mAskedPeers.empty())
     {
-        peer = mPeersToAsk.back();
-        if (!peer->isAuthenticated())
+        if (mNumListRebuild != 0 && !mWaitingForNextRound)
         {
-            peer.reset();
+            waitForNextRound(now);
+            return;
         }
-        mPeersToAsk.pop_back();
-    }
-
-    std::chrono::milliseconds nextTry;
-    if (!peer)
-    { // we have asked all our peers
-        // clear mLastAskedPeer so that we rebuild a new list
-        mLastAskedPeer.reset();
-        if (mNumListRebuild > MAX_REBUILD_FETCH_LIST)
-        {
-            nextTry = MS_TO_WAIT_FOR_FETCH_REPLY * MAX_REBUILD_FETCH_LIST;
-        }
-        else
+        if (mWaitingForNextRound && now < mNextRound)
         {
-            nextTry = MS_TO_WAIT_FOR_FETCH_REPLY * mNumListRebuild;
+            armTimer(mNextRound - now);
+            return;
         }
+        mWaitingForNextRound = false;
+        rebuildPeersToAsk();
     }
-    else
+
+    size_t fanout = mApp.getConfig().FETCH_FANOUT;
+    while (mAskedPeers.size() < fanout && !mPeersToAsk.empty())
     {
-        mLastAskedPeer = peer;
+        auto peer = mPeersToAsk.front();
+        mPeersToAsk.pop_front();
+        if (!peer->isAuthenticated() ||
+            mAskedPeers.find(peer) != mAskedPeers.end())
+        {
+            continue;
+        }
+
         CLOG(TRACE, "Overlay") << "Asking for " << hexAbbrev(mItemHash)
                                << " to " << peer->toString();
         mTryNextPeer.Mark();
+        mAskedPeers.emplace(peer, now);
         mAskPeer(peer, mItemHash);
-        nextTry = MS_TO_WAIT_FOR_FETCH_REPLY;
     }
 
-    mTimer.expires_from_now(nextTry);
+    if (mAskedPeers.empty())
+    { // we have asked all our peers
+        waitForNextRound(now);
+        return;
+    }
+
+    // wake up when the oldest request times out
+    auto oldest = now;
+    for (auto const& asked : mAskedPeers)
+    {
+        oldest = std::min(oldest, asked.second);
+    }
+    armTimer(oldest + MS_TO_WAIT_FOR_FETCH_REPLY - now);
+}
+
+void
+Tracker::waitForNextRound(VirtualClock::time_point now)
+{
+    // back off a bit more after each round, as no peer had the item
+    mWaitingForNextRound = true;
+    mNextRound = now + MS_TO_WAIT_FOR_FETCH_REPLY *
+                           std::min(mNumListRebuild, MAX_REBUILD_FETCH_LIST);
+    armTimer(mNextRound - now);
+}
+
+void
+Tracker::armTimer(VirtualClock::duration wait)
+{
+    mTimer.expires_from_now(wait);
     mTimer.async_wait([this]() { this->tryNextPeer(); },
                       VirtualTimer::onFailureNoop);
 }
@@ -193,10 +245,23 @@ Tracker::discard(const SCPEnvelope& env)
                             std::end(mWaitingEnvelopes));
 }
 
+void
+Tracker::abandonRequests(bool timedOut)
+{
+    for (auto const& asked : mAskedPeers)
+    {
+        asked.first->fetchAbandoned(mItemHash, timedOut);
+    }
+    mAskedPeers.clear();
+}
+
 void
 Tracker::cancel()
 {
     mTimer.cancel();
+    abandonRequests(false);
+    mPeersToAsk.clear();
+    mWaitingForNextRound = false;
     mLastSeenSlotIndex = 0;
 }
 }
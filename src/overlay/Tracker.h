@@ -7,8 +7,11 @@
 /**
  * @class Tracker
  *
- * Asks peers for given data set. If a peer does not have given data set,
- * asks another one. If no peer does have given data set, it starts again
+ * Asks peers for given data set, FETCH_FANOUT of them at a time. If a peer
+ * does not have given data set or does not answer in time, asks another one.
+ * Peers that sent one of the waiting envelopes are asked first, and among
+ * them the ones that delivered items the fastest so far. If no peer does have
+ * given data set, it waits a bit longer after each round and starts again
  * with new set of peers (possibly overlapping, as peers may learned about
  * this data set in meantime).
  *
@@ -24,7 +27,9 @@
 #include "util/Timer.h"
 #include "xdr/Stellar-types.h"
 
+#include <deque>
 #include <functional>
+#include <map>
 #include <utility>
 #include <vector>
 
@@ -40,16 +45,27 @@ class Tracker
   private:
     AskPeer mAskPeer;
     Application& mApp;
-    Peer::pointer mLastAskedPeer;
+    // peers asked and that did not answer yet, with when they were asked
+    std::map<Peer::pointer, VirtualClock::time_point> mAskedPeers;
     int mNumListRebuild;
     std::deque<Peer::pointer> mPeersToAsk;
     VirtualTimer mTimer;
+    // set once every peer was asked, until mNextRound
+    bool mWaitingForNextRound{false};
+    VirtualClock::time_point mNextRound;
     std::vector<std::pair<Hash, SCPEnvelope>> mWaitingEnvelopes;
     Hash mItemHash;
     medida::Meter& mTryNextPeerReset;
     medida::Meter& mTryNextPeer;
+    medida::Meter& mFetchTimeout;
     uint64 mLastSeenSlotIndex{0};
 
+    void rebuildPeersToAsk();
+    void waitForNextRound(VirtualClock::time_point now);
+    void armTimer(VirtualClock::duration wait);
+    // stops waiting for the peers asked
+    void abandonRequests(bool timedOut);
+
   public:
     /**
      * Create Tracker that tracks data identified by @p hash. @p askPeer
@@ -110,7 +126,8 @@ class Tracker
     void discard(const SCPEnvelope& env);
 
     /**
-     * Stop the timer, stop requesting the item as we have it.
+     * Stop the timer, stop requesting the item as we have it. Requests not
+     * answered yet are abandoned.
      */
     void cancel();
 
@@ -122,7 +139,8 @@ class Tracker
 
     /**
      * Called either when @see doesntHave(Peer::pointer) was received or
-     * request to peer timed out.
+     * request to peer timed out. Asks new peers until FETCH_FANOUT requests
+     * are waiting for an answer.
      */
     void tryNextPeer();
 
@@ -23,6 +23,9 @@ using namespace std::placeholders;
 // max number of transitions that can occur from processing one message
 static const int MAX_ADVANCE_SLOT_RECURSION = 50;
 
+// bound on the number of memoized federated checks kept for a slot
+static const size_t MAX_FEDERATED_CHECKS = 1000;
+
 BallotProtocol::BallotProtocol(Slot& slot)
     : mSlot(slot)
     , mHeardFromQuorum(false)
@@ -137,10 +140,12 @@ BallotProtocol::recordEnvelope(SCPEnvelope const& env)
     auto oldp = mLatestEnvelopes.find(st.nodeID);
     if (oldp == mLatestEnvelopes.end())
     {
+        invalidateFederatedChecks(nullptr, st);
         mLatestEnvelopes.insert(std::make_pair(st.nodeID, env));
     }
     else
     {
+        invalidateFederatedChecks(&oldp->second.statement, st);
         oldp->second = env;
     }
     mSlot.recordStatement(env.statement);
@@ -833,9 +838,10 @@ BallotProtocol::attemptPreparedAccept(SCPStatement const& hint)
             // otherwise, there is a chance it increases p'
         }
 
-        bool accepted = federatedAccept(
+        bool accepted = federatedCheck(
+            FederatedCheckKey(ACCEPT_PREPARED, ballot, Interval(0, 0)),
             // checks if any node is voting for this ballot
-            [&ballot](SCPStatement const& st) {
+            [ballot](SCPStatement const& st) {
                 bool res;
 
                 switch (st.pledges.type())
@@ -940,7 +946,8 @@ BallotProtocol::attemptPreparedConfirmed(SCPStatement const& hint)
             break;
         }
 
-        bool ratified = federatedRatify(
+        bool ratified = federatedCheck(
+            FederatedCheckKey(CONFIRM_PREPARED, ballot, Interval(0, 0)),
             std::bind(&BallotProtocol::hasPreparedBallot, ballot, _1));
         if (ratified)
         {
@@ -976,7 +983,8 @@ BallotProtocol::attemptPreparedConfirmed(SCPStatement const& hint)
                 {
                     continue;
                 }
-                bool ratified = federatedRatify(
+                bool ratified = federatedCheck(
+                    FederatedCheckKey(CONFIRM_PREPARED, ballot, Interval(0, 0)),
                     std::bind(&BallotProtocol::hasPreparedBallot, ballot, _1));
                 if (ratified)
                 {
@@ -1215,8 +1223,9 @@ BallotProtocol::attemptAcceptCommit(SCPStatement const& hint)
     }
 
     auto pred = [&ballot, this](Interval const& cur) -> bool {
-        return federatedAccept(
-            [&](SCPStatement const& st) -> bool {
+        return federatedCheck(
+            FederatedCheckKey(ACCEPT_COMMIT, ballot, cur),
+            [ballot, cur](SCPStatement const& st) -> bool {
                 bool res = false;
                 auto const& pl = st.pledges;
                 switch (pl.type())
@@ -1476,7 +1485,8 @@ BallotProtocol::attemptConfirmCommit(SCPStatement const& hint)
     Interval candidate;
 
     auto pred = [&ballot, this](Interval const& cur) -> bool {
-        return federatedRatify(
+        return federatedCheck(
+            FederatedCheckKey(CONFIRM_COMMIT, ballot, cur),
             std::bind(&BallotProtocol::commitPredicate, ballot, cur, _1));
     };
 
@@ -2103,6 +2113,73 @@ BallotProtocol::federatedRatify(StatementPredicate voted)
     return mSlot.federatedRatify(voted, mLatestEnvelopes);
 }
 
+bool
+BallotProtocol::federatedCheck(FederatedCheckKey const& key,
+                               StatementPredicate voted,
+                               StatementPredicate accepted)
+{
+    auto const& qSetHash = getLocalNode()->getQuorumSetHash();
+    if (!(qSetHash == mFederatedChecksQSetHash))
+    {
+        mFederatedChecks.clear();
+        mFederatedChecksQSetHash = qSetHash;
+    }
+
+    auto it = mFederatedChecks.find(key);
+    if (it != mFederatedChecks.end())
+    {
+        return it->second.result;
+    }
+
+    bool res = accepted ? federatedAccept(voted, accepted)
+                        : federatedRatify(voted);
+    if (mFederatedChecks.size() >= MAX_FEDERATED_CHECKS)
+    {
+        mFederatedChecks.clear();
+    }
+    mFederatedChecks.emplace(key, FederatedCheck{voted, accepted, res});
+    return res;
+}
+
+void
+BallotProtocol::invalidateFederatedChecks(SCPStatement const* oldst,
+                                          SCPStatement const& st)
+{
+    // quorum and v-blocking checks only look at the nodes that satisfy their
+    // predicates (and at the quorum sets of those), so a check stands as long
+    // as the node keeps giving it the same support with the same quorum set
+    bool qSetChanged = true;
+    if (oldst)
+    {
+        qSetChanged = !(getCompanionQuorumSetHashFromStatement(*oldst) ==
+                        getCompanionQuorumSetHashFromStatement(st));
+    }
+
+    auto support = [](FederatedCheck const& check, SCPStatement const* s) {
+        int res = 0;
+        if (s)
+        {
+            res |= check.voted(*s) ? 1 : 0;
+            res |= (check.accepted && check.accepted(*s)) ? 2 : 0;
+        }
+        return res;
+    };
+
+    for (auto it = mFederatedChecks.begin(); it != mFederatedChecks.end();)
+    {
+        int before = support(it->second, oldst);
+        int after = support(it->second, &st);
+        if (before != after || (qSetChanged && (before | after) != 0))
+        {
+            it = mFederatedChecks.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
 void
 BallotProtocol::checkHeardFromQuorum()
 {
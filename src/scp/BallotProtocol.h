@@ -10,6 +10,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <tuple>
 #include <utility>
 
 namespace stellar
@@ -260,6 +261,44 @@ class BallotProtocol
     bool federatedAccept(StatementPredicate voted, StatementPredicate accepted);
     bool federatedRatify(StatementPredicate voted);
 
+    // ** memoized federated checks
+    //
+    // The attempt* methods run their federated checks against every
+    // statement in M each time an envelope comes in, yet a new statement
+    // from a node can only change the outcome of the checks that node stops
+    // or starts supporting. The outcome of each check is kept until
+    // recordEnvelope sees a statement that changes one of its predicates for
+    // the sending node, or the quorum set of a node that supports it.
+    enum FederatedCheckType
+    {
+        ACCEPT_PREPARED,
+        CONFIRM_PREPARED,
+        ACCEPT_COMMIT,
+        CONFIRM_COMMIT
+    };
+    // (type, ballot, commit interval -- {0, 0} for prepare checks)
+    using FederatedCheckKey =
+        std::tuple<FederatedCheckType, SCPBallot, Interval>;
+    struct FederatedCheck
+    {
+        StatementPredicate voted;
+        StatementPredicate accepted; // empty for ratify checks
+        bool result;
+    };
+    std::map<FederatedCheckKey, FederatedCheck> mFederatedChecks;
+    // local quorum set the checks were made with
+    Hash mFederatedChecksQSetHash;
+
+    // federatedAccept (or federatedRatify if accepted is empty), memoized
+    // under key
+    bool federatedCheck(FederatedCheckKey const& key,
+                        StatementPredicate voted,
+                        StatementPredicate accepted = StatementPredicate());
+    // drops the checks whose outcome may change when a node's statement goes
+    // from oldst (nullptr if none) to st
+    void invalidateFederatedChecks(SCPStatement const* oldst,
+                                   SCPStatement const& st);
+
     void startBallotProtocolTimer();
     void stopBallotProtocolTimer();
     void checkHeardFromQuorum();
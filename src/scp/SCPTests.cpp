@@ -14,6 +14,7 @@
 #include "util/XDROperators.h"
 #include "xdrpp/marshal.h"
 #include "xdrpp/printer.h"
+#include <chrono>
 
 namespace stellar
 {
@@ -2712,4 +2713,70 @@ TEST_CASE("nomination tests core5", "[scp][nominationprotocol]")
         }
     }
 }
+
+TEST_CASE("ballot protocol 100 validators bench", "[scp][bench][!hide]")
+{
+    size_t const n = 100;
+    uint64 const slots = 20;
+
+    std::vector<SecretKey> keys;
+    SCPQuorumSet qSet;
+    qSet.threshold = 67;
+    for (size_t i = 0; i < n; i++)
+    {
+        keys.emplace_back(
+            SecretKey::fromSeed(sha256("NODE_SEED_" + std::to_string(i))));
+        qSet.validators.push_back(keys.back().getPublicKey());
+    }
+    uint256 qSetHash = sha256(xdr::xdr_to_opaque(qSet));
+
+    TestSCP scp(keys[0].getPublicKey(), qSet);
+    scp.storeQuorumSet(std::make_shared<SCPQuorumSet>(qSet));
+
+    // every other validator walks through each phase of the ballot protocol
+    // in turn, so that the local node sees n envelopes per phase
+    std::vector<std::vector<SCPEnvelope>> envs;
+    for (uint64 slot = 0; slot < slots; slot++)
+    {
+        SCPBallot b(1, xValue);
+        std::vector<SCPEnvelope> slotEnvs;
+        for (size_t i = 1; i < n; i++)
+        {
+            slotEnvs.push_back(makePrepare(keys[i], qSetHash, slot, b));
+        }
+        for (size_t i = 1; i < n; i++)
+        {
+            slotEnvs.push_back(makePrepare(keys[i], qSetHash, slot, b, &b));
+        }
+        for (size_t i = 1; i < n; i++)
+        {
+            slotEnvs.push_back(
+                makePrepare(keys[i], qSetHash, slot, b, &b, b.counter,
+                            b.counter));
+        }
+        for (size_t i = 1; i < n; i++)
+        {
+            slotEnvs.push_back(makeConfirm(keys[i], qSetHash, slot, b.counter,
+                                           b, b.counter, b.counter));
+        }
+        envs.emplace_back(std::move(slotEnvs));
+    }
+
+    LOG(INFO) << "Benchmarking " << slots << " slots with " << n
+              << " validators";
+    auto start = std::chrono::steady_clock::now();
+    for (uint64 slot = 0; slot < slots; slot++)
+    {
+        REQUIRE(scp.bumpState(slot, xValue));
+        for (auto const& e : envs[slot])
+        {
+            scp.receiveEnvelope(e);
+        }
+        REQUIRE(scp.mExternalizedValues[slot] == xValue);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    LOG(INFO) << "Externalized " << slots << " slots in " << elapsed.count()
+              << "ms";
+}
 }
@@ -0,0 +1,344 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "simulation/SCPSimulation.h"
+#include "crypto/SHA.h"
+#include "util/Logging.h"
+#include "util/XDROperators.h"
+#include "xdrpp/marshal.h"
+#include <lib/util/format.h>
+
+#include <algorithm>
+
+namespace stellar
+{
+
+class SCPSimulation::Node : public SCPDriver
+{
+    SCPSimulation& mSim;
+    size_t const mIndex;
+
+    // (slot, timer id) -> generation of the armed timer; setting up a timer
+    // again disarms the event scheduled for the previous one
+    std::map<std::pair<uint64, int>, uint64> mTimers;
+    uint64 mTimerGeneration{0};
+
+  public:
+    SCP mSCP;
+    // slot -> value externalized and when
+    std::map<uint64, std::pair<Value, std::chrono::milliseconds>>
+        mExternalized;
+
+    Node(SCPSimulation& sim, size_t index, NodeID const& nodeID,
+         SCPQuorumSet const& qSet)
+        : mSim(sim), mIndex(index), mSCP(*this, nodeID, true, qSet)
+    {
+    }
+
+    void
+    signEnvelope(SCPEnvelope&) override
+    {
+    }
+
+    bool
+    verifyEnvelope(SCPEnvelope const&) override
+    {
+        return true;
+    }
+
+    SCPQuorumSetPtr
+    getQSet(Hash const& qSetHash) override
+    {
+        return mSim.getQSet(qSetHash);
+    }
+
+    void
+    emitEnvelope(SCPEnvelope const& envelope) override
+    {
+        mSim.broadcast(mIndex, envelope);
+    }
+
+    ValidationLevel
+    validateValue(uint64 slotIndex, Value const& value,
+                  bool nomination) override
+    {
+        return kFullyValidatedValue;
+    }
+
+    Value
+    combineCandidates(uint64 slotIndex,
+                      std::set<Value> const& candidates) override
+    {
+        return *candidates.rbegin();
+    }
+
+    void
+    setupTimer(uint64 slotIndex, int timerID, std::chrono::milliseconds timeout,
+               std::function<void()> cb) override
+    {
+        auto key = std::make_pair(slotIndex, timerID);
+        auto generation = ++mTimerGeneration;
+        mTimers[key] = generation;
+        if (!cb)
+        {
+            return;
+        }
+
+        mSim.schedule(timeout, [this, key, generation, cb]() {
+            auto it = mTimers.find(key);
+            if (it != mTimers.end() && it->second == generation)
+            {
+                mTimers.erase(it);
+                cb();
+            }
+        });
+    }
+
+    void
+    cancelTimers()
+    {
+        mTimers.clear();
+    }
+
+    void
+    valueExternalized(uint64 slotIndex, Value const& value) override
+    {
+        mExternalized[slotIndex] = std::make_pair(value, mSim.mCurrentTime);
+        if (slotIndex == mSim.mCurrentSlot)
+        {
+            mSim.mExternalizedCount++;
+        }
+    }
+};
+
+SCPSimulation::SCPSimulation(Params const& params)
+    : mParams(params), mRandom(params.seed)
+{
+}
+
+SCPSimulation::~SCPSimulation()
+{
+}
+
+void
+SCPSimulation::addNode(SecretKey const& key, SCPQuorumSet const& qSet)
+{
+    auto qSetHash = sha256(xdr::xdr_to_opaque(qSet));
+    mQuorumSets[qSetHash] = std::make_shared<SCPQuorumSet>(qSet);
+    mNodes.emplace_back(std::make_unique<Node>(*this, mNodes.size(),
+                                               key.getPublicKey(), qSet));
+}
+
+void
+SCPSimulation::addTieredNodes(size_t nbOrgs, size_t nodesPerOrg)
+{
+    std::vector<SecretKey> keys;
+    SCPQuorumSet qSet;
+    qSet.threshold = static_cast<uint32>(nbOrgs - (nbOrgs - 1) / 3);
+    for (size_t i = 0; i < nbOrgs; i++)
+    {
+        SCPQuorumSet org;
+        org.threshold =
+            static_cast<uint32>(nodesPerOrg - (nodesPerOrg - 1) / 3);
+        for (size_t j = 0; j < nodesPerOrg; j++)
+        {
+            auto seed = fmt::format("SCP_SIMULATION_NODE_{}",
+                                    mNodes.size() + keys.size());
+            keys.emplace_back(SecretKey::fromSeed(sha256(seed)));
+            org.validators.emplace_back(keys.back().getPublicKey());
+        }
+        qSet.innerSets.emplace_back(org);
+    }
+
+    for (auto const& key : keys)
+    {
+        addNode(key, qSet);
+    }
+}
+
+void
+SCPSimulation::schedule(std::chrono::milliseconds delay,
+                        std::function<void()> f)
+{
+    mEvents.emplace(std::make_pair(mCurrentTime + delay, mEventCount++),
+                    std::move(f));
+}
+
+void
+SCPSimulation::broadcast(size_t from, SCPEnvelope const& envelope)
+{
+    mStats.envelopesSent++;
+
+    auto env = std::make_shared<SCPEnvelope const>(envelope);
+    std::uniform_int_distribution<int64_t> latency(
+        mParams.minLatency.count(), mParams.maxLatency.count());
+    std::bernoulli_distribution loss(mParams.lossRate);
+    for (size_t i = 0; i < mNodes.size(); i++)
+    {
+        if (i == from)
+        {
+            continue;
+        }
+        if (loss(mRandom))
+        {
+            mStats.envelopesDropped++;
+            continue;
+        }
+
+        auto& node = *mNodes[i];
+        schedule(std::chrono::milliseconds(latency(mRandom)),
+                 [this, &node, env]() {
+                     auto start = std::chrono::steady_clock::now();
+                     node.mSCP.receiveEnvelope(*env);
+                     mStats.processingTime +=
+                         std::chrono::steady_clock::now() - start;
+                     mStats.envelopesProcessed++;
+                 });
+    }
+}
+
+void
+SCPSimulation::rebroadcast(uint64 slotIndex)
+{
+    for (size_t i = 0; i < mNodes.size(); i++)
+    {
+        for (auto const& e : mNodes[i]->mSCP.getLatestMessagesSend(slotIndex))
+        {
+            broadcast(i, e);
+        }
+    }
+    schedule(mParams.rebroadcastPeriod,
+             [this, slotIndex]() { rebroadcast(slotIndex); });
+}
+
+SCPQuorumSetPtr
+SCPSimulation::getQSet(Hash const& qSetHash) const
+{
+    auto it = mQuorumSets.find(qSetHash);
+    return it == mQuorumSets.end() ? SCPQuorumSetPtr() : it->second;
+}
+
+bool
+SCPSimulation::runSlot(uint64 slotIndex, std::chrono::milliseconds timeout)
+{
+    mCurrentSlot = slotIndex;
+    mExternalizedCount = 0;
+    auto slotStart = mCurrentTime;
+    auto deadline = mCurrentTime + timeout;
+
+    for (size_t i = 0; i < mNodes.size(); i++)
+    {
+        auto value = fmt::format("SCP_SIMULATION_VALUE_{}_{}", slotIndex, i);
+        mNodes[i]->mSCP.nominate(slotIndex, xdr::xdr_to_opaque(sha256(value)),
+                                 Value());
+    }
+    schedule(mParams.rebroadcastPeriod,
+             [this, slotIndex]() { rebroadcast(slotIndex); });
+
+    while (mExternalizedCount < mNodes.size() && !mEvents.empty() &&
+           mEvents.begin()->first.first <= deadline)
+    {
+        auto it = mEvents.begin();
+        mCurrentTime = it->first.first;
+        auto event = std::move(it->second);
+        mEvents.erase(it);
+        event();
+    }
+
+    // whatever is still in flight or armed only concerns this slot
+    mEvents.clear();
+    for (auto& node : mNodes)
+    {
+        node->cancelTimers();
+        node->mSCP.purgeSlots(slotIndex);
+    }
+    recordSlotStats(slotIndex, slotStart);
+
+    if (mExternalizedCount < mNodes.size())
+    {
+        CLOG(WARNING, "SCP") << "Only " << mExternalizedCount << " of "
+                             << mNodes.size() << " nodes externalized slot "
+                             << slotIndex;
+        return false;
+    }
+
+    auto const& value = mNodes.front()->mExternalized[slotIndex].first;
+    return std::all_of(mNodes.begin(), mNodes.end(),
+                       [&](std::unique_ptr<Node> const& node) {
+                           return node->mExternalized[slotIndex].first ==
+                                  value;
+                       });
+}
+
+void
+SCPSimulation::recordSlotStats(uint64 slotIndex,
+                               std::chrono::milliseconds slotStart)
+{
+    std::vector<std::chrono::milliseconds> times;
+    for (auto const& node : mNodes)
+    {
+        auto it = node->mExternalized.find(slotIndex);
+        if (it != node->mExternalized.end())
+        {
+            times.emplace_back(it->second.second - slotStart);
+        }
+    }
+    std::sort(times.begin(), times.end());
+
+    SlotStats stats{slotIndex, times.size(), {}, {}, {}};
+    if (!times.empty())
+    {
+        stats.firstExternalize = times.front();
+        stats.medianExternalize = times[times.size() / 2];
+        stats.lastExternalize = times.back();
+    }
+    mSlotStats.emplace_back(stats);
+}
+
+size_t
+SCPSimulation::getNodeCount() const
+{
+    return mNodes.size();
+}
+
+std::chrono::milliseconds
+SCPSimulation::getCurrentTime() const
+{
+    return mCurrentTime;
+}
+
+SCPSimulation::Stats const&
+SCPSimulation::getStats() const
+{
+    return mStats;
+}
+
+std::vector<SCPSimulation::SlotStats> const&
+SCPSimulation::getSlotStats() const
+{
+    return mSlotStats;
+}
+
+std::string
+SCPSimulation::statsSummary() const
+{
+    auto res = fmt::format(
+        "{} nodes: {} envelopes sent, {} processed, {} dropped, {:.1f}ms "
+        "spent in SCP\n",
+        mNodes.size(), mStats.envelopesSent, mStats.envelopesProcessed,
+        mStats.envelopesDropped,
+        std::chrono::duration<double, std::milli>(mStats.processingTime)
+            .count());
+    for (auto const& s : mSlotStats)
+    {
+        res += fmt::format("slot {}: {} externalized, first at {}ms, median "
+                           "at {}ms, last at {}ms\n",
+                           s.slotIndex, s.externalized,
+                           s.firstExternalize.count(),
+                           s.medianExternalize.count(),
+                           s.lastExternalize.count());
+    }
+    return res;
+}
+}
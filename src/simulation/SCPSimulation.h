@@ -0,0 +1,123 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/SecretKey.h"
+#include "scp/SCP.h"
+#include "scp/SCPDriver.h"
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * SCPSimulation runs many SCP instances in one process without Application,
+ * overlay or database, to model consensus on networks of hundreds or
+ * thousands of validators.
+ *
+ * Each node is an SCP object whose SCPDriver hands emitted envelopes to an
+ * in-process message bus. The bus delivers every envelope to every other
+ * node after a random latency, or drops it with probability lossRate; like
+ * the herder, nodes periodically rebroadcast their latest envelopes so that
+ * consensus survives losses. Time is virtual: events (deliveries, SCP timers
+ * and rebroadcasts) run in order of their due time, and all randomness comes
+ * from a generator seeded by Params::seed, so a run is deterministic.
+ *
+ * runSlot has every node nominate its own value for a slot and returns once
+ * all nodes have externalized it. Besides envelope counts, the simulation
+ * measures the wall-clock time spent inside SCP::receiveEnvelope (which is
+ * dominated by quorum and v-blocking evaluation) and the virtual time it
+ * took nodes to externalize each slot.
+ */
+class SCPSimulation
+{
+  public:
+    struct Params
+    {
+        std::chrono::milliseconds minLatency{20};
+        std::chrono::milliseconds maxLatency{200};
+        // fraction of envelope deliveries dropped
+        double lossRate{0.0};
+        std::chrono::milliseconds rebroadcastPeriod{2000};
+        uint32_t seed{1};
+    };
+
+    struct Stats
+    {
+        uint64 envelopesSent{0};
+        uint64 envelopesProcessed{0};
+        uint64 envelopesDropped{0};
+        // wall-clock time spent in SCP::receiveEnvelope
+        std::chrono::nanoseconds processingTime{0};
+    };
+
+    struct SlotStats
+    {
+        uint64 slotIndex;
+        size_t externalized;
+        // virtual time between the start of the slot and the first, median
+        // and last node externalizing it
+        std::chrono::milliseconds firstExternalize;
+        std::chrono::milliseconds medianExternalize;
+        std::chrono::milliseconds lastExternalize;
+    };
+
+    explicit SCPSimulation(Params const& params);
+    ~SCPSimulation();
+
+    void addNode(SecretKey const& key, SCPQuorumSet const& qSet);
+
+    // adds nbOrgs * nodesPerOrg validators sharing one tiered quorum set:
+    // each organization is an inner set that tolerates a third of its nodes
+    // failing, and the top level likewise requires all but a third of the
+    // organizations
+    void addTieredNodes(size_t nbOrgs, size_t nodesPerOrg);
+
+    // has every node nominate a value for slotIndex and runs the network
+    // until all nodes externalized it, or for at most `timeout` of virtual
+    // time; returns true if all nodes externalized the same value
+    bool runSlot(uint64 slotIndex, std::chrono::milliseconds timeout);
+
+    size_t getNodeCount() const;
+    std::chrono::milliseconds getCurrentTime() const;
+    Stats const& getStats() const;
+    std::vector<SlotStats> const& getSlotStats() const;
+    std::string statsSummary() const;
+
+  private:
+    class Node;
+
+    void schedule(std::chrono::milliseconds delay, std::function<void()> f);
+    void broadcast(size_t from, SCPEnvelope const& envelope);
+    void rebroadcast(uint64 slotIndex);
+    void recordSlotStats(uint64 slotIndex,
+                         std::chrono::milliseconds slotStart);
+    SCPQuorumSetPtr getQSet(Hash const& qSetHash) const;
+
+    Params const mParams;
+    std::mt19937 mRandom;
+    std::chrono::milliseconds mCurrentTime{0};
+
+    // (due time, insertion order) -> event
+    std::map<std::pair<std::chrono::milliseconds, uint64>,
+             std::function<void()>>
+        mEvents;
+    uint64 mEventCount{0};
+
+    std::map<Hash, SCPQuorumSetPtr> mQuorumSets;
+    std::vector<std::unique_ptr<Node>> mNodes;
+    size_t mExternalizedCount{0};
+    uint64 mCurrentSlot{0};
+
+    Stats mStats;
+    std::vector<SlotStats> mSlotStats;
+};
+}
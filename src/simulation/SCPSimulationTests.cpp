@@ -0,0 +1,78 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "lib/catch.hpp"
+#include "simulation/SCPSimulation.h"
+#include "util/Logging.h"
+
+using namespace stellar;
+
+TEST_CASE("SCP simulation externalizes on tiered quorum", "[scp][simulation]")
+{
+    SCPSimulation::Params params;
+    params.lossRate = 0.05;
+
+    SCPSimulation sim(params);
+    sim.addTieredNodes(4, 3);
+    REQUIRE(sim.getNodeCount() == 12);
+
+    for (uint64 slot = 1; slot <= 3; slot++)
+    {
+        REQUIRE(sim.runSlot(slot, std::chrono::minutes(5)));
+    }
+
+    auto const& stats = sim.getStats();
+    REQUIRE(stats.envelopesProcessed > 0);
+    REQUIRE(stats.envelopesDropped > 0);
+    REQUIRE(sim.getSlotStats().size() == 3);
+    for (auto const& s : sim.getSlotStats())
+    {
+        REQUIRE(s.externalized == 12);
+        REQUIRE(s.firstExternalize <= s.lastExternalize);
+    }
+    LOG(INFO) << sim.statsSummary();
+}
+
+TEST_CASE("SCP simulation is deterministic", "[scp][simulation]")
+{
+    SCPSimulation::Params params;
+    params.lossRate = 0.1;
+    params.seed = 42;
+
+    auto run = [&]() {
+        SCPSimulation sim(params);
+        sim.addTieredNodes(3, 3);
+        REQUIRE(sim.runSlot(1, std::chrono::minutes(5)));
+        return std::make_pair(sim.getStats().envelopesProcessed,
+                              sim.getCurrentTime());
+    };
+    REQUIRE(run() == run());
+}
+
+static void
+benchSCPSimulation(size_t nbOrgs, size_t nodesPerOrg)
+{
+    SCPSimulation::Params params;
+    params.lossRate = 0.01;
+
+    SCPSimulation sim(params);
+    sim.addTieredNodes(nbOrgs, nodesPerOrg);
+    for (uint64 slot = 1; slot <= 5; slot++)
+    {
+        REQUIRE(sim.runSlot(slot, std::chrono::minutes(5)));
+    }
+    LOG(INFO) << sim.statsSummary();
+}
+
+TEST_CASE("SCP simulation 100 validators bench",
+          "[scp][simulation][bench][!hide]")
+{
+    benchSCPSimulation(20, 5);
+}
+
+TEST_CASE("SCP simulation 1000 validators bench",
+          "[scp][simulation][bench][long][!hide]")
+{
+    benchSCPSimulation(100, 10);
+}
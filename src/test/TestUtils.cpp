@@ -58,8 +58,8 @@ BucketListDepthModifier::~BucketListDepthModifier()
 }
 }
 
-TestInvariantManager::TestInvariantManager(medida::MetricsRegistry& registry)
-    : InvariantManagerImpl(registry)
+TestInvariantManager::TestInvariantManager(Application& app)
+    : InvariantManagerImpl(app)
 {
 }
 
@@ -78,7 +78,7 @@ TestApplication::TestApplication(VirtualClock& clock, Config const& cfg)
 std::unique_ptr<InvariantManager>
 TestApplication::createInvariantManager()
 {
-    return std::make_unique<TestInvariantManager>(getMetrics());
+    return std::make_unique<TestInvariantManager>(*this);
 }
 
 time_t
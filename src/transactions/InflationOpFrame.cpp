@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "transactions/InflationOpFrame.h"
+#include "database/Database.h"
 #include "ledger/AccountFrame.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerManager.h"
@@ -64,6 +65,14 @@ InflationOpFrame::doApply(Application& app, LedgerDelta& delta,
     std::vector<AccountFrame::InflationVotes> winners;
     auto& db = ledgerManager.getDatabase();
 
+    // accounts changed earlier in this transaction are not in the tally yet
+    bool fromAccounts = delta.hasPendingInflationVotes();
+    if (app.getConfig().VERIFY_INFLATION_VOTES &&
+        db.isTrackingInflationVotes() && !fromAccounts)
+    {
+        AccountFrame::checkInflationVotes(db);
+    }
+
     AccountFrame::processForInflation(
         [&](AccountFrame::InflationVotes const& votes) {
             if (votes.mVotes >= minBalance)
@@ -73,7 +82,7 @@ InflationOpFrame::doApply(Application& app, LedgerDelta& delta,
             }
             return false;
         },
-        INFLATION_NUM_WINNERS, db);
+        INFLATION_NUM_WINNERS, db, fromAccounts);
 
     auto inflationAmount = bigDivide(lcl.totalCoins, INFLATION_RATE_TRILLIONTHS,
                                      TRILLION, ROUND_DOWN);
@@ -2,12 +2,14 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "database/Database.h"
 #include "herder/LedgerCloseData.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerManager.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/Config.h"
+#include "main/PersistentState.h"
 #include "test/TestAccount.h"
 #include "test/TestExceptions.h"
 #include "test/TestMarket.h"
@@ -632,3 +634,115 @@ TEST_CASE("inflation", "[tx][inflation]")
         }
     }
 }
+
+TEST_CASE("inflation votes tally", "[tx][inflation]")
+{
+    Config cfg = getTestConfig(0);
+    cfg.VERIFY_INFLATION_VOTES = true;
+
+    VirtualClock clock;
+    clock.setCurrentTime(VirtualClock::from_time_t(getTestDate(1, 7, 2014)));
+    auto app = createTestApplication(clock, cfg);
+    app->start();
+
+    auto& db = app->getDatabase();
+    auto root = TestAccount::createRoot(*app);
+
+    const int64 minVote = 1000000000LL;
+    auto a1 = root.create("A1", 10 * minVote);
+    auto a2 = root.create("A2", 10 * minVote);
+    auto a3 = root.create("A3", 10 * minVote);
+    a1.setOptions(setInflationDestination(a3));
+    a2.setOptions(setInflationDestination(a3));
+    a3.setOptions(setInflationDestination(a1));
+
+    auto loadVotes = [&](bool fromAccounts) {
+        std::vector<std::pair<AccountID, int64>> votes;
+        AccountFrame::processForInflation(
+            [&](AccountFrame::InflationVotes const& v) {
+                votes.emplace_back(v.mInflationDest, v.mVotes);
+                return true;
+            },
+            maxWinners, db, fromAccounts);
+        return votes;
+    };
+    auto checkVotes = [&]() {
+        REQUIRE_NOTHROW(AccountFrame::checkInflationVotes(db));
+        REQUIRE(loadVotes(false) == loadVotes(true));
+    };
+
+    checkVotes();
+    REQUIRE(loadVotes(false).size() == 2);
+
+    SECTION("follows account changes")
+    {
+        a1.pay(a2, 2 * minVote);
+        checkVotes();
+
+        a2.setOptions(setInflationDestination(a1));
+        checkVotes();
+
+        // rolled back by the failed second operation
+        auto tx = a1.tx({payment(a2, minVote), payment(a3, 100 * minVote)});
+        REQUIRE(!applyCheck(tx, *app));
+        checkVotes();
+
+        // a1 drops below the minimum balance to vote
+        a1.pay(root, a1.getBalance() - minVote / 2);
+        checkVotes();
+
+        a2.merge(a3);
+        checkVotes();
+        REQUIRE(loadVotes(false).size() == 1);
+    }
+
+    SECTION("rebuild repairs the tally")
+    {
+        db.getSession() << "UPDATE inflationvotes SET votes = votes + 1";
+        REQUIRE_THROWS_AS(AccountFrame::checkInflationVotes(db),
+                          std::runtime_error);
+        AccountFrame::rebuildInflationVotes(db);
+        checkVotes();
+    }
+
+    SECTION("written once the transaction commits")
+    {
+        auto tallied = loadVotes(false);
+        LedgerDelta ledgerDelta(
+            app->getLedgerManager().getCurrentLedgerHeader(), db);
+        {
+            LedgerDelta txDelta(ledgerDelta);
+            auto a = AccountFrame::loadAccount(txDelta, a1.getPublicKey(), db);
+            a->getAccount().balance += minVote;
+            a->storeChange(txDelta, db);
+            REQUIRE(txDelta.hasPendingInflationVotes());
+            REQUIRE(loadVotes(false) == tallied);
+            txDelta.commit();
+        }
+        REQUIRE(!ledgerDelta.hasPendingInflationVotes());
+        checkVotes();
+    }
+
+    SECTION("stale tally rebuilt on startup")
+    {
+        auto& ps = app->getPersistentState();
+        db.setTrackingInflationVotes(false);
+        REQUIRE(ps.getState(PersistentState::kInflationVotesDirty) == "true");
+        a1.pay(a2, 2 * minVote);
+        REQUIRE_THROWS_AS(AccountFrame::checkInflationVotes(db),
+                          std::runtime_error);
+
+        // as after a crash in the middle of bucket apply: every startup path,
+        // offline catchup included, loads the last known ledger first
+        app->getLedgerManager().loadLastKnownLedger(nullptr);
+        REQUIRE(ps.getState(PersistentState::kInflationVotesDirty) == "false");
+        REQUIRE_NOTHROW(AccountFrame::checkInflationVotes(db));
+    }
+
+    SECTION("verify mode stops inflation on a wrong tally")
+    {
+        closeLedgerOn(*app, 2, 21, 7, 2014);
+        db.getSession() << "UPDATE inflationvotes SET votes = votes + 1";
+        REQUIRE_THROWS_AS(root.inflation(), std::runtime_error);
+    }
+}
@@ -143,15 +143,47 @@ ManageOfferOpFrame::doApply(Application& app, LedgerDelta& delta,
         return false;
     }
 
+    // The operations after this one in the transaction still run when it
+    // fails, so a failed offer must leave SQL as it found it: through a
+    // savepoint where the database needs one, and otherwise by having
+    // tempDelta write back the state it changed.
+    std::unique_ptr<soci::transaction> sqlTx;
+    if (db.needsSavepoints())
+    {
+        sqlTx = std::make_unique<soci::transaction>(db.getSession());
+    }
+    LedgerDelta tempDelta(delta, !sqlTx);
+
+    if (!applyOffer(app, tempDelta, ledgerManager))
+    {
+        tempDelta.rollback();
+        return false;
+    }
+
+    if (sqlTx)
+    {
+        sqlTx->commit();
+    }
+    tempDelta.commit();
+
+    app.getMetrics()
+        .NewMeter({"op-create-offer", "success", "apply"}, "operation")
+        .Mark();
+    return true;
+}
+
+bool
+ManageOfferOpFrame::applyOffer(Application& app, LedgerDelta& tempDelta,
+                               LedgerManager& ledgerManager)
+{
+    Database& db = ledgerManager.getDatabase();
+
     Asset const& sheep = mManageOffer.selling;
     Asset const& wheat = mManageOffer.buying;
 
     bool creatingNewOffer = false;
     uint64_t offerID = mManageOffer.offerID;
 
-    soci::transaction sqlTx(db.getSession());
-    LedgerDelta tempDelta(delta);
-
     if (offerID)
     { // modifying an old offer
         mSellSheepOffer =
@@ -470,12 +502,6 @@ ManageOfferOpFrame::doApply(Application& app, LedgerDelta& delta,
         }
     }
 
-    sqlTx.commit();
-    tempDelta.commit();
-
-    app.getMetrics()
-        .NewMeter({"op-create-offer", "success", "apply"}, "operation")
-        .Mark();
     return true;
 }
 
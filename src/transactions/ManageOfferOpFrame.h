@@ -20,6 +20,11 @@ class ManageOfferOpFrame : public OperationFrame
     bool checkOfferValid(medida::MetricsRegistry& metrics, Database& db,
                          LedgerDelta& delta);
 
+    // crosses the offer and stores what is left of it; on failure, tempDelta
+    // may already hold writes that the caller must roll back
+    bool applyOffer(Application& app, LedgerDelta& tempDelta,
+                    LedgerManager& ledgerManager);
+
     ManageOfferResult&
     innerResult()
     {
@@ -8,16 +8,21 @@
 #include "lib/util/uint128_t.h"
 #include "main/Application.h"
 #include "main/Config.h"
+#include "soci-sqlite3.h"
 #include "test/TestAccount.h"
 #include "test/TestExceptions.h"
 #include "test/TestMarket.h"
 #include "test/TestUtils.h"
 #include "test/TxTests.h"
 #include "test/test.h"
+#include "transactions/ManageOfferOpFrame.h"
 #include "transactions/OfferExchange.h"
+#include "transactions/PaymentOpFrame.h"
 #include "util/Logging.h"
 #include "util/Timer.h"
 #include "util/format.h"
+#include <algorithm>
+#include <chrono>
 
 using namespace stellar;
 using namespace stellar::txtest;
@@ -2935,3 +2940,177 @@ TEST_CASE("liabilities match created offer", "[tx][offers]")
     // NOTE: Starting in version 10, it is not possible to create an offer that
     // initially exceeds limits.
 }
+
+TEST_CASE("failed offer is undone before the next operation", "[tx][offers]")
+{
+    Config cfg = getTestConfig(0);
+    SECTION("rolled back through LedgerDelta")
+    {
+    }
+    SECTION("rolled back through a savepoint")
+    {
+        cfg.ARTIFICIALLY_USE_SAVEPOINTS_FOR_TESTING = true;
+    }
+
+    VirtualClock clock;
+    auto app = createTestApplication(clock, cfg);
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    int64_t const minBalance = app->getLedgerManager().getMinBalance(3) +
+                               100 * app->getLedgerManager().getTxFee();
+    auto issuer = root.create("issuer", minBalance);
+    auto xlm = makeNativeAsset();
+    auto usd = issuer.asset("USD");
+
+    auto a1 = root.create("A", minBalance + 1000);
+    auto b1 = root.create("B", minBalance + 1000);
+    a1.changeTrust(usd, 1000);
+    b1.changeTrust(usd, 1000);
+    issuer.pay(a1, usd, 100);
+    issuer.pay(b1, usd, 100);
+
+    // the book sells USD for 1 XLM from A, then for 2 XLM from B
+    auto aOffer = a1.manageOffer(0, usd, xlm, Price{1, 1}, 100);
+    b1.manageOffer(0, usd, xlm, Price{2, 1}, 100);
+    auto aOfferBefore = a1.loadOffer(aOffer);
+    auto bBalance = b1.getBalance();
+
+    // B's offer takes all of A's offer and then fails on its own one. All
+    // B's USD is promised to its offer, so the payment can only succeed if
+    // the USD bought from A were left in place.
+    auto tx = b1.tx({manageOffer(0, xlm, usd, Price{1, 2}, 300),
+                     payment(a1, usd, 100)});
+    REQUIRE(!applyCheck(tx, *app));
+
+    auto const& results = tx->getResult().result.results();
+    REQUIRE(ManageOfferOpFrame::getInnerCode(results[0]) ==
+            MANAGE_OFFER_CROSS_SELF);
+    REQUIRE(PaymentOpFrame::getInnerCode(results[1]) == PAYMENT_UNDERFUNDED);
+
+    REQUIRE(a1.hasOffer(aOffer));
+    REQUIRE(a1.loadOffer(aOffer) == aOfferBefore);
+    REQUIRE(a1.loadTrustLine(usd).balance == 100);
+    REQUIRE(b1.loadTrustLine(usd).balance == 100);
+    REQUIRE(b1.getBalance() == bBalance - tx->getFee());
+}
+
+TEST_CASE("offer ledger close bench", "[tx][offers][bench][!hide]")
+{
+    // SQLite only: statements are counted through its trace hook, which also
+    // sees the savepoint statements that never reach the query meter. The
+    // savepoint way of rolling back, which is what PostgreSQL always uses,
+    // is run as well to compare against.
+    struct StatementCounts
+    {
+        uint64_t all{0};
+        uint64_t savepoints{0};
+    };
+    size_t const nAccounts = 500;
+    size_t const nLedgers = 10;
+
+    auto run = [&](bool useSavepoints, std::chrono::nanoseconds& totalTime) {
+        VirtualClock clock;
+        Config cfg = getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE);
+        cfg.ARTIFICIALLY_USE_SAVEPOINTS_FOR_TESTING = useSavepoints;
+        auto app = createTestApplication(clock, cfg);
+        app->start();
+
+        StatementCounts counts;
+        auto be = dynamic_cast<soci::sqlite3_session_backend*>(
+            app->getDatabase().getSession().get_backend());
+        REQUIRE(be);
+        sqlite_api::sqlite3_trace_v2(
+            be->conn_, SQLITE_TRACE_STMT,
+            [](unsigned, void* ctx, void*, void* x) -> int {
+                auto c = static_cast<StatementCounts*>(ctx);
+                std::string sql(static_cast<char const*>(x));
+                ++c->all;
+                if (sql.find("SAVEPOINT") != std::string::npos)
+                {
+                    ++c->savepoints;
+                }
+                return 0;
+            },
+            &counts);
+
+        auto root = TestAccount::createRoot(*app);
+        int64_t txfee = app->getLedgerManager().getTxFee();
+        int64_t const balance =
+            app->getLedgerManager().getMinBalance(100) + 1000 * txfee;
+
+        auto issuer = root.create("issuer", balance);
+        auto xlm = makeNativeAsset();
+        auto usd = issuer.asset("USD");
+
+        std::vector<TestAccount> traders;
+        for (size_t i = 0; i < nAccounts; ++i)
+        {
+            traders.emplace_back(
+                root.create(fmt::format("trader{}", i), balance));
+            traders.back().changeTrust(usd, INT64_MAX);
+        }
+
+        auto& lm = app->getLedgerManager();
+        StatementCounts total;
+        totalTime = std::chrono::nanoseconds{0};
+        for (size_t l = 0; l < nLedgers; ++l)
+        {
+            // Every tenth transaction creates an offer and then fails on an
+            // offer that does not exist, so that undoing the SQL writes of
+            // failed transactions is part of what is measured.
+            std::vector<TransactionFramePtr> txs;
+            for (size_t i = 0; i < traders.size(); ++i)
+            {
+                std::vector<Operation> ops{
+                    manageOffer(0, xlm, usd, Price{1, 1}, 100)};
+                if (i % 10 == 0)
+                {
+                    ops.push_back(manageOffer(UINT64_MAX, xlm, usd,
+                                              Price{1, 1}, 100));
+                }
+                txs.push_back(traders[i].tx(ops));
+            }
+
+            auto before = counts;
+            auto start = std::chrono::steady_clock::now();
+            auto r = closeLedgerOn(*app, lm.getLedgerNum(), 1, 1,
+                                   2017 + int(l), txs);
+            totalTime += std::chrono::steady_clock::now() - start;
+            total.all += counts.all - before.all;
+            total.savepoints += counts.savepoints - before.savepoints;
+
+            REQUIRE(std::count_if(r.begin(), r.end(), [](auto const& res) {
+                        return res.first.result.result.code() == txFAILED;
+                    }) == int(nAccounts / 10));
+        }
+        sqlite_api::sqlite3_trace_v2(be->conn_, 0, nullptr, nullptr);
+        return total;
+    };
+
+    std::chrono::nanoseconds deltaTime, savepointTime;
+    auto withDelta = run(false, deltaTime);
+    auto withSavepoints = run(true, savepointTime);
+
+    // With a savepoint around every transaction and every offer, each
+    // transaction here issues at least four savepoint statements; rolling
+    // back through LedgerDelta leaves only a fixed number per ledger, at the
+    // cost of reading back entries the deltas have not seen yet.
+    REQUIRE(withSavepoints.savepoints / nLedgers >= 4 * nAccounts);
+    REQUIRE(withDelta.savepoints / nLedgers < nAccounts);
+
+    auto report = [&](char const* name, StatementCounts const& counts,
+                      std::chrono::nanoseconds time) {
+        LOG(INFO) << name << ": closed " << nLedgers << " ledgers of "
+                  << nAccounts << " offer transactions: "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                         time)
+                             .count() /
+                         nLedgers
+                  << "ms, " << counts.all / nLedgers
+                  << " statements of which " << counts.savepoints / nLedgers
+                  << " savepoint statements per ledger";
+    };
+    report("LedgerDelta rollback", withDelta, deltaTime);
+    report("Savepoint rollback", withSavepoints, savepointTime);
+}
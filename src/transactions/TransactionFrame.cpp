@@ -7,6 +7,7 @@
 #include "OperationFrame.h"
 #include "crypto/Hex.h"
 #include "crypto/SHA.h"
+#include "crypto/SecretKey.h"
 #include "crypto/SignerKey.h"
 #include "database/Database.h"
 #include "database/DatabaseUtils.h"
@@ -28,6 +29,7 @@
 #include "medida/metrics_registry.h"
 
 #include <algorithm>
+#include <memory>
 #include <numeric>
 
 namespace stellar
@@ -70,6 +72,30 @@ TransactionFrame::getContentsHash() const
     return (mContentsHash);
 }
 
+void
+TransactionFrame::prefetchSignatures() const
+{
+    auto const& hash = getContentsHash();
+    std::vector<PublicKey const*> keys{&mEnvelope.tx.sourceAccount};
+    for (auto const& op : mEnvelope.tx.operations)
+    {
+        if (op.sourceAccount)
+        {
+            keys.push_back(op.sourceAccount.get());
+        }
+    }
+    for (auto const& sig : mEnvelope.signatures)
+    {
+        for (auto key : keys)
+        {
+            if (SignatureUtils::doesHintMatch(key->ed25519(), sig.hint))
+            {
+                PubKeyUtils::verifySig(*key, sig.signature, hash);
+            }
+        }
+    }
+}
+
 void
 TransactionFrame::clearCached()
 {
@@ -577,53 +603,83 @@ TransactionFrame::applyOperations(SignatureChecker& signatureChecker,
     bool errorEncountered = false;
 
     {
-        // shield outer scope of any side effects by using
-        // a sql transaction for ledger state and LedgerDelta
-        soci::transaction sqlTx(app.getDatabase().getSession());
-        LedgerDelta thisTxOpsDelta(delta);
-
-        auto& opTimer =
-            app.getMetrics().NewTimer({"transaction", "op", "apply"});
-
-        for (auto& op : mOperations)
+        // shield outer scope of any side effects. Without a savepoint,
+        // rolling back thisTxOpsDelta also reverts what was written to SQL.
+        auto& db = app.getDatabase();
+        std::unique_ptr<soci::transaction> sqlTx;
+        if (db.needsSavepoints())
         {
-            auto time = opTimer.TimeScope();
-            LedgerDelta opDelta(thisTxOpsDelta);
-            bool txRes = op->apply(signatureChecker, opDelta, app);
+            sqlTx = std::make_unique<soci::transaction>(db.getSession());
+        }
+        LedgerDelta thisTxOpsDelta(delta, !sqlTx);
 
-            if (!txRes)
+        auto rollback = [&]() {
+            thisTxOpsDelta.rollback();
+            if (sqlTx)
             {
-                errorEncountered = true;
+                sqlTx->rollback();
             }
-            if (!errorEncountered)
+        };
+
+        try
+        {
+            auto& opTimer =
+                app.getMetrics().NewTimer({"transaction", "op", "apply"});
+
+            for (auto& op : mOperations)
             {
-                app.getInvariantManager().checkOnOperationApply(
-                    op->getOperation(), op->getResult(), opDelta);
+                auto time = opTimer.TimeScope();
+                LedgerDelta opDelta(thisTxOpsDelta);
+                bool txRes = op->apply(signatureChecker, opDelta, app);
+
+                if (!txRes)
+                {
+                    errorEncountered = true;
+                }
+                if (!errorEncountered)
+                {
+                    app.getInvariantManager().checkOnOperationApply(
+                        op->getOperation(), op->getResult(), opDelta);
+                }
+                meta.operations.emplace_back(opDelta.getChanges());
+                opDelta.commit();
             }
-            meta.operations.emplace_back(opDelta.getChanges());
-            opDelta.commit();
-        }
 
-        if (!errorEncountered)
-        {
-            if (app.getLedgerManager().getCurrentLedgerVersion() < 10)
+            if (!errorEncountered)
             {
-                if (!signatureChecker.checkAllSignaturesUsed())
+                if (app.getLedgerManager().getCurrentLedgerVersion() < 10)
                 {
-                    getResult().result.code(txBAD_AUTH_EXTRA);
-                    // this should never happen: malformed transaction should
-                    // not be accepted by nodes
-                    return false;
+                    if (!signatureChecker.checkAllSignaturesUsed())
+                    {
+                        getResult().result.code(txBAD_AUTH_EXTRA);
+                        rollback();
+                        // this should never happen: malformed transaction
+                        // should not be accepted by nodes
+                        return false;
+                    }
+
+                    // if an error occurred, it is responsibility of account's
+                    // owner to remove that signer
+                    removeUsedOneTimeSignerKeys(signatureChecker,
+                                                thisTxOpsDelta,
+                                                app.getLedgerManager());
                 }
 
-                // if an error occurred, it is responsibility of account's owner
-                // to remove that signer
-                removeUsedOneTimeSignerKeys(signatureChecker, thisTxOpsDelta,
-                                            app.getLedgerManager());
+                if (sqlTx)
+                {
+                    sqlTx->commit();
+                }
+                thisTxOpsDelta.commit();
             }
-
-            sqlTx.commit();
-            thisTxOpsDelta.commit();
+            else
+            {
+                rollback();
+            }
+        }
+        catch (...)
+        {
+            rollback();
+            throw;
         }
     }
 
@@ -100,6 +100,13 @@ class TransactionFrame
     Hash const& getFullHash() const;
     Hash const& getContentsHash() const;
 
+    // Verifies the signatures whose hint matches the source account of the
+    // transaction or of one of its operations, so that checking the
+    // transaction later finds them in the signature cache. Once the contents
+    // hash is computed this only reads the frame, and can run on a worker
+    // thread.
+    void prefetchSignatures() const;
+
     std::vector<std::shared_ptr<OperationFrame>> const&
     getOperations() const
     {
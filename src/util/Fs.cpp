@@ -6,6 +6,7 @@
 #include "crypto/Hex.h"
 #include "lib/util/format.h"
 #include "util/Logging.h"
+#include <fstream>
 #include <map>
 #include <regex>
 #include <sstream>
@@ -13,10 +14,13 @@
 #ifdef _WIN32
 #include <direct.h>
 #include <filesystem>
+#include <sys/stat.h>
+#include <sys/utime.h>
 #else
 #include <dirent.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <utime.h>
 #endif
 
 #include <cstdio>
@@ -27,6 +31,25 @@ namespace stellar
 namespace fs
 {
 
+namespace
+{
+
+bool
+copyFile(std::string const& from, std::string const& to)
+{
+    {
+        std::ifstream in(from, std::ifstream::binary);
+        std::ofstream out(to, std::ofstream::binary | std::ofstream::trunc);
+        if (in && out && (out << in.rdbuf()) && out.flush())
+        {
+            return true;
+        }
+    }
+    std::remove(to.c_str());
+    return false;
+}
+}
+
 #ifdef _WIN32
 #include <Shellapi.h>
 #include <Windows.h>
@@ -143,6 +166,35 @@ findfiles(std::string const& p,
     return res;
 }
 
+bool
+fileStat(std::string const& path, uint64_t& size, std::time_t& mtime)
+{
+    struct _stat64 buf;
+    if (_stat64(path.c_str(), &buf) != 0 || !(buf.st_mode & _S_IFREG))
+    {
+        return false;
+    }
+    size = static_cast<uint64_t>(buf.st_size);
+    mtime = buf.st_mtime;
+    return true;
+}
+
+bool
+touch(std::string const& path)
+{
+    return _utime(path.c_str(), nullptr) == 0;
+}
+
+bool
+linkOrCopy(std::string const& from, std::string const& to)
+{
+    if (CreateHardLinkA(to.c_str(), from.c_str(), nullptr))
+    {
+        return true;
+    }
+    return !exists(to) && copyFile(from, to);
+}
+
 long
 getCurrentPid()
 {
@@ -328,6 +380,36 @@ findfiles(std::string const& path,
     }
 }
 
+bool
+fileStat(std::string const& path, uint64_t& size, std::time_t& mtime)
+{
+    struct stat buf;
+    if (stat(path.c_str(), &buf) != 0 || !S_ISREG(buf.st_mode))
+    {
+        return false;
+    }
+    size = static_cast<uint64_t>(buf.st_size);
+    mtime = buf.st_mtime;
+    return true;
+}
+
+bool
+touch(std::string const& path)
+{
+    return utime(path.c_str(), nullptr) == 0;
+}
+
+bool
+linkOrCopy(std::string const& from, std::string const& to)
+{
+    if (::link(from.c_str(), to.c_str()) == 0)
+    {
+        return true;
+    }
+    // EXDEV, or a filesystem that has no hard links at all
+    return errno != EEXIST && errno != ENOENT && copyFile(from, to);
+}
+
 long
 getCurrentPid()
 {
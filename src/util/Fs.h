@@ -4,6 +4,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include <ctime>
 #include <functional>
 #include <string>
 #include <vector>
@@ -42,6 +43,17 @@ bool mkdir(std::string const& path);
 // Make a dir path like mkdir -p, i.e. recursive, uses '/' as dir separator
 bool mkpath(std::string const& path);
 
+// Size in bytes and last modification time of a regular file; false if it
+// cannot be read
+bool fileStat(std::string const& path, uint64_t& size, std::time_t& mtime);
+
+// Set the modification time of a file to now
+bool touch(std::string const& path);
+
+// Hard-link `to` to `from`, falling back to a copy if they are on different
+// filesystems; `to` must not exist yet
+bool linkOrCopy(std::string const& from, std::string const& to);
+
 // Get list of all files with names matching predicate
 // Returned names are relative to path
 std::vector<std::string>
@@ -24,6 +24,8 @@ class XDRInputFileStream
     std::ifstream mIn;
     std::vector<char> mBuf;
     unsigned int mSizeLimit;
+    // offset of the next object, tracked here as tellg() is slow
+    size_t mPos{0};
 
   public:
     XDRInputFileStream(unsigned int sizeLimit = 0) : mSizeLimit{sizeLimit}
@@ -40,6 +42,7 @@ class XDRInputFileStream
     open(std::string const& filename)
     {
         mIn.open(filename, std::ifstream::binary);
+        mPos = 0;
         if (!mIn)
         {
             std::string msg("failed to open XDR file: ");
@@ -56,6 +59,22 @@ class XDRInputFileStream
         return mIn.good();
     }
 
+    // Return the offset of the next object to be read.
+    size_t
+    pos() const
+    {
+        return mPos;
+    }
+
+    // Reposition the stream so the next object read is the one at `offset`.
+    void
+    seek(size_t offset)
+    {
+        mIn.clear();
+        mIn.seekg(offset);
+        mPos = offset;
+    }
+
     template <typename T>
     bool
     readOne(T& out)
@@ -89,6 +108,7 @@ class XDRInputFileStream
         {
             throw xdr::xdr_runtime_error("malformed XDR file");
         }
+        mPos += 4 + sz;
         xdr::xdr_get g(mBuf.data(), mBuf.data() + sz);
         xdr::xdr_argpack_archive(g, out);
         return true;
@@ -90,7 +90,16 @@ enum MessageType
     GET_SCP_STATE = 12,
 
     // new messages
-    HELLO = 13
+    HELLO = 13,
+
+    // pull-mode transaction flooding, from overlay version 8
+    FLOOD_ADVERT = 14, // announces transactions by hash
+    FLOOD_DEMAND = 15, // requests announced transactions
+
+    // compact tx set transfer, from overlay version 9
+    COMPACT_TX_SET = 16, // answers GET_TX_SET with transaction hashes
+    GET_TX_SET_TXS = 17, // requests the transactions of a tx set not known
+    TX_SET_TXS = 18
 };
 
 struct DontHave
@@ -99,6 +108,42 @@ struct DontHave
     uint256 reqHash;
 };
 
+const TX_ADVERT_VECTOR_MAX_SIZE = 1000;
+typedef Hash TxAdvertVector<TX_ADVERT_VECTOR_MAX_SIZE>;
+
+struct FloodAdvert
+{
+    TxAdvertVector txHashes;
+};
+
+const TX_DEMAND_VECTOR_MAX_SIZE = 1000;
+typedef Hash TxDemandVector<TX_DEMAND_VECTOR_MAX_SIZE>;
+
+struct FloodDemand
+{
+    TxDemandVector txHashes;
+};
+
+// a tx set, with its transactions identified by their full hash
+struct CompactTransactionSet
+{
+    Hash txSetHash;
+    Hash previousLedgerHash;
+    Hash txHashes<>;
+};
+
+struct GetTxSetTransactions
+{
+    Hash txSetHash;
+    Hash txHashes<>;
+};
+
+struct TxSetTransactions
+{
+    Hash txSetHash;
+    TransactionEnvelope txs<>;
+};
+
 union StellarMessage switch (MessageType type)
 {
 case ERROR_MSG:
@@ -131,6 +176,18 @@ case SCP_MESSAGE:
     SCPEnvelope envelope;
 case GET_SCP_STATE:
     uint32 getSCPLedgerSeq; // ledger seq requested ; if 0, requests the latest
+
+case FLOOD_ADVERT:
+    FloodAdvert floodAdvert;
+case FLOOD_DEMAND:
+    FloodDemand floodDemand;
+
+case COMPACT_TX_SET:
+    CompactTransactionSet compactTxSet;
+case GET_TX_SET_TXS:
+    GetTxSetTransactions getTxSetTxs;
+case TX_SET_TXS:
+    TxSetTransactions txSetTxs;
 };
 
 union AuthenticatedMessage switch (uint32 v)